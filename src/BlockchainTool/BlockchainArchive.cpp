@@ -0,0 +1,241 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "BlockchainArchive.h"
+
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "Common/StdInputStream.h"
+#include "Common/StdOutputStream.h"
+#include "Common/StreamTools.h"
+#include "crypto/hash.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+
+#include <Logging/LoggerRef.h>
+
+using namespace Logging;
+
+namespace CryptoNote {
+
+namespace {
+
+const char ARCHIVE_MAGIC[8] = { 'F', 'U', 'E', 'G', 'O', 'B', 'C', 'A' };
+const uint32_t ARCHIVE_VERSION = 2;
+// a damaged size must not turn into a huge allocation
+const uint64_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+const size_t IMPORT_BATCH_SIZE = 100;
+const uint32_t PROGRESS_INTERVAL = 10000;
+
+struct ImportedBlock {
+  uint32_t height;
+  Block block;
+  std::vector<Transaction> transactions;
+  Crypto::Hash proofOfWork;
+};
+
+uint32_t blockChecksum(const uint8_t* data, size_t size) {
+  Crypto::Hash hash;
+  Crypto::cn_fast_hash(data, size, hash);
+
+  uint32_t checksum;
+  std::memcpy(&checksum, hash.data, sizeof(checksum));
+  return checksum;
+}
+
+// Returns an empty batch at the end of the archive
+void readBatch(BlockchainArchiveReader& reader, uint32_t& height, std::vector<ImportedBlock>& batch) {
+  batch.clear();
+  BinaryArray rawBlock;
+  while (batch.size() < IMPORT_BATCH_SIZE && reader.read(rawBlock)) {
+    batch.emplace_back();
+    ImportedBlock& imported = batch.back();
+    imported.height = height++;
+    imported.proofOfWork = NULL_HASH;
+    if (!Blockchain::parseRawBlock(Common::ArrayView<uint8_t>(rawBlock.data(), rawBlock.size()), imported.block, imported.transactions)) {
+      throw std::runtime_error("Failed to parse block at height " + std::to_string(imported.height));
+    }
+  }
+}
+
+// The slow hash doesn't depend on the chain, only the comparison with the difficulty has to wait for the commit
+void computeProofsOfWork(core& ccore, std::vector<ImportedBlock>& batch) {
+  std::vector<const Block*> blocks;
+  for (const ImportedBlock& imported : batch) {
+    blocks.push_back(&imported.block);
+  }
+
+  std::vector<Crypto::Hash> proofsOfWork = ccore.computeProofsOfWork(blocks);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    batch[i].proofOfWork = proofsOfWork[i];
+  }
+}
+
+}
+
+BlockchainArchiveWriter::BlockchainArchiveWriter(const std::string& fileName, uint32_t startHeight) :
+  m_file(fileName, std::ios::binary | std::ios::trunc) {
+  if (!m_file) {
+    throw std::runtime_error("Can't create " + fileName);
+  }
+
+  Common::StdOutputStream out(m_file);
+  Common::write(out, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+  Common::write(out, ARCHIVE_VERSION);
+  Common::write(out, startHeight);
+}
+
+void BlockchainArchiveWriter::write(Common::ArrayView<uint8_t> rawBlock) {
+  Common::StdOutputStream out(m_file);
+  Common::writeVarint(out, rawBlock.getSize());
+  Common::write(out, rawBlock.getData(), rawBlock.getSize());
+  Common::write(out, blockChecksum(rawBlock.getData(), rawBlock.getSize()));
+}
+
+void BlockchainArchiveWriter::flush() {
+  m_file.flush();
+  if (!m_file) {
+    throw std::runtime_error("Failed to write blockchain archive");
+  }
+}
+
+BlockchainArchiveReader::BlockchainArchiveReader(const std::string& fileName) :
+  m_file(fileName, std::ios::binary) {
+  if (!m_file) {
+    throw std::runtime_error("Can't open " + fileName);
+  }
+
+  Common::StdInputStream in(m_file);
+  char magic[sizeof(ARCHIVE_MAGIC)];
+  Common::read(in, magic, sizeof(magic));
+  if (std::memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) != 0) {
+    throw std::runtime_error(fileName + " is not a blockchain archive");
+  }
+
+  uint32_t version;
+  Common::read(in, version);
+  if (version != ARCHIVE_VERSION) {
+    throw std::runtime_error("Unsupported blockchain archive version " + std::to_string(version));
+  }
+
+  Common::read(in, m_startHeight);
+}
+
+bool BlockchainArchiveReader::read(BinaryArray& rawBlock) {
+  if (m_file.peek() == std::ifstream::traits_type::eof()) {
+    return false;
+  }
+
+  Common::StdInputStream in(m_file);
+  uint64_t size;
+  Common::readVarint(in, size);
+  if (size > MAX_BLOCK_SIZE) {
+    throw std::runtime_error("Blockchain archive record is too large");
+  }
+
+  Common::read(in, rawBlock, static_cast<size_t>(size));
+  uint32_t checksum;
+  Common::read(in, checksum);
+  if (checksum != blockChecksum(rawBlock.data(), rawBlock.size())) {
+    throw std::runtime_error("Blockchain archive record checksum mismatch");
+  }
+
+  return true;
+}
+
+bool exportBlockchain(core& ccore, const std::string& fileName, uint32_t startHeight, ILogger& log) {
+  LoggerRef logger(log, "BlockchainArchive");
+  uint32_t height = ccore.get_current_blockchain_height();
+  if (startHeight >= height) {
+    logger(ERROR, BRIGHT_RED) << "Start height " << startHeight << " is above the blockchain height " << height;
+    return false;
+  }
+
+  logger(INFO) << "Exporting blocks " << startHeight << " - " << height - 1 << " to " << fileName;
+
+  // the stored blocks are copied as they are, nothing is deserialized
+  BlockchainArchiveWriter writer(fileName, startHeight);
+  for (uint32_t blockHeight = startHeight; blockHeight < height; ++blockHeight) {
+    writer.write(ccore.getRawBlock(blockHeight));
+    if ((blockHeight + 1) % PROGRESS_INTERVAL == 0) {
+      logger(INFO) << "Exported " << blockHeight + 1 << " / " << height;
+    }
+  }
+
+  writer.flush();
+  logger(INFO, BRIGHT_GREEN) << "Exported " << height - startHeight << " blocks";
+  return true;
+}
+
+bool importBlockchain(core& ccore, const std::string& fileName, ILogger& log) {
+  LoggerRef logger(log, "BlockchainArchive");
+  BlockchainArchiveReader reader(fileName);
+  uint32_t height = reader.startHeight();
+  if (height > ccore.get_current_blockchain_height()) {
+    logger(ERROR, BRIGHT_RED) << "Archive starts at height " << height << ", the blockchain has only " << ccore.get_current_blockchain_height() << " blocks";
+    return false;
+  }
+
+  logger(INFO) << "Importing " << fileName;
+
+  std::vector<ImportedBlock> current;
+  std::vector<ImportedBlock> next;
+  readBatch(reader, height, current);
+  computeProofsOfWork(ccore, current);
+
+  uint32_t imported = 0;
+  uint32_t skipped = 0;
+  auto importStart = std::chrono::steady_clock::now();
+  while (!current.empty()) {
+    // the next batch is read and hashed while the current one is committed in order
+    std::future<void> nextBatch = std::async(std::launch::async, [&] {
+      readBatch(reader, height, next);
+      computeProofsOfWork(ccore, next);
+    });
+
+    for (const ImportedBlock& block : current) {
+      block_verification_context bvc = boost::value_initialized<block_verification_context>();
+      ccore.importBlock(block.block, block.transactions, bvc, block.proofOfWork != NULL_HASH ? &block.proofOfWork : nullptr);
+      if (bvc.m_already_exists) {
+        ++skipped;
+      } else if (bvc.m_verification_failed || !bvc.m_added_to_main_chain) {
+        logger(ERROR, BRIGHT_RED) << "Block " << get_block_hash(block.block) << " at height " << block.height << " was rejected";
+        nextBatch.wait();
+        return false;
+      } else {
+        ++imported;
+        if (block.height % PROGRESS_INTERVAL == 0) {
+          logger(INFO) << "Imported " << block.height << " blocks";
+        }
+      }
+    }
+
+    nextBatch.get();
+    std::swap(current, next);
+  }
+
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - importStart).count();
+  logger(INFO, BRIGHT_GREEN) << "Imported " << imported << " blocks in " << seconds << " s, " << skipped << " blocks were already known";
+  return true;
+}
+
+}
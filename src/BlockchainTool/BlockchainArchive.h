@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "Common/ArrayView.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+
+#include <Logging/ILogger.h>
+
+namespace CryptoNote {
+
+class core;
+
+// Flat file holding a range of the main chain as the blocks are stored by Blockchain.
+//
+// header: "FUEGOBCA", uint32 version, uint32 height of the first block
+// record: varint size, block as returned by Blockchain::getRawBlock, uint32 checksum
+//
+// The checksum is the first four bytes of cn_fast_hash(block), it only guards against damaged files,
+// the blocks themselves are verified when they are imported. Only the block and its transactions
+// are taken from a record, the rest of the stored entry is computed again.
+
+class BlockchainArchiveWriter {
+public:
+  // Throws std::runtime_error if the file can't be created
+  BlockchainArchiveWriter(const std::string& fileName, uint32_t startHeight);
+
+  void write(Common::ArrayView<uint8_t> rawBlock);
+  void flush();
+
+private:
+  std::ofstream m_file;
+};
+
+class BlockchainArchiveReader {
+public:
+  // Throws std::runtime_error if the file can't be opened or isn't an archive
+  explicit BlockchainArchiveReader(const std::string& fileName);
+
+  uint32_t startHeight() const { return m_startHeight; }
+
+  // Returns false at the end of the file, throws std::runtime_error on a damaged record
+  bool read(BinaryArray& rawBlock);
+
+private:
+  std::ifstream m_file;
+  uint32_t m_startHeight;
+};
+
+// Writes the main chain from startHeight up to the top to the archive
+bool exportBlockchain(core& ccore, const std::string& fileName, uint32_t startHeight, Logging::ILogger& log);
+// Adds the blocks of the archive to the blockchain, the blocks it already has are skipped.
+// The slow hashes of the next blocks are computed on the verification pool while the current ones are added.
+bool importBlockchain(core& ccore, const std::string& fileName, Logging::ILogger& log);
+
+}
@@ -0,0 +1,173 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+// Exports the main chain to a blockchain archive and bootstraps a node from one, see BlockchainArchive.h
+
+#include <boost/program_options.hpp>
+
+#include "BlockchainArchive.h"
+
+#include "Common/CommandLine.h"
+#include "Common/Util.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "version.h"
+
+#include <Logging/LoggerManager.h>
+#include <Logging/LoggerRef.h>
+
+using Common::JsonValue;
+using namespace CryptoNote;
+using namespace Logging;
+
+namespace po = boost::program_options;
+
+namespace {
+
+const command_line::arg_descriptor<std::string> arg_export       = {"export", "Write the main chain to the given archive file", ""};
+const command_line::arg_descriptor<std::string> arg_import       = {"import", "Add the blocks of the given archive file to the blockchain", ""};
+const command_line::arg_descriptor<uint32_t>    arg_start_height = {"start-height", "Height of the first exported block", 0};
+const command_line::arg_descriptor<std::string> arg_verify       = {"verify", "Verification of imported blocks: checkpoints - trust blocks covered by checkpoints, "
+  "headers - check proof of work of every block but no ring signatures, full - check every block", "checkpoints"};
+const command_line::arg_descriptor<int>         arg_log_level    = {"log-level", "", 2}; // info level
+const command_line::arg_descriptor<bool>        arg_testnet_on   = {"testnet", "Use the testnet blockchain", false};
+
+JsonValue buildLoggerConfiguration(Level level) {
+  JsonValue loggerConfiguration(JsonValue::OBJECT);
+  loggerConfiguration.insert("globalLevel", static_cast<int64_t>(level));
+
+  JsonValue& cfgLoggers = loggerConfiguration.insert("loggers", JsonValue::ARRAY);
+
+  JsonValue& consoleLogger = cfgLoggers.pushBack(JsonValue::OBJECT);
+  consoleLogger.insert("type", "console");
+  consoleLogger.insert("level", static_cast<int64_t>(TRACE));
+  consoleLogger.insert("pattern", "%D %T %L ");
+
+  return loggerConfiguration;
+}
+
+bool parseVerification(const std::string& value, Blockchain::ImportVerification& verification) {
+  if (value == "checkpoints") {
+    verification = Blockchain::ImportVerification::TrustCheckpoints;
+  } else if (value == "headers") {
+    verification = Blockchain::ImportVerification::HeadersOnly;
+  } else if (value == "full") {
+    verification = Blockchain::ImportVerification::Full;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  LoggerManager logManager;
+  LoggerRef logger(logManager, "BlockchainTool");
+
+  try {
+    po::options_description desc_options("Allowed options");
+    command_line::add_arg(desc_options, command_line::arg_help);
+    command_line::add_arg(desc_options, command_line::arg_version);
+    command_line::add_arg(desc_options, command_line::arg_data_dir, Tools::getDefaultDataDirectory());
+    command_line::add_arg(desc_options, arg_export);
+    command_line::add_arg(desc_options, arg_import);
+    command_line::add_arg(desc_options, arg_start_height);
+    command_line::add_arg(desc_options, arg_verify);
+    command_line::add_arg(desc_options, arg_log_level);
+    command_line::add_arg(desc_options, arg_testnet_on);
+    CoreConfig::initOptions(desc_options);
+    MinerConfig::initOptions(desc_options);
+
+    po::variables_map vm;
+    bool r = command_line::handle_error_helper(desc_options, [&]() {
+      po::store(po::parse_command_line(argc, argv, desc_options), vm);
+      po::notify(vm);
+      return true;
+    });
+
+    if (!r) {
+      return 1;
+    }
+
+    if (command_line::get_arg(vm, command_line::arg_help)) {
+      std::cout << "Fuego || " << PROJECT_VERSION_LONG << ENDL;
+      std::cout << desc_options << std::endl;
+      return 0;
+    }
+
+    if (command_line::get_arg(vm, command_line::arg_version)) {
+      std::cout << "Fuego || " << PROJECT_VERSION_LONG << ENDL;
+      return 0;
+    }
+
+    std::string exportFile = command_line::get_arg(vm, arg_export);
+    std::string importFile = command_line::get_arg(vm, arg_import);
+    if (exportFile.empty() == importFile.empty()) {
+      std::cout << "Exactly one of --" << arg_export.name << " and --" << arg_import.name << " has to be given" << std::endl;
+      return 1;
+    }
+
+    Blockchain::ImportVerification verification;
+    if (!parseVerification(command_line::get_arg(vm, arg_verify), verification)) {
+      std::cout << "Unknown --" << arg_verify.name << " value, expected checkpoints, headers or full" << std::endl;
+      return 1;
+    }
+
+    Level cfgLogLevel = static_cast<Level>(static_cast<int>(Logging::ERROR) + command_line::get_arg(vm, arg_log_level));
+    logManager.configure(buildLoggerConfiguration(cfgLogLevel));
+
+    CryptoNote::CurrencyBuilder currencyBuilder(logManager);
+    currencyBuilder.testnet(command_line::get_arg(vm, arg_testnet_on));
+    CryptoNote::Currency currency = currencyBuilder.currency();
+    CryptoNote::core ccore(currency, nullptr, logManager, false, false);
+
+    CoreConfig coreConfig;
+    coreConfig.init(vm);
+    MinerConfig minerConfig;
+    minerConfig.init(vm);
+
+    if (!Tools::create_directories_if_necessary(coreConfig.configFolder)) {
+      logger(ERROR, BRIGHT_RED) << "Can't create directory: " << coreConfig.configFolder;
+      return 1;
+    }
+
+    logger(INFO) << "Initializing core...";
+    if (!ccore.init(coreConfig, minerConfig, true)) {
+      logger(ERROR, BRIGHT_RED) << "Failed to initialize core";
+      return 1;
+    }
+
+    bool success;
+    if (!exportFile.empty()) {
+      success = exportBlockchain(ccore, exportFile, command_line::get_arg(vm, arg_start_height), logManager);
+    } else {
+      ccore.setImportVerification(verification);
+      success = importBlockchain(ccore, importFile, logManager);
+    }
+
+    logger(INFO) << "Deinitializing core...";
+    ccore.deinit();
+    return success ? 0 : 1;
+  } catch (const std::exception& e) {
+    logger(ERROR, BRIGHT_RED) << "Exception: " << e.what();
+    return 1;
+  }
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "RecursiveSharedMutex.h"
+
+#include <cassert>
+#include <system_error>
+#include <unordered_map>
+
+namespace Tools {
+
+namespace {
+
+// Shared lock depth of the current thread, per mutex
+thread_local std::unordered_map<const RecursiveSharedMutex*, size_t> sharedDepths;
+
+}
+
+RecursiveSharedMutex::RecursiveSharedMutex() : m_depth(0) {
+}
+
+void RecursiveSharedMutex::lock() {
+  if (ownedByThisThread()) {
+    ++m_depth;
+    return;
+  }
+
+  if (sharedDepth() != 0) {
+    // the shared lock can't be upgraded, waiting for the exclusive one would never return
+    throw std::system_error(std::make_error_code(std::errc::resource_deadlock_would_occur),
+      "RecursiveSharedMutex: exclusive lock requested by a thread holding a shared lock");
+  }
+
+  std::lock_guard<std::mutex> gate(m_writerGate);
+  m_mutex.lock();
+  m_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+  m_depth = 1;
+}
+
+bool RecursiveSharedMutex::try_lock() {
+  if (ownedByThisThread()) {
+    ++m_depth;
+    return true;
+  }
+
+  if (sharedDepth() != 0) {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> gate(m_writerGate, std::try_to_lock);
+  if (!gate.owns_lock() || !m_mutex.try_lock()) {
+    return false;
+  }
+
+  m_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+  m_depth = 1;
+  return true;
+}
+
+void RecursiveSharedMutex::unlock() {
+  assert(ownedByThisThread());
+  assert(m_depth > 0);
+
+  if (--m_depth == 0) {
+    m_owner.store(std::thread::id(), std::memory_order_relaxed);
+    m_mutex.unlock();
+  }
+}
+
+void RecursiveSharedMutex::lock_shared() {
+  if (ownedByThisThread()) {
+    ++m_depth;
+    return;
+  }
+
+  size_t& depth = sharedDepths[this];
+  if (depth == 0) {
+    // nested shared locks skip the gate, the writer waits for them anyway
+    { std::lock_guard<std::mutex> gate(m_writerGate); }
+    m_mutex.lock_shared();
+  }
+
+  ++depth;
+}
+
+bool RecursiveSharedMutex::try_lock_shared() {
+  if (ownedByThisThread()) {
+    ++m_depth;
+    return true;
+  }
+
+  if (sharedDepth() == 0) {
+    std::unique_lock<std::mutex> gate(m_writerGate, std::try_to_lock);
+    if (!gate.owns_lock()) {
+      return false;
+    }
+
+    gate.unlock();
+    if (!m_mutex.try_lock_shared()) {
+      return false;
+    }
+  }
+
+  ++sharedDepths[this];
+  return true;
+}
+
+void RecursiveSharedMutex::unlock_shared() {
+  if (ownedByThisThread()) {
+    unlock();
+    return;
+  }
+
+  auto it = sharedDepths.find(this);
+  assert(it != sharedDepths.end() && it->second > 0);
+  if (--it->second == 0) {
+    sharedDepths.erase(it);
+    m_mutex.unlock_shared();
+  }
+}
+
+bool RecursiveSharedMutex::ownedByThisThread() const {
+  return m_owner.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+size_t RecursiveSharedMutex::sharedDepth() const {
+  auto it = sharedDepths.find(this);
+  return it == sharedDepths.end() ? 0 : it->second;
+}
+
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+namespace Tools {
+
+// Reader/writer mutex that may be locked again by a thread which already holds it.
+// The exclusive owner may take both exclusive and shared locks again, such locks count as exclusive.
+// A thread holding only shared locks may take more shared locks, but must not ask for the exclusive one,
+// that would deadlock. lock() throws std::system_error with resource_deadlock_would_occur instead, and
+// try_lock() fails.
+// A waiting exclusive lock keeps new readers out, so a steady stream of queries can't starve block application.
+// Satisfies Lockable and SharedLockable, so std::lock_guard, std::unique_lock and std::shared_lock work with it.
+class RecursiveSharedMutex {
+public:
+  RecursiveSharedMutex();
+
+  RecursiveSharedMutex(const RecursiveSharedMutex&) = delete;
+  RecursiveSharedMutex& operator=(const RecursiveSharedMutex&) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+  void lock_shared();
+  bool try_lock_shared();
+  void unlock_shared();
+
+private:
+  bool ownedByThisThread() const;
+  size_t sharedDepth() const;
+
+  // held by a thread waiting for the exclusive lock, readers pass it before they lock m_mutex
+  std::mutex m_writerGate;
+  std::shared_timed_mutex m_mutex;
+  std::atomic<std::thread::id> m_owner;
+  size_t m_depth;
+};
+
+}
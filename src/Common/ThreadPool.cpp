@@ -0,0 +1,127 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace Tools {
+
+ThreadPool::ThreadPool(size_t threadCount) : m_task(nullptr), m_count(0), m_next(0), m_pending(0), m_generation(0), m_stop(false) {
+  if (threadCount == 0) {
+    threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  m_threads.reserve(threadCount - 1);
+  for (size_t i = 1; i < threadCount; ++i) {
+    m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+
+  m_haveWork.notify_all();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::size() const {
+  return m_threads.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const Task& task) {
+  if (count == 0) {
+    return;
+  }
+
+  if (m_threads.empty() || count == 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i, 0);
+    }
+
+    return;
+  }
+
+  std::lock_guard<std::mutex> batchLock(m_batchMutex);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_count = count;
+    m_next = 0;
+    m_pending = m_threads.size();
+    m_error = nullptr;
+    ++m_generation;
+  }
+
+  m_haveWork.notify_all();
+  runTasks(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_workDone.wait(lock, [this] { return m_pending == 0; });
+  m_task = nullptr;
+
+  if (m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::workerLoop(size_t worker) {
+  uint64_t generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_haveWork.wait(lock, [&] { return m_stop || m_generation != generation; });
+      if (m_stop) {
+        return;
+      }
+
+      generation = m_generation;
+    }
+
+    runTasks(worker);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_pending == 0) {
+      m_workDone.notify_one();
+    }
+  }
+}
+
+void ThreadPool::runTasks(size_t worker) {
+  for (size_t i = m_next++; i < m_count; i = m_next++) {
+    try {
+      (*m_task)(i, worker);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) {
+        m_error = std::current_exception();
+      }
+
+      // skip the remaining indexes, the batch has failed anyway
+      m_next = m_count;
+    }
+  }
+}
+
+}
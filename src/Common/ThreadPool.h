@@ -0,0 +1,71 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Tools {
+
+// Fixed set of worker threads used to spread CPU bound verification work.
+// The thread calling parallelFor() takes part in the work, so a pool of size N
+// owns N - 1 threads and a pool of size 1 runs everything inline.
+class ThreadPool {
+public:
+  typedef std::function<void(size_t index, size_t worker)> Task;
+
+  // threadCount == 0 selects std::thread::hardware_concurrency()
+  explicit ThreadPool(size_t threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const;
+
+  // Calls task(index, worker) for every index in [0, count) and returns when all calls have finished.
+  // worker is in [0, size()) and is unique among concurrently running calls.
+  // The first exception thrown by a task is rethrown to the caller.
+  void parallelFor(size_t count, const Task& task);
+
+private:
+  void workerLoop(size_t worker);
+  void runTasks(size_t worker);
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_batchMutex;
+  std::mutex m_mutex;
+  std::condition_variable m_haveWork;
+  std::condition_variable m_workDone;
+
+  const Task* m_task;
+  size_t m_count;
+  std::atomic<size_t> m_next;
+  size_t m_pending;
+  uint64_t m_generation;
+  bool m_stop;
+  std::exception_ptr m_error;
+};
+
+}
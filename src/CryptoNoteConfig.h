@@ -126,7 +126,13 @@ namespace CryptoNote
 
 		const char CRYPTONOTE_BLOCKS_FILENAME[] = "blocks.dat";
  		const char CRYPTONOTE_BLOCKINDEXES_FILENAME[] = "blockindexes.dat";
+ 		const char CRYPTONOTE_BLOCKSTORE_FILENAME[] = "blockstore.dat";
+ 		const char CRYPTONOTE_BLOCKSTOREINDEX_FILENAME[] = "blockstoreindex.dat";
  		const char CRYPTONOTE_BLOCKSCACHE_FILENAME[] = "blockscache.dat";
+ 		const char CRYPTONOTE_SPENTKEYSINDEX_FILENAME[] = "spentkeysindex.dat";
+ 		const char CRYPTONOTE_TRANSACTIONSINDEX_FILENAME[] = "transactionsindex.dat";
+ 		const char CRYPTONOTE_OUTPUTSINDEX_FILENAME[] = "outputsindex.dat";
+ 		const char CRYPTONOTE_OUTPUTCOUNTSINDEX_FILENAME[] = "outputcountsindex.dat";
  		const char CRYPTONOTE_POOLDATA_FILENAME[] = "poolstate.bin";
  		const char P2P_NET_DATA_FILENAME[] = "p2pstate.bin";
  		const char CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME[] = "blockchainindices.dat";
@@ -153,6 +159,12 @@ namespace CryptoNote
 
 	const size_t BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT = 10000; // by default, blocks ids count in synchronizing
 	const size_t BLOCKS_SYNCHRONIZING_DEFAULT_COUNT = 128;		 // by default, blocks count in blocks downloading
+	const size_t BLOCKS_SYNCHRONIZING_MAX_COUNT = 500;		 // blocks count limit of a single block request
+	const size_t BLOCKS_SYNCHRONIZING_BATCH_SIZE = 2000000;	 // bytes a block request aims to download
+	const uint32_t BLOCKS_SYNCHRONIZING_BATCH_TIME = 5;		 // seconds a block request aims to be answered in
+	const size_t BLOCKS_SYNCHRONIZING_MAX_REQUESTS = 4;		 // block requests kept in flight per peer while synchronizing
+	const size_t BLOCKS_SYNCHRONIZING_WINDOW = 64;			 // block requests downloaded ahead of the first block not imported yet
+	const uint32_t BLOCKS_SYNCHRONIZING_TIMEOUT = 30;		 // seconds before a block request is given to another peer
 	const size_t COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT = 1000;
 
 	const int P2P_DEFAULT_PORT = 10808;
@@ -162,13 +174,30 @@ namespace CryptoNote
 	and the minimum version for communication between nodes */
 	const uint8_t P2P_VERSION_1 = 1;
 	const uint8_t P2P_VERSION_2 = 2;
-	const uint8_t P2P_CURRENT_VERSION = 1;
+	const uint8_t P2P_VERSION_4 = 4;
+	const uint8_t P2P_CURRENT_VERSION = 4;
 	const uint8_t P2P_MINIMUM_VERSION = 1;
 	const uint8_t P2P_UPGRADE_WINDOW = 2;
 
 	// This defines the minimum P2P version required for lite blocks propogation
 	const uint8_t P2P_LITE_BLOCKS_PROPOGATION_VERSION = 3;
 
+	// This defines the minimum P2P version required for relaying transactions by their hashes
+	const uint8_t P2P_TX_HASHES_RELAY_VERSION = P2P_VERSION_4;
+	const size_t P2P_TX_KNOWN_HASHES_LIMIT = 20000;			 // transactions remembered as known to a peer
+	const uint32_t P2P_TX_REQUEST_TIMEOUT = 10;				 // seconds before an announced transaction is requested from another peer
+	const size_t P2P_TX_REQUESTED_LIMIT = 20000;			 // announced transactions waiting for their bodies, the pool sketch catches up with the rest
+	const size_t P2P_TX_ANNOUNCERS_LIMIT = 8;				 // peers remembered per announced transaction
+
+	// This defines the minimum P2P version required for transaction pool synchronization by sketches
+	const uint8_t P2P_POOL_SKETCH_VERSION = P2P_VERSION_4;
+	const size_t TX_POOL_SKETCH_MIN_CELLS = 150;			 // cells of the first pool sketch, decodes a difference of about 100 transactions
+	const size_t TX_POOL_SKETCH_MAX_CELLS = 24000;			 // larger differences are synchronized by full hash lists
+
+	// This defines the minimum P2P version required for compact blocks propagation
+	const uint8_t P2P_COMPACT_BLOCKS_VERSION = P2P_VERSION_4;
+	const size_t COMPACT_BLOCK_SHORT_ID_SIZE = 6;			 // bytes of a transaction short id, keyed by the block hash and a salt
+
 	const size_t P2P_LOCAL_WHITE_PEERLIST_LIMIT = 1000;
 	const size_t P2P_LOCAL_GRAY_PEERLIST_LIMIT = 5000;
 
@@ -23,8 +23,11 @@
 #include <numeric>
 #include <cstdio>
 #include <cmath>
+#include <unordered_set>
+#include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include "Common/Math.h"
+#include "Common/ScopeExit.h"
 #include "Common/int-util.h"
 #include "Common/ShuffleGenerator.h"
 #include "Common/StdInputStream.h"
@@ -34,13 +37,18 @@
 #include "CryptoNoteTools.h"
 #include "TransactionExtra.h"
 #include "CryptoNoteConfig.h"
-#include "parallel_hashmap/phmap_dump.h"
 
 using namespace Logging;
 using namespace Common;
 
 namespace {
 
+const size_t VERIFIED_TRANSACTIONS_CACHE_SIZE = 100000;
+// The indexes are committed every INDEX_COMMIT_BLOCKS blocks, and with the first block pushed INDEX_COMMIT_INTERVAL
+// after the last commit, so a crash leaves at most that much to replay
+const uint32_t INDEX_COMMIT_BLOCKS = 1000;
+const std::chrono::seconds INDEX_COMMIT_INTERVAL(10);
+
 std::string appendPath(const std::string& path, const std::string& fileName) {
   std::string result = path;
   if (!result.empty()) {
@@ -51,6 +59,16 @@ std::string appendPath(const std::string& path, const std::string& fileName) {
   return result;
 }
 
+bool checkRingSignature(const Crypto::Hash& prefixHash, const Crypto::KeyImage& keyImage, const std::vector<Crypto::PublicKey>& outputKeys, const Crypto::Signature* signatures) {
+  std::vector<const Crypto::PublicKey*> keyPointers;
+  keyPointers.reserve(outputKeys.size());
+  for (const auto& key : outputKeys) {
+    keyPointers.push_back(&key);
+  }
+
+  return Crypto::check_ring_signature(prefixHash, keyImage, keyPointers, signatures);
+}
+
 }
 
 namespace std {
@@ -63,7 +81,7 @@ bool operator<(const Crypto::KeyImage& keyImage1, const Crypto::KeyImage& keyIma
 }
 }
 
-#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 4
+#define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 5
 #define CURRENT_BLOCKCHAININDICES_STORAGE_ARCHIVE_VER 1
 
 namespace CryptoNote {
@@ -135,7 +153,7 @@ class BlockCacheSerializer {
 
 public:
   BlockCacheSerializer(Blockchain& bs, const Crypto::Hash lastBlockHash, ILogger& logger) :
-    m_bs(bs), m_lastBlockHash(lastBlockHash), m_loaded(false), logger(logger, "BlockCacheSerializer") {
+    m_bs(bs), m_lastBlockHash(lastBlockHash), m_height(static_cast<uint32_t>(bs.m_blocks.size())), m_loaded(false), logger(logger, "BlockCacheSerializer") {
   }
 
   void load(const std::string& filename) {
@@ -186,46 +204,22 @@ public:
       operation = "- loading ";
       Crypto::Hash blockHash;
       s(blockHash, "last_block");
+      s(m_height, "height");
 
-      if (blockHash != m_lastBlockHash) {
+      // The cache may be older than the block store after a crash, it is still usable if it was saved on the current chain
+      if (m_height == 0 || m_height > m_bs.m_blocks.size() || get_block_hash(m_bs.m_blocks[m_height - 1]->bl) != blockHash) {
         return;
       }
 
     } else {
       operation = "- saving ";
       s(m_lastBlockHash, "last_block");
+      s(m_height, "height");
     }
 
     logger(INFO) << operation << "block index...";
     s(m_bs.m_blockIndex, "block_index");
 
-      logger(INFO) << operation << "transaction map";
-      if (s.type() == ISerializer::INPUT)
-      {
-        phmap::BinaryInputArchive ar_in(appendPath(m_bs.m_config_folder, "transactionsmap.dat").c_str());
-        m_bs.m_transactionMap.load(ar_in);
-      }
-      else
-      {
-        phmap::BinaryOutputArchive ar_out(appendPath(m_bs.m_config_folder, "transactionsmap.dat").c_str());
-        m_bs.m_transactionMap.dump(ar_out);
-      }
-
-      logger(INFO) << operation << "spent keys";
-      if (s.type() == ISerializer::INPUT)
-      {
-        phmap::BinaryInputArchive ar_in(appendPath(m_bs.m_config_folder, "spentkeys.dat").c_str());
-        m_bs.m_spent_keys.load(ar_in);
-      }
-      else
-      {
-        phmap::BinaryOutputArchive ar_out(appendPath(m_bs.m_config_folder, "spentkeys.dat").c_str());
-        m_bs.m_spent_keys.dump(ar_out);
-      }
-
-      logger(INFO) << operation << "outputs";
-      s(m_bs.m_outputs, "outputs");
-
       logger(INFO) << operation << "multi-signature outputs";
       s(m_bs.m_multisignatureOutputs, "multisig_outputs");
 
@@ -243,12 +237,18 @@ public:
     return m_loaded;
   }
 
+  // Number of blocks the loaded cache covers
+  uint32_t height() const {
+    return m_height;
+  }
+
 private:
 
   LoggerRef logger;
   bool m_loaded;
   Blockchain& m_bs;
   Crypto::Hash m_lastBlockHash;
+  uint32_t m_height;
 };
 
 class BlockchainIndicesSerializer {
@@ -353,6 +353,10 @@ private:
     logger(logger, "Blockchain"),
                          m_currency(currency),
                          m_tx_pool(tx_pool),
+                         m_verificationThreads(0),
+                         m_proofOfWorkBatchTop(NULL_HASH),
+                         m_proofOfWorkBatchTopHeight(0),
+                         m_importVerification(ImportVerification::TrustCheckpoints),
                          m_current_block_cumul_sz_limit(0),
 			 m_checkpoints(logger),
 			 m_blockchainIndexesEnabled(blockchainIndexesEnabled),
@@ -365,6 +369,8 @@ private:
 			 m_upgradeDetectorV7(currency, m_blocks, BLOCK_MAJOR_VERSION_7, logger),
 			 m_upgradeDetectorV8(currency, m_blocks, BLOCK_MAJOR_VERSION_8, logger),
         		 m_upgradeDetectorV9(currency, m_blocks, BLOCK_MAJOR_VERSION_9, logger) {
+  m_difficultyWindow.setCapacity(std::max({ m_currency.difficultyBlocksCountByBlockVersion(BLOCK_MAJOR_VERSION_1),
+    m_currency.difficultyBlocksCountByBlockVersion(BLOCK_MAJOR_VERSION_2), m_currency.difficultyBlocksCountByBlockVersion(BLOCK_MAJOR_VERSION_3) }));
 }
 
 bool Blockchain::addObserver(IBlockchainStorageObserver* observer) {
@@ -438,22 +444,39 @@ bool Blockchain::checkTransactionSize(size_t blobSize) {
 }
 
 bool Blockchain::haveTransaction(const Crypto::Hash &id) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_transactionMap.find(id) != m_transactionMap.end();
 }
 
 bool Blockchain::have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return  m_spent_keys.find(key_im) != m_spent_keys.end();
 }
 
 uint32_t Blockchain::getCurrentBlockchainHeight() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return static_cast<uint32_t>(m_blocks.size());
 }
 
+void Blockchain::setVerificationThreads(size_t threadCount) {
+  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  m_verificationThreads = threadCount;
+  m_verificationPool.reset();
+  m_workerContexts.clear();
+}
+
+void Blockchain::setImportVerification(ImportVerification verification) {
+  m_importVerification = verification;
+}
+
 bool Blockchain::init(const std::string& config_folder, bool load_existing) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (!m_verificationPool) {
+    m_verificationPool.reset(new Tools::ThreadPool(m_verificationThreads));
+    m_workerContexts = std::vector<Crypto::cn_context>(m_verificationPool->size());
+    logger(INFO) << "Using " << m_verificationPool->size() << " thread(s) for signature verification";
+  }
+
   if (!config_folder.empty() && !Tools::create_directories_if_necessary(config_folder)) {
     logger(ERROR, BRIGHT_RED) << "Failed to create data directory: " << m_config_folder;
     return false;
@@ -461,34 +484,77 @@ bool Blockchain::init(const std::string& config_folder, bool load_existing) {
 
   m_config_folder = config_folder;
 
-  if (!m_blocks.open(appendPath(config_folder, m_currency.blocksFileName()), appendPath(config_folder, m_currency.blockIndexesFileName()), 1024)) {
+  if (!m_blocks.open(appendPath(config_folder, m_currency.blockStoreFileName()), appendPath(config_folder, m_currency.blockStoreIndexFileName()), 1024)) {
+    logger(ERROR, BRIGHT_RED) << "Failed to open block storage in " << config_folder;
     return false;
   }
 
+  if (load_existing && m_blocks.empty()) {
+    std::string blocksFile = appendPath(config_folder, m_currency.blocksFileName());
+    std::string blockIndexesFile = appendPath(config_folder, m_currency.blockIndexesFileName());
+    if (boost::filesystem::exists(blocksFile) && boost::filesystem::exists(blockIndexesFile)) {
+      logger(INFO, BRIGHT_WHITE) << "Importing blocks from " << blocksFile << "...";
+      if (!m_blocks.importSwappedVector(blocksFile, blockIndexesFile)) {
+        logger(ERROR, BRIGHT_RED) << "Failed to import blocks from " << blocksFile;
+        m_blocks.clear();
+        return false;
+      }
+
+      logger(INFO, BRIGHT_WHITE) << "Imported " << m_blocks.size() << " blocks, " << blocksFile << " is no longer used and can be removed";
+    }
+  }
+
+  if (!openIndexes(config_folder)) {
+    return false;
+  }
+
+  // The indexes hold the first getIndexHeight() blocks, and those of the blocks pushed after their last commit
+  // if they were interrupted. Those are dropped and replayed along with the blocks the indexes miss.
+  uint64_t indexHeight = getIndexHeight();
+  if (!load_existing || m_blocks.empty() || indexHeight == INDEX_HEIGHT_UNKNOWN) {
+    if (load_existing && !m_blocks.empty()) {
+      logger(WARNING, BRIGHT_YELLOW) << "Spent key, transaction and output indexes don't match the block store, rebuilding them...";
+    }
+
+    m_transactionMap.clear();
+    m_spent_keys.clear();
+    m_outputs.clear();
+    clearUnlockedOutputCounts();
+  } else if (!indexesCommitted() || indexHeight > m_blocks.size()) {
+    trimIndexes(static_cast<uint32_t>(std::min<uint64_t>(indexHeight, m_blocks.size())));
+  }
+
   if (load_existing && !m_blocks.empty()) {
     logger(INFO, BRIGHT_WHITE) << "Loading blockchain...";
-    BlockCacheSerializer loader(*this, get_block_hash(m_blocks.back().bl), logger.getLogger());
+    BlockCacheSerializer loader(*this, get_block_hash(m_blocks.back()->bl), logger.getLogger());
     loader.load(appendPath(config_folder, m_currency.blocksCacheFileName()));
 
+    indexHeight = getIndexHeight();
     if (!loader.loaded()) {
       logger(WARNING, BRIGHT_YELLOW) << "No actual blockchain cache found, rebuilding internal structures...";
-      rebuildCache();
+      m_blockIndex.clear();
+      m_multisignatureOutputs.clear();
     }
 
+    updateCache(static_cast<uint32_t>(indexHeight), loader.loaded() ? loader.height() : 0);
+
       /* Load (or generate) the indices only if Explorer mode is enabled */
       if (m_blockchainIndexesEnabled)
       {
         loadBlockchainIndices();
       }
 
-      m_checkpoints.load_checkpoints();
-      logger(Logging::INFO) << "Loading checkpoints";
-      m_checkpoints.load_checkpoints_from_dns();
-      logger(Logging::INFO) << "Loading DNS checkpoints";
+      if (!m_currency.isTestnet()) {
+        m_checkpoints.load_checkpoints();
+        logger(Logging::INFO) << "Loading checkpoints";
+        m_checkpoints.load_checkpoints_from_dns();
+        logger(Logging::INFO) << "Loading DNS checkpoints";
+      }
     }
     else
     {
       m_blocks.clear();
+      m_difficultyWindow.clear();
     }
 
   if (m_blocks.empty()) {
@@ -501,7 +567,7 @@ bool Blockchain::init(const std::string& config_folder, bool load_existing) {
       return false;
     }
   } else {
-    Crypto::Hash firstBlockHash = get_block_hash(m_blocks[0].bl);
+    Crypto::Hash firstBlockHash = get_block_hash(m_blocks[0]->bl);
     if (!(firstBlockHash == m_currency.genesisBlockHash())) {
       logger(ERROR, BRIGHT_RED) << "Failed to init: genesis block mismatch. "
         "You've probably set --testnet flag and are "
@@ -525,49 +591,49 @@ if (!m_upgradeDetectorV2.init() || !m_upgradeDetectorV3.init() || !m_upgradeDete
   if (!checkUpgradeHeight(m_upgradeDetectorV2)) {
     uint32_t upgradeHeight = m_upgradeDetectorV2.upgradeHeight();
     assert(upgradeHeight != UpgradeDetectorBase::UNDEF_HEIGHT);
-    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV2.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV3)) {
     uint32_t upgradeHeight = m_upgradeDetectorV3.upgradeHeight();
-    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV3.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV4)) {
     uint32_t upgradeHeight = m_upgradeDetectorV4.upgradeHeight();
-    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV4.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV5)) {
     uint32_t upgradeHeight = m_upgradeDetectorV5.upgradeHeight();
-    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_YELLOW) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV5.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV6)) {
     uint32_t upgradeHeight = m_upgradeDetectorV6.upgradeHeight();
-    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV6.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV7)) {
     uint32_t upgradeHeight = m_upgradeDetectorV7.upgradeHeight();
-    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV7.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV8)) {
     uint32_t upgradeHeight = m_upgradeDetectorV8.upgradeHeight();
-    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV8.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
   } else if (!checkUpgradeHeight(m_upgradeDetectorV9)) {
     uint32_t upgradeHeight = m_upgradeDetectorV9.upgradeHeight();
-    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1].bl.majorVersion) <<
+    logger(WARNING, BRIGHT_MAGENTA) << "Invalid block version at " << upgradeHeight + 1 << ": real=" << static_cast<int>(m_blocks[upgradeHeight + 1]->bl.majorVersion) <<
     " expected=" << static_cast<int>(m_upgradeDetectorV9.targetVersion()) << ". Rollback blockchain to height=" << upgradeHeight;
     rollbackBlockchainTo(upgradeHeight);
     reinitUpgradeDetectors = true;
@@ -578,9 +644,10 @@ if (!m_upgradeDetectorV2.init() || !m_upgradeDetectorV3.init() || !m_upgradeDete
   }
 
   update_next_comulative_size_limit();
+  reserveIndexes();
 
-  uint64_t timestamp_diff = time(NULL) - m_blocks.back().bl.timestamp;
-  if (!m_blocks.back().bl.timestamp) {
+  uint64_t timestamp_diff = time(NULL) - m_blocks.back()->bl.timestamp;
+  if (!m_blocks.back()->bl.timestamp) {
     timestamp_diff = time(NULL) - 1341378000;
   }
 
@@ -618,38 +685,70 @@ if (!m_upgradeDetectorV2.init() || !m_upgradeDetectorV3.init() || !m_upgradeDete
   {
     logger(INFO, BRIGHT_WHITE) << "Rebuilding cache";
 
-    std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
     m_blockIndex.clear();
     m_transactionMap.clear();
     m_spent_keys.clear();
     m_outputs.clear();
+    clearUnlockedOutputCounts();
     m_multisignatureOutputs.clear();
-    for (uint32_t b = 0; b < m_blocks.size(); ++b)
+    updateCache(0, 0);
+  }
+
+  // Replays the blocks the caches are missing. The memory mapped indexes cover the first indexHeight blocks,
+  // the caches loaded from the blocks cache file the first cacheHeight blocks, each of them is only given the blocks above.
+  void Blockchain::updateCache(uint32_t indexHeight, uint32_t cacheHeight)
+  {
+    uint32_t startHeight = std::min(indexHeight, cacheHeight);
+    if (startHeight == m_blocks.size())
+    {
+      return;
+    }
+
+    logger(INFO, BRIGHT_WHITE) << "Updating cache from height " << startHeight;
+
+    std::chrono::steady_clock::time_point timePoint = std::chrono::steady_clock::now();
+    for (uint32_t b = startHeight; b < m_blocks.size(); ++b)
     {
       if (b % 1000 == 0)
       {
         logger(INFO, BRIGHT_WHITE) << "Rebuilding Cache for Height " << b << " of " << m_blocks.size();
       }
 
-      const BlockEntry &block = m_blocks[b];
-      Crypto::Hash blockHash = get_block_hash(block.bl);
-      m_blockIndex.push(blockHash);
+      std::shared_ptr<const BlockEntry> blockEntry = m_blocks[b];
+      const BlockEntry& block = *blockEntry;
+      bool updateIndexes = b >= indexHeight;
+      bool updateCaches = b >= cacheHeight;
+      if (updateIndexes)
+      {
+        beginIndexChange();
+      }
+
+      if (updateCaches)
+      {
+        m_blockIndex.push(get_block_hash(block.bl));
+      }
+
       uint64_t interest = 0;
       for (uint16_t t = 0; t < block.transactions.size(); ++t)
       {
         const TransactionEntry &transaction = block.transactions[t];
-        Crypto::Hash transactionHash = getObjectHash(transaction.tx);
         TransactionIndex transactionIndex = {b, t};
-        m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
+        if (updateIndexes)
+        {
+          m_transactionMap.insert(getObjectHash(transaction.tx), transactionIndex);
+        }
 
         // process inputs
         for (auto &i : transaction.tx.inputs)
         {
           if (i.type() == typeid(KeyInput))
           {
-            m_spent_keys.insert(std::make_pair(::boost::get<KeyInput>(i).keyImage, b));
+            if (updateIndexes)
+            {
+              m_spent_keys.insert(::boost::get<KeyInput>(i).keyImage, b);
+            }
           }
-          else if (i.type() == typeid(MultisignatureInput))
+          else if (i.type() == typeid(MultisignatureInput) && updateCaches)
           {
             auto out = ::boost::get<MultisignatureInput>(i);
             m_multisignatureOutputs[out.amount][out.outputIndex].isUsed = true;
@@ -660,15 +759,30 @@ if (!m_upgradeDetectorV2.init() || !m_upgradeDetectorV3.init() || !m_upgradeDete
       for (uint16_t o = 0; o < transaction.tx.outputs.size(); ++o) {
         const auto& out = transaction.tx.outputs[o];
         if (out.target.type() == typeid(KeyOutput)) {
-          m_outputs[out.amount].push_back(std::make_pair<>(transactionIndex, o));
-        } else if (out.target.type() == typeid(MultisignatureOutput)) {
+          if (updateIndexes) {
+            m_outputs.push(out.amount, std::make_pair<>(transactionIndex, o), boost::get<KeyOutput>(out.target).key, transaction.tx.unlockTime);
+          }
+        } else if (out.target.type() == typeid(MultisignatureOutput) && updateCaches) {
           MultisignatureOutputUsage usage = { transactionIndex, o, false };
           m_multisignatureOutputs[out.amount].push_back(usage);
         }
       }
-        interest += m_currency.calculateTotalTransactionInterest(transaction.tx, b); //block.height); //block.height shows 0 wrongly sometimes apparently
+        if (updateCaches)
+        {
+          interest += m_currency.calculateTotalTransactionInterest(transaction.tx, b); //block.height); //block.height shows 0 wrongly sometimes apparently
+        }
+      }
+
+      if (updateCaches)
+      {
+        pushToDepositIndex(block, interest);
+      }
+
+      // Committing syncs the index files, a rebuild does it once per thousand blocks
+      if (updateIndexes && ((b + 1) % INDEX_COMMIT_BLOCKS == 0 || b + 1 == m_blocks.size()))
+      {
+        setIndexHeight(b + 1);
       }
-      pushToDepositIndex(block, interest);
     }
 
   std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
@@ -684,6 +798,18 @@ bool Blockchain::storeCache() {
     logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
     return false;
   }
+
+  try {
+    // the indexes refer to the stored blocks, so those reach the disk first
+    m_blocks.flush();
+    commitIndexes();
+    m_spent_keys.flush();
+    m_transactionMap.flush();
+    m_outputs.flush();
+  } catch (std::exception& e) {
+    logger(ERROR, BRIGHT_RED) << "Failed to flush blockchain indexes: " << e.what();
+    return false;
+  }
     logger(INFO, BRIGHT_GREEN) << "Fuego blockchain was successfully saved.";
   return true;
 }
@@ -693,6 +819,12 @@ bool Blockchain::deinit() {
   if (m_blockchainIndexesEnabled) {
     storeBlockchainIndices();
   }
+
+  uint64_t lookups = m_blocks.cacheHits() + m_blocks.cacheMisses();
+  if (lookups != 0) {
+    logger(DEBUGGING) << "Block cache hits: " << m_blocks.cacheHits() << ", misses: " << m_blocks.cacheMisses() <<
+      " (" << m_blocks.cacheMisses() * 100 / lookups << "%)";
+  }
   assert(m_messageQueueList.empty());
   return true;
 }
@@ -701,11 +833,13 @@ bool Blockchain::resetAndSetGenesisBlock(const Block& b) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   m_blocks.clear();
   m_blockIndex.clear();
+  m_difficultyWindow.clear();
   m_transactionMap.clear();
 
   m_spent_keys.clear();
   m_alternative_chains.clear();
   m_outputs.clear();
+  clearUnlockedOutputCounts();
 
   m_paymentIdIndex.clear();
   m_timestampIndex.clear();
@@ -719,24 +853,24 @@ bool Blockchain::resetAndSetGenesisBlock(const Block& b) {
 
 Crypto::Hash Blockchain::getTailId(uint32_t& height) {
   assert(!m_blocks.empty());
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   height = getCurrentBlockchainHeight() - 1;
   return getTailId();
 }
 
 Crypto::Hash Blockchain::getTailId() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_blocks.empty() ? NULL_HASH : m_blockIndex.getTailId();
 }
 
 std::vector<Crypto::Hash> Blockchain::buildSparseChain() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   assert(m_blockIndex.size() != 0);
   return doBuildSparseChain(m_blockIndex.getTailId());
 }
 
 std::vector<Crypto::Hash> Blockchain::buildSparseChain(const Crypto::Hash& startBlockId) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   assert(haveBlock(startBlockId));
   return doBuildSparseChain(startBlockId);
 }
@@ -773,18 +907,18 @@ std::vector<Crypto::Hash> Blockchain::doBuildSparseChain(const Crypto::Hash& sta
 }
 
 Crypto::Hash Blockchain::getBlockIdByHeight(uint32_t height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   assert(height < m_blockIndex.size());
   return m_blockIndex.getBlockId(height);
 }
 
 bool Blockchain::getBlockByHash(const Crypto::Hash& blockHash, Block& b) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   uint32_t height = 0;
 
   if (m_blockIndex.getBlockHeight(blockHash, height)) {
-    b = m_blocks[height].bl;
+    b = m_blocks[height]->bl;
     return true;
   }
 
@@ -800,14 +934,12 @@ bool Blockchain::getBlockByHash(const Crypto::Hash& blockHash, Block& b) {
 }
 
 bool Blockchain::getBlockHeight(const Crypto::Hash& blockId, uint32_t& blockHeight) {
-  std::lock_guard<decltype(m_blockchain_lock)> lock(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lock(m_blockchain_lock);
   return m_blockIndex.getBlockHeight(blockId, blockHeight);
 }
 
 difficulty_type Blockchain::getDifficultyForNextBlock() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> cumulative_difficulties;
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   uint8_t BlockMajorVersion = getBlockMajorVersionForHeight(static_cast<uint32_t>(m_blocks.size()));
   size_t offset;
   offset = m_blocks.size() - std::min(m_blocks.size(), static_cast<uint64_t>(m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion)));
@@ -815,44 +947,56 @@ difficulty_type Blockchain::getDifficultyForNextBlock() {
   if (offset == 0) {
     ++offset;
   }
-  for (; offset < m_blocks.size(); offset++) {
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
-    cumulative_difficulties.push_back(m_blocks[offset].cumulative_difficulty);
+
+  size_t count = m_blocks.size() > offset ? m_blocks.size() - offset : 0;
+  std::lock_guard<std::mutex> windowLock(m_difficultyWindowLock);
+  updateDifficultyWindow(count);
+  return m_currency.nextDifficulty(static_cast<uint32_t>(m_blocks.size()), BlockMajorVersion, m_difficultyWindow.timestamps(count), m_difficultyWindow.cumulativeDifficulties(count));
+}
+
+void Blockchain::updateDifficultyWindow(size_t count) {
+  if (m_difficultyWindow.endHeight() == m_blocks.size() && m_difficultyWindow.size() >= count) {
+    return;
+  }
+
+  // first call or the window was shortened by a rollback, reload it from the blocks
+  m_difficultyWindow.clear();
+  size_t offset = m_blocks.size() - std::min<size_t>(m_blocks.size(), m_difficultyWindow.capacity());
+  for (; offset < m_blocks.size(); ++offset) {
+    std::shared_ptr<const BlockEntry> block = m_blocks[offset];
+    m_difficultyWindow.push(static_cast<uint32_t>(offset), block->bl.timestamp, block->cumulative_difficulty);
   }
-  return m_currency.nextDifficulty(static_cast<uint32_t>(m_blocks.size()), BlockMajorVersion, timestamps, cumulative_difficulties);
 }
 
 uint64_t Blockchain::getBlockTimestamp(uint32_t height) {
   assert(height < m_blocks.size());
-  return m_blocks[height].bl.timestamp;
+  return m_blocks[height]->bl.timestamp;
 }
 
 uint64_t Blockchain::getCoinsInCirculation() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blocks.empty()) {
     return 0;
   } else {
-    return m_blocks.back().already_generated_coins;
+    return m_blocks.back()->already_generated_coins;
   }
 }
     
 uint64_t Blockchain::coinsEmittedAtHeight(uint64_t height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  const auto& block = m_blocks[height];
-  return block.already_generated_coins;
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blocks[height]->already_generated_coins;
 }
   
   difficulty_type Blockchain::difficultyAtHeight(uint64_t height)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    const auto &current = m_blocks[height];
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    difficulty_type current = m_blocks[height]->cumulative_difficulty;
     if (height < 1)
     {
-      return current.cumulative_difficulty;
+      return current;
     }
 
-    const auto &previous = m_blocks[height - 1];
-    return current.cumulative_difficulty - previous.cumulative_difficulty;
+    return current - m_blocks[height - 1]->cumulative_difficulty;
   }
   
 uint8_t Blockchain::getBlockMajorVersionForHeight(uint32_t height) const {
@@ -881,7 +1025,7 @@ bool Blockchain::rollback_blockchain_switching(std::list<Block> &original_chain,
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   // remove failed subchain
   for (size_t i = m_blocks.size() - 1; i >= rollback_height; i--) {
-    popBlock(get_block_hash(m_blocks.back().bl));
+    popBlock(get_block_hash(m_blocks.back()->bl));
   }
 
     uint32_t height = static_cast<uint32_t>(rollback_height - 1);
@@ -993,7 +1137,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
    // Compare transactions in proposed alt chain vs current main chain and reject if some transaction is missing in the alt chain
   std::vector<Crypto::Hash> mainChainTxHashes, altChainTxHashes;
   for (size_t i = m_blocks.size() - 1; i >= split_height; i--) {
-    Block b = m_blocks[i].bl;
+    Block b = m_blocks[i]->bl;
     std::copy(b.transactionHashes.begin(), b.transactionHashes.end(), std::inserter(mainChainTxHashes, mainChainTxHashes.end()));
   }
   for (auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++) {
@@ -1016,7 +1160,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   //disconnecting old chain
   std::list<Block> disconnected_chain;
   for (size_t i = m_blocks.size() - 1; i >= split_height; i--) {
-    Block b = m_blocks[i].bl;
+    Block b = m_blocks[i]->bl;
     popBlock(get_block_hash(b));
     //if (!(r)) { logger(ERROR, BRIGHT_RED) << "failed to remove block on chain switching"; return false; }
     disconnected_chain.push_front(b);
@@ -1087,7 +1231,7 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
   // if the alt chain isn't long enough to calculate the difficulty target
   // based on its blocks alone, need to get more blocks from the main chain
   if (alt_chain.size() < m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion)) {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
     size_t main_chain_count = m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion) - std::min(m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion), alt_chain.size());
     main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
@@ -1098,8 +1242,8 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
     
     // get difficulties and timestamps from relevant main chain blocks
     for (; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset) {
-      timestamps.push_back(m_blocks[main_chain_start_offset].bl.timestamp);
-      cumulative_difficulties.push_back(m_blocks[main_chain_start_offset].cumulative_difficulty);
+      timestamps.push_back(m_blocks[main_chain_start_offset]->bl.timestamp);
+      cumulative_difficulties.push_back(m_blocks[main_chain_start_offset]->cumulative_difficulty);
     }
 
     // make sure we haven't accidentally grabbed too many blocks... ???
@@ -1205,7 +1349,7 @@ bool Blockchain::validate_miner_transaction(const Block& b, uint32_t height, siz
 }
 
 bool Blockchain::getBackwardBlocksSize(size_t from_height, std::vector<size_t>& sz, size_t count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!(from_height < m_blocks.size())) {
     logger(ERROR, BRIGHT_RED)
       << "Internal error: get_backward_blocks_sizes called with from_height="
@@ -1214,14 +1358,14 @@ bool Blockchain::getBackwardBlocksSize(size_t from_height, std::vector<size_t>&
   }
   size_t start_offset = (from_height + 1) - std::min((from_height + 1), count);
   for (size_t i = start_offset; i != from_height + 1; i++) {
-    sz.push_back(m_blocks[i].block_cumulative_size);
+    sz.push_back(m_blocks[i]->block_cumulative_size);
   }
 
   return true;
 }
 
 bool Blockchain::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!m_blocks.size()) {
     return true;
   }
@@ -1237,12 +1381,12 @@ uint64_t Blockchain::getCurrentCumulativeBlocksizeLimit() {
    if (timestamps.size() >= m_currency.timestampCheckWindow(blockMajorVersion)) 
     return true;
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   size_t need_elements = m_currency.timestampCheckWindow(blockMajorVersion) - timestamps.size(); 
   if (!(start_top_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: passed start_height = " << start_top_height << " not less then m_blocks.size()=" << m_blocks.size(); return false; }
   size_t stop_offset = start_top_height > need_elements ? start_top_height - need_elements : 0;
   do {
-    timestamps.push_back(m_blocks[start_top_height].bl.timestamp);
+    timestamps.push_back(m_blocks[start_top_height]->bl.timestamp);
     if (start_top_height == 0)
       break;
     --start_top_height;
@@ -1315,7 +1459,7 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
       if (!(m_blocks.size() > alt_chain.front()->second.height)) { logger(ERROR, BRIGHT_RED) << "main blockchain wrong height"; return false; }
       // make sure block connects correctly to the main chain
 	  Crypto::Hash h = NULL_HASH;
-      get_block_hash(m_blocks[alt_chain.front()->second.height - 1].bl, h);
+      get_block_hash(m_blocks[alt_chain.front()->second.height - 1]->bl, h);
       if (!(h == alt_chain.front()->second.bl.previousBlockHash)) { logger(ERROR, BRIGHT_RED) << "alternative chain has wrong connection to main chain"; return false; }
       complete_timestamps_vector(b.majorVersion, alt_chain.front()->second.height - 1, timestamps);
     } else {
@@ -1348,7 +1492,6 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
     }
 
     // Always check PoW for alternative blocks
-    m_is_in_checkpoint_zone = false;
     // Check the block's hash against the difficulty target for its alt chain
     difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     if (!(current_diff)) { logger(ERROR, BRIGHT_RED) << "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!"; return false; }
@@ -1369,7 +1512,7 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
       return false;
     }
 
-    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight].cumulative_difficulty;
+    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight]->cumulative_difficulty;
     bei.cumulative_difficulty += current_diff;
 
 #ifdef _DEBUG
@@ -1397,11 +1540,11 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
         bvc.m_verification_failed = true;
       }
       return r;
-    } else if (m_blocks.back().cumulative_difficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
+    } else if (m_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
     {
       //do reorganize!
       logger(INFO, BRIGHT_YELLOW) <<
-        "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cumulative_difficulty " << m_blocks.back().cumulative_difficulty
+        "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cumulative_difficulty " << m_blocks.back()->cumulative_difficulty
         << ENDL << " alternative blockchain size: " << alt_chain.size() << " with cumulative_difficulty " << bei.cumulative_difficulty;
       bool r = switch_to_alternative_blockchain(alt_chain, false);
       if (r) {
@@ -1433,13 +1576,13 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
 }
 
 bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Block>& blocks, std::list<Transaction>& txs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_offset >= m_blocks.size())
     return false;
   for (size_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++) {
-    blocks.push_back(m_blocks[i].bl);
+    blocks.push_back(m_blocks[i]->bl);
     std::list<Crypto::Hash> missed_ids;
-    getTransactions(m_blocks[i].bl.transactionHashes, txs, missed_ids);
+    getTransactions(m_blocks[i]->bl.transactionHashes, txs, missed_ids);
     if (!(!missed_ids.size())) { logger(ERROR, BRIGHT_RED) << "have missed transactions in own block of main blockchain"; return false; }
   }
 
@@ -1447,20 +1590,20 @@ bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Bloc
 }
 
 bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Block>& blocks) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_offset >= m_blocks.size()) {
     return false;
   }
 
   for (uint32_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++) {
-    blocks.push_back(m_blocks[i].bl);
+    blocks.push_back(m_blocks[i]->bl);
   }
 
   return true;
 }
 
 bool Blockchain::handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) { //Deprecated. Should be removed with CryptoNoteProtocolHandler.
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   rsp.current_blockchain_height = getCurrentBlockchainHeight();
   std::list<Block> blocks;
   getBlocks(arg.blocks, blocks, rsp.missed_ids);
@@ -1492,7 +1635,7 @@ bool Blockchain::handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTI
 }
 
 bool Blockchain::getAlternativeBlocks(std::list<Block>& blocks) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   for (auto& alt_bl : m_alternative_chains) {
     blocks.push_back(alt_bl.second.bl);
   }
@@ -1501,97 +1644,136 @@ bool Blockchain::getAlternativeBlocks(std::list<Block>& blocks) {
 }
 
 uint32_t Blockchain::getAlternativeBlocksCount() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return static_cast<uint32_t>(m_alternative_chains.size());
 }
 
-bool Blockchain::add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  const Transaction& tx = transactionByIndex(amount_outs[i].first).tx;
-  if (!(tx.outputs.size() > amount_outs[i].second)) {
-    logger(ERROR, BRIGHT_RED) << "internal error: in global outs index, transaction out index="
-      << amount_outs[i].second << " more than transaction outputs = " << tx.outputs.size() << ", for tx id = " << getObjectHash(tx); return false;
-  }
-  if (!(tx.outputs[amount_outs[i].second].target.type() == typeid(KeyOutput))) { logger(ERROR, BRIGHT_RED) << "unknown tx out type"; return false; }
+bool Blockchain::add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, uint32_t i, uint32_t height) {
+  const OutputsIndex::Entry& entry = m_outputs.entry(amount, i);
 
   //check if transaction is unlocked
-  if (!is_tx_spendtime_unlocked(tx.unlockTime))
+  if (!is_tx_spendtime_unlocked(entry.unlockTime, height))
     return false;
 
   COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
-  oen.global_amount_index = static_cast<uint32_t>(i);
-  oen.out_key = boost::get<KeyOutput>(tx.outputs[amount_outs[i].second].target).key;
+  oen.global_amount_index = i;
+  oen.out_key = entry.key;
   return true;
 }
 
-size_t Blockchain::find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  if (amount_outs.empty()) {
-    return 0;
+uint32_t Blockchain::find_end_of_allowed_index(uint64_t amount, uint32_t height) {
+  std::lock_guard<std::mutex> lock(m_unlockedOutputCountsLock);
+  auto it = m_unlockedOutputCounts.find(amount);
+  if (it != m_unlockedOutputCounts.end()) {
+    return it->second;
   }
 
-  size_t i = amount_outs.size();
-  do {
+  uint32_t i = m_outputs.count(amount);
+  while (i != 0 && m_outputs.get(amount, i - 1).first.block + m_currency.minedMoneyUnlockWindow() > height) {
     --i;
-    if (amount_outs[i].first.block + m_currency.minedMoneyUnlockWindow() <= getCurrentBlockchainHeight()) {
-      return i + 1;
-    }
-  } while (i != 0);
+  }
 
-  return 0;
+  m_unlockedOutputCounts.emplace(amount, i);
+  return i;
 }
 
-bool Blockchain::getRandomOutsByAmount(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+// Outputs of the block at height - minedMoneyUnlockWindow become usable as mixins once the chain is 'height' blocks long
+void Blockchain::updateUnlockedOutputCounts(uint32_t height, bool blockPushed) {
+  std::lock_guard<std::mutex> lock(m_unlockedOutputCountsLock);
+  if (m_unlockedOutputCounts.empty() || height < m_currency.minedMoneyUnlockWindow()) {
+    return;
+  }
 
-  for (uint64_t amount : req.amounts) {
-    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
-    result_outs.amount = amount;
-    auto it = m_outputs.find(amount);
-    if (it == m_outputs.end()) {
-      logger(ERROR, BRIGHT_RED) <<
-        "COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS: not outs for amount " << amount << ", wallet should use some real outs when it looks for mixins, so at least one out for this amount should exist";
-      continue;//actually this is strange situation, wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist
+  std::shared_ptr<const BlockEntry> block = m_blocks[height - m_currency.minedMoneyUnlockWindow()];
+  for (const TransactionEntry& transaction : block->transactions) {
+    for (const TransactionOutput& output : transaction.tx.outputs) {
+      if (output.target.type() != typeid(KeyOutput)) {
+        continue;
+      }
+
+      auto it = m_unlockedOutputCounts.find(output.amount);
+      if (it != m_unlockedOutputCounts.end()) {
+        if (blockPushed) {
+          ++it->second;
+        } else {
+          --it->second;
+        }
+      }
     }
+  }
+}
 
-    std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs = it->second;
-    //it is not good idea to use top fresh outs, because it increases possibility of transaction canceling on split
-    //lets find upper bound of not fresh outs
-    size_t up_index_limit = find_end_of_allowed_index(amount_outs);
-    if (!(up_index_limit <= amount_outs.size())) { logger(ERROR, BRIGHT_RED) << "internal error: find_end_of_allowed_index returned wrong index=" << up_index_limit << ", with amount_outs.size = " << amount_outs.size(); return false; }
+void Blockchain::clearUnlockedOutputCounts() {
+  std::lock_guard<std::mutex> lock(m_unlockedOutputCountsLock);
+  m_unlockedOutputCounts.clear();
+}
 
-    	if(amount_outs.size() > req.outs_count)
-    {
-      std::set<size_t> used;
-      size_t try_count = 0;
-      for(uint64_t j = 0; j != req.outs_count && try_count < up_index_limit;)
-      {
-	    // triangular distribution over [a,b) with a=0, mode c=b=up_index_limit
-        uint64_t r = Crypto::rand<uint64_t>() % ((uint64_t)1 << 53);
-        double frac = std::sqrt((double)r / ((uint64_t)1 << 53));
-        size_t i = (size_t)(frac*up_index_limit);
-        if(used.count(i))
-          continue;
-        bool added = add_out_to_get_random_outs(amount_outs, result_outs, amount, i);
-        used.insert(i);
-        if(added)
-          ++j;
-        ++try_count;
-      }
-    } 
-     else {
-      for(size_t i = 0; i != up_index_limit; i++)
-        add_out_to_get_random_outs(amount_outs, result_outs, amount, i);
+bool Blockchain::getRandomOutsForAmount(uint64_t amount, uint64_t outsCount, uint32_t height, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs) {
+  result_outs.amount = amount;
+  uint32_t amountOutputCount = m_outputs.count(amount);
+  if (amountOutputCount == 0) {
+    logger(ERROR, BRIGHT_RED) <<
+      "COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS: not outs for amount " << amount << ", wallet should use some real outs when it looks for mixins, so at least one out for this amount should exist";
+    return true;//actually this is strange situation, wallet should use some real outs when it lookup for some mix, so, at least one out for this amount should exist
+  }
+
+  //it is not good idea to use top fresh outs, because it increases possibility of transaction canceling on split
+  //lets find upper bound of not fresh outs
+  uint32_t up_index_limit = find_end_of_allowed_index(amount, height);
+  if (!(up_index_limit <= amountOutputCount)) { logger(ERROR, BRIGHT_RED) << "internal error: find_end_of_allowed_index returned wrong index=" << up_index_limit << ", with amount_outs.size = " << amountOutputCount; return false; }
+
+  if (amountOutputCount > outsCount) {
+    std::unordered_set<uint32_t> used;
+    used.reserve(static_cast<size_t>(std::min<uint64_t>(outsCount * 2, up_index_limit)));
+    size_t try_count = 0;
+    for (uint64_t j = 0; j != outsCount && try_count < up_index_limit;) {
+      // triangular distribution over [a,b) with a=0, mode c=b=up_index_limit
+      uint64_t r = Crypto::rand<uint64_t>() % ((uint64_t)1 << 53);
+      double frac = std::sqrt((double)r / ((uint64_t)1 << 53));
+      uint32_t i = (uint32_t)(frac*up_index_limit);
+      if (!used.insert(i).second)
+        continue;
+      if (add_out_to_get_random_outs(result_outs, amount, i, height))
+        ++j;
+      ++try_count;
     }
+  } else {
+    for (uint32_t i = 0; i != up_index_limit; i++)
+      add_out_to_get_random_outs(result_outs, amount, i, height);
   }
+
   return true;
 }
 
+bool Blockchain::getRandomOutsByAmount(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  uint32_t height = static_cast<uint32_t>(m_blocks.size());
+  res.outs.resize(req.amounts.size());
+
+  // amounts are independent, the workers only read the outputs index and never take the blockchain lock themselves
+  std::atomic<bool> valid(true);
+  auto sample = [&](size_t index, size_t) {
+    if (!getRandomOutsForAmount(req.amounts[index], req.outs_count, height, res.outs[index])) {
+      valid = false;
+    }
+  };
+
+  if (m_verificationPool && req.amounts.size() > 1) {
+    m_verificationPool->parallelFor(req.amounts.size(), sample);
+  } else {
+    for (size_t i = 0; i < req.amounts.size(); ++i) {
+      sample(i, 0);
+    }
+  }
+
+  return valid;
+}
+
 uint32_t Blockchain::findBlockchainSupplement(const std::vector<Crypto::Hash>& qblock_ids) {
   assert(!qblock_ids.empty());
   assert(qblock_ids.back() == m_blockIndex.getBlockId(0));
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   uint32_t blockIndex;
   // assert above guarantees that method returns true
   m_blockIndex.findSupplement(qblock_ids, blockIndex);
@@ -1599,17 +1781,17 @@ uint32_t Blockchain::findBlockchainSupplement(const std::vector<Crypto::Hash>& q
 }
 
 uint64_t Blockchain::blockDifficulty(size_t i) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!(i < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "wrong block index i = " << i << " at Blockchain::block_difficulty()"; return false; }
   if (i == 0)
-    return m_blocks[i].cumulative_difficulty;
+    return m_blocks[i]->cumulative_difficulty;
 
-  return m_blocks[i].cumulative_difficulty - m_blocks[i - 1].cumulative_difficulty;
+  return m_blocks[i]->cumulative_difficulty - m_blocks[i - 1]->cumulative_difficulty;
 }
 
 void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index) {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_index >= m_blocks.size()) {
     logger(INFO, BRIGHT_WHITE) <<
       "Wrong starter index set: " << start_index << ", expected max index " << m_blocks.size() - 1;
@@ -1617,9 +1799,9 @@ void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index) {
   }
 
   for (size_t i = start_index; i != m_blocks.size() && i != end_index; i++) {
-    ss << "height " << i << ", timestamp " << m_blocks[i].bl.timestamp << ", cumul_dif " << m_blocks[i].cumulative_difficulty << ", cumul_size " << m_blocks[i].block_cumulative_size
-      << "\nid\t\t" << get_block_hash(m_blocks[i].bl)
-      << "\ndifficulty\t\t" << blockDifficulty(i) << ", nonce " << m_blocks[i].bl.nonce << ", tx_count " << m_blocks[i].bl.transactionHashes.size() << ENDL;
+    ss << "height " << i << ", timestamp " << m_blocks[i]->bl.timestamp << ", cumul_dif " << m_blocks[i]->cumulative_difficulty << ", cumul_size " << m_blocks[i]->block_cumulative_size
+      << "\nid\t\t" << get_block_hash(m_blocks[i]->bl)
+      << "\ndifficulty\t\t" << blockDifficulty(i) << ", nonce " << m_blocks[i]->bl.nonce << ", tx_count " << m_blocks[i]->bl.transactionHashes.size() << ENDL;
   }
   logger(DEBUGGING) <<
     "Current blockchain:" << ENDL << ss.str();
@@ -1629,7 +1811,7 @@ void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index) {
 
 void Blockchain::print_blockchain_index() {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   std::vector<Crypto::Hash> blockIds = m_blockIndex.getBlockIds(0, std::numeric_limits<uint32_t>::max());
   logger(INFO, BRIGHT_WHITE) << "Current blockchain index:";
@@ -1643,14 +1825,12 @@ void Blockchain::print_blockchain_index() {
 
 void Blockchain::print_blockchain_outs(const std::string& file) {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  for (const outputs_container::value_type& v : m_outputs) {
-    const std::vector<std::pair<TransactionIndex, uint16_t>>& vals = v.second;
-    if (!vals.empty()) {
-      ss << "amount: " << v.first << ENDL;
-      for (size_t i = 0; i != vals.size(); i++) {
-        ss << "\t" << getObjectHash(transactionByIndex(vals[i].first).tx) << ": " << vals[i].second << ENDL;
-      }
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  for (const auto& v : m_outputs.amounts()) {
+    ss << "amount: " << v.first << ENDL;
+    for (uint32_t i = 0; i != v.second; i++) {
+      const OutputsIndex::Output& output = m_outputs.get(v.first, i);
+      ss << "\t" << getObjectHash(transactionByIndex(output.first)->tx) << ": " << output.second << ENDL;
     }
   }
 
@@ -1669,7 +1849,7 @@ std::vector<Crypto::Hash> Blockchain::findBlockchainSupplement(const std::vector
   assert(!remoteBlockIds.empty());
   assert(remoteBlockIds.back() == m_blockIndex.getBlockId(0));
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   totalBlockCount = getCurrentBlockchainHeight();
   startBlockIndex = findBlockchainSupplement(remoteBlockIds);
 
@@ -1677,7 +1857,7 @@ std::vector<Crypto::Hash> Blockchain::findBlockchainSupplement(const std::vector
 }
 
 bool Blockchain::haveBlock(const Crypto::Hash& id) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blockIndex.hasBlock(id))
     return true;
 
@@ -1688,30 +1868,30 @@ bool Blockchain::haveBlock(const Crypto::Hash& id) {
 }
 
 size_t Blockchain::getTotalTransactions() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_transactionMap.size();
 }
 
 bool Blockchain::getTransactionOutputGlobalIndexes(const Crypto::Hash& tx_id, std::vector<uint32_t>& indexs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   auto it = m_transactionMap.find(tx_id);
   if (it == m_transactionMap.end()) {
     logger(WARNING, YELLOW) << "warning: get_tx_outputs_gindexs failed to find transaction with id = " << tx_id;
     return false;
   }
 
-  const TransactionEntry& tx = transactionByIndex(it->second);
-  if (!(tx.m_global_output_indexes.size())) { logger(ERROR, BRIGHT_RED) << "internal error: global indexes for transaction " << tx_id << " is empty"; return false; }
-  indexs.resize(tx.m_global_output_indexes.size());
-  for (size_t i = 0; i < tx.m_global_output_indexes.size(); ++i) {
-    indexs[i] = tx.m_global_output_indexes[i];
+  std::shared_ptr<const TransactionEntry> tx = transactionByIndex(it->second);
+  if (!(tx->m_global_output_indexes.size())) { logger(ERROR, BRIGHT_RED) << "internal error: global indexes for transaction " << tx_id << " is empty"; return false; }
+  indexs.resize(tx->m_global_output_indexes.size());
+  for (size_t i = 0; i < tx->m_global_output_indexes.size(); ++i) {
+    indexs[i] = tx->m_global_output_indexes[i];
   }
 
   return true;
 }
 
 bool Blockchain::get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, MultisignatureOutput& out) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   auto it = m_multisignatureOutputs.find(amount);
   if (it == m_multisignatureOutputs.end()) {
     return false;
@@ -1722,7 +1902,8 @@ bool Blockchain::get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, Multis
   }
 
   auto msigUsage = it->second[gindex];
-  auto& targetOut = transactionByIndex(msigUsage.transactionIndex).tx.outputs[msigUsage.outputIndex].target;
+  std::shared_ptr<const TransactionEntry> transaction = transactionByIndex(msigUsage.transactionIndex);
+  auto& targetOut = transaction->tx.outputs[msigUsage.outputIndex].target;
   if (targetOut.type() != typeid(MultisignatureOutput)) {
     return false;
   }
@@ -1734,15 +1915,36 @@ bool Blockchain::get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, Multis
 
 
 bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t& max_used_block_height, Crypto::Hash& max_used_block_id, BlockInfo* tail) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   if (tail)
     tail->id = getTailId(tail->height);
 
-  bool res = checkTransactionInputs(tx, &max_used_block_height);
+  TransactionInputsValidation validation;
+  bool res = validateTransactionInputs(tx, validation);
+  max_used_block_height = validation.maxUsedBlockHeight;
   if (!res) return false;
   if (!(max_used_block_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_blocks.size(); return false; }
-  get_block_hash(m_blocks[max_used_block_height].bl, max_used_block_id);
+  get_block_hash(m_blocks[max_used_block_height]->bl, max_used_block_id);
+
+  if (validation.signaturesChecked) {
+    // remember the verdict, pushBlock doesn't have to check the signatures again while the used block stays in the main chain
+    std::lock_guard<std::mutex> verifiedLock(m_verifiedTransactionsLock);
+    auto inserted = m_verifiedTransactions.emplace(validation.transactionHash, BlockInfo());
+    if (inserted.second) {
+      // hashes pushBlock already erased stay queued, popping one at worst evicts a re-added verdict early
+      m_verifiedTransactionsOrder.push_back(validation.transactionHash);
+      while (m_verifiedTransactionsOrder.size() > VERIFIED_TRANSACTIONS_CACHE_SIZE) {
+        m_verifiedTransactions.erase(m_verifiedTransactionsOrder.front());
+        m_verifiedTransactionsOrder.pop_front();
+      }
+    }
+
+    BlockInfo& maxUsedBlock = inserted.first->second;
+    maxUsedBlock.height = max_used_block_height;
+    maxUsedBlock.id = max_used_block_id;
+  }
+
   return true;
 }
 
@@ -1758,24 +1960,25 @@ bool Blockchain::haveTransactionKeyImagesAsSpent(const Transaction &tx) {
   return false;
 }
 
-bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height) {
-  Crypto::Hash tx_prefix_hash = getObjectHash(*static_cast<const TransactionPrefix*>(&tx));
-  return checkTransactionInputs(tx, tx_prefix_hash, pmax_used_block_height);
-}
+bool Blockchain::validateTransactionInputs(const Transaction& tx, TransactionInputsValidation& validation, bool checkRingSignatures) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
-bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height) {
-  size_t inputIndex = 0;
-  if (pmax_used_block_height) {
-    *pmax_used_block_height = 0;
-  }
+  validation.transactionHash = getObjectHash(tx);
+  validation.prefixHash = getObjectHash(*static_cast<const TransactionPrefix*>(&tx));
+  validation.inputs.clear();
+  validation.inputs.resize(tx.inputs.size());
+  validation.maxUsedBlockHeight = 0;
+  validation.signaturesChecked = true;
 
-  Crypto::Hash transactionHash = getObjectHash(tx);
-  for (const auto& txin : tx.inputs) {
+  const Crypto::Hash& transactionHash = validation.transactionHash;
+  for (size_t inputIndex = 0; inputIndex < tx.inputs.size(); ++inputIndex) {
     assert(inputIndex < tx.signatures.size());
-    if (txin.type() == typeid(KeyInput)) {
+    const auto& txin = tx.inputs[inputIndex];
+    InputValidationResult& result = validation.inputs[inputIndex];
 
+    if (txin.type() == typeid(KeyInput)) {
       const KeyInput& in_to_key = boost::get<KeyInput>(txin);
-      if (!(!in_to_key.outputIndexes.empty())) { logger(ERROR, BRIGHT_RED) << "empty in_to_key.outputIndexes in transaction with id " << getObjectHash(tx); return false; }
+      if (!(!in_to_key.outputIndexes.empty())) { logger(ERROR, BRIGHT_RED) << "empty in_to_key.outputIndexes in transaction with id " << transactionHash; return false; }
 
       if (have_tx_keyimg_as_spent(in_to_key.keyImage)) {
         logger(DEBUGGING) <<
@@ -1783,49 +1986,196 @@ bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Has
         return false;
       }
 
-      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height)) {
-        logger(DEBUGGING, BRIGHT_WHITE) <<
-          "Failed to check ring signature for tx " << transactionHash;
+      if (!get_tx_input_keys(in_to_key, tx.signatures[inputIndex], result.outputKeys, &result.maxRelatedHeight)) {
+        logger(INFO, BRIGHT_WHITE) << "Failed to check input in transaction " << transactionHash;
         return false;
       }
 
-        if (!isInCheckpointZone(getCurrentBlockchainHeight()))
-        {
-          if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height))
-          {
-            logger(INFO, BRIGHT_WHITE) << "Failed to check input in transaction " << transactionHash;
-            return false;
-          }
-        }
+      validation.maxUsedBlockHeight = std::max(validation.maxUsedBlockHeight, result.maxRelatedHeight);
 
-        ++inputIndex;
+      if (checkRingSignatures) {
+        result.signatureChecked = true;
+        result.valid = checkRingSignature(validation.prefixHash, in_to_key.keyImage, result.outputKeys, tx.signatures[inputIndex].data());
+        if (!result.valid) {
+          logger(DEBUGGING, BRIGHT_WHITE) <<
+            "Failed to check ring signature for tx " << transactionHash;
+          return false;
+        }
+      } else {
+        // left for the caller, see verifyRingSignatures
+        validation.signaturesChecked = false;
       }
-      else if (txin.type() == typeid(MultisignatureInput))
-      {
-        if (!isInCheckpointZone(getCurrentBlockchainHeight()))
-        {
-          if (!validateInput(::boost::get<MultisignatureInput>(txin), transactionHash, tx_prefix_hash, tx.signatures[inputIndex]))
-          {
-            return false;
-          }
+    } else if (txin.type() == typeid(MultisignatureInput)) {
+      // the signatures are checked along with the output, so blocks trusted by a checkpoint skip both
+      if (m_importVerification == ImportVerification::Full || !isInCheckpointZone(getCurrentBlockchainHeight())) {
+        if (!validateInput(::boost::get<MultisignatureInput>(txin), transactionHash, validation.prefixHash, tx.signatures[inputIndex])) {
+          return false;
         }
+      }
+
+      result.valid = true;
+    } else {
+      logger(INFO, BRIGHT_WHITE) << "Transaction << " << transactionHash << " contains input of unsupported type.";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Blockchain::verifyRingSignatures(const std::vector<Transaction>& transactions, std::vector<TransactionInputsValidation>& validations, size_t* checkedCount) {
+  assert(transactions.size() == validations.size());
 
-        ++inputIndex;
+  std::vector<std::pair<size_t, size_t>> pending;
+  for (size_t i = 0; i < validations.size(); ++i) {
+    for (size_t j = 0; j < validations[i].inputs.size(); ++j) {
+      const InputValidationResult& result = validations[i].inputs[j];
+      if (!result.valid && !result.signatureChecked && transactions[i].inputs[j].type() == typeid(KeyInput)) {
+        pending.emplace_back(i, j);
       }
-      else
-      {
-        logger(INFO, BRIGHT_WHITE) << "Transaction << " << transactionHash << " contains input of unsupported type.";
-        return false;
+    }
+  }
+
+  if (checkedCount) {
+    *checkedCount = pending.size();
+  }
+
+  std::atomic<bool> valid(true);
+  auto verify = [&](size_t index, size_t) {
+    if (!valid) {
+      return;
+    }
+
+    const Transaction& tx = transactions[pending[index].first];
+    TransactionInputsValidation& validation = validations[pending[index].first];
+    size_t inputIndex = pending[index].second;
+    InputValidationResult& result = validation.inputs[inputIndex];
+
+    const KeyInput& in_to_key = boost::get<KeyInput>(tx.inputs[inputIndex]);
+    result.signatureChecked = true;
+    result.valid = checkRingSignature(validation.prefixHash, in_to_key.keyImage, result.outputKeys, tx.signatures[inputIndex].data());
+    if (!result.valid) {
+      logger(DEBUGGING) << "Failed to check ring signature for keyImage: " << in_to_key.keyImage;
+      valid = false;
+    }
+  };
+
+  if (m_verificationPool) {
+    m_verificationPool->parallelFor(pending.size(), verify);
+  } else {
+    for (size_t i = 0; i < pending.size(); ++i) {
+      verify(i, 0);
+    }
+  }
+
+  return valid;
+}
+
+std::vector<Crypto::Hash> Blockchain::computeProofsOfWork(const std::vector<const Block*>& blocks) {
+  std::vector<Crypto::Hash> proofsOfWork(blocks.size(), NULL_HASH);
+  std::vector<Crypto::Hash> blockHashes;
+  blockHashes.reserve(blocks.size());
+  for (const Block* block : blocks) {
+    blockHashes.push_back(get_block_hash(*block));
+  }
+
+  // A block is hashed if it extends the main chain, the block before it in the batch or the top of the previous batch.
+  // The locks are only held to find the heights.
+  std::vector<size_t> pending;
+  {
+    std::lock_guard<std::mutex> batchLock(m_proofOfWorkBatchLock);
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    bool previousHasHeight = false;
+    uint32_t previousHeight = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      uint32_t parentHeight = 0;
+      bool hasHeight;
+      if (i > 0 && blocks[i]->previousBlockHash == blockHashes[i - 1]) {
+        hasHeight = previousHasHeight;
+        parentHeight = previousHeight;
+      } else if (m_blockIndex.getBlockHeight(blocks[i]->previousBlockHash, parentHeight)) {
+        hasHeight = true;
+      } else {
+        hasHeight = blocks[i]->previousBlockHash == m_proofOfWorkBatchTop;
+        parentHeight = m_proofOfWorkBatchTopHeight;
+      }
+
+      previousHasHeight = hasHeight;
+      previousHeight = parentHeight + 1;
+      if (hasHeight && !m_blockIndex.hasBlock(blockHashes[i]) && checksProofOfWork(parentHeight + 1)) {
+        pending.push_back(i);
       }
     }
 
+    if (!blocks.empty() && previousHasHeight) {
+      m_proofOfWorkBatchTop = blockHashes.back();
+      m_proofOfWorkBatchTopHeight = previousHeight;
+    }
+  }
+
+  // the long hash only depends on the block itself, the comparison with the difficulty is left to pushBlock
+  auto compute = [&](size_t index, size_t worker) {
+    if (!get_block_longhash(m_workerContexts[worker], *blocks[pending[index]], proofsOfWork[pending[index]])) {
+      proofsOfWork[pending[index]] = NULL_HASH;
+    }
+  };
+
+  if (m_verificationPool) {
+    m_verificationPool->parallelFor(pending.size(), compute);
+  }
+
+  return proofsOfWork;
+}
+
+Common::ArrayView<uint8_t> Blockchain::getRawBlock(uint32_t height) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blocks.raw(height);
+}
+
+bool Blockchain::parseRawBlock(Common::ArrayView<uint8_t> rawBlock, Block& block, std::vector<Transaction>& transactions) {
+  BlockEntry entry;
+  Common::MemoryInputStream stream(rawBlock.getData(), rawBlock.getSize());
+  BinaryInputStreamSerializer archive(stream);
+  try {
+    entry.serialize(archive);
+  } catch (std::exception&) {
+    return false;
+  }
+
+  if (!stream.endOfStream() || entry.transactions.empty()) {
+    return false;
+  }
+
+  block = std::move(entry.bl);
+  transactions.clear();
+  transactions.reserve(entry.transactions.size() - 1);
+  for (size_t i = 1; i < entry.transactions.size(); ++i) {
+    transactions.push_back(std::move(entry.transactions[i].tx));
+  }
+
   return true;
 }
 
+bool Blockchain::isTransactionVerified(const Crypto::Hash& transactionHash) {
+  std::lock_guard<std::mutex> verifiedLock(m_verifiedTransactionsLock);
+  auto it = m_verifiedTransactions.find(transactionHash);
+  if (it == m_verifiedTransactions.end()) {
+    return false;
+  }
+
+  // the ring of every input only references outputs up to maxUsedBlock, they can't change while it is in the main chain
+  const BlockInfo& maxUsedBlock = it->second;
+  return maxUsedBlock.height < m_blocks.size() && m_blockIndex.getBlockId(maxUsedBlock.height) == maxUsedBlock.id;
+}
+
 bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time) {
+  return is_tx_spendtime_unlocked(unlock_time, getCurrentBlockchainHeight());
+}
+
+bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time, uint32_t height) {
   if (unlock_time < m_currency.maxBlockHeight()) {
     //interpret as block index
-    if (getCurrentBlockchainHeight() - 1 + m_currency.lockedTxAllowedDeltaBlocks() >= unlock_time)
+    if (height - 1 + m_currency.lockedTxAllowedDeltaBlocks() >= unlock_time)
       return true;
     else
       return false;
@@ -1841,14 +2191,14 @@ bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time) {
   return false;
 }
 
-bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+bool Blockchain::get_tx_input_keys(const KeyInput& txin, const std::vector<Crypto::Signature>& sig, std::vector<Crypto::PublicKey>& output_keys, uint32_t* pmax_related_block_height) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   struct outputs_visitor {
-    std::vector<const Crypto::PublicKey *>& m_results_collector;
+    std::vector<Crypto::PublicKey>& m_results_collector;
     Blockchain& m_bch;
     LoggerRef logger;
-    outputs_visitor(std::vector<const Crypto::PublicKey *>& results_collector, Blockchain& bch, ILogger& logger) :m_results_collector(results_collector), m_bch(bch), logger(logger, "outputs_visitor") {
+    outputs_visitor(std::vector<Crypto::PublicKey>& results_collector, Blockchain& bch, ILogger& logger) :m_results_collector(results_collector), m_bch(bch), logger(logger, "outputs_visitor") {
     }
 
     bool handle_output(const Transaction& tx, const TransactionOutput& out, size_t transactionOutputIndex) {
@@ -1865,7 +2215,8 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
         return false;
       }
 
-      m_results_collector.push_back(&boost::get<KeyOutput>(out.target).key);
+      // keys are copied, entries of m_blocks may be swapped out before the signature is checked
+      m_results_collector.push_back(boost::get<KeyOutput>(out.target).key);
       return true;
     }
   };
@@ -1878,8 +2229,7 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
 	 return false;
   }
 
-  //check ring signature
-  std::vector<const Crypto::PublicKey *> output_keys;
+  output_keys.reserve(txin.outputIndexes.size());
   outputs_visitor vi(output_keys, *this, logger.getLogger());
   if (!scanOutputKeysForIndexes(txin, vi, pmax_related_block_height)) {
     logger(INFO, BRIGHT_YELLOW) <<
@@ -1895,15 +2245,7 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
   }
 
   if (!(sig.size() == output_keys.size())) { logger(ERROR, BRIGHT_RED) << "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size(); return false; }
-  if (m_is_in_checkpoint_zone) {
-    return true;
-  }
-
-  bool check_tx_ring_signature = Crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_keys, sig.data());
-  if (!check_tx_ring_signature) {
-    logger(DEBUGGING) << "Failed to check ring signature for keyImage: " << txin.keyImage;
-  }
-  return check_tx_ring_signature;
+  return true;
 }
 
 uint64_t Blockchain::get_adjusted_time() {
@@ -1945,7 +2287,7 @@ bool Blockchain::check_block_timestamp_main(const Block& b) {
 
   std::vector<uint64_t> timestamps;
  size_t offset = m_blocks.size() <= m_currency.timestampCheckWindow(b.majorVersion) ? 0 : m_blocks.size() - m_currency.timestampCheckWindow(b.majorVersion);  for (; offset != m_blocks.size(); ++offset) { 
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
+    timestamps.push_back(m_blocks[offset]->bl.timestamp);
   }
 
   return check_block_timestamp(std::move(timestamps), b);
@@ -2059,6 +2401,15 @@ bool Blockchain::update_next_comulative_size_limit() {
 }
 
 bool Blockchain::addNewBlock(const Block& bl_, block_verification_context& bvc) {
+  return addBlock(bl_, nullptr, nullptr, bvc);
+}
+
+bool Blockchain::importBlock(const Block& block, const std::vector<Transaction>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork) {
+  return addBlock(block, &transactions, proofOfWork, bvc);
+}
+
+// transactions == nullptr: the transactions are taken from the pool
+bool Blockchain::addBlock(const Block& bl_, const std::vector<Transaction>* transactions, const Crypto::Hash* proofOfWork, block_verification_context& bvc) {
   //copy block here to let modify block.target
   Block bl = bl_;
   Crypto::Hash id;
@@ -2087,14 +2438,30 @@ bool Blockchain::addNewBlock(const Block& bl_, block_verification_context& bvc)
       if (!(bl.previousBlockHash == getTailId()))
       {
         //chain switching or wrong block
+        if (transactions != nullptr) {
+          // a chain switch takes the transactions of alternative blocks from the pool
+          saveTransactions(*transactions, height);
+        }
+
         bvc.m_added_to_main_chain = false;
         add_result = handle_alternative_block(bl, id, bvc);
       }
       else
       {
-        add_result = pushBlock(bl, id, bvc, ++height);
+        if (transactions == nullptr) {
+          add_result = pushBlock(bl, id, bvc, ++height);
+        } else {
+          add_result = pushBlock(bl, *transactions, id, bvc, proofOfWork);
+          ++height;
+          if (add_result) {
+            // the pool may already hold some of them if they were relayed before the block
+            removePoolTransactions(bl.transactionHashes);
+          }
+        }
+
         if (add_result)
         {
+          reserveIndexes();
           sendMessage(BlockchainMessage(NewBlockMessage(id)));
 
           /** Save the blockchain every 720 blocks if the option is enabled*/
@@ -2116,8 +2483,10 @@ bool Blockchain::addNewBlock(const Block& bl_, block_verification_context& bvc)
   return add_result;
 }
 
-const Blockchain::TransactionEntry& Blockchain::transactionByIndex(TransactionIndex index) {
-  return m_blocks[index.block].transactions[index.transaction];
+std::shared_ptr<const Blockchain::TransactionEntry> Blockchain::transactionByIndex(TransactionIndex index) {
+  std::shared_ptr<const BlockEntry> block = m_blocks[index.block];
+  // keeps the whole block alive
+  return std::shared_ptr<const TransactionEntry>(block, &block->transactions[index.transaction]);
 }
 
 bool Blockchain::pushBlock(const Block &blockData, const Crypto::Hash &id, block_verification_context &bvc, uint32_t height) {
@@ -2135,7 +2504,7 @@ bool Blockchain::pushBlock(const Block &blockData, const Crypto::Hash &id, block
   return true;
 }
 
-bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc) {
+bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc, const Crypto::Hash* proofOfWork) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   auto blockProcessingStart = std::chrono::steady_clock::now();
@@ -2188,27 +2557,34 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
 auto longhashTimeStart = std::chrono::steady_clock::now();
   Crypto::Hash proof_of_work = NULL_HASH;
 
-  if (m_checkpoints.is_in_checkpoint_zone(getCurrentBlockchainHeight())) {
+  bool inCheckpointZone = m_checkpoints.is_in_checkpoint_zone(getCurrentBlockchainHeight());
+  if (inCheckpointZone) {
     if (!m_checkpoints.check_block(getCurrentBlockchainHeight(), blockHash)) {
       logger(ERROR, BRIGHT_RED) <<
         "CHECKPOINT VALIDATION FAILED";
       bvc.m_verification_failed = true;
       return false;
     }
-  } else {
-    // Skip difficulty validation only for FOUNDATIONAL blocks, ie anything < 800k
-    // Fixes daemon's backwards compatibility issues syncing with early blocks
-    if (getCurrentBlockchainHeight() < 800000) {
-      logger(INFO, BRIGHT_WHITE) <<
-        "Skipping difficulty validation for historical block " << blockHash << " at height " << getCurrentBlockchainHeight();
+  }
+
+  if (checksProofOfWork(getCurrentBlockchainHeight())) {
+    bool enoughWork;
+    if (proofOfWork != nullptr) {
+      proof_of_work = *proofOfWork;
+      enoughWork = m_currency.checkProofOfWork(blockData, currentDifficulty, proof_of_work);
     } else {
-      if (!m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work)) {
-        logger(INFO, BRIGHT_WHITE) <<
-          "Block " << blockHash << ", has too weak proof of work: " << proof_of_work << ", expected difficulty: " << currentDifficulty;
-        bvc.m_verification_failed = true;
-        return false;
-      }
+      enoughWork = m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work);
     }
+
+    if (!enoughWork) {
+      logger(INFO, BRIGHT_WHITE) <<
+        "Block " << blockHash << ", has too weak proof of work: " << proof_of_work << ", expected difficulty: " << currentDifficulty;
+      bvc.m_verification_failed = true;
+      return false;
+    }
+  } else if (!inCheckpointZone) {
+    logger(INFO, BRIGHT_WHITE) <<
+      "Skipping difficulty validation for historical block " << blockHash << " at height " << getCurrentBlockchainHeight();
   }
 
   auto longhash_calculating_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - longhashTimeStart).count();
@@ -2228,12 +2604,17 @@ auto longhashTimeStart = std::chrono::steady_clock::now();
   block.transactions.resize(1);
   block.transactions[0].tx = blockData.baseTransaction;
   TransactionIndex transactionIndex = { block.height, static_cast<uint16_t>(0) };
+  // Every way out below leaves the indexes matching the block store again, they are committed once that is due
+  beginIndexChange();
+  Tools::ScopeExit indexCommitter([this] { commitIndexesIfDue(); });
   pushTransaction(block, minerTransactionHash, transactionIndex);
 
   size_t coinbase_blob_size = getObjectBinarySize(blockData.baseTransaction);
   size_t cumulative_block_size = coinbase_blob_size;
   uint64_t fee_summary = 0;
     uint64_t interestSummary = 0;
+  std::vector<TransactionInputsValidation> validations(transactions.size());
+  size_t reusedVerifications = 0;
 
     for (size_t i = 0; i < transactions.size(); ++i)
     {
@@ -2252,9 +2633,16 @@ auto longhashTimeStart = std::chrono::steady_clock::now();
       logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " can't contain transaction " << tx_id << " because it has invalid version " << transactions[i].version;
     }
 
-    if (!checkTransactionInputs(transactions[i])) {
+    if (!validateTransactionInputs(transactions[i], validations[i], false)) {
       isTransactionValid = false;
       logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has at least one transaction with wrong inputs: " << tx_id;
+    } else if (isTransactionVerified(tx_id)) {
+      // ring signatures were already checked when the transaction entered the pool
+      for (auto& input : validations[i].inputs) {
+        input.valid = true;
+      }
+
+      ++reusedVerifications;
     }
 
     if (!check_tx_outputs(transactions[i], block.height)) {
@@ -2279,14 +2667,26 @@ auto longhashTimeStart = std::chrono::steady_clock::now();
       interestSummary += m_currency.calculateTotalTransactionInterest(transactions[i], block.height);
   }
 
+  // inputs were resolved under the lock above, the signatures themselves are independent of each other
+  auto signatureTimeStart = std::chrono::steady_clock::now();
+  size_t ringSignaturesChecked = 0;
+  if (checksSignatures(block.height) && !verifyRingSignatures(transactions, validations, &ringSignaturesChecked)) {
+    logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has at least one transaction with invalid ring signature";
+    bvc.m_verification_failed = true;
+    popTransactions(block, minerTransactionHash);
+    return false;
+  }
+  auto signature_checking_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - signatureTimeStart).count();
+
   if (!checkCumulativeBlockSize(blockHash, cumulative_block_size, m_blocks.size())) {
     bvc.m_verification_failed = true;
+    popTransactions(block, minerTransactionHash);
     return false;
   }
 
   int64_t emissionChange = 0;
   uint64_t reward = 0;
-  uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blocks.back().already_generated_coins;
+  uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blocks.back()->already_generated_coins;
   if (!validate_miner_transaction(blockData, static_cast<uint32_t>(m_blocks.size()), cumulative_block_size, already_generated_coins, fee_summary, reward, emissionChange)) {
     logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has invalid miner transaction";
     bvc.m_verification_failed = true;
@@ -2299,12 +2699,16 @@ auto longhashTimeStart = std::chrono::steady_clock::now();
   block.cumulative_difficulty = currentDifficulty;
   block.already_generated_coins = already_generated_coins + emissionChange;
   if (m_blocks.size() > 0) {
-    block.cumulative_difficulty += m_blocks.back().cumulative_difficulty;
+    block.cumulative_difficulty += m_blocks.back()->cumulative_difficulty;
   }
 
   pushBlock(block);
     pushToDepositIndex(block, interestSummary);
 
+  for (const auto& transactionHash : blockData.transactionHashes) {
+    m_verifiedTransactions.erase(transactionHash);
+  }
+
   auto block_processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - blockProcessingStart).count();
 
   logger(DEBUGGING, YELLOW) <<
@@ -2313,7 +2717,8 @@ auto longhashTimeStart = std::chrono::steady_clock::now();
     << ENDL << "HEIGHT " << block.height << ", difficulty:\t" << currentDifficulty
     << ENDL << "block reward: " << m_currency.formatAmount(reward) << ", fee = " << m_currency.formatAmount(fee_summary)
     << ", coinbase_blob_size: " << coinbase_blob_size << ", cumulative size: " << cumulative_block_size
-    << ", " << block_processing_time << "(" << target_calculating_time << "/" << longhash_calculating_time << ")ms";
+    << ", " << block_processing_time << "(" << target_calculating_time << "/" << longhash_calculating_time << "/" << signature_checking_time << ")ms"
+    << ", ring signatures: " << ringSignaturesChecked << " (" << reusedVerifications << " transactions verified in pool)";
 
   bvc.m_added_to_main_chain = true;
 
@@ -2332,18 +2737,18 @@ auto longhashTimeStart = std::chrono::steady_clock::now();
 }
 
 uint64_t Blockchain::fullDepositAmount() const {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_depositIndex.fullDepositAmount();
 }
 
 uint64_t Blockchain::depositAmountAtHeight(size_t height) const {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_depositIndex.depositAmountAtHeight(static_cast<DepositIndex::DepositHeight>(height));
 }
 
   uint64_t Blockchain::depositInterestAtHeight(size_t height) const
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     return m_depositIndex.depositInterestAtHeight(static_cast<DepositIndex::DepositHeight>(height));
   }
 
@@ -2382,7 +2787,9 @@ bool Blockchain::pushBlock(BlockEntry &block) {
   Crypto::Hash blockHash = get_block_hash(block.bl);
 
   m_blocks.push_back(block);
+  updateUnlockedOutputCounts(static_cast<uint32_t>(m_blocks.size()), true);
   m_blockIndex.push(blockHash);
+  m_difficultyWindow.push(block.height, block.bl.timestamp, block.cumulative_difficulty);
 
   m_timestampIndex.add(block.bl.timestamp, blockHash);
   m_generatedTransactionsIndex.add(block.bl);
@@ -2399,22 +2806,25 @@ void Blockchain::popBlock(const Crypto::Hash& blockHash) {
     return;
   }
 
-  std::vector<Transaction> transactions(m_blocks.back().transactions.size() - 1);
-  for (size_t i = 0; i < m_blocks.back().transactions.size() - 1; ++i) {
-    transactions[i] = m_blocks.back().transactions[1 + i].tx;
+  std::shared_ptr<const BlockEntry> lastBlock = m_blocks.back();
+  std::vector<Transaction> transactions(lastBlock->transactions.size() - 1);
+  for (size_t i = 0; i < lastBlock->transactions.size() - 1; ++i) {
+    transactions[i] = lastBlock->transactions[1 + i].tx;
   }
 
   uint32_t height = m_blocks.size(); //height of popped block should be same as number of blocks
   saveTransactions(transactions, height);
 
-  popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
+  popTransactions(*lastBlock, getObjectHash(lastBlock->bl.baseTransaction));
 
-  m_timestampIndex.remove(m_blocks.back().bl.timestamp, blockHash);
-  m_generatedTransactionsIndex.remove(m_blocks.back().bl);
+  m_timestampIndex.remove(lastBlock->bl.timestamp, blockHash);
+  m_generatedTransactionsIndex.remove(lastBlock->bl);
 
   m_depositIndex.popBlock();
+  updateUnlockedOutputCounts(static_cast<uint32_t>(m_blocks.size()), false);
   m_blocks.pop_back();
   m_blockIndex.pop();
+  m_difficultyWindow.pop();
 
   assert(m_blockIndex.size() == m_blocks.size());
 /*--------------------------------------------------------------------------------------------------------------*/
@@ -2428,12 +2838,10 @@ void Blockchain::popBlock(const Crypto::Hash& blockHash) {
   m_upgradeDetectorV7.blockPopped();
   m_upgradeDetectorV8.blockPopped();
   m_upgradeDetectorV9.blockPopped();
-
-
 }
 
 bool Blockchain::pushTransaction(BlockEntry& block, const Crypto::Hash& transactionHash, TransactionIndex transactionIndex) {
-  auto result = m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
+  auto result = m_transactionMap.insert(transactionHash, transactionIndex);
   if (!result.second) {
     logger(ERROR, BRIGHT_RED) <<
       "Duplicate transaction was pushed to blockchain.";
@@ -2445,6 +2853,7 @@ bool Blockchain::pushTransaction(BlockEntry& block, const Crypto::Hash& transact
   if (!checkMultisignatureInputsDiff(transaction.tx)) {
     logger(ERROR, BRIGHT_RED) <<
       "Double spending transaction was pushed to blockchain.";
+    setIndexHeight(INDEX_HEIGHT_UNKNOWN);
     m_transactionMap.erase(transactionHash);
     return false;
   }
@@ -2453,11 +2862,12 @@ bool Blockchain::pushTransaction(BlockEntry& block, const Crypto::Hash& transact
     {
       if (transaction.tx.inputs[i].type() == typeid(KeyInput))
       {
-        auto result = m_spent_keys.insert(std::make_pair(::boost::get<KeyInput>(transaction.tx.inputs[i]).keyImage, block.height));
+        auto result = m_spent_keys.insert(::boost::get<KeyInput>(transaction.tx.inputs[i]).keyImage, block.height);
         if (!result.second)
         {
           logger(ERROR, BRIGHT_RED) << "Double spending transaction was pushed to blockchain.";
 
+          setIndexHeight(INDEX_HEIGHT_UNKNOWN);
           for (size_t j = 0; j < i; ++j)
           {
             m_spent_keys.erase(::boost::get<KeyInput>(transaction.tx.inputs[i - 1 - j]).keyImage);
@@ -2480,9 +2890,8 @@ bool Blockchain::pushTransaction(BlockEntry& block, const Crypto::Hash& transact
   transaction.m_global_output_indexes.resize(transaction.tx.outputs.size());
   for (uint16_t output = 0; output < transaction.tx.outputs.size(); ++output) {
     if (transaction.tx.outputs[output].target.type() == typeid(KeyOutput)) {
-      auto& amountOutputs = m_outputs[transaction.tx.outputs[output].amount];
-      transaction.m_global_output_indexes[output] = static_cast<uint32_t>(amountOutputs.size());
-      amountOutputs.push_back(std::make_pair<>(transactionIndex, output));
+      transaction.m_global_output_indexes[output] = m_outputs.push(transaction.tx.outputs[output].amount, std::make_pair<>(transactionIndex, output),
+        boost::get<KeyOutput>(transaction.tx.outputs[output].target).key, transaction.tx.unlockTime);
     } else if (transaction.tx.outputs[output].target.type() == typeid(MultisignatureOutput)) {
       auto& amountOutputs = m_multisignatureOutputs[transaction.tx.outputs[output].amount];
       transaction.m_global_output_indexes[output] = static_cast<uint32_t>(amountOutputs.size());
@@ -2501,35 +2910,27 @@ void Blockchain::popTransaction(const Transaction& transaction, const Crypto::Ha
   for (size_t outputIndex = 0; outputIndex < transaction.outputs.size(); ++outputIndex) {
     const TransactionOutput& output = transaction.outputs[transaction.outputs.size() - 1 - outputIndex];
     if (output.target.type() == typeid(KeyOutput)) {
-      auto amountOutputs = m_outputs.find(output.amount);
-      if (amountOutputs == m_outputs.end()) {
+      uint32_t amountOutputCount = m_outputs.count(output.amount);
+      if (amountOutputCount == 0) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - cannot find specific amount in outputs map.";
         continue;
       }
 
-      if (amountOutputs->second.empty()) {
-        logger(ERROR, BRIGHT_RED) <<
-          "Blockchain consistency broken - output array for specific amount is empty.";
-        continue;
-      }
-
-      if (amountOutputs->second.back().first.block != transactionIndex.block || amountOutputs->second.back().first.transaction != transactionIndex.transaction) {
+      const OutputsIndex::Output& lastOutput = m_outputs.get(output.amount, amountOutputCount - 1);
+      if (lastOutput.first.block != transactionIndex.block || lastOutput.first.transaction != transactionIndex.transaction) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - invalid transaction index.";
         continue;
       }
 
-      if (amountOutputs->second.back().second != transaction.outputs.size() - 1 - outputIndex) {
+      if (lastOutput.second != transaction.outputs.size() - 1 - outputIndex) {
         logger(ERROR, BRIGHT_RED) <<
           "Blockchain consistency broken - invalid output index.";
         continue;
       }
 
-      amountOutputs->second.pop_back();
-      if (amountOutputs->second.empty()) {
-        m_outputs.erase(amountOutputs);
-      }
+      m_outputs.pop(output.amount);
     } else if (output.target.type() == typeid(MultisignatureOutput)) {
       auto amountOutputs = m_multisignatureOutputs.find(output.amount);
       if (amountOutputs == m_multisignatureOutputs.end()) {
@@ -2598,6 +2999,7 @@ void Blockchain::popTransaction(const Transaction& transaction, const Crypto::Ha
 }
 
 void Blockchain::popTransactions(const BlockEntry& block, const Crypto::Hash& minerTransactionHash) {
+  setIndexHeight(INDEX_HEIGHT_UNKNOWN);
   for (size_t i = 0; i < block.transactions.size() - 1; ++i) {
     popTransaction(block.transactions[block.transactions.size() - 1 - i].tx, block.bl.transactionHashes[block.transactions.size() - 2 - i]);
   }
@@ -2627,7 +3029,8 @@ bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::H
     return false;
   }
 
-  const Transaction& outputTransaction = m_blocks[outputIndex.transactionIndex.block].transactions[outputIndex.transactionIndex.transaction].tx;
+  std::shared_ptr<const TransactionEntry> outputTransactionEntry = transactionByIndex(outputIndex.transactionIndex);
+  const Transaction& outputTransaction = outputTransactionEntry->tx;
   if (!is_tx_spendtime_unlocked(outputTransaction.unlockTime)) {
     logger(DEBUGGING) <<
       "Transaction << " << transactionHash << " contains multisignature input which points to a locked transaction.";
@@ -2674,11 +3077,14 @@ bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::H
 
   bool Blockchain::rollbackBlockchainTo(uint32_t height)
   {
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     logger(INFO) << "Rolling back blockchain to " << height;
     while (height + 1 < m_blocks.size())
     {
       removeLastBlock();
     }
+
+    commitIndexes();
     logger(INFO) << "Rollback complete. Synchronization will resume.";
     return true;
   }
@@ -2691,24 +3097,28 @@ bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::H
       return false;
   }
 
-  logger(DEBUGGING) << "Removing last block with height " << m_blocks.back().height;
-  popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
+  std::shared_ptr<const BlockEntry> lastBlock = m_blocks.back();
+  logger(DEBUGGING) << "Removing last block with height " << lastBlock->height;
+  popTransactions(*lastBlock, getObjectHash(lastBlock->bl.baseTransaction));
 
-  Crypto::Hash blockHash = getBlockIdByHeight(m_blocks.back().height);
-  m_timestampIndex.remove(m_blocks.back().bl.timestamp, blockHash);
-  m_generatedTransactionsIndex.remove(m_blocks.back().bl);
+  Crypto::Hash blockHash = getBlockIdByHeight(lastBlock->height);
+  m_timestampIndex.remove(lastBlock->bl.timestamp, blockHash);
+  m_generatedTransactionsIndex.remove(lastBlock->bl);
 
+  updateUnlockedOutputCounts(static_cast<uint32_t>(m_blocks.size()), false);
   m_blocks.pop_back();
   m_blockIndex.pop();
+  m_difficultyWindow.pop();
 
   assert(m_blockIndex.size() == m_blocks.size());
+  return true;
 }
 
 bool Blockchain::checkUpgradeHeight(const UpgradeDetector& upgradeDetector) {
   uint32_t upgradeHeight = upgradeDetector.upgradeHeight();
   if (upgradeHeight != UpgradeDetectorBase::UNDEF_HEIGHT && upgradeHeight + 1 < m_blocks.size()) {
     logger(INFO) << "Checking block version at " << upgradeHeight + 1;
-    if (m_blocks[upgradeHeight + 1].bl.majorVersion != upgradeDetector.targetVersion()) {
+    if (m_blocks[upgradeHeight + 1]->bl.majorVersion != upgradeDetector.targetVersion()) {
       return false;
     }
   }
@@ -2717,12 +3127,12 @@ bool Blockchain::checkUpgradeHeight(const UpgradeDetector& upgradeDetector) {
 }
 
 bool Blockchain::getLowerBound(uint64_t timestamp, uint64_t startOffset, uint32_t& height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   assert(startOffset < m_blocks.size());
 
   auto bound = std::lower_bound(m_blocks.begin() + startOffset, m_blocks.end(), timestamp - m_currency.blockFutureTimeLimit(),
-    [](const BlockEntry& b, uint64_t timestamp) { return b.bl.timestamp < timestamp; });
+    [](const std::shared_ptr<const BlockEntry>& b, uint64_t timestamp) { return b->bl.timestamp < timestamp; });
 
   if (bound == m_blocks.end()) {
     return false;
@@ -2733,29 +3143,29 @@ bool Blockchain::getLowerBound(uint64_t timestamp, uint64_t startOffset, uint32_
 }
 
 std::vector<Crypto::Hash> Blockchain::getBlockIds(uint32_t startHeight, uint32_t maxCount) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_blockIndex.getBlockIds(startHeight, maxCount);
 }
 
 bool Blockchain::getBlockContainingTransaction(const Crypto::Hash& txId, Crypto::Hash& blockId, uint32_t& blockHeight) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   auto it = m_transactionMap.find(txId);
   if (it == m_transactionMap.end()) {
     return false;
   } else {
-    blockHeight = m_blocks[it->second.block].height;
+    blockHeight = m_blocks[it->second.block]->height;
     blockId = getBlockIdByHeight(blockHeight);
     return true;
   }
 }
 
 bool Blockchain::getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& generatedCoins) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   // try to find block in main chain
   uint32_t height = 0;
   if (m_blockIndex.getBlockHeight(hash, height)) {
-    generatedCoins = m_blocks[height].already_generated_coins;
+    generatedCoins = m_blocks[height]->already_generated_coins;
     return true;
   }
 
@@ -2771,12 +3181,12 @@ bool Blockchain::getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& ge
 }
 
 bool Blockchain::getBlockSize(const Crypto::Hash& hash, size_t& size) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   // try to find block in main chain
   uint32_t height = 0;
   if (m_blockIndex.getBlockHeight(hash, height)) {
-    size = m_blocks[height].block_cumulative_size;
+    size = m_blocks[height]->block_cumulative_size;
     return true;
   }
 
@@ -2792,7 +3202,7 @@ bool Blockchain::getBlockSize(const Crypto::Hash& hash, size_t& size) {
 }
 
 bool Blockchain::getMultisigOutputReference(const MultisignatureInput& txInMultisig, std::pair<Crypto::Hash, size_t>& outputReference) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   MultisignatureOutputsContainer::const_iterator amountIter = m_multisignatureOutputs.find(txInMultisig.amount);
   if (amountIter == m_multisignatureOutputs.end()) {
     logger(DEBUGGING) << "Transaction contains multisignature input with invalid amount.";
@@ -2803,7 +3213,8 @@ bool Blockchain::getMultisigOutputReference(const MultisignatureInput& txInMulti
     return false;
   }
   const MultisignatureOutputUsage& outputIndex = amountIter->second[txInMultisig.outputIndex];
-  const Transaction& outputTransaction = m_blocks[outputIndex.transactionIndex.block].transactions[outputIndex.transactionIndex.transaction].tx;
+  std::shared_ptr<const TransactionEntry> outputTransactionEntry = transactionByIndex(outputIndex.transactionIndex);
+  const Transaction& outputTransaction = outputTransactionEntry->tx;
   outputReference.first = getObjectHash(outputTransaction);
   outputReference.second = outputIndex.outputIndex;
   return true;
@@ -2827,7 +3238,7 @@ bool Blockchain::loadBlockchainIndices() {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   logger(INFO, BRIGHT_WHITE) << "Loading blockchain indices for BlockchainExplorer...";
-  BlockchainIndicesSerializer loader(*this, get_block_hash(m_blocks.back().bl), logger.getLogger());
+  BlockchainIndicesSerializer loader(*this, get_block_hash(m_blocks.back()->bl), logger.getLogger());
 
   loadFromBinaryFile(loader, appendPath(m_config_folder, m_currency.blockchinIndicesFileName()));
 
@@ -2843,7 +3254,8 @@ bool Blockchain::loadBlockchainIndices() {
       if (b % 1000 == 0) {
         logger(INFO, BRIGHT_WHITE) << "Height " << b << " of " << m_blocks.size();
       }
-      const BlockEntry& block = m_blocks[b];
+      std::shared_ptr<const BlockEntry> blockEntry = m_blocks[b];
+      const BlockEntry& block = *blockEntry;
       m_timestampIndex.add(block.bl.timestamp, get_block_hash(block.bl));
       m_generatedTransactionsIndex.add(block.bl);
       for (uint16_t t = 0; t < block.transactions.size(); ++t) {
@@ -2858,23 +3270,228 @@ bool Blockchain::loadBlockchainIndices() {
   return true;
 }
 
+bool Blockchain::openIndexes(const std::string& config_folder) {
+  try {
+    m_spent_keys.open(appendPath(config_folder, m_currency.spentKeysIndexFileName()));
+    m_transactionMap.open(appendPath(config_folder, m_currency.transactionsIndexFileName()));
+    m_outputs.open(appendPath(config_folder, m_currency.outputsIndexFileName()), appendPath(config_folder, m_currency.outputCountsIndexFileName()));
+  } catch (std::exception& e) {
+    logger(ERROR, BRIGHT_RED) << "Failed to open blockchain indexes in " << config_folder << ": " << e.what();
+    return false;
+  }
+
+  for (const char* fileName : { "spentkeys.dat", "transactionsmap.dat" }) {
+    if (boost::filesystem::exists(appendPath(config_folder, fileName))) {
+      logger(INFO, BRIGHT_WHITE) << appendPath(config_folder, fileName) << " is no longer used and can be removed";
+    }
+  }
+
+  return true;
+}
+
+// Number of blocks whose entries the spent key, transaction and output indexes all hold, or INDEX_HEIGHT_UNKNOWN.
+// Unless they are committed they may also hold entries of later blocks.
+uint64_t Blockchain::getIndexHeight() const {
+  uint64_t height = INDEX_HEIGHT_UNKNOWN;
+  for (uint64_t tag : { m_spent_keys.tag(), m_transactionMap.tag(), m_outputs.tag() }) {
+    if (tag == INDEX_HEIGHT_UNKNOWN) {
+      return INDEX_HEIGHT_UNKNOWN;
+    }
+
+    height = std::min(height, tag & ~INDEX_HEIGHT_CHANGING);
+  }
+
+  return height;
+}
+
+// Whether the indexes hold exactly the first getIndexHeight() blocks
+bool Blockchain::indexesCommitted() const {
+  uint64_t height = m_spent_keys.tag();
+  return (height & INDEX_HEIGHT_CHANGING) == 0 && m_transactionMap.tag() == height && m_outputs.tag() == height;
+}
+
+// The height is kept in the index files, so after a crash init() knows whether they are usable and which blocks they miss.
+// It is the block count when the indexes are committed. While blocks are pushed it is INDEX_HEIGHT_CHANGING with the count
+// of the last commit, as pushing only adds entries, and INDEX_HEIGHT_UNKNOWN once entries are removed.
+// Each change syncs the index files first, so a height found on disk is one the indexes on disk match.
+void Blockchain::setIndexHeight(uint64_t height) {
+  m_spent_keys.setTag(height);
+  m_transactionMap.setTag(height);
+  m_outputs.setTag(height);
+}
+
+// Marks the indexes as changing once for a whole batch of blocks, the mark costs a sync
+void Blockchain::beginIndexChange() {
+  if (indexesCommitted()) {
+    setIndexHeight(INDEX_HEIGHT_CHANGING | getIndexHeight());
+  }
+}
+
+void Blockchain::commitIndexes() {
+  setIndexHeight(m_blocks.size());
+  m_indexCommitTime = std::chrono::steady_clock::now();
+}
+
+// Erasing moves the entries that follow, which a crash can leave half done, so a change that erased some is committed right away
+void Blockchain::commitIndexesIfDue() {
+  uint64_t height = getIndexHeight();
+  if (height == INDEX_HEIGHT_UNKNOWN || m_blocks.size() >= height + INDEX_COMMIT_BLOCKS ||
+    std::chrono::steady_clock::now() - m_indexCommitTime >= INDEX_COMMIT_INTERVAL) {
+    commitIndexes();
+  }
+}
+
+// Drops the entries of the blocks from height on, which the indexes were given after their last commit
+void Blockchain::trimIndexes(uint32_t height) {
+  logger(WARNING, BRIGHT_YELLOW) << "Spent key, transaction and output indexes weren't committed, replaying them from height " << height;
+  setIndexHeight(INDEX_HEIGHT_UNKNOWN);
+
+  std::vector<Crypto::KeyImage> keyImages;
+  for (const auto& spentKey : m_spent_keys) {
+    if (spentKey.second >= height) {
+      keyImages.push_back(spentKey.first);
+    }
+  }
+
+  for (const auto& keyImage : keyImages) {
+    m_spent_keys.erase(keyImage);
+  }
+
+  std::vector<Crypto::Hash> transactionHashes;
+  for (const auto& transaction : m_transactionMap) {
+    if (transaction.second.block >= height) {
+      transactionHashes.push_back(transaction.first);
+    }
+  }
+
+  for (const auto& transactionHash : transactionHashes) {
+    m_transactionMap.erase(transactionHash);
+  }
+
+  m_outputs.trim(height);
+  setIndexHeight(height);
+}
+
+// Grows the indexes while they match the block store, with room for a block of the largest size allowed,
+// so that pushing the next block doesn't rehash a table in the middle of changing the indexes
+void Blockchain::reserveIndexes() {
+  uint64_t entries = getCurrentCumulativeBlocksizeLimit() / sizeof(Crypto::PublicKey);
+  m_spent_keys.reserve(entries);
+  m_transactionMap.reserve(entries);
+  m_outputs.reserve(entries);
+}
+
+void Blockchain::OutputsIndex::open(const std::string& outputsFileName, const std::string& countsFileName) {
+  m_outputs.open(outputsFileName);
+  m_counts.open(countsFileName);
+}
+
+void Blockchain::OutputsIndex::close() {
+  m_outputs.close();
+  m_counts.close();
+}
+
+void Blockchain::OutputsIndex::clear() {
+  m_outputs.clear();
+  m_counts.clear();
+}
+
+void Blockchain::OutputsIndex::flush() {
+  m_outputs.flush();
+  m_counts.flush();
+}
+
+// A commit interrupted between the two tables leaves the lower height changing
+uint64_t Blockchain::OutputsIndex::tag() const {
+  uint64_t outputsTag = m_outputs.tag();
+  uint64_t countsTag = m_counts.tag();
+  if (outputsTag == countsTag) {
+    return outputsTag;
+  } else if (outputsTag == INDEX_HEIGHT_UNKNOWN || countsTag == INDEX_HEIGHT_UNKNOWN) {
+    return INDEX_HEIGHT_UNKNOWN;
+  }
+
+  return INDEX_HEIGHT_CHANGING | std::min(outputsTag & ~INDEX_HEIGHT_CHANGING, countsTag & ~INDEX_HEIGHT_CHANGING);
+}
+
+void Blockchain::OutputsIndex::setTag(uint64_t tag) {
+  m_outputs.setTag(tag);
+  m_counts.setTag(tag);
+}
+
+void Blockchain::OutputsIndex::reserve(uint64_t count) {
+  m_outputs.reserve(count);
+  m_counts.reserve(count);
+}
+
+uint32_t Blockchain::OutputsIndex::count(uint64_t amount) const {
+  auto it = m_counts.find(amount);
+  return it == m_counts.end() ? 0 : it->second;
+}
+
+const Blockchain::OutputsIndex::Output& Blockchain::OutputsIndex::get(uint64_t amount, uint32_t index) const {
+  return m_outputs.at({ amount, index }).output;
+}
+
+const Blockchain::OutputsIndex::Entry& Blockchain::OutputsIndex::entry(uint64_t amount, uint32_t index) const {
+  return m_outputs.at({ amount, index });
+}
+
+uint32_t Blockchain::OutputsIndex::push(uint64_t amount, const Output& output, const Crypto::PublicKey& key, uint64_t unlockTime) {
+  uint32_t index = count(amount);
+  m_outputs.insert_or_assign({ amount, index }, { output, key, unlockTime });
+  m_counts.insert_or_assign(amount, index + 1);
+  return index;
+}
+
+// The outputs of an amount are in block order, so those of the later blocks are the last ones.
+// After a crash a count may point past entries that never reached the disk, or short of some that did, which push overwrites.
+void Blockchain::OutputsIndex::trim(uint32_t height) {
+  std::vector<uint64_t> amounts;
+  for (const auto& amount : m_counts) {
+    amounts.push_back(amount.first);
+  }
+
+  for (uint64_t amount : amounts) {
+    for (uint32_t index = count(amount); index != 0; --index) {
+      auto output = m_outputs.find({ amount, index - 1 });
+      if (output != m_outputs.end() && output->second.output.first.block < height) {
+        break;
+      }
+
+      pop(amount);
+    }
+  }
+}
+
+void Blockchain::OutputsIndex::pop(uint64_t amount) {
+  uint32_t index = count(amount);
+  assert(index != 0);
+  m_outputs.erase({ amount, index - 1 });
+  if (index > 1) {
+    m_counts.insert_or_assign(amount, index - 1);
+  } else {
+    m_counts.erase(amount);
+  }
+}
+
 bool Blockchain::getGeneratedTransactionsNumber(uint32_t height, uint64_t& generatedTransactions) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_generatedTransactionsIndex.find(height, generatedTransactions);
 }
 
 bool Blockchain::getOrphanBlockIdsByHeight(uint32_t height, std::vector<Crypto::Hash>& blockHashes) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_orthanBlocksIndex.find(height, blockHashes);
 }
 
 bool Blockchain::getBlockIdsByTimestamp(uint64_t timestampBegin, uint64_t timestampEnd, uint32_t blocksNumberLimit, std::vector<Crypto::Hash>& hashes, uint32_t& blocksNumberWithinTimestamps) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_timestampIndex.find(timestampBegin, timestampEnd, blocksNumberLimit, hashes, blocksNumberWithinTimestamps);
 }
 
 bool Blockchain::getTransactionIdsByPaymentId(const Crypto::Hash& paymentId, std::vector<Crypto::Hash>& transactionHashes) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_paymentIdIndex.find(paymentId, transactionHashes);
 }
 
@@ -2907,6 +3524,17 @@ void Blockchain::saveTransactions(const std::vector<Transaction>& transactions,
   }
 }
 
+void Blockchain::removePoolTransactions(const std::vector<Crypto::Hash>& transactionHashes) {
+  for (const auto& transactionHash : transactionHashes) {
+    if (m_tx_pool.have_tx(transactionHash)) {
+      Transaction transaction;
+      size_t transactionSize;
+      uint64_t fee;
+      m_tx_pool.take_tx(transactionHash, transaction, transactionSize, fee);
+    }
+  }
+}
+
 bool Blockchain::addMessageQueue(MessageQueue<BlockchainMessage>& messageQueue) {
   return m_messageQueueList.insert(messageQueue);
 }
@@ -2929,4 +3557,25 @@ bool Blockchain::isInCheckpointZone(const uint32_t height) {
   return m_checkpoints.is_in_checkpoint_zone(height);
 }
 
+bool Blockchain::checksProofOfWork(uint32_t height) const {
+  if (m_importVerification == ImportVerification::TrustCheckpoints && m_checkpoints.is_in_checkpoint_zone(height)) {
+    return false;
+  }
+
+  // Skip difficulty validation only for FOUNDATIONAL blocks, ie anything < 800k
+  // Fixes daemon's backwards compatibility issues syncing with early blocks
+  return height >= 800000;
+}
+
+bool Blockchain::checksSignatures(uint32_t height) const {
+  switch (m_importVerification) {
+  case ImportVerification::Full:
+    return true;
+  case ImportVerification::HeadersOnly:
+    return false;
+  default:
+    return !m_checkpoints.is_in_checkpoint_zone(height);
+  }
+}
+
 }
@@ -19,20 +19,29 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 
 #include "google/sparse_hash_set"
 #include "google/sparse_hash_map"
 #include <parallel_hashmap/phmap.h>
 
 #include "Common/ObserverManager.h"
+#include "Common/RecursiveSharedMutex.h"
+#include "Common/ThreadPool.h"
 #include "Common/Util.h"
 #include "CryptoNoteCore/BlockIndex.h"
 #include "CryptoNoteCore/Checkpoints.h"
 #include "CryptoNoteCore/Currency.h"
 #include "CryptoNoteCore/DepositIndex.h"
+#include "CryptoNoteCore/DifficultyWindow.h"
 #include "CryptoNoteCore/IBlockchainStorageObserver.h"
 #include "CryptoNoteCore/ITransactionValidator.h"
-#include "CryptoNoteCore/SwappedVector.h"
+#include "CryptoNoteCore/MappedHashMap.h"
+#include "CryptoNoteCore/MappedVector.h"
 #include "CryptoNoteCore/UpgradeDetector.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/TransactionPool.h"
@@ -56,6 +65,23 @@ namespace CryptoNote {
   using CryptoNote::BlockInfo;
   class Blockchain : public CryptoNote::ITransactionValidator {
   public:
+    struct InputValidationResult {
+      std::vector<Crypto::PublicKey> outputKeys;
+      uint32_t maxRelatedHeight = 0;
+      bool signatureChecked = false;
+      bool valid = false;
+    };
+
+    // Outcome of a single pass over the inputs of a transaction. Ring signatures are left unchecked
+    // when validateTransactionInputs is asked to defer them, see verifyRingSignatures.
+    struct TransactionInputsValidation {
+      Crypto::Hash transactionHash;
+      Crypto::Hash prefixHash;
+      std::vector<InputValidationResult> inputs;
+      uint32_t maxUsedBlockHeight = 0;
+      bool signaturesChecked = false;
+    };
+
     Blockchain(const Currency &currency, tx_memory_pool &tx_pool, Logging::ILogger &logger, bool blockchainIndexesEnabled, bool blockchainAutosaveEnabled);
 
     bool addObserver(IBlockchainStorageObserver* observer);
@@ -69,6 +95,15 @@ namespace CryptoNote {
     virtual bool haveSpentKeyImages(const CryptoNote::Transaction& tx) override;
     virtual bool checkTransactionSize(size_t blobSize) override;
 
+    // How much of the chain is verified when blocks are added
+    // TrustCheckpoints: blocks in the checkpoint zone are accepted by hash, without proof of work or
+    //   signatures, the rest is fully verified
+    // HeadersOnly: proof of work is checked for every block, ring signatures are not checked
+    // Full: every block is fully verified, checkpoints are only compared against
+    enum class ImportVerification { TrustCheckpoints, HeadersOnly, Full };
+
+    void setVerificationThreads(size_t threadCount);
+    void setImportVerification(ImportVerification verification);
     bool init() { return init(Tools::getDefaultDataDirectory(), true); }
     bool init(const std::string& config_folder, bool load_existing);
     bool deinit();
@@ -100,6 +135,15 @@ namespace CryptoNote {
     uint8_t getBlockMajorVersionForHeight(uint32_t height) const;
     uint8_t blockMajorVersion;
     bool addNewBlock(const Block& bl_, block_verification_context& bvc);
+    // Adds a block whose transactions are already parsed, without passing them through the transaction pool
+    // proofOfWork, if given, is the block long hash computed by the caller and is only compared to the difficulty
+    bool importBlock(const Block& block, const std::vector<Transaction>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork = nullptr);
+    // Computes the long hashes of a batch of blocks on the verification pool, see ICore::computeProofsOfWork
+    std::vector<Crypto::Hash> computeProofsOfWork(const std::vector<const Block*>& blocks);
+    // Main chain block at the given height serialized the way it is stored, valid until the next block is added or removed
+    Common::ArrayView<uint8_t> getRawBlock(uint32_t height);
+    // Reads a block returned by getRawBlock, transactions doesn't include the base transaction
+    static bool parseRawBlock(Common::ArrayView<uint8_t> rawBlock, Block& block, std::vector<Transaction>& transactions);
     bool resetAndSetGenesisBlock(const Block& b);
     bool haveBlock(const Crypto::Hash& id);
     size_t getTotalTransactions();
@@ -114,6 +158,9 @@ namespace CryptoNote {
     bool getTransactionOutputGlobalIndexes(const Crypto::Hash& tx_id, std::vector<uint32_t>& indexs);
     bool get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, MultisignatureOutput& out);
     bool checkTransactionInputs(const Transaction& tx, uint32_t& pmax_used_block_height, Crypto::Hash& max_used_block_id, BlockInfo* tail = 0);
+    bool validateTransactionInputs(const Transaction& tx, TransactionInputsValidation& validation, bool checkRingSignatures = true);
+    // Whether checkTransactionInputs already checked the ring signatures against the current main chain
+    bool isTransactionVerified(const Crypto::Hash& transactionHash);
     uint64_t getCurrentCumulativeBlocksizeLimit();
     uint64_t blockDifficulty(size_t i);
     bool getBlockContainingTransaction(const Crypto::Hash& txId, Crypto::Hash& blockId, uint32_t& blockHeight);
@@ -131,6 +178,10 @@ namespace CryptoNote {
     uint64_t coinsEmittedAtHeight(uint64_t height);
     uint64_t difficultyAtHeight(uint64_t height);
     bool isInCheckpointZone(const uint32_t height);
+    // Whether the proof of work of a block at this height is checked before it is added
+    bool checksProofOfWork(uint32_t height) const;
+    // Whether the ring and multisignature signatures of a block at this height are checked before it is added
+    bool checksSignatures(uint32_t height) const;
 
     template <class visitor_t>
     bool scanOutputKeysForIndexes(const KeyInput &tx_in_to_key, visitor_t &vis, uint32_t *pmax_related_block_height = NULL);
@@ -140,7 +191,7 @@ namespace CryptoNote {
 
     template<class t_ids_container, class t_blocks_container, class t_missed_container>
     bool getBlocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) {
-      std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+      std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
       for (const auto& bl_id : block_ids) {
         uint32_t height = 0;
@@ -149,7 +200,7 @@ namespace CryptoNote {
         } else {
           if (!(height < m_blocks.size())) { logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: bl_id=" << Common::podToHex(bl_id)
             << " have index record with offset=" << height << ", bigger then m_blocks.size()=" << m_blocks.size(); return false; }
-            blocks.push_back(m_blocks[height].bl);
+            blocks.push_back(m_blocks[height]->bl);
         }
       }
 
@@ -158,14 +209,14 @@ namespace CryptoNote {
 
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     void getBlockchainTransactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) {
-      std::lock_guard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
+      std::shared_lock<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
 
       for (const auto& tx_id : txs_ids) {
         auto it = m_transactionMap.find(tx_id);
         if (it == m_transactionMap.end()) {
           missed_txs.push_back(tx_id);
         } else {
-          txs.push_back(transactionByIndex(it->second).tx);
+          txs.push_back(transactionByIndex(it->second)->tx);
         }
       }
     }
@@ -246,29 +297,107 @@ namespace CryptoNote {
       }
     };
 
-    typedef parallel_flat_hash_map<Crypto::KeyImage, uint32_t> key_images_container;
+    // Key outputs of every amount in the order they appear in the chain, the position of an output is its global index.
+    // Kept in two memory mapped tables: outputs by amount and position, and output count by amount.
+    class OutputsIndex {
+    public:
+      typedef std::pair<TransactionIndex, uint16_t> Output; // transaction, index of the output in the transaction
+
+      // The output key and the unlock time of its transaction are kept next to the position,
+      // so mixins are picked without loading transactions
+      struct Entry {
+        Output output;
+        Crypto::PublicKey key;
+        uint64_t unlockTime;
+      };
+
+      void open(const std::string& outputsFileName, const std::string& countsFileName);
+      void close();
+      void clear();
+      void flush();
+      uint64_t tag() const;
+      void setTag(uint64_t tag);
+      void reserve(uint64_t count);
+      // Pops the outputs of the blocks from height on
+      void trim(uint32_t height);
+
+      uint32_t count(uint64_t amount) const;
+      const Output& get(uint64_t amount, uint32_t index) const;
+      const Entry& entry(uint64_t amount, uint32_t index) const;
+      uint32_t push(uint64_t amount, const Output& output, const Crypto::PublicKey& key, uint64_t unlockTime);
+      void pop(uint64_t amount);
+
+      // Output counts by amount
+      const MappedHashMap<uint64_t, uint32_t>& amounts() const {
+        return m_counts;
+      }
+
+    private:
+      struct OutputKey {
+        uint64_t amount;
+        uint64_t index;
+
+        bool operator==(const OutputKey& other) const {
+          return amount == other.amount && index == other.index;
+        }
+      };
+
+      struct OutputKeyHash {
+        size_t operator()(const OutputKey& key) const {
+          return static_cast<size_t>(key.amount * 0xff51afd7ed558ccdULL ^ key.index);
+        }
+      };
+
+      MappedHashMap<OutputKey, Entry, OutputKeyHash> m_outputs;
+      MappedHashMap<uint64_t, uint32_t> m_counts;
+    };
+
+    // Tags of the memory mapped indexes, see setIndexHeight
+    static const uint64_t INDEX_HEIGHT_UNKNOWN = UINT64_MAX;
+    static const uint64_t INDEX_HEIGHT_CHANGING = 1ULL << 63;
+
+    typedef MappedHashMap<Crypto::KeyImage, uint32_t> key_images_container;
     typedef parallel_flat_hash_map<Crypto::Hash, BlockEntry> blocks_ext_by_hash;
-    typedef parallel_flat_hash_map<uint64_t, std::vector<std::pair<TransactionIndex, uint16_t>>> outputs_container; //Crypto::Hash - tx hash, size_t - index of out in transaction
+    typedef OutputsIndex outputs_container;
     typedef parallel_flat_hash_map<uint64_t, std::vector<MultisignatureOutputUsage>> MultisignatureOutputsContainer;
 
     const Currency& m_currency;
     tx_memory_pool& m_tx_pool;
-    mutable std::recursive_mutex m_blockchain_lock; // TODO: add here reader/writer lock
+    // Queries take the lock shared, only block application and rollbacks take it exclusively
+    mutable Tools::RecursiveSharedMutex m_blockchain_lock;
     Crypto::cn_context m_cn_context;
+    size_t m_verificationThreads;
+    std::unique_ptr<Tools::ThreadPool> m_verificationPool;
+    // one per verification pool worker, the slow hash scratchpad can't be shared
+    std::vector<Crypto::cn_context> m_workerContexts;
+    // last block of the previous computeProofsOfWork batch, the next batch may extend it before it is added
+    std::mutex m_proofOfWorkBatchLock;
+    Crypto::Hash m_proofOfWorkBatchTop;
+    uint32_t m_proofOfWorkBatchTopHeight;
+    std::atomic<ImportVerification> m_importVerification;
+    // written by readers of the blockchain, so guarded separately
+    std::mutex m_verifiedTransactionsLock;
+    parallel_flat_hash_map<Crypto::Hash, BlockInfo> m_verifiedTransactions;
+    // insertion order of m_verifiedTransactions, the oldest verdicts are evicted first
+    std::deque<Crypto::Hash> m_verifiedTransactionsOrder;
     Tools::ObserverManager<IBlockchainStorageObserver> m_observerManager;
 
     key_images_container m_spent_keys;
     size_t m_current_block_cumul_sz_limit;
     blocks_ext_by_hash m_alternative_chains; // Crypto::Hash -> block_extended_info
     outputs_container m_outputs;
+    std::chrono::steady_clock::time_point m_indexCommitTime;
+    // Number of outputs of an amount that are old enough to be used as mixins, for the amounts asked for so far.
+    // Filled by readers and shifted by one block whenever a block is pushed or popped.
+    std::mutex m_unlockedOutputCountsLock;
+    parallel_flat_hash_map<uint64_t, uint32_t> m_unlockedOutputCounts;
 
     std::string m_config_folder;
     Checkpoints m_checkpoints;
-    std::atomic<bool> m_is_in_checkpoint_zone;
 
-    typedef SwappedVector<BlockEntry> Blocks;
+    typedef MappedVector<BlockEntry> Blocks;
     typedef parallel_flat_hash_map<Crypto::Hash, uint32_t> BlockMap;
-    typedef parallel_flat_hash_map<Crypto::Hash, TransactionIndex> TransactionMap;
+    typedef MappedHashMap<Crypto::Hash, TransactionIndex> TransactionMap;
     typedef BasicUpgradeDetector<Blocks> UpgradeDetector;
 
     friend class BlockCacheSerializer;
@@ -276,6 +405,8 @@ namespace CryptoNote {
 
     Blocks m_blocks;
     CryptoNote::BlockIndex m_blockIndex;
+    std::mutex m_difficultyWindowLock;
+    DifficultyWindow m_difficultyWindow;
     CryptoNote::DepositIndex m_depositIndex;
     TransactionMap m_transactionMap;
     MultisignatureOutputsContainer m_multisignatureOutputs;
@@ -309,9 +440,13 @@ namespace CryptoNote {
     bool validate_miner_transaction(const Block &b, uint32_t height, size_t cumulativeBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint64_t &reward, int64_t &emissionChange);
     bool rollback_blockchain_switching(std::list<Block> &original_chain, size_t rollback_height);
     bool get_last_n_blocks_sizes(std::vector<size_t> &sz, size_t count);
-    bool add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount &result_outs, uint64_t amount, size_t i);
+    bool getRandomOutsForAmount(uint64_t amount, uint64_t outsCount, uint32_t height, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount &result_outs);
+    bool add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount &result_outs, uint64_t amount, uint32_t i, uint32_t height);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
-    size_t find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs);
+    bool is_tx_spendtime_unlocked(uint64_t unlock_time, uint32_t height);
+    uint32_t find_end_of_allowed_index(uint64_t amount, uint32_t height);
+    void updateUnlockedOutputCounts(uint32_t height, bool blockPushed);
+    void clearUnlockedOutputCounts();
     bool check_block_timestamp_main(const Block &b);
     bool check_block_timestamp(std::vector<uint64_t> timestamps, const Block &b);
     uint64_t get_adjusted_time();
@@ -322,13 +457,14 @@ namespace CryptoNote {
     std::vector<Crypto::Hash> doBuildSparseChain(const Crypto::Hash& startBlockId) const;
     bool getBlockCumulativeSize(const Block& block, size_t& cumulativeSize);
     bool update_next_comulative_size_limit();
-    bool check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height = NULL);
-    bool checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height = NULL);
-    bool checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height = NULL);
+    void updateDifficultyWindow(size_t count);
+    bool get_tx_input_keys(const KeyInput& txin, const std::vector<Crypto::Signature>& sig, std::vector<Crypto::PublicKey>& output_keys, uint32_t* pmax_related_block_height = NULL);
+    bool verifyRingSignatures(const std::vector<Transaction>& transactions, std::vector<TransactionInputsValidation>& validations, size_t* checkedCount = nullptr);
     bool check_tx_outputs(const Transaction& tx, uint32_t height) const;
-    const TransactionEntry& transactionByIndex(TransactionIndex index);
+    std::shared_ptr<const TransactionEntry> transactionByIndex(TransactionIndex index);
+    bool addBlock(const Block& bl_, const std::vector<Transaction>* transactions, const Crypto::Hash* proofOfWork, block_verification_context& bvc);
     bool pushBlock(const Block &blockData, const Crypto::Hash &id, block_verification_context &bvc, uint32_t height);
-    bool pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc);
+    bool pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc, const Crypto::Hash* proofOfWork = nullptr);
     bool pushBlock(BlockEntry &block);
     void popBlock(const Crypto::Hash &blockHash);
     bool pushTransaction(BlockEntry &block, const Crypto::Hash &transactionHash, TransactionIndex transactionIndex);
@@ -342,14 +478,29 @@ namespace CryptoNote {
     bool storeBlockchainIndices();
     bool loadBlockchainIndices();
 
+    bool openIndexes(const std::string& config_folder);
+    uint64_t getIndexHeight() const;
+    bool indexesCommitted() const;
+    void setIndexHeight(uint64_t height);
+    void beginIndexChange();
+    void commitIndexes();
+    void commitIndexesIfDue();
+    void trimIndexes(uint32_t height);
+    void reserveIndexes();
+    void updateCache(uint32_t indexHeight, uint32_t cacheHeight);
+
     bool loadTransactions(const Block& block, std::vector<Transaction>& transactions, uint32_t height);
     void saveTransactions(const std::vector<Transaction>& transactions, uint32_t height);
+    void removePoolTransactions(const std::vector<Crypto::Hash>& transactionHashes);
 
     void sendMessage(const BlockchainMessage& message);
 
     friend class LockedBlockchainStorage;
   };
 
+  // Keeps the blockchain locked for reading, blocks can't be added or removed meanwhile.
+  // The shared lock can't be upgraded: the holders (core::add_new_tx, core::executeLocked and the
+  // core queries) only read the chain and the pool, nothing they call adds, pops or stores blocks.
   class LockedBlockchainStorage: boost::noncopyable {
   public:
 
@@ -363,45 +514,42 @@ namespace CryptoNote {
   private:
 
     Blockchain& m_bc;
-    std::lock_guard<std::recursive_mutex> m_lock;
+    std::shared_lock<Tools::RecursiveSharedMutex> m_lock;
   };
 
   template<class visitor_t> bool Blockchain::scanOutputKeysForIndexes(const KeyInput& tx_in_to_key, visitor_t& vis, uint32_t* pmax_related_block_height) {
-    std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
-    auto it = m_outputs.find(tx_in_to_key.amount);
-    if (it == m_outputs.end() || !tx_in_to_key.outputIndexes.size())
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    uint32_t amountOutputCount = m_outputs.count(tx_in_to_key.amount);
+    if (amountOutputCount == 0 || !tx_in_to_key.outputIndexes.size())
       return false;
 
     std::vector<uint32_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.outputIndexes);
-    std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs_vec = it->second;
     size_t count = 0;
     for (uint64_t i : absolute_offsets) {
-      if(i >= amount_outs_vec.size() ) {
-        logger(Logging::INFO) << "Wrong index in transaction inputs: " << i << ", expected maximum " << amount_outs_vec.size() - 1;
+      if(i >= amountOutputCount ) {
+        logger(Logging::INFO) << "Wrong index in transaction inputs: " << i << ", expected maximum " << amountOutputCount - 1;
         return false;
       }
 
-      //auto tx_it = m_transactionMap.find(amount_outs_vec[i].first);
-      //if (!(tx_it != m_transactionMap.end())) { logger(ERROR, BRIGHT_RED) << "Wrong transaction id in output indexes: " << Common::podToHex(amount_outs_vec[i].first); return false; }
-
-      const TransactionEntry& tx = transactionByIndex(amount_outs_vec[i].first);
+      const OutputsIndex::Output& output = m_outputs.get(tx_in_to_key.amount, static_cast<uint32_t>(i));
+      std::shared_ptr<const TransactionEntry> tx = transactionByIndex(output.first);
 
-      if (!(amount_outs_vec[i].second < tx.tx.outputs.size())) {
+      if (!(output.second < tx->tx.outputs.size())) {
         logger(Logging::ERROR, Logging::BRIGHT_RED)
             << "Wrong index in transaction outputs: "
-            << amount_outs_vec[i].second << ", expected less then "
-            << tx.tx.outputs.size();
+            << output.second << ", expected less then "
+            << tx->tx.outputs.size();
         return false;
       }
 
-      if (!vis.handle_output(tx.tx, tx.tx.outputs[amount_outs_vec[i].second], amount_outs_vec[i].second)) {
+      if (!vis.handle_output(tx->tx, tx->tx.outputs[output.second], output.second)) {
         logger(Logging::INFO) << "Failed to handle_output for output no = " << count << ", with absolute offset " << i;
         return false;
       }
 
       if(count++ == absolute_offsets.size()-1 && pmax_related_block_height) {
-        if (*pmax_related_block_height < amount_outs_vec[i].first.block) {
-          *pmax_related_block_height = amount_outs_vec[i].first.block;
+        if (*pmax_related_block_height < output.first.block) {
+          *pmax_related_block_height = output.first.block;
         }
       }
     }
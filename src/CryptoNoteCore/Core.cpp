@@ -17,6 +17,7 @@
 
 #include "Core.h"
 
+#include <algorithm>
 #include <sstream>
 #include <unordered_set>
 #include "../CryptoNoteConfig.h"
@@ -73,8 +74,11 @@ core::core(const Currency &currency, i_cryptonote_protocol *pprotocol, Logging::
                                                                                                                                                                   m_mempool(currency, m_blockchain, m_timeProvider, logger),
                                                                                                                                                                   m_blockchain(currency, m_mempool, logger, blockchainIndexesEnabled, blockchainAutosaveEnabled),
                                                                                                                                                                   m_miner(new miner(currency, *this, logger)),
-                                                                                                                                                                  m_starter_message_showed(false)
+                                                                                                                                                                  m_starter_message_showed(false),
+                                                                                                                                                                  m_blockTemplateOutdated(false)
 {
+  m_blockTemplate.headerValid = false;
+  m_blockTemplate.valid = false;
 
   set_cryptonote_protocol(pprotocol);
   m_blockchain.addObserver(this);
@@ -172,6 +176,7 @@ bool core::init(const CoreConfig& config, const MinerConfig& minerConfig, bool l
     return false;
   }
 
+  m_blockchain.setVerificationThreads(config.verificationThreads);
   r = m_blockchain.init(m_config_folder, load_existing);
   if (!(r)) {
     logger(ERROR, BRIGHT_RED) << "Failed to initialize blockchain storage";
@@ -441,8 +446,47 @@ bool core::add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, size_t
 }
 
 bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const BinaryArray& ex_nonce) {
-  size_t median_size;
-  uint64_t already_generated_coins;
+  std::lock_guard<std::mutex> templateLock(m_blockTemplateMutex);
+  if (m_blockTemplateOutdated.exchange(false)) {
+    m_blockTemplate.headerValid = false;
+  }
+
+  uint64_t poolVersion = m_mempool.getVersion();
+  if (!m_blockTemplate.headerValid || m_blockTemplate.previousBlockHash != get_tail_id()) {
+    m_blockTemplate.valid = false;
+    if (!prepareBlockTemplateHeader()) {
+      return false;
+    }
+  }
+
+  if (!m_blockTemplate.valid || m_blockTemplate.poolVersion != poolVersion || m_blockTemplate.extraNonceSize != ex_nonce.size() ||
+    m_blockTemplate.address.spendPublicKey != adr.spendPublicKey || m_blockTemplate.address.viewPublicKey != adr.viewPublicKey) {
+    m_blockTemplate.valid = false;
+    if (!fillBlockTemplate(adr, ex_nonce) || !findExtraNonce(ex_nonce)) {
+      return false;
+    }
+
+    m_blockTemplate.poolVersion = poolVersion;
+    m_blockTemplate.address = adr;
+    m_blockTemplate.extraNonceSize = ex_nonce.size();
+    m_blockTemplate.valid = true;
+  }
+
+  b = m_blockTemplate.block;
+  std::copy(ex_nonce.begin(), ex_nonce.end(), b.baseTransaction.extra.begin() + m_blockTemplate.extraNonceOffset);
+
+  //the cached timestamp is already raised to the median of the recent blocks if needed
+  b.timestamp = std::max<uint64_t>(time(NULL), b.timestamp);
+  diffic = m_blockTemplate.difficulty;
+  height = m_blockTemplate.height;
+  return true;
+}
+
+bool core::prepareBlockTemplateHeader() {
+  m_blockTemplate.headerValid = false;
+  Block& b = m_blockTemplate.block;
+  uint32_t& height = m_blockTemplate.height;
+  difficulty_type& diffic = m_blockTemplate.difficulty;
 
   {
     LockedBlockchainStorage blockchainLock(m_blockchain);
@@ -521,10 +565,20 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
       }
     }
 //	
-    median_size = m_blockchain.getCurrentCumulativeBlocksizeLimit() / 2;
-    already_generated_coins = m_blockchain.getCoinsInCirculation();
+    m_blockTemplate.medianSize = m_blockchain.getCurrentCumulativeBlocksizeLimit() / 2;
+    m_blockTemplate.alreadyGeneratedCoins = m_blockchain.getCoinsInCirculation();
   }
 
+  m_blockTemplate.previousBlockHash = b.previousBlockHash;
+  m_blockTemplate.headerValid = true;
+  return true;
+}
+
+bool core::fillBlockTemplate(const AccountPublicAddress& adr, const BinaryArray& ex_nonce) {
+  Block& b = m_blockTemplate.block;
+  uint32_t height = m_blockTemplate.height;
+  size_t median_size = m_blockTemplate.medianSize;
+  uint64_t already_generated_coins = m_blockTemplate.alreadyGeneratedCoins;
   size_t txs_size;
   uint64_t fee;
   if (!m_mempool.fill_block_template(b, median_size, m_currency.maxBlockCumulativeSize(height), already_generated_coins, txs_size, fee, height)) {
@@ -587,6 +641,29 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
   return false;
 }
 
+// Records where the extra nonce of the template miner transaction starts, so that other requests can write theirs there
+bool core::findExtraNonce(const BinaryArray& ex_nonce) {
+  m_blockTemplate.extraNonceOffset = 0;
+  if (ex_nonce.empty()) {
+    return true;
+  }
+
+  //the field is written after the transaction public key and followed by zero padding only, so its last occurrence is the field itself
+  const std::vector<uint8_t>& extra = m_blockTemplate.block.baseTransaction.extra;
+  BinaryArray field;
+  field.push_back(TX_EXTRA_NONCE);
+  field.push_back(static_cast<uint8_t>(ex_nonce.size()));
+  field.insert(field.end(), ex_nonce.begin(), ex_nonce.end());
+  auto position = std::find_end(extra.begin(), extra.end(), field.begin(), field.end());
+  if (position == extra.end()) {
+    logger(ERROR, BRIGHT_RED) << "Extra nonce not found in the miner transaction of the block template";
+    return false;
+  }
+
+  m_blockTemplate.extraNonceOffset = static_cast<size_t>(position - extra.begin()) + 2;
+  return true;
+}
+
 std::vector<Crypto::Hash> core::findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds, size_t maxCount,
   uint32_t& totalBlockCount, uint32_t& startBlockIndex) {
 
@@ -684,6 +761,21 @@ void core::getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vec
   assert(misses.empty());
 }
 
+bool core::getPoolChanges(const TransactionPoolSketch& knownTxsSketch, std::vector<Transaction>& addedTxs,
+                          std::vector<uint64_t>& deletedTxsShortIds) {
+
+  std::vector<Crypto::Hash> addedTxsIds;
+  auto guard = m_mempool.obtainGuard();
+  if (!m_mempool.get_difference(knownTxsSketch, addedTxsIds, deletedTxsShortIds)) {
+    return false;
+  }
+
+  std::vector<Crypto::Hash> misses;
+  m_mempool.getTransactions(addedTxsIds, addedTxs, misses);
+  assert(misses.empty());
+  return true;
+}
+
 bool core::handle_incoming_block_blob(const BinaryArray& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) {
   if (block_blob.size() > m_currency.maxBlockBlobSize()) {
     logger(INFO) << "WRONG BLOCK BLOB, too big size " << block_blob.size() << ", rejected";
@@ -742,6 +834,92 @@ bool core::handle_incoming_block(const Block& b, block_verification_context& bvc
   return true;
 }
 
+bool core::importBlock(const Block& block, const std::vector<BinaryArray>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork) {
+  if (transactions.size() != block.transactionHashes.size()) {
+    logger(INFO) << "Block " << get_block_hash(block) << " came with " << transactions.size() << " transactions, expected " << block.transactionHashes.size();
+    bvc.m_verification_failed = true;
+    return false;
+  }
+
+  std::vector<Transaction> parsedTransactions(transactions.size());
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    const BinaryArray& transactionBlob = transactions[i];
+    if (transactionBlob.size() > m_currency.maxTxSize()) {
+      logger(INFO) << "WRONG TRANSACTION BLOB, too big size " << transactionBlob.size() << ", rejected";
+      bvc.m_verification_failed = true;
+      return false;
+    }
+
+    Crypto::Hash transactionHash;
+    Crypto::Hash transactionPrefixHash;
+    if (!parse_tx_from_blob(parsedTransactions[i], transactionHash, transactionPrefixHash, transactionBlob)) {
+      logger(INFO) << "WRONG TRANSACTION BLOB, Failed to parse, rejected";
+      bvc.m_verification_failed = true;
+      return false;
+    }
+
+    if (transactionHash != block.transactionHashes[i]) {
+      logger(INFO) << "Transaction " << transactionHash << " doesn't match block transaction " << block.transactionHashes[i];
+      bvc.m_verification_failed = true;
+      return false;
+    }
+  }
+
+  return importCheckedBlock(block, parsedTransactions, bvc, proofOfWork);
+}
+
+bool core::importBlock(const Block& block, const std::vector<Transaction>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork) {
+  if (transactions.size() != block.transactionHashes.size()) {
+    logger(INFO) << "Block " << get_block_hash(block) << " came with " << transactions.size() << " transactions, expected " << block.transactionHashes.size();
+    bvc.m_verification_failed = true;
+    return false;
+  }
+
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    Crypto::Hash transactionHash = getObjectHash(transactions[i]);
+    if (transactionHash != block.transactionHashes[i]) {
+      logger(INFO) << "Transaction " << transactionHash << " doesn't match block transaction " << block.transactionHashes[i];
+      bvc.m_verification_failed = true;
+      return false;
+    }
+  }
+
+  return importCheckedBlock(block, transactions, bvc, proofOfWork);
+}
+
+// The transactions are known to be the ones of the block
+bool core::importCheckedBlock(const Block& block, const std::vector<Transaction>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork) {
+  uint32_t height = get_current_blockchain_height();
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    const Transaction& tx = transactions[i];
+    if (!check_tx_syntax(tx)) {
+      logger(ERROR) << "WRONG TRANSACTION BLOB, Failed to check tx " << block.transactionHashes[i] << " syntax, rejected";
+      bvc.m_verification_failed = true;
+      return false;
+    }
+
+    if (!check_tx_semantic(tx, true, height)) {
+      logger(ERROR) << "WRONG TRANSACTION BLOB, Failed to check tx " << block.transactionHashes[i] << " semantic, rejected";
+      bvc.m_verification_failed = true;
+      return false;
+    }
+  }
+
+  return m_blockchain.importBlock(block, transactions, bvc, proofOfWork);
+}
+
+std::vector<Crypto::Hash> core::computeProofsOfWork(const std::vector<const Block*>& blocks) {
+  return m_blockchain.computeProofsOfWork(blocks);
+}
+
+void core::setImportVerification(Blockchain::ImportVerification verification) {
+  m_blockchain.setImportVerification(verification);
+}
+
+Common::ArrayView<uint8_t> core::getRawBlock(uint32_t height) {
+  return m_blockchain.getRawBlock(height);
+}
+
 Crypto::Hash core::get_tail_id() {
   return m_blockchain.getTailId();
 }
@@ -754,6 +932,10 @@ bool core::have_block(const Crypto::Hash& id) {
   return m_blockchain.haveBlock(id);
 }
 
+bool core::have_transaction(const Crypto::Hash& id) {
+  return m_mempool.have_tx(id) || m_blockchain.haveTransaction(id);
+}
+
 bool core::parse_tx_from_blob(Transaction& tx, Crypto::Hash& tx_hash, Crypto::Hash& tx_prefix_hash, const BinaryArray& blob) {
   return parseAndValidateTransactionFromBinaryArray(blob, tx, tx_hash, tx_prefix_hash);
 }
@@ -773,6 +955,12 @@ std::vector<Transaction> core::getPoolTransactions() {
   return result;
 }
 
+std::vector<Crypto::Hash> core::getPoolTransactionIds() {
+  std::vector<Crypto::Hash> ids;
+  m_mempool.get_transaction_ids(ids);
+  return ids;
+}
+
 
 std::vector<Crypto::Hash> core::buildSparseChain() {
   assert(m_blockchain.getCurrentBlockchainHeight() != 0);
@@ -857,6 +1045,7 @@ bool core::removeObserver(ICoreObserver* observer) {
 }
 
 void core::blockchainUpdated() {
+  m_blockTemplateOutdated = true;
   m_observerManager.notify(&ICoreObserver::blockchainUpdated);
 }
 
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <ctime>
+#include <mutex>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 
@@ -52,6 +53,12 @@ namespace CryptoNote {
      bool on_idle() override;
      virtual bool handle_incoming_tx(const BinaryArray& tx_blob, tx_verification_context& tvc, bool keeped_by_block) override; //Deprecated. Should be removed with CryptoNoteProtocolHandler.
      bool handle_incoming_block_blob(const BinaryArray& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) override;
+     virtual bool importBlock(const Block& block, const std::vector<BinaryArray>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork) override;
+     // Same as the ICore one for transactions that are already parsed
+     bool importBlock(const Block& block, const std::vector<Transaction>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork);
+     virtual std::vector<Crypto::Hash> computeProofsOfWork(const std::vector<const Block*>& blocks) override;
+     Common::ArrayView<uint8_t> getRawBlock(uint32_t height);
+     void setImportVerification(Blockchain::ImportVerification verification);
      virtual i_cryptonote_protocol* get_protocol() override {return m_pprotocol;}
      virtual const Currency& currency() const override { return m_currency; }
 
@@ -98,6 +105,7 @@ namespace CryptoNote {
      uint8_t getCurrentBlockMajorVersion();
      uint32_t get_current_blockchain_height();
      bool have_block(const Crypto::Hash& id) override;
+     bool have_transaction(const Crypto::Hash& id) override;
      std::vector<Crypto::Hash> buildSparseChain() override;
      std::vector<Crypto::Hash> buildSparseChain(const Crypto::Hash& startBlockId) override;
      void on_synchronized() override;
@@ -131,6 +139,7 @@ namespace CryptoNote {
     void set_checkpoints(Checkpoints &&chk_pts);
 
     std::vector<Transaction> getPoolTransactions() override;
+    std::vector<Crypto::Hash> getPoolTransactionIds() override;
     bool getPoolTransaction(const Crypto::Hash &tx_hash, Transaction &transaction) override;
     size_t get_pool_transactions_count();
     size_t get_blockchain_total_transactions();
@@ -155,6 +164,8 @@ namespace CryptoNote {
                                 std::vector<Transaction> &addedTxs, std::vector<Crypto::Hash> &deletedTxsIds) override;
     virtual bool getPoolChangesLite(const Crypto::Hash &tailBlockId, const std::vector<Crypto::Hash> &knownTxsIds,
                                     std::vector<TransactionPrefixInfo> &addedTxs, std::vector<Crypto::Hash> &deletedTxsIds) override;
+    virtual bool getPoolChanges(const TransactionPoolSketch &knownTxsSketch, std::vector<Transaction> &addedTxs,
+                                std::vector<uint64_t> &deletedTxsShortIds) override;
     virtual void getPoolChanges(const std::vector<Crypto::Hash> &knownTxsIds, std::vector<Transaction> &addedTxs,
                                 std::vector<Crypto::Hash> &deletedTxsIds) override;
 
@@ -174,6 +185,7 @@ namespace CryptoNote {
 
     bool check_tx_syntax(const Transaction &tx);  //check correct values, amounts and all lightweight checks not related with database
     bool check_tx_semantic(const Transaction &tx, bool keeped_by_block, uint32_t &height); //check if tx already in memory pool or in main blockchain
+    bool importCheckedBlock(const Block& block, const std::vector<Transaction>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork);
     bool check_tx_mixin(const Transaction& tx);   //check if the mixin is not too large
     bool check_tx_fee(const Transaction& tx, size_t blobSize, tx_verification_context& tvc); //check for proper tx fee
 
@@ -189,6 +201,26 @@ namespace CryptoNote {
 
     bool findStartAndFullOffsets(const std::vector<Crypto::Hash> &knownBlockIds, uint64_t timestamp, uint32_t &startOffset, uint32_t &startFullOffset);
     std::vector<Crypto::Hash> findIdsForShortBlocks(uint32_t startOffset, uint32_t startFullOffset);
+    bool prepareBlockTemplateHeader();
+    bool fillBlockTemplate(const AccountPublicAddress& adr, const BinaryArray& ex_nonce);
+    bool findExtraNonce(const BinaryArray& ex_nonce);
+
+    // The last block template handed out. Requests for the same top block, pool version, address and extra nonce size
+    // only copy it and write their own extra nonce, a new pool version on the same top block keeps the header part.
+    struct BlockTemplateCache {
+      Crypto::Hash previousBlockHash;
+      uint64_t poolVersion;
+      AccountPublicAddress address;
+      size_t extraNonceSize;
+      size_t extraNonceOffset; // in the extra of the miner transaction
+      Block block;
+      difficulty_type difficulty;
+      uint32_t height;
+      size_t medianSize;
+      uint64_t alreadyGeneratedCoins;
+      bool headerValid;
+      bool valid;
+    };
 
     const Currency &m_currency;
     Logging::LoggerRef logger;
@@ -202,6 +234,9 @@ namespace CryptoNote {
     friend class tx_validate_inputs;
     std::atomic<bool> m_starter_message_showed;
     Tools::ObserverManager<ICoreObserver> m_observerManager;
+    std::mutex m_blockTemplateMutex;
+    BlockTemplateCache m_blockTemplate;
+    std::atomic<bool> m_blockTemplateOutdated;
      time_t start_time;
    };
 }
@@ -22,6 +22,10 @@
 
 namespace CryptoNote {
 
+namespace {
+const command_line::arg_descriptor<uint32_t> arg_verification_threads = {"verification-threads", "Number of threads used to verify ring signatures of incoming blocks, 0 - use all available cores", 0};
+}
+
 CoreConfig::CoreConfig() {
   configFolder = Tools::getDefaultDataDirectory();
 }
@@ -31,8 +35,13 @@ void CoreConfig::init(const boost::program_options::variables_map& options) {
     configFolder = command_line::get_arg(options, command_line::arg_data_dir);
     configFolderDefaulted = options[command_line::arg_data_dir.name].defaulted();
   }
+
+  if (options.count(arg_verification_threads.name) != 0) {
+    verificationThreads = command_line::get_arg(options, arg_verification_threads);
+  }
 }
 
 void CoreConfig::initOptions(boost::program_options::options_description& desc) {
+  command_line::add_arg(desc, arg_verification_threads);
 }
 } //namespace CryptoNote
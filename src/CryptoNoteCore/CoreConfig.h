@@ -32,6 +32,7 @@ public:
 
   std::string configFolder;
   bool configFolderDefaulted = true;
+  size_t verificationThreads = 0;
 };
 
 } //namespace CryptoNote
@@ -88,6 +88,12 @@ namespace CryptoNote
       m_blocksFileName = "testnet_" + m_blocksFileName;
       m_blocksCacheFileName = "testnet_" + m_blocksCacheFileName;
       m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
+      m_blockStoreFileName = "testnet_" + m_blockStoreFileName;
+      m_blockStoreIndexFileName = "testnet_" + m_blockStoreIndexFileName;
+      m_spentKeysIndexFileName = "testnet_" + m_spentKeysIndexFileName;
+      m_transactionsIndexFileName = "testnet_" + m_transactionsIndexFileName;
+      m_outputsIndexFileName = "testnet_" + m_outputsIndexFileName;
+      m_outputCountsIndexFileName = "testnet_" + m_outputCountsIndexFileName;
       m_txPoolFileName = "testnet_" + m_txPoolFileName;
       m_blockchinIndicesFileName = "testnet_" + m_blockchinIndicesFileName;
     }
@@ -795,8 +801,14 @@ namespace CryptoNote
     return Common::fromString(strAmount, amount);
   }
 
-	difficulty_type Currency::nextDifficulty(uint32_t height, uint8_t blockMajorVersion, std::vector<uint64_t> timestamps,
-		std::vector<difficulty_type> cumulativeDifficulties) const {
+	difficulty_type Currency::nextDifficulty(uint32_t height, uint8_t blockMajorVersion, const std::vector<uint64_t>& timestamps,
+		const std::vector<difficulty_type>& cumulativeDifficulties) const {
+		return nextDifficulty(height, blockMajorVersion, Common::ArrayView<uint64_t>(timestamps.data(), timestamps.size()),
+			Common::ArrayView<difficulty_type>(cumulativeDifficulties.data(), cumulativeDifficulties.size()));
+	}
+
+	difficulty_type Currency::nextDifficulty(uint32_t height, uint8_t blockMajorVersion, Common::ArrayView<uint64_t> timestamps,
+		Common::ArrayView<difficulty_type> cumulativeDifficulties) const {
 
 		if (blockMajorVersion >= BLOCK_MAJOR_VERSION_7) {
 			return nextDifficultyV5(height, blockMajorVersion, timestamps, cumulativeDifficulties);
@@ -807,11 +819,15 @@ namespace CryptoNote
 		else if (blockMajorVersion >= BLOCK_MAJOR_VERSION_3) {
 			return nextDifficultyV3(timestamps, cumulativeDifficulties);
 		}
-		else if (blockMajorVersion == BLOCK_MAJOR_VERSION_2) {
-			return nextDifficultyV2(timestamps, cumulativeDifficulties);
+
+		// V1 and V2 sort the timestamps, they work on their own copy of the window
+		std::vector<uint64_t> timestampsCopy(timestamps.begin(), timestamps.end());
+		std::vector<difficulty_type> cumulativeDifficultiesCopy(cumulativeDifficulties.begin(), cumulativeDifficulties.end());
+		if (blockMajorVersion == BLOCK_MAJOR_VERSION_2) {
+			return nextDifficultyV2(std::move(timestampsCopy), std::move(cumulativeDifficultiesCopy));
 		}
 		else {
-			return nextDifficultyV1(timestamps, cumulativeDifficulties);
+			return nextDifficultyV1(std::move(timestampsCopy), std::move(cumulativeDifficultiesCopy));
 		}
 	}
 
@@ -922,8 +938,8 @@ namespace CryptoNote
 		return nextDiffZ;
 	}
 
-	difficulty_type Currency::nextDifficultyV3(std::vector<uint64_t> timestamps,
-		std::vector<difficulty_type> cumulativeDifficulties) const {
+	difficulty_type Currency::nextDifficultyV3(Common::ArrayView<uint64_t> timestamps,
+		Common::ArrayView<difficulty_type> cumulativeDifficulties) const {
 
 		// LWMA difficulty algorithm
 		// Copyright (c) 2017-2018 Zawy
@@ -939,16 +955,13 @@ namespace CryptoNote
 		size_t N = CryptoNote::parameters::DIFFICULTY_WINDOW_V3;
 
 		// return a difficulty of 1 for first 3 blocks if it's the start of the chain
-		if (timestamps.size() < 4) {
+		if (timestamps.getSize() < 4) {
 			return 1;
 		}
 		// otherwise, use a smaller N if the start of the chain is less than N+1
-		else if (timestamps.size() < N + 1) {
-			N = timestamps.size() - 1;
-		}
-		else if (timestamps.size() > N + 1) {
-			timestamps.resize(N + 1);
-			cumulativeDifficulties.resize(N + 1);
+		// (only the first N+1 entries are used if there are more)
+		else if (timestamps.getSize() < N + 1) {
+			N = timestamps.getSize() - 1;
 		}
 
 		// To get an average solvetime to within +/- ~0.1%, use an adjustment factor.
@@ -988,7 +1001,7 @@ namespace CryptoNote
 	
 
 	difficulty_type Currency::nextDifficultyV4(uint32_t height, uint8_t blockMajorVersion,
-		std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulativeDifficulties) const {
+		Common::ArrayView<uint64_t> timestamps, Common::ArrayView<difficulty_type> cumulativeDifficulties) const {
 			
 			// LWMA-1 difficulty algorithm 
 			// Copyright (c) 2017-2018 Zawy, MIT License
@@ -1002,7 +1015,7 @@ namespace CryptoNote
 	   		   uint64_t difficulty_plate = 10000;
 	   		   
 
-			   assert(timestamps.size() == cumulativeDifficulties.size() && timestamps.size() <= static_cast<uint64_t>(N + 1));
+			   assert(timestamps.getSize() == cumulativeDifficulties.getSize() && timestamps.getSize() <= static_cast<uint64_t>(N + 1));
 
 			   // If it's a new coin, do startup code. Do not remove in case other coins copy your code.
 			   // uint64_t difficulty_guess = 10000;
@@ -1055,7 +1068,7 @@ namespace CryptoNote
 	}
 
 		difficulty_type Currency::nextDifficultyV5(uint32_t height, uint8_t blockMajorVersion,
-		std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulativeDifficulties) const {
+		Common::ArrayView<uint64_t> timestamps, Common::ArrayView<difficulty_type> cumulativeDifficulties) const {
 			
 			// LWMA-1 difficulty algorithm 
 			// Copyright (c) 2017-2018 Zawy, MIT License
@@ -1069,7 +1082,7 @@ namespace CryptoNote
 	   		   uint64_t difficulty_plate = 100000;
 	   		   
 
-			   assert(timestamps.size() == cumulativeDifficulties.size() && timestamps.size() <= static_cast<uint64_t>(N + 1));
+			   assert(timestamps.getSize() == cumulativeDifficulties.getSize() && timestamps.getSize() <= static_cast<uint64_t>(N + 1));
 
 			   // If it's a new coin, do startup code. Do not remove in case other coins copy your code.
 			   // uint64_t difficulty_guess = 10000;
@@ -1132,7 +1145,7 @@ namespace CryptoNote
 			return false;
 		}
 
-		return check_hash(proofOfWork, currentDiffic);
+		return checkProofOfWork(block, currentDiffic, proofOfWork);
 	}
 
 	bool Currency::checkProofOfWorkV2(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic,
@@ -1145,10 +1158,23 @@ namespace CryptoNote
 			return false;
 		}
 
+		return checkProofOfWork(block, currentDiffic, proofOfWork);
+	}
+
+	bool Currency::checkProofOfWork(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const {
+		if (block.majorVersion < BLOCK_MAJOR_VERSION_1 || block.majorVersion > BLOCK_MAJOR_VERSION_9) {
+			logger(ERROR, BRIGHT_RED) << "Unknown block major version: " << block.majorVersion << "." << block.minorVersion;
+			return false;
+		}
+
 		if (!check_hash(proofOfWork, currentDiffic)) {
 			return false;
 		}
 
+		if (block.majorVersion < BLOCK_MAJOR_VERSION_2) {
+			return true;
+		}
+
 		TransactionExtraMergeMiningTag mmTag;
 		if (!getMergeMiningTagFromExtra(block.parentBlock.baseTransaction.extra, mmTag)) {
 			logger(ERROR) << "merge mining tag wasn't found in extra of the parent block miner transaction";
@@ -1302,6 +1328,12 @@ namespace CryptoNote
     blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
     blocksCacheFileName(parameters::CRYPTONOTE_BLOCKSCACHE_FILENAME);
     blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
+    blockStoreFileName(parameters::CRYPTONOTE_BLOCKSTORE_FILENAME);
+    blockStoreIndexFileName(parameters::CRYPTONOTE_BLOCKSTOREINDEX_FILENAME);
+    spentKeysIndexFileName(parameters::CRYPTONOTE_SPENTKEYSINDEX_FILENAME);
+    transactionsIndexFileName(parameters::CRYPTONOTE_TRANSACTIONSINDEX_FILENAME);
+    outputsIndexFileName(parameters::CRYPTONOTE_OUTPUTSINDEX_FILENAME);
+    outputCountsIndexFileName(parameters::CRYPTONOTE_OUTPUTCOUNTSINDEX_FILENAME);
     txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
     blockchinIndicesFileName(parameters::CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME);
 
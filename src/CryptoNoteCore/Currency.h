@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 #include <boost/utility.hpp>
+#include "../Common/ArrayView.h"
 #include "../CryptoNoteConfig.h"
 #include "../crypto/hash.h"
 #include "../Logging/LoggerRef.h"
@@ -174,6 +175,12 @@ public:
   const std::string &blocksFileName() const { return m_blocksFileName; }
   const std::string &blocksCacheFileName() const { return m_blocksCacheFileName; }
   const std::string &blockIndexesFileName() const { return m_blockIndexesFileName; }
+  const std::string &blockStoreFileName() const { return m_blockStoreFileName; }
+  const std::string &blockStoreIndexFileName() const { return m_blockStoreIndexFileName; }
+  const std::string &spentKeysIndexFileName() const { return m_spentKeysIndexFileName; }
+  const std::string &transactionsIndexFileName() const { return m_transactionsIndexFileName; }
+  const std::string &outputsIndexFileName() const { return m_outputsIndexFileName; }
+  const std::string &outputCountsIndexFileName() const { return m_outputCountsIndexFileName; }
   const std::string &txPoolFileName() const { return m_txPoolFileName; }
   const std::string &blockchinIndicesFileName() const { return m_blockchinIndicesFileName; }
 
@@ -210,16 +217,19 @@ public:
   std::string formatAmount(int64_t amount) const;
   bool parseAmount(const std::string &str, uint64_t &amount) const;
 
-  difficulty_type nextDifficulty(uint32_t height, uint8_t blockMajorVersion, std::vector<uint64_t> timestamps, std::vector<difficulty_type> Difficulties) const;
+  difficulty_type nextDifficulty(uint32_t height, uint8_t blockMajorVersion, const std::vector<uint64_t>& timestamps, const std::vector<difficulty_type>& Difficulties) const;
+  difficulty_type nextDifficulty(uint32_t height, uint8_t blockMajorVersion, Common::ArrayView<uint64_t> timestamps, Common::ArrayView<difficulty_type> Difficulties) const;
   difficulty_type nextDifficultyV1(std::vector<uint64_t> timestamps, std::vector<difficulty_type> Difficulties) const;
   difficulty_type nextDifficultyV2(std::vector<uint64_t> timestamps, std::vector<difficulty_type> Difficulties) const;
-  difficulty_type nextDifficultyV3(std::vector<uint64_t> timestamps, std::vector<difficulty_type> Difficulties) const;
-  difficulty_type nextDifficultyV4(uint32_t height, uint8_t blockMajorVersion, std::vector<uint64_t> timestamps, std::vector<difficulty_type> Difficulties) const;
-  difficulty_type nextDifficultyV5(uint32_t height, uint8_t blockMajorVersion, std::vector<uint64_t> timestamps, std::vector<difficulty_type> Difficulties) const;
+  difficulty_type nextDifficultyV3(Common::ArrayView<uint64_t> timestamps, Common::ArrayView<difficulty_type> Difficulties) const;
+  difficulty_type nextDifficultyV4(uint32_t height, uint8_t blockMajorVersion, Common::ArrayView<uint64_t> timestamps, Common::ArrayView<difficulty_type> Difficulties) const;
+  difficulty_type nextDifficultyV5(uint32_t height, uint8_t blockMajorVersion, Common::ArrayView<uint64_t> timestamps, Common::ArrayView<difficulty_type> Difficulties) const;
 
   bool checkProofOfWorkV1(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, Crypto::Hash& proofOfWork) const;
   bool checkProofOfWorkV2(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, Crypto::Hash& proofOfWork) const;
   bool checkProofOfWork(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, Crypto::Hash& proofOfWork) const;
+  // Same checks for a proofOfWork already computed with get_block_longhash
+  bool checkProofOfWork(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const;
   size_t getApproximateMaximumInputCount(size_t transactionSize, size_t outputCount, size_t mixinCount) const;
 
 private:
@@ -308,6 +318,12 @@ private:
   std::string m_blocksFileName;
   std::string m_blocksCacheFileName;
   std::string m_blockIndexesFileName;
+  std::string m_blockStoreFileName;
+  std::string m_blockStoreIndexFileName;
+  std::string m_spentKeysIndexFileName;
+  std::string m_transactionsIndexFileName;
+  std::string m_outputsIndexFileName;
+  std::string m_outputCountsIndexFileName;
   std::string m_txPoolFileName;
   std::string m_blockchinIndicesFileName;
 
@@ -418,6 +434,12 @@ public:
   CurrencyBuilder& blocksFileName(const std::string& val) { m_currency.m_blocksFileName = val; return *this; }
   CurrencyBuilder& blocksCacheFileName(const std::string& val) { m_currency.m_blocksCacheFileName = val; return *this; }
   CurrencyBuilder& blockIndexesFileName(const std::string& val) { m_currency.m_blockIndexesFileName = val; return *this; }
+  CurrencyBuilder& blockStoreFileName(const std::string& val) { m_currency.m_blockStoreFileName = val; return *this; }
+  CurrencyBuilder& blockStoreIndexFileName(const std::string& val) { m_currency.m_blockStoreIndexFileName = val; return *this; }
+  CurrencyBuilder& spentKeysIndexFileName(const std::string& val) { m_currency.m_spentKeysIndexFileName = val; return *this; }
+  CurrencyBuilder& transactionsIndexFileName(const std::string& val) { m_currency.m_transactionsIndexFileName = val; return *this; }
+  CurrencyBuilder& outputsIndexFileName(const std::string& val) { m_currency.m_outputsIndexFileName = val; return *this; }
+  CurrencyBuilder& outputCountsIndexFileName(const std::string& val) { m_currency.m_outputCountsIndexFileName = val; return *this; }
   CurrencyBuilder& txPoolFileName(const std::string& val) { m_currency.m_txPoolFileName = val; return *this; }
   CurrencyBuilder& blockchinIndicesFileName(const std::string& val) { m_currency.m_blockchinIndicesFileName = val; return *this; }
   
@@ -0,0 +1,89 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// that it will be useful, but WITHOUT ANY WARRANTY; without even
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>
+
+#include "DifficultyWindow.h"
+
+#include <cassert>
+
+namespace CryptoNote {
+
+DifficultyWindow::DifficultyWindow(size_t capacity) : m_capacity(capacity), m_begin(0), m_endHeight(0) {
+}
+
+void DifficultyWindow::setCapacity(size_t capacity) {
+  m_capacity = capacity;
+  clear();
+}
+
+void DifficultyWindow::push(uint32_t height, uint64_t timestamp, difficulty_type cumulativeDifficulty) {
+  if (size() != 0 && height != m_endHeight) {
+    // not a continuation of the current window, start over
+    clear();
+  }
+
+  if (m_timestamps.capacity() < 2 * m_capacity) {
+    m_timestamps.reserve(2 * m_capacity);
+    m_cumulativeDifficulties.reserve(2 * m_capacity);
+  }
+
+  m_timestamps.push_back(timestamp);
+  m_cumulativeDifficulties.push_back(cumulativeDifficulty);
+  m_endHeight = height + 1;
+
+  if (size() > m_capacity) {
+    ++m_begin;
+  }
+
+  if (m_begin >= m_capacity && m_begin != 0) {
+    m_timestamps.erase(m_timestamps.begin(), m_timestamps.begin() + m_begin);
+    m_cumulativeDifficulties.erase(m_cumulativeDifficulties.begin(), m_cumulativeDifficulties.begin() + m_begin);
+    m_begin = 0;
+  }
+}
+
+void DifficultyWindow::pop() {
+  if (size() == 0) {
+    return;
+  }
+
+  m_timestamps.pop_back();
+  m_cumulativeDifficulties.pop_back();
+  --m_endHeight;
+
+  if (size() == 0) {
+    clear();
+  }
+}
+
+void DifficultyWindow::clear() {
+  m_timestamps.clear();
+  m_cumulativeDifficulties.clear();
+  m_begin = 0;
+  m_endHeight = 0;
+}
+
+Common::ArrayView<uint64_t> DifficultyWindow::timestamps(size_t count) const {
+  assert(count <= size());
+  return Common::ArrayView<uint64_t>(m_timestamps.data() + m_timestamps.size() - count, count);
+}
+
+Common::ArrayView<difficulty_type> DifficultyWindow::cumulativeDifficulties(size_t count) const {
+  assert(count <= size());
+  return Common::ArrayView<difficulty_type>(m_cumulativeDifficulties.data() + m_cumulativeDifficulties.size() - count, count);
+}
+
+}
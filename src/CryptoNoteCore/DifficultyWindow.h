@@ -0,0 +1,59 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// that it will be useful, but WITHOUT ANY WARRANTY; without even
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Common/ArrayView.h"
+#include "CryptoNoteCore/Difficulty.h"
+
+namespace CryptoNote {
+
+// Timestamps and cumulative difficulties of the most recent main chain blocks, kept
+// contiguous so the difficulty of the next block can be computed without reading m_blocks.
+// Entries are appended and removed together with the blocks, storage is compacted once
+// the stale prefix grows to the capacity, so push() is amortized O(1).
+class DifficultyWindow {
+public:
+  explicit DifficultyWindow(size_t capacity = 0);
+
+  void setCapacity(size_t capacity);
+  size_t capacity() const { return m_capacity; }
+
+  void push(uint32_t height, uint64_t timestamp, difficulty_type cumulativeDifficulty);
+  void pop();
+  void clear();
+
+  size_t size() const { return m_timestamps.size() - m_begin; }
+  // height of the block following the last entry
+  uint32_t endHeight() const { return m_endHeight; }
+
+  // last 'count' entries, oldest first
+  Common::ArrayView<uint64_t> timestamps(size_t count) const;
+  Common::ArrayView<difficulty_type> cumulativeDifficulties(size_t count) const;
+
+private:
+  size_t m_capacity;
+  size_t m_begin;
+  uint32_t m_endHeight;
+  std::vector<uint64_t> m_timestamps;
+  std::vector<difficulty_type> m_cumulativeDifficulties;
+};
+
+}
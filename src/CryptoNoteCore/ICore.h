@@ -50,6 +50,7 @@ struct Transaction;
 struct MultisignatureInput;
 struct KeyInput;
 struct TransactionPrefixInfo;
+class TransactionPoolSketch;
 struct tx_verification_context;
 
 class ICore {
@@ -63,6 +64,7 @@ public:
   virtual bool saveBlockchain() = 0;
 
   virtual bool have_block(const Crypto::Hash& id) = 0;
+  virtual bool have_transaction(const Crypto::Hash& id) = 0;
   virtual std::vector<Crypto::Hash> buildSparseChain() = 0;
   virtual std::vector<Crypto::Hash> buildSparseChain(const Crypto::Hash& startBlockId) = 0;
   virtual bool get_stat_info(CryptoNote::core_stat_info& st_inf) = 0;
@@ -71,6 +73,15 @@ public:
   virtual void update_block_template_and_resume_mining() = 0;
   virtual bool handle_incoming_block_blob(const CryptoNote::BinaryArray& block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) = 0;
   virtual bool handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block) = 0;
+  // Adds a block received during synchronization together with its transactions, bypassing the transaction pool
+  // proofOfWork, if not null, is the block long hash from computeProofsOfWork
+  virtual bool importBlock(const Block& block, const std::vector<BinaryArray>& transactions, block_verification_context& bvc, const Crypto::Hash* proofOfWork) = 0;
+  // Computes in parallel the long hashes of a batch of blocks, each extending the main chain, the block before it
+  // or the last block of the previous batch.
+  // Runs the hashing unlocked, so it can be called off the dispatcher thread while the blockchain is in use.
+  // An entry is NULL_HASH if the block is already known, its parent isn't, its proof of work isn't checked
+  // at its height or couldn't be computed.
+  virtual std::vector<Crypto::Hash> computeProofsOfWork(const std::vector<const Block*>& blocks) = 0;
   virtual bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp) = 0; //Deprecated. Should be removed with CryptoNoteProtocolHandler.
   virtual void on_synchronized() = 0;
   virtual size_t addChain(const std::vector<const IBlock*>& chain) = 0;
@@ -84,11 +95,14 @@ public:
   virtual i_cryptonote_protocol* get_protocol() = 0;
   virtual bool handle_incoming_tx(const BinaryArray& tx_blob, tx_verification_context& tvc, bool keeped_by_block) = 0; //Deprecated. Should be removed with CryptoNoteProtocolHandler.
   virtual std::vector<Transaction> getPoolTransactions() = 0;
+  virtual std::vector<Crypto::Hash> getPoolTransactionIds() = 0;
   virtual bool getPoolTransaction(const Crypto::Hash &tx_hash, Transaction &transaction) = 0;
   virtual bool getPoolChanges(const Crypto::Hash& tailBlockId, const std::vector<Crypto::Hash>& knownTxsIds,
                               std::vector<Transaction>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) = 0;
   virtual bool getPoolChangesLite(const Crypto::Hash& tailBlockId, const std::vector<Crypto::Hash>& knownTxsIds,
                               std::vector<TransactionPrefixInfo>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) = 0;
+  virtual bool getPoolChanges(const TransactionPoolSketch& knownTxsSketch, std::vector<Transaction>& addedTxs,
+                              std::vector<uint64_t>& deletedTxsShortIds) = 0;
   virtual void getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vector<Transaction>& addedTxs,
                               std::vector<Crypto::Hash>& deletedTxsIds) = 0;
   virtual bool queryBlocks(const std::vector<Crypto::Hash>& block_ids, uint64_t timestamp,
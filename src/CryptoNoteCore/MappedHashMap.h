@@ -0,0 +1,495 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+
+#include "System/MemoryMappedFile.h"
+
+// Hash map kept in a memory mapped file, so it is usable right after open() without loading anything.
+// Keys and values are stored as plain bytes and have to be trivially copyable.
+// Collisions are resolved by linear probing, erase moves the following entries back instead of leaving tombstones.
+// When the table gets 2/3 full it is rehashed into a file twice as large, which then replaces the old one.
+// reserve() does that ahead of time, so that a series of insertions doesn't have to stop for it.
+//
+// Changes are made in the mapping only and reach the disk when the system writes the pages back or on flush().
+// The tag is an arbitrary value kept in the file header, the owner uses it to record which state the contents match.
+// setTag() syncs the entries changed since the last sync before writing the new tag, and the first change after it syncs
+// the tag before it is made. So the tag on disk never claims a state the entries on disk don't have, whatever order
+// the system writes the pages back in, and a tag change costs at most two syncs.
+//
+// Lookups may run concurrently with each other, but not with modifications.
+// Iterators and references are invalidated by insertion and erase.
+template<class Key, class Value, class Hash = std::hash<Key>>
+class MappedHashMap {
+  struct Slot;
+
+public:
+  struct value_type {
+    Key first;
+    Value second;
+  };
+
+  class const_iterator {
+  public:
+    const_iterator() : m_slot(nullptr), m_end(nullptr) {
+    }
+
+    const_iterator(const Slot* slot, const Slot* end) : m_slot(slot), m_end(end) {
+      skipUnused();
+    }
+
+    const value_type& operator*() const {
+      return m_slot->value;
+    }
+
+    const value_type* operator->() const {
+      return &m_slot->value;
+    }
+
+    const_iterator& operator++() {
+      ++m_slot;
+      skipUnused();
+      return *this;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_slot == other.m_slot;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return m_slot != other.m_slot;
+    }
+
+  private:
+    const Slot* m_slot;
+    const Slot* m_end;
+
+    void skipUnused() {
+      while (m_slot != m_end && !m_slot->used) {
+        ++m_slot;
+      }
+    }
+  };
+
+  MappedHashMap();
+  MappedHashMap(const MappedHashMap&) = delete;
+  ~MappedHashMap();
+  MappedHashMap& operator=(const MappedHashMap&) = delete;
+
+  // A missing or unreadable file is replaced with an empty table and zero tag
+  void open(const std::string& path);
+  void close();
+  bool isOpened() const;
+
+  bool empty() const;
+  uint64_t size() const;
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_iterator find(const Key& key) const;
+  size_t count(const Key& key) const;
+  const Value& at(const Key& key) const;
+
+  std::pair<const_iterator, bool> insert(const Key& key, const Value& value);
+  std::pair<const_iterator, bool> insert_or_assign(const Key& key, const Value& value);
+  size_t erase(const Key& key);
+  // Grows the table now if inserting count more entries would make it grow
+  void reserve(uint64_t count);
+  // Also resets the tag to zero
+  void clear();
+
+  uint64_t tag() const;
+  void setTag(uint64_t tag);
+  void flush();
+
+private:
+  struct Header {
+    uint64_t signature;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t tag;
+  };
+
+  struct Slot {
+    value_type value;
+    uint8_t used;
+  };
+
+  // Tables written with differently sized entries are not reused
+  static const uint64_t SIGNATURE = 0x70614d6873614846ULL ^ (static_cast<uint64_t>(sizeof(Slot)) << 32);
+  static const uint64_t INITIAL_CAPACITY = 1 << 16;
+
+  std::string m_path;
+  System::MemoryMappedFile m_file;
+  unsigned m_shift;
+  bool m_changed; // entries changed since the last sync
+  bool m_tagUnsynced; // tag written since the last sync
+
+  Header* header();
+  const Header* header() const;
+  Slot* slots();
+  const Slot* slots() const;
+  uint64_t mask() const;
+  static unsigned shiftFor(uint64_t capacity);
+  uint64_t home(const Key& key) const;
+  uint64_t findIndex(const Key& key) const;
+  bool needsGrow(uint64_t count) const;
+  void beginChange();
+  bool validate() const;
+  void create(const std::string& path, uint64_t capacity);
+  void grow();
+};
+
+template<class Key, class Value, class Hash>
+MappedHashMap<Key, Value, Hash>::MappedHashMap() : m_shift(0), m_changed(false), m_tagUnsynced(false) {
+}
+
+template<class Key, class Value, class Hash>
+MappedHashMap<Key, Value, Hash>::~MappedHashMap() {
+  close();
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::open(const std::string& path) {
+  close();
+
+  // A crash during grow() may leave only the previous table, under the .bak name
+  std::string bakPath = path + ".bak";
+  if (boost::filesystem::exists(path)) {
+    if (boost::filesystem::exists(bakPath)) {
+      boost::filesystem::remove(bakPath);
+    }
+  } else if (boost::filesystem::exists(bakPath)) {
+    boost::filesystem::rename(bakPath, path);
+  }
+
+  if (boost::filesystem::exists(path)) {
+    std::error_code ec;
+    m_file.open(path, ec);
+    if (!ec && validate()) {
+      m_path = path;
+      m_shift = shiftFor(header()->capacity);
+      m_changed = false;
+      m_tagUnsynced = false;
+      return;
+    }
+
+    m_file.close(ec);
+  }
+
+  create(path, INITIAL_CAPACITY);
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::close() {
+  if (m_file.isOpened()) {
+    std::error_code ignore;
+    m_file.close(ignore);
+  }
+
+  m_path.clear();
+}
+
+template<class Key, class Value, class Hash>
+bool MappedHashMap<Key, Value, Hash>::isOpened() const {
+  return m_file.isOpened();
+}
+
+template<class Key, class Value, class Hash>
+bool MappedHashMap<Key, Value, Hash>::empty() const {
+  return header()->size == 0;
+}
+
+template<class Key, class Value, class Hash>
+uint64_t MappedHashMap<Key, Value, Hash>::size() const {
+  return header()->size;
+}
+
+template<class Key, class Value, class Hash>
+typename MappedHashMap<Key, Value, Hash>::const_iterator MappedHashMap<Key, Value, Hash>::begin() const {
+  return const_iterator(slots(), slots() + header()->capacity);
+}
+
+template<class Key, class Value, class Hash>
+typename MappedHashMap<Key, Value, Hash>::const_iterator MappedHashMap<Key, Value, Hash>::end() const {
+  return const_iterator(slots() + header()->capacity, slots() + header()->capacity);
+}
+
+template<class Key, class Value, class Hash>
+typename MappedHashMap<Key, Value, Hash>::const_iterator MappedHashMap<Key, Value, Hash>::find(const Key& key) const {
+  uint64_t index = findIndex(key);
+  if (!slots()[index].used) {
+    return end();
+  }
+
+  return const_iterator(slots() + index, slots() + header()->capacity);
+}
+
+template<class Key, class Value, class Hash>
+size_t MappedHashMap<Key, Value, Hash>::count(const Key& key) const {
+  return slots()[findIndex(key)].used ? 1 : 0;
+}
+
+template<class Key, class Value, class Hash>
+const Value& MappedHashMap<Key, Value, Hash>::at(const Key& key) const {
+  const Slot& slot = slots()[findIndex(key)];
+  if (!slot.used) {
+    throw std::out_of_range("MappedHashMap::at");
+  }
+
+  return slot.value.second;
+}
+
+template<class Key, class Value, class Hash>
+std::pair<typename MappedHashMap<Key, Value, Hash>::const_iterator, bool> MappedHashMap<Key, Value, Hash>::insert(const Key& key, const Value& value) {
+  uint64_t index = findIndex(key);
+  if (slots()[index].used) {
+    return std::make_pair(const_iterator(slots() + index, slots() + header()->capacity), false);
+  }
+
+  beginChange();
+  if (needsGrow(1)) {
+    grow();
+    index = findIndex(key);
+  }
+
+  Slot& slot = slots()[index];
+  slot.value.first = key;
+  slot.value.second = value;
+  slot.used = 1;
+  ++header()->size;
+  return std::make_pair(const_iterator(&slot, slots() + header()->capacity), true);
+}
+
+template<class Key, class Value, class Hash>
+std::pair<typename MappedHashMap<Key, Value, Hash>::const_iterator, bool> MappedHashMap<Key, Value, Hash>::insert_or_assign(const Key& key, const Value& value) {
+  uint64_t index = findIndex(key);
+  if (!slots()[index].used) {
+    return insert(key, value);
+  }
+
+  beginChange();
+  slots()[index].value.second = value;
+  return std::make_pair(const_iterator(slots() + index, slots() + header()->capacity), false);
+}
+
+template<class Key, class Value, class Hash>
+size_t MappedHashMap<Key, Value, Hash>::erase(const Key& key) {
+  uint64_t hole = findIndex(key);
+  if (!slots()[hole].used) {
+    return 0;
+  }
+
+  beginChange();
+
+  // Entries after the hole move back into it unless that would put them before their home slot
+  uint64_t index = hole;
+  for (;;) {
+    index = (index + 1) & mask();
+    if (!slots()[index].used) {
+      break;
+    }
+
+    uint64_t entryHome = home(slots()[index].value.first);
+    if (((index - entryHome) & mask()) >= ((index - hole) & mask())) {
+      slots()[hole] = slots()[index];
+      hole = index;
+    }
+  }
+
+  slots()[hole].used = 0;
+  --header()->size;
+  return 1;
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::reserve(uint64_t count) {
+  if (needsGrow(count)) {
+    beginChange();
+    do {
+      grow();
+    } while (needsGrow(count));
+  }
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::clear() {
+  std::string path = m_path;
+  close();
+  create(path, INITIAL_CAPACITY);
+}
+
+template<class Key, class Value, class Hash>
+uint64_t MappedHashMap<Key, Value, Hash>::tag() const {
+  return header()->tag;
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::setTag(uint64_t tag) {
+  if (header()->tag == tag) {
+    return;
+  }
+
+  if (m_changed) {
+    flush();
+  }
+
+  header()->tag = tag;
+  m_tagUnsynced = true;
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::flush() {
+  m_file.flush(m_file.data(), m_file.size());
+  m_changed = false;
+  m_tagUnsynced = false;
+}
+
+template<class Key, class Value, class Hash>
+typename MappedHashMap<Key, Value, Hash>::Header* MappedHashMap<Key, Value, Hash>::header() {
+  return reinterpret_cast<Header*>(m_file.data());
+}
+
+template<class Key, class Value, class Hash>
+const typename MappedHashMap<Key, Value, Hash>::Header* MappedHashMap<Key, Value, Hash>::header() const {
+  return reinterpret_cast<const Header*>(m_file.data());
+}
+
+template<class Key, class Value, class Hash>
+typename MappedHashMap<Key, Value, Hash>::Slot* MappedHashMap<Key, Value, Hash>::slots() {
+  return reinterpret_cast<Slot*>(m_file.data() + sizeof(Header));
+}
+
+template<class Key, class Value, class Hash>
+const typename MappedHashMap<Key, Value, Hash>::Slot* MappedHashMap<Key, Value, Hash>::slots() const {
+  return reinterpret_cast<const Slot*>(m_file.data() + sizeof(Header));
+}
+
+template<class Key, class Value, class Hash>
+uint64_t MappedHashMap<Key, Value, Hash>::mask() const {
+  return header()->capacity - 1;
+}
+
+template<class Key, class Value, class Hash>
+unsigned MappedHashMap<Key, Value, Hash>::shiftFor(uint64_t capacity) {
+  unsigned shift = 64;
+  for (; capacity > 1; capacity >>= 1) {
+    --shift;
+  }
+
+  return shift;
+}
+
+// Fibonacci hashing takes the top bits of the product, so weak hashes such as std::hash<uint64_t> still spread well
+template<class Key, class Value, class Hash>
+uint64_t MappedHashMap<Key, Value, Hash>::home(const Key& key) const {
+  return (static_cast<uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ULL) >> m_shift;
+}
+
+// Index of the slot holding the key, or of the free slot it would be inserted into
+template<class Key, class Value, class Hash>
+uint64_t MappedHashMap<Key, Value, Hash>::findIndex(const Key& key) const {
+  uint64_t index = home(key);
+  while (slots()[index].used && !(slots()[index].value.first == key)) {
+    index = (index + 1) & mask();
+  }
+
+  return index;
+}
+
+template<class Key, class Value, class Hash>
+bool MappedHashMap<Key, Value, Hash>::needsGrow(uint64_t count) const {
+  return (header()->size + count) * 3 > header()->capacity * 2;
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::beginChange() {
+  if (m_tagUnsynced) {
+    m_file.flush(m_file.data(), sizeof(Header));
+    m_tagUnsynced = false;
+  }
+
+  m_changed = true;
+}
+
+template<class Key, class Value, class Hash>
+bool MappedHashMap<Key, Value, Hash>::validate() const {
+  if (m_file.size() < sizeof(Header)) {
+    return false;
+  }
+
+  const Header* h = header();
+  return h->signature == SIGNATURE && h->capacity >= INITIAL_CAPACITY && (h->capacity & (h->capacity - 1)) == 0 &&
+    h->size < h->capacity && m_file.size() == sizeof(Header) + h->capacity * sizeof(Slot);
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::create(const std::string& path, uint64_t capacity) {
+  m_file.create(path, sizeof(Header) + capacity * sizeof(Slot), true);
+  m_path = path;
+  m_shift = shiftFor(capacity);
+
+  Header* h = header();
+  h->signature = SIGNATURE;
+  h->capacity = capacity;
+  h->size = 0;
+  h->tag = 0;
+  m_changed = true;
+  m_tagUnsynced = false;
+}
+
+template<class Key, class Value, class Hash>
+void MappedHashMap<Key, Value, Hash>::grow() {
+  std::string tmpPath = m_path + ".tmp";
+  std::string bakPath = m_path + ".bak";
+
+  MappedHashMap<Key, Value, Hash> newMap;
+  newMap.create(tmpPath, header()->capacity * 2);
+  for (const Slot* slot = slots(); slot != slots() + header()->capacity; ++slot) {
+    if (slot->used) {
+      newMap.slots()[newMap.findIndex(slot->value.first)] = *slot;
+    }
+  }
+
+  newMap.header()->size = header()->size;
+  newMap.header()->tag = header()->tag;
+  newMap.flush();
+
+  m_file.rename(bakPath);
+  std::error_code ec;
+  newMap.m_file.rename(m_path, ec);
+  if (ec) {
+    std::error_code ignore;
+    m_file.rename(m_path, ignore);
+    throw std::system_error(ec, "MappedHashMap: failed to replace the table file");
+  }
+
+  m_file.swap(newMap.m_file);
+  std::swap(m_shift, newMap.m_shift);
+  newMap.close();
+
+  boost::system::error_code ignore;
+  boost::filesystem::remove(bakPath, ignore);
+}
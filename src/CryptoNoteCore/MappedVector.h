@@ -0,0 +1,497 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/ArrayView.h"
+#include "Common/FileMappedVector.h"
+#include "Common/MemoryInputStream.h"
+#include "Common/VectorOutputStream.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/BinaryOutputStreamSerializer.h"
+#include "System/MemoryMappedFile.h"
+
+// Append-only item storage with the same interface as SwappedVector.
+// Serialized items are kept back to back in a memory mapped file, the index file
+// keeps the end offset of every item. Items are deserialized on first access only
+// and kept in an LRU pool; raw() gives access to the serialized bytes without copying.
+//
+// Both files are written through their mappings: a push survives a crash of the process,
+// but only reaches the disk on flush() or close(). After a power loss the index may miss
+// the items pushed since the last flush.
+//
+// Lookups may run concurrently with each other, but not with modifications.
+// They share the ownership of the item, so it stays valid after it is evicted from the pool.
+
+template<class T> class MappedVector {
+public:
+  typedef T value_type;
+
+  class const_iterator {
+  public:
+    typedef ptrdiff_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef std::shared_ptr<const T> pointer;
+    typedef std::shared_ptr<const T> reference;
+    typedef T value_type;
+
+    const_iterator() {
+    }
+
+    const_iterator(MappedVector* mappedVector, size_t index) : m_mappedVector(mappedVector), m_index(index) {
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return m_index != other.m_index;
+    }
+
+    bool operator<(const const_iterator& other) const {
+      return m_index < other.m_index;
+    }
+
+    bool operator<=(const const_iterator& other) const {
+      return m_index <= other.m_index;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_index == other.m_index;
+    }
+
+    bool operator>(const const_iterator& other) const {
+      return m_index > other.m_index;
+    }
+
+    bool operator>=(const const_iterator& other) const {
+      return m_index >= other.m_index;
+    }
+
+    const_iterator& operator++() {
+      ++m_index;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator i = *this;
+      ++m_index;
+      return i;
+    }
+
+    const_iterator& operator--() {
+      --m_index;
+      return *this;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator i = *this;
+      --m_index;
+      return i;
+    }
+
+    const_iterator& operator+=(difference_type n) {
+      m_index += n;
+      return *this;
+    }
+
+    const_iterator& operator-=(difference_type n) {
+      m_index -= n;
+      return *this;
+    }
+
+    const_iterator operator+(difference_type n) const {
+      return const_iterator(m_mappedVector, m_index + n);
+    }
+
+    friend const_iterator operator+(difference_type n, const const_iterator& i) {
+      return const_iterator(i.m_mappedVector, n + i.m_index);
+    }
+
+    difference_type operator-(const const_iterator& other) const {
+      return m_index - other.m_index;
+    }
+
+    const_iterator operator-(difference_type n) const {
+      return const_iterator(m_mappedVector, m_index - n);
+    }
+
+    std::shared_ptr<const T> operator*() const {
+      return (*m_mappedVector)[m_index];
+    }
+
+    std::shared_ptr<const T> operator->() const {
+      return (*m_mappedVector)[m_index];
+    }
+
+    std::shared_ptr<const T> operator[](difference_type offset) const {
+      return (*m_mappedVector)[m_index + offset];
+    }
+
+    size_t index() const {
+      return m_index;
+    }
+
+  private:
+    MappedVector* m_mappedVector;
+    size_t m_index;
+  };
+
+  MappedVector();
+  MappedVector(const MappedVector&) = delete;
+  ~MappedVector();
+  MappedVector& operator=(const MappedVector&) = delete;
+
+  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize);
+  // Appends items stored by SwappedVector in the given files, the files are left untouched
+  bool importSwappedVector(const std::string& itemFileName, const std::string& indexFileName);
+  void close();
+  void flush();
+
+  bool empty() const;
+  uint64_t size() const;
+  const_iterator begin();
+  const_iterator end();
+  std::shared_ptr<const T> operator[](uint64_t index);
+  std::shared_ptr<const T> front();
+  std::shared_ptr<const T> back();
+  void clear();
+  void pop_back();
+  void push_back(const T& item);
+
+  // Serialized item, valid until the next push_back
+  Common::ArrayView<uint8_t> raw(uint64_t index) const;
+  void pushRaw(Common::ArrayView<uint8_t> data);
+
+  // Lookups served from the pool and lookups that had to deserialize the item, since open()
+  uint64_t cacheHits() const;
+  uint64_t cacheMisses() const;
+
+private:
+  struct ItemEntry;
+  struct CacheEntry;
+
+  struct ItemEntry {
+  public:
+    std::shared_ptr<T> item;
+    typename std::list<CacheEntry>::iterator cacheIter;
+  };
+
+  struct CacheEntry {
+  public:
+    typename std::map<uint64_t, ItemEntry>::iterator itemIter;
+  };
+
+  // Items file grows by chunks to avoid remapping it on every push
+  static const uint64_t ITEMS_FILE_GROWTH = 64 * 1024 * 1024;
+
+  std::string m_itemsFileName;
+  System::MemoryMappedFile m_itemsFile;
+  Common::FileMappedVector<uint64_t> m_offsets;
+  size_t m_poolSize;
+  std::mutex m_cacheMutex;
+  std::map<uint64_t, ItemEntry> m_items;
+  std::list<CacheEntry> m_cache;
+  std::atomic<uint64_t> m_cacheHits;
+  std::atomic<uint64_t> m_cacheMisses;
+
+  uint64_t itemsSize() const;
+  uint64_t itemOffset(uint64_t index) const;
+  void reserveItems(uint64_t size);
+  std::shared_ptr<T> findCached(uint64_t index);
+  std::shared_ptr<T> insertCached(uint64_t index, std::shared_ptr<T> item);
+  void removeCached(uint64_t index);
+};
+
+template<class T> MappedVector<T>::MappedVector() : m_poolSize(0), m_cacheHits(0), m_cacheMisses(0) {
+}
+
+template<class T> MappedVector<T>::~MappedVector() {
+  close();
+}
+
+template<class T> bool MappedVector<T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize) {
+  if (poolSize == 0) {
+    return false;
+  }
+
+  try {
+    bool indexExists = boost::filesystem::exists(indexFileName) || boost::filesystem::exists(indexFileName + ".bak");
+    m_offsets.open(indexFileName, Common::FileMappedVectorOpenMode::OPEN_OR_CREATE);
+    m_offsets.setAutoFlush(false);
+
+    std::error_code ec;
+    if (indexExists && boost::filesystem::exists(itemFileName)) {
+      m_itemsFile.open(itemFileName, ec);
+    } else {
+      m_offsets.clear();
+      m_itemsFile.create(itemFileName, ITEMS_FILE_GROWTH, true, ec);
+    }
+
+    if (ec || m_itemsFile.size() < itemsSize()) {
+      return false;
+    }
+  } catch (std::exception&) {
+    return false;
+  }
+
+  m_itemsFileName = itemFileName;
+  m_poolSize = poolSize;
+  m_items.clear();
+  m_cache.clear();
+  m_cacheHits = 0;
+  m_cacheMisses = 0;
+  return true;
+}
+
+template<class T> bool MappedVector<T>::importSwappedVector(const std::string& itemFileName, const std::string& indexFileName) {
+  std::ifstream itemsFile(itemFileName, std::ios::in | std::ios::binary);
+  std::ifstream indexesFile(indexFileName, std::ios::in | std::ios::binary);
+  if (!itemsFile || !indexesFile) {
+    return false;
+  }
+
+  uint64_t count;
+  indexesFile.read(reinterpret_cast<char*>(&count), sizeof count);
+  if (!indexesFile) {
+    return false;
+  }
+
+  std::vector<uint32_t> itemSizes;
+  itemSizes.reserve(static_cast<size_t>(count));
+  uint64_t totalSize = 0;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint32_t itemSize;
+    indexesFile.read(reinterpret_cast<char*>(&itemSize), sizeof itemSize);
+    if (!indexesFile) {
+      return false;
+    }
+
+    itemSizes.push_back(itemSize);
+    totalSize += itemSize;
+  }
+
+  reserveItems(itemsSize() + totalSize);
+  m_offsets.reserve(m_offsets.size() + count);
+
+  // Items are copied as they are, the serialization format is the same
+  uint64_t offset = itemsSize();
+  for (uint32_t itemSize : itemSizes) {
+    itemsFile.read(reinterpret_cast<char*>(m_itemsFile.data() + offset), itemSize);
+    if (!itemsFile) {
+      return false;
+    }
+
+    offset += itemSize;
+    m_offsets.push_back(offset);
+  }
+
+  m_itemsFile.flush(m_itemsFile.data(), offset);
+  m_offsets.flush();
+  return true;
+}
+
+template<class T> void MappedVector<T>::close() {
+  if (!m_itemsFile.isOpened()) {
+    return;
+  }
+
+  flush();
+
+  std::error_code ignore;
+  m_offsets.close(ignore);
+  m_itemsFile.close(ignore);
+  m_items.clear();
+  m_cache.clear();
+}
+
+template<class T> void MappedVector<T>::flush() {
+  m_itemsFile.flush(m_itemsFile.data(), itemsSize());
+  m_offsets.flush();
+}
+
+template<class T> bool MappedVector<T>::empty() const {
+  return m_offsets.empty();
+}
+
+template<class T> uint64_t MappedVector<T>::size() const {
+  return m_offsets.size();
+}
+
+template<class T> typename MappedVector<T>::const_iterator MappedVector<T>::begin() {
+  return const_iterator(this, 0);
+}
+
+template<class T> typename MappedVector<T>::const_iterator MappedVector<T>::end() {
+  return const_iterator(this, m_offsets.size());
+}
+
+template<class T> std::shared_ptr<const T> MappedVector<T>::operator[](uint64_t index) {
+  std::shared_ptr<T> item = findCached(index);
+  if (!item) {
+    if (index >= m_offsets.size()) {
+      throw std::runtime_error("MappedVector::operator[]");
+    }
+
+    // Deserialization runs unlocked, concurrent misses of the same item keep the first inserted copy
+    Common::ArrayView<uint8_t> data = raw(index);
+    std::shared_ptr<T> newItem = std::make_shared<T>();
+
+    Common::MemoryInputStream stream(data.getData(), data.getSize());
+    CryptoNote::BinaryInputStreamSerializer archive(stream);
+    serialize(*newItem, archive);
+
+    item = insertCached(index, std::move(newItem));
+    ++m_cacheMisses;
+  }
+
+  return item;
+}
+
+template<class T> std::shared_ptr<const T> MappedVector<T>::front() {
+  return operator[](0);
+}
+
+template<class T> std::shared_ptr<const T> MappedVector<T>::back() {
+  return operator[](m_offsets.size() - 1);
+}
+
+template<class T> void MappedVector<T>::clear() {
+  m_offsets.clear();
+  m_offsets.flush();
+
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  m_items.clear();
+  m_cache.clear();
+}
+
+template<class T> void MappedVector<T>::pop_back() {
+  if (m_offsets.empty()) {
+    throw std::runtime_error("MappedVector::pop_back");
+  }
+
+  m_offsets.pop_back();
+  removeCached(m_offsets.size());
+}
+
+template<class T> void MappedVector<T>::push_back(const T& item) {
+  std::vector<uint8_t> data;
+  Common::VectorOutputStream stream(data);
+  CryptoNote::BinaryOutputStreamSerializer archive(stream);
+  serialize(const_cast<T&>(item), archive);
+
+  pushRaw(Common::ArrayView<uint8_t>(data.data(), data.size()));
+  insertCached(m_offsets.size() - 1, std::make_shared<T>(item));
+}
+
+template<class T> Common::ArrayView<uint8_t> MappedVector<T>::raw(uint64_t index) const {
+  if (index >= m_offsets.size()) {
+    throw std::runtime_error("MappedVector::raw");
+  }
+
+  uint64_t offset = itemOffset(index);
+  return Common::ArrayView<uint8_t>(m_itemsFile.data() + offset, m_offsets[index] - offset);
+}
+
+template<class T> void MappedVector<T>::pushRaw(Common::ArrayView<uint8_t> data) {
+  uint64_t offset = itemsSize();
+  reserveItems(offset + data.getSize());
+  std::copy(data.begin(), data.end(), m_itemsFile.data() + offset);
+  m_offsets.push_back(offset + data.getSize());
+}
+
+template<class T> uint64_t MappedVector<T>::cacheHits() const {
+  return m_cacheHits;
+}
+
+template<class T> uint64_t MappedVector<T>::cacheMisses() const {
+  return m_cacheMisses;
+}
+
+template<class T> uint64_t MappedVector<T>::itemsSize() const {
+  return m_offsets.empty() ? 0 : m_offsets.back();
+}
+
+template<class T> uint64_t MappedVector<T>::itemOffset(uint64_t index) const {
+  return index == 0 ? 0 : m_offsets[index - 1];
+}
+
+template<class T> void MappedVector<T>::reserveItems(uint64_t size) {
+  if (size <= m_itemsFile.size()) {
+    return;
+  }
+
+  uint64_t newSize = (size / ITEMS_FILE_GROWTH + 1) * ITEMS_FILE_GROWTH;
+  m_itemsFile.close();
+  boost::filesystem::resize_file(m_itemsFileName, newSize);
+  m_itemsFile.open(m_itemsFileName);
+}
+
+template<class T> std::shared_ptr<T> MappedVector<T>::findCached(uint64_t index) {
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  auto itemIter = m_items.find(index);
+  if (itemIter == m_items.end()) {
+    return nullptr;
+  }
+
+  if (itemIter->second.cacheIter != --m_cache.end()) {
+    m_cache.splice(m_cache.end(), m_cache, itemIter->second.cacheIter);
+  }
+
+  ++m_cacheHits;
+  return itemIter->second.item;
+}
+
+template<class T> std::shared_ptr<T> MappedVector<T>::insertCached(uint64_t index, std::shared_ptr<T> item) {
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  auto itemIter = m_items.find(index);
+  if (itemIter != m_items.end()) {
+    return itemIter->second.item;
+  }
+
+  if (m_items.size() == m_poolSize) {
+    auto cacheIter = m_cache.begin();
+    m_items.erase(cacheIter->itemIter);
+    m_cache.erase(cacheIter);
+  }
+
+  itemIter = m_items.insert(std::make_pair(index, ItemEntry())).first;
+  CacheEntry cacheEntry = { itemIter };
+  itemIter->second.item = std::move(item);
+  itemIter->second.cacheIter = m_cache.insert(m_cache.end(), cacheEntry);
+  return itemIter->second.item;
+}
+
+template<class T> void MappedVector<T>::removeCached(uint64_t index) {
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  auto itemIter = m_items.find(index);
+  if (itemIter != m_items.end()) {
+    m_cache.erase(itemIter->second.cacheIter);
+    m_items.erase(itemIter);
+  }
+}
@@ -126,6 +126,8 @@ namespace CryptoNote
                                m_timeProvider(timeProvider),
                                m_txCheckInterval(60, timeProvider),
                                m_fee_index(boost::get<1>(m_transactions)),
+                               m_version(0),
+                               m_readyTransactionsTop(NULL_HASH),
                                logger(log, "txpool")
   {
   }
@@ -268,6 +270,7 @@ namespace CryptoNote
         logger(WARNING, BRIGHT_YELLOW) << " Transaction already exists at inserting in memory pool";
         return false;
       }
+      ++m_version;
       m_paymentIdIndex.add(txd.tx);
       m_timestampIndex.add(txd.receiveTime, txd.id);
 
@@ -356,6 +359,16 @@ namespace CryptoNote
     }
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::get_transaction_ids(std::vector<Crypto::Hash> &ids) const
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    ids.reserve(ids.size() + m_transactions.size());
+    for (const auto &tx_vt : m_transactions)
+    {
+      ids.push_back(tx_vt.id);
+    }
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::get_difference(const std::vector<Crypto::Hash> &known_tx_ids, std::vector<Crypto::Hash> &new_tx_ids, std::vector<Crypto::Hash> &deleted_tx_ids) const
   {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
@@ -388,6 +401,43 @@ namespace CryptoNote
     deleted_tx_ids.assign(known_set.begin(), known_set.end());
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_difference(const TransactionPoolSketch &known_tx_sketch, std::vector<Crypto::Hash> &new_tx_ids, std::vector<uint64_t> &deleted_tx_short_ids) const
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    TransactionPoolSketch sketch(known_tx_sketch.cellCount(), known_tx_sketch.salt());
+    std::unordered_map<uint64_t, Crypto::Hash> ready_tx_ids;
+    for (const auto &tx : m_transactions)
+    {
+      TransactionCheckInfo checkInfo(tx);
+      if (is_transaction_ready_to_go(tx.tx, checkInfo))
+      {
+        uint64_t short_id = sketch.shortId(tx.id);
+        ready_tx_ids.emplace(short_id, tx.id);
+        sketch.insert(short_id);
+      }
+    }
+
+    std::vector<uint64_t> new_tx_short_ids;
+    sketch.subtract(known_tx_sketch);
+    if (!sketch.decode(new_tx_short_ids, deleted_tx_short_ids))
+    {
+      return false;
+    }
+
+    for (uint64_t short_id : new_tx_short_ids)
+    {
+      auto it = ready_tx_ids.find(short_id);
+      if (it == ready_tx_ids.end())
+      {
+        return false;
+      }
+
+      new_tx_ids.push_back(it->second);
+    }
+
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash &top_block_id)
   {
     return true;
@@ -490,6 +540,12 @@ namespace CryptoNote
 
     BlockTemplate blockTemplate;
 
+    if (m_readyTransactionsTop != bl.previousBlockHash)
+    {
+      m_readyTransactions.clear();
+      m_readyTransactionsTop = bl.previousBlockHash;
+    }
+
     for (auto it = m_fee_index.rbegin(); it != m_fee_index.rend(); ++it)
     {
       const auto &txd = *it;
@@ -499,14 +555,18 @@ namespace CryptoNote
         continue;
       }
 
-      uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(txd.tx, height);
-      uint64_t outputs_amount = get_outs_money_amount(txd.tx);
-
-      if (outputs_amount > inputs_amount)
+      bool ready = m_readyTransactions.count(txd.id) > 0;
+      if (!ready)
       {
-        logger(WARNING, BRIGHT_YELLOW) << "Transaction, with id " << txd.id << " uses more money than it has: uses " << m_currency.formatAmount(outputs_amount) << ", has " << m_currency.formatAmount(inputs_amount)
-                                       << " and will not be included in the block template";
-        continue;
+        uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(txd.tx, height);
+        uint64_t outputs_amount = get_outs_money_amount(txd.tx);
+
+        if (outputs_amount > inputs_amount)
+        {
+          logger(WARNING, BRIGHT_YELLOW) << "Transaction, with id " << txd.id << " uses more money than it has: uses " << m_currency.formatAmount(outputs_amount) << ", has " << m_currency.formatAmount(inputs_amount)
+                                         << " and will not be included in the block template";
+          continue;
+        }
       }
 
       size_t blockSizeLimit = (txd.fee == 0) ? median_size : max_total_size;
@@ -515,8 +575,15 @@ namespace CryptoNote
         continue;
       }
 
-      TransactionCheckInfo checkInfo(txd);
-      bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
+      if (!ready)
+      {
+        TransactionCheckInfo checkInfo(txd);
+        ready = is_transaction_ready_to_go(txd.tx, checkInfo);
+        if (ready)
+        {
+          m_readyTransactions.insert(txd.id);
+        }
+      }
 
       if (ready && blockTemplate.addTransaction(txd.id, txd.tx))
       {
@@ -534,6 +601,12 @@ namespace CryptoNote
     return true;
   }
   //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::getVersion() const
+  {
+    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    return m_version;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::init(const std::string &config_folder)
   {
     std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
@@ -551,6 +624,7 @@ namespace CryptoNote
       logger(ERROR) << "Failed to load memory pool from file " << state_file_path;
 
       m_transactions.clear();
+      ++m_version;
       m_spent_key_images.clear();
       m_spentOutputs.clear();
 
@@ -624,6 +698,7 @@ namespace CryptoNote
     if (s.type() == ISerializer::INPUT)
     {
       m_transactions.clear();
+      ++m_version;
       readSequence<TransactionDetails>(std::inserter(m_transactions, m_transactions.end()), "transactions", s);
     }
     else
@@ -708,6 +783,8 @@ namespace CryptoNote
     m_paymentIdIndex.remove(i->tx);
     m_timestampIndex.remove(i->receiveTime, i->id);
     m_ttlIndex.erase(i->id);
+    m_readyTransactions.erase(i->id);
+    ++m_version;
     return m_transactions.erase(i);
   }
 
@@ -41,6 +41,7 @@
 #include "CryptoNoteCore/ITimeProvider.h"
 #include "CryptoNoteCore/ITransactionValidator.h"
 #include "CryptoNoteCore/ITxPoolObserver.h"
+#include "CryptoNoteCore/TransactionPoolSketch.h"
 #include "CryptoNoteCore/VerificationContext.h"
 #include "CryptoNoteCore/BlockchainIndices.h"
 
@@ -111,9 +112,13 @@ namespace CryptoNote {
     std::unique_lock<std::recursive_mutex> obtainGuard() const;
 
     bool fill_block_template(Block &bl, size_t median_size, size_t maxCumulativeSize, uint64_t already_generated_coins, size_t &total_size, uint64_t &fee, uint32_t& height);
+    // Changes whenever a transaction is added to or removed from the pool
+    uint64_t getVersion() const;
 
     void get_transactions(std::list<Transaction>& txs) const;
+    void get_transaction_ids(std::vector<Crypto::Hash>& ids) const;
     void get_difference(const std::vector<Crypto::Hash>& known_tx_ids, std::vector<Crypto::Hash>& new_tx_ids, std::vector<Crypto::Hash>& deleted_tx_ids) const;
+    bool get_difference(const TransactionPoolSketch& known_tx_sketch, std::vector<Crypto::Hash>& new_tx_ids, std::vector<uint64_t>& deleted_tx_short_ids) const;
     size_t get_transactions_count() const;
     std::string print_pool(bool short_format) const;
     void on_idle();
@@ -211,6 +216,12 @@ namespace CryptoNote {
     tx_container_t m_transactions;  
     tx_container_t::nth_index<1>::type& m_fee_index;
     std::unordered_map<Crypto::Hash, uint64_t> m_recentlyDeletedTransactions;
+    uint64_t m_version;
+
+    // Transactions already found ready to go on top of m_readyTransactionsTop, so block templates
+    // built on the same top block only check the transactions that arrived since the previous one
+    std::unordered_set<Crypto::Hash> m_readyTransactions;
+    Crypto::Hash m_readyTransactionsTop;
 
     Logging::LoggerRef logger;
 
@@ -0,0 +1,197 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// that it will be useful, but WITHOUT ANY WARRANTY; without even
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>
+
+#include "TransactionPoolSketch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <unordered_set>
+
+#include "crypto/siphash.h"
+
+namespace CryptoNote {
+
+namespace {
+
+// every id goes into one cell of each part of the table
+const size_t HASH_COUNT = 3;
+const uint64_t SHORT_ID_KEY = 0x7478706f6f6c6964ULL; // second half of the short id key, the salt is the first
+
+uint64_t mix(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+uint64_t checkSum(uint64_t id) {
+  return mix(id ^ 0x5bd1e9955bd1e995ULL);
+}
+
+void writeInteger(uint64_t value, size_t size, char* data) {
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+uint64_t readInteger(size_t size, const char* data) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; ++i) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+  }
+
+  return value;
+}
+
+}
+
+TransactionPoolSketch::TransactionPoolSketch() : m_salt(0) {
+}
+
+TransactionPoolSketch::TransactionPoolSketch(size_t cellCount, uint64_t salt) :
+  m_salt(salt),
+  m_cells((std::max<size_t>(cellCount, 1) + HASH_COUNT - 1) / HASH_COUNT * HASH_COUNT, Cell{0, 0, 0}) {
+}
+
+uint64_t TransactionPoolSketch::salt() const {
+  return m_salt;
+}
+
+uint64_t TransactionPoolSketch::shortId(const Crypto::Hash& transactionHash) const {
+  return Crypto::siphash24(m_salt, SHORT_ID_KEY, &transactionHash, sizeof(transactionHash));
+}
+
+size_t TransactionPoolSketch::cellCount() const {
+  return m_cells.size();
+}
+
+void TransactionPoolSketch::insert(uint64_t id) {
+  update(id, 1);
+}
+
+void TransactionPoolSketch::insert(const Crypto::Hash& transactionHash) {
+  update(shortId(transactionHash), 1);
+}
+
+void TransactionPoolSketch::subtract(const TransactionPoolSketch& other) {
+  assert(other.m_cells.size() == m_cells.size());
+  assert(other.m_salt == m_salt);
+  for (size_t i = 0; i < m_cells.size(); ++i) {
+    m_cells[i].count -= other.m_cells[i].count;
+    m_cells[i].idSum ^= other.m_cells[i].idSum;
+    m_cells[i].checkSum ^= other.m_cells[i].checkSum;
+  }
+}
+
+bool TransactionPoolSketch::decode(std::vector<uint64_t>& ownIds, std::vector<uint64_t>& otherIds) const {
+  TransactionPoolSketch rest(*this);
+  std::vector<size_t> pureCells;
+  auto isPure = [&rest](size_t index) {
+    const Cell& cell = rest.m_cells[index];
+    return (cell.count == 1 || cell.count == -1) && cell.checkSum == checkSum(cell.idSum);
+  };
+
+  for (size_t i = 0; i < rest.m_cells.size(); ++i) {
+    if (isPure(i)) {
+      pureCells.push_back(i);
+    }
+  }
+
+  // peel the cells holding a single id, removing the id makes other cells pure. Every peel empties a cell
+  // of an honest sketch for good, a crafted one may offer the same id again or never run out of pure cells.
+  std::unordered_set<uint64_t> peeledIds;
+  while (!pureCells.empty()) {
+    size_t index = pureCells.back();
+    pureCells.pop_back();
+    if (!isPure(index)) {
+      continue;
+    }
+
+    uint64_t id = rest.m_cells[index].idSum;
+    if (!peeledIds.insert(id).second || peeledIds.size() > rest.m_cells.size()) {
+      return false;
+    }
+
+    int32_t count = rest.m_cells[index].count;
+    (count > 0 ? ownIds : otherIds).push_back(id);
+    rest.update(id, -count);
+
+    size_t partSize = rest.m_cells.size() / HASH_COUNT;
+    for (size_t i = 0; i < HASH_COUNT; ++i) {
+      size_t cellIndex = i * partSize + mix(id + i) % partSize;
+      if (isPure(cellIndex)) {
+        pureCells.push_back(cellIndex);
+      }
+    }
+  }
+
+  for (const Cell& cell : rest.m_cells) {
+    if (cell.count != 0 || cell.idSum != 0 || cell.checkSum != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::string TransactionPoolSketch::toString() const {
+  std::string data(sizeof(m_salt) + m_cells.size() * CELL_SIZE, '\0');
+  writeInteger(m_salt, sizeof(m_salt), &data[0]);
+  char* cellData = &data[sizeof(m_salt)];
+  for (const Cell& cell : m_cells) {
+    writeInteger(static_cast<uint32_t>(cell.count), 4, cellData);
+    writeInteger(cell.idSum, 8, cellData + 4);
+    writeInteger(cell.checkSum, 8, cellData + 12);
+    cellData += CELL_SIZE;
+  }
+
+  return data;
+}
+
+bool TransactionPoolSketch::fromString(const std::string& data) {
+  if (data.size() <= sizeof(m_salt) || (data.size() - sizeof(m_salt)) % (CELL_SIZE * HASH_COUNT) != 0) {
+    return false;
+  }
+
+  m_salt = readInteger(sizeof(m_salt), data.data());
+  m_cells.resize((data.size() - sizeof(m_salt)) / CELL_SIZE);
+  const char* cellData = data.data() + sizeof(m_salt);
+  for (Cell& cell : m_cells) {
+    cell.count = static_cast<int32_t>(static_cast<uint32_t>(readInteger(4, cellData)));
+    cell.idSum = readInteger(8, cellData + 4);
+    cell.checkSum = readInteger(8, cellData + 12);
+    cellData += CELL_SIZE;
+  }
+
+  return true;
+}
+
+void TransactionPoolSketch::update(uint64_t id, int32_t count) {
+  size_t partSize = m_cells.size() / HASH_COUNT;
+  uint64_t idCheckSum = checkSum(id);
+  for (size_t i = 0; i < HASH_COUNT; ++i) {
+    Cell& cell = m_cells[i * partSize + mix(id + i) % partSize];
+    cell.count += count;
+    cell.idSum ^= id;
+    cell.checkSum ^= idCheckSum;
+  }
+}
+
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// that it will be useful, but WITHOUT ANY WARRANTY; without even
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace CryptoNote {
+
+// Invertible Bloom lookup table of short transaction ids, used to find the difference of two pools
+// without listing either of them. Subtracting the sketch of one pool from an equally sized sketch of
+// the other leaves the ids found in only one of them, which decode as long as there are no more
+// than about two thirds as many of them as cells.
+// The short ids are keyed by a salt picked by the requester for every sketch, so no transaction
+// can be made to collide with others in advance.
+class TransactionPoolSketch {
+public:
+  static const size_t CELL_SIZE = 20; // serialized bytes per cell, after the 8 byte salt
+
+  TransactionPoolSketch();
+  TransactionPoolSketch(size_t cellCount, uint64_t salt);
+
+  uint64_t salt() const;
+  uint64_t shortId(const Crypto::Hash& transactionHash) const;
+
+  size_t cellCount() const;
+  void insert(uint64_t id);
+  void insert(const Crypto::Hash& transactionHash);
+  void subtract(const TransactionPoolSketch& other);
+
+  // Ids inserted only into this sketch go to 'ownIds', ids only in the subtracted one to 'otherIds'.
+  // Fails when the cells don't peel down to empty ones, which a sketch sent by a peer may never do.
+  bool decode(std::vector<uint64_t>& ownIds, std::vector<uint64_t>& otherIds) const;
+
+  std::string toString() const;
+  bool fromString(const std::string& data);
+
+private:
+  struct Cell {
+    int32_t count;
+    uint64_t idSum;
+    uint64_t checkSum;
+  };
+
+  uint64_t m_salt;
+  std::vector<Cell> m_cells;
+
+  void update(uint64_t id, int32_t count);
+};
+
+}
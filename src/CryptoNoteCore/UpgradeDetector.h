@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <ctime>
+#include <memory>
 
 #include "Common/StringTools.h"
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
@@ -55,13 +56,13 @@ namespace CryptoNote {
         if (m_blockchain.empty()) {
           m_votingCompleteHeight = UNDEF_HEIGHT;
 
-        } else if (m_targetVersion - 1 == m_blockchain.back().bl.majorVersion) {
+        } else if (m_targetVersion - 1 == entry(m_blockchain.back()).bl.majorVersion) {
           m_votingCompleteHeight = findVotingCompleteHeight(m_blockchain.size() - 1);
 
-        } else if (m_targetVersion <= m_blockchain.back().bl.majorVersion) {
+        } else if (m_targetVersion <= entry(m_blockchain.back()).bl.majorVersion) {
           auto it = std::lower_bound(m_blockchain.begin(), m_blockchain.end(), m_targetVersion,
-            [](const typename BC::value_type& b, uint8_t v) { return b.bl.majorVersion < v; });
-          if (it == m_blockchain.end() || it->bl.majorVersion != m_targetVersion) {
+            [](const auto& b, uint8_t v) { return entry(b).bl.majorVersion < v; });
+          if (it == m_blockchain.end() || entry(*it).bl.majorVersion != m_targetVersion) {
             logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: upgrade height isn't found";
             return false;
           }
@@ -77,18 +78,18 @@ namespace CryptoNote {
         }
       } else if (!m_blockchain.empty()) {
         if (m_blockchain.size() <= upgradeHeight + 1) {
-          if (m_blockchain.back().bl.majorVersion >= m_targetVersion) {
+          if (entry(m_blockchain.back()).bl.majorVersion >= m_targetVersion) {
             logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: block at height " << (m_blockchain.size() - 1) <<
-              " has invalid version " << static_cast<int>(m_blockchain.back().bl.majorVersion) <<
+              " has invalid version " << static_cast<int>(entry(m_blockchain.back()).bl.majorVersion) <<
               ", expected " << static_cast<int>(m_targetVersion - 1) << " or less";
             return false;
           }
         } else {
-          int blockVersionAtUpgradeHeight = m_blockchain[upgradeHeight].bl.majorVersion;
+          int blockVersionAtUpgradeHeight = entry(m_blockchain[upgradeHeight]).bl.majorVersion;
           if (blockVersionAtUpgradeHeight != m_targetVersion - 1) {
           }
 
-          int blockVersionAfterUpgradeHeight = m_blockchain[upgradeHeight + 1].bl.majorVersion;
+          int blockVersionAfterUpgradeHeight = entry(m_blockchain[upgradeHeight + 1]).bl.majorVersion;
           if (blockVersionAfterUpgradeHeight != m_targetVersion) {
             logger(Logging::ERROR, Logging::BRIGHT_RED) << "Internal error: block at height " << (upgradeHeight + 1) <<
               " has invalid version " << blockVersionAfterUpgradeHeight <<
@@ -121,16 +122,16 @@ namespace CryptoNote {
 
       if (m_currency.upgradeHeight(m_targetVersion) != UNDEF_HEIGHT) {
         if (m_blockchain.size() <= m_currency.upgradeHeight(m_targetVersion) + 1) {
-          assert(m_blockchain.back().bl.majorVersion <= m_targetVersion - 1);
+          assert(entry(m_blockchain.back()).bl.majorVersion <= m_targetVersion - 1);
         } else {
-          assert(m_blockchain.back().bl.majorVersion >= m_targetVersion);
+          assert(entry(m_blockchain.back()).bl.majorVersion >= m_targetVersion);
         }
 
       } else if (m_votingCompleteHeight != UNDEF_HEIGHT) {
         assert(m_blockchain.size() > m_votingCompleteHeight);
 
         if (m_blockchain.size() <= upgradeHeight()) {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion - 1);
+          assert(entry(m_blockchain.back()).bl.majorVersion == m_targetVersion - 1);
 
           if (m_blockchain.size() % (60 * 60 / m_currency.difficultyTarget()) == 0) {
             auto interval = m_currency.difficultyTarget() * (upgradeHeight() - m_blockchain.size() + 2);
@@ -141,15 +142,15 @@ namespace CryptoNote {
 
             logger(Logging::TRACE, Logging::BRIGHT_GREEN) << "###### UPGRADE is going to happen after block index " << upgradeHeight() << " at about " <<
               upgradeTimeStr << " (in " << Common::timeIntervalToString(interval) << ")! Current last block index " << (m_blockchain.size() - 1) <<
-              ", hash " << get_block_hash(m_blockchain.back().bl);
+              ", hash " << get_block_hash(entry(m_blockchain.back()).bl);
           }
         } else if (m_blockchain.size() == upgradeHeight() + 1) {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion - 1);
+          assert(entry(m_blockchain.back()).bl.majorVersion == m_targetVersion - 1);
 
           logger(Logging::TRACE, Logging::BRIGHT_GREEN) << "###### UPGRADE has happened! Starting from block index " << (upgradeHeight() + 1) <<
             " blocks with major version below " << static_cast<int>(m_targetVersion) << " will be rejected!";
         } else {
-          assert(m_blockchain.back().bl.majorVersion == m_targetVersion);
+          assert(entry(m_blockchain.back()).bl.majorVersion == m_targetVersion);
         }
 
       } else {
@@ -182,7 +183,8 @@ namespace CryptoNote {
 
       size_t voteCounter = 0;
       for (size_t i = height + 1 - m_currency.upgradeVotingWindow(); i <= height; ++i) {
-        const auto& b = m_blockchain[i].bl;
+        const auto& item = m_blockchain[i];
+        const auto& b = entry(item).bl;
         voteCounter += (b.majorVersion == m_targetVersion - 1) && (b.minorVersion == BLOCK_MINOR_VERSION_1) ? 1 : 0;
       }
 
@@ -190,6 +192,15 @@ namespace CryptoNote {
     }
 
   private:
+    // BC either stores the block entries or shares them, like Blockchain::Blocks
+    static const typename BC::value_type& entry(const typename BC::value_type& item) {
+      return item;
+    }
+
+    static const typename BC::value_type& entry(const std::shared_ptr<const typename BC::value_type>& item) {
+      return *item;
+    }
+
     uint32_t findVotingCompleteHeight(uint32_t probableUpgradeHeight) {
       assert(m_currency.upgradeHeight(m_targetVersion) == UNDEF_HEIGHT);
 
@@ -243,5 +243,124 @@ namespace CryptoNote
     const static int ID = BC_COMMANDS_POOL_BASE + 10;
     typedef NOTIFY_MISSING_TXS_request request;
   };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_TX_HASHES_request
+  {
+    std::vector<Crypto::Hash> txs;
+
+    void serialize(ISerializer &s)
+    {
+      serializeAsBinary(txs, "txs", s);
+    }
+  };
+
+  struct NOTIFY_TX_HASHES
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+    typedef NOTIFY_TX_HASHES_request request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX_POOL_SKETCH_request
+  {
+    std::string sketch;
+
+    void serialize(ISerializer &s)
+    {
+      KV_MEMBER(sketch)
+    }
+  };
+
+  struct NOTIFY_REQUEST_TX_POOL_SKETCH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+    typedef NOTIFY_REQUEST_TX_POOL_SKETCH_request request;
+  };
+
+  struct NOTIFY_TX_POOL_SKETCH_FAILED_request
+  {
+    uint32_t cell_count;
+
+    void serialize(ISerializer &s)
+    {
+      KV_MEMBER(cell_count)
+    }
+  };
+
+  struct NOTIFY_TX_POOL_SKETCH_FAILED
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+    typedef NOTIFY_TX_POOL_SKETCH_FAILED_request request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK_request
+  {
+    std::string block;        // block blob with the coinbase transaction and without the transaction hashes
+    Crypto::Hash block_hash;
+    uint64_t salt;
+    std::string short_ids;    // salted short ids of the block transactions, in block order
+    uint32_t current_blockchain_height;
+    uint32_t hop;
+
+    void serialize(ISerializer &s)
+    {
+      KV_MEMBER(block)
+      KV_MEMBER(block_hash)
+      KV_MEMBER(salt)
+      KV_MEMBER(short_ids)
+      KV_MEMBER(current_blockchain_height)
+      KV_MEMBER(hop)
+    }
+  };
+
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 14;
+    typedef NOTIFY_NEW_COMPACT_BLOCK_request request;
+  };
+
+  struct NOTIFY_REQUEST_COMPACT_BLOCK_TXS_request
+  {
+    Crypto::Hash block_hash;
+    std::vector<uint32_t> indexes;
+
+    void serialize(ISerializer &s)
+    {
+      KV_MEMBER(block_hash)
+      serializeAsBinary(indexes, "indexes", s);
+    }
+  };
+
+  struct NOTIFY_REQUEST_COMPACT_BLOCK_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 15;
+    typedef NOTIFY_REQUEST_COMPACT_BLOCK_TXS_request request;
+  };
+
+  struct NOTIFY_COMPACT_BLOCK_TXS_request
+  {
+    Crypto::Hash block_hash;
+    std::vector<std::string> txs;
+
+    void serialize(ISerializer &s)
+    {
+      KV_MEMBER(block_hash)
+      KV_MEMBER(txs)
+    }
+  };
+
+  struct NOTIFY_COMPACT_BLOCK_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 16;
+    typedef NOTIFY_COMPACT_BLOCK_TXS_request request;
+  };
 } // namespace CryptoNote
 
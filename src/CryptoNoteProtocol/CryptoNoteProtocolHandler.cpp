@@ -10,16 +10,24 @@
 
 #include "CryptoNoteProtocolHandler.h"
 
+#include <algorithm>
+#include <chrono>
 #include <future>
+#include <unordered_set>
+#include <boost/functional/hash.hpp>
 #include <boost/scope_exit.hpp>
+#include <boost/uuid/nil_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <System/Dispatcher.h>
+#include <System/RemoteContext.h>
 #include <boost/optional.hpp>
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/TransactionPoolSketch.h"
 #include "CryptoNoteCore/VerificationContext.h"
+#include "crypto/siphash.h"
 #include "P2p/LevinProtocol.h"
 
 using namespace Logging;
@@ -43,6 +51,42 @@ void relay_post_notify(IP2pEndpoint &p2p, typename t_parametr::request &arg, con
   p2p.relay_notify_to_all(t_parametr::ID, LevinProtocol::encode(arg), excludeConnection);
 }
 
+// The short ids of a compact block are SipHash keyed by the hash of the block and the salt, one slow hash
+// per block, so mapping the whole pool for a block that isn't verified yet stays cheap
+struct CompactBlockShortIdKey
+{
+  uint64_t k0;
+  uint64_t k1;
+};
+
+CompactBlockShortIdKey compactBlockShortIdKey(const Crypto::Hash &blockHash, uint64_t salt)
+{
+  uint8_t data[sizeof(blockHash) + sizeof(salt)];
+  memcpy(data, &blockHash, sizeof(blockHash));
+  for (size_t i = 0; i < sizeof(salt); ++i)
+  {
+    data[sizeof(blockHash) + i] = static_cast<uint8_t>(salt >> (8 * i));
+  }
+
+  Crypto::Hash hash = Crypto::cn_fast_hash(data, sizeof(data));
+  CompactBlockShortIdKey key;
+  memcpy(&key.k0, hash.data, sizeof(key.k0));
+  memcpy(&key.k1, hash.data + sizeof(key.k0), sizeof(key.k1));
+  return key;
+}
+
+std::string compactBlockShortId(const CompactBlockShortIdKey &key, const Crypto::Hash &transactionHash)
+{
+  uint64_t id = Crypto::siphash24(key.k0, key.k1, &transactionHash, sizeof(transactionHash));
+  std::string shortId(COMPACT_BLOCK_SHORT_ID_SIZE, '\0');
+  for (size_t i = 0; i < COMPACT_BLOCK_SHORT_ID_SIZE; ++i)
+  {
+    shortId[i] = static_cast<char>(id >> (8 * i));
+  }
+
+  return shortId;
+}
+
 } // namespace
 
 CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency &currency, System::Dispatcher &dispatcher, ICore &rcore, IP2pEndpoint *p_net_layout, Logging::ILogger &log) : m_dispatcher(dispatcher),
@@ -51,6 +95,9 @@ CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency &currency, S
                                                                                                                                                                                   m_p2p(p_net_layout),
                                                                                                                                                                                   m_synchronized(false),
                                                                                                                                                                                   m_stop(false),
+                                                                                                                                                                                  m_syncGeneration(0),
+                                                                                                                                                                                  m_syncImporting(false),
+                                                                                                                                                                                  m_syncMaxRequests(BLOCKS_SYNCHRONIZING_MAX_REQUESTS),
                                                                                                                                                                                   m_observedHeight(0),
                                                                                                                                                                                   m_peersCount(0),
                                                                                                                                                                                   logger(log, "protocol")
@@ -75,12 +122,35 @@ void CryptoNoteProtocolHandler::set_p2p_endpoint(IP2pEndpoint *p2p)
     m_p2p = &m_p2p_stub;
 }
 
+void CryptoNoteProtocolHandler::setSyncMaxRequests(size_t count)
+{
+  m_syncMaxRequests = std::max<size_t>(count, 1);
+}
+
 void CryptoNoteProtocolHandler::onConnectionOpened(CryptoNoteConnectionContext &context)
 {
 }
 
 void CryptoNoteProtocolHandler::onConnectionClosed(CryptoNoteConnectionContext &context)
 {
+  // blocks requested from the peer go to the other peers on the next idle round
+  for (auto &kv : m_syncSpans)
+  {
+    if (kv.second.peer == context.m_connection_id)
+    {
+      kv.second.peer = boost::uuids::nil_uuid();
+    }
+  }
+
+  // and the transactions requested from it go to their next announcers
+  for (auto &kv : m_requestedTransactions)
+  {
+    if (kv.second.peer == context.m_connection_id)
+    {
+      kv.second.peer = boost::uuids::nil_uuid();
+    }
+  }
+
   bool updated = false;
   {
     std::lock_guard<std::mutex> lock(m_observedHeightMutex);
@@ -116,11 +186,9 @@ bool CryptoNoteProtocolHandler::start_sync(CryptoNoteConnectionContext &context)
 
   if (context.m_state == CryptoNoteConnectionContext::state_synchronizing)
   {
-    assert(context.m_needed_objects.empty());
-    assert(context.m_requested_objects.empty());
-
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
     r.block_ids = m_core.buildSparseChain();
+    context.m_chain_requested = true;
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
     post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
   }
@@ -141,14 +209,28 @@ void CryptoNoteProtocolHandler::log_connections()
      << std::setw(20) << "Peer id"
      << std::setw(25) << "Recv/Sent (inactive,sec)"
      << std::setw(25) << "State"
-     << std::setw(20) << "Lifetime(seconds)" << ENDL;
+     << std::setw(20) << "Lifetime(seconds)"
+     << std::setw(30) << "Sync blocks (KB/s, requests, rtt ms)" << ENDL;
 
+  auto now = std::chrono::steady_clock::now();
   m_p2p->for_each_connection([&](const CryptoNoteConnectionContext &cntxt, PeerIdType peer_id) {
+    auto syncTime = cntxt.m_sync_time;
+    if (!cntxt.m_requested_spans.empty())
+    {
+      syncTime += now - cntxt.m_sync_request_time;
+    }
+
+    auto syncMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(syncTime).count();
+    std::string syncStats = std::to_string(cntxt.m_sync_blocks) + " (" + std::to_string(syncMilliseconds > 0 ? cntxt.m_sync_bytes / syncMilliseconds : 0) +
+                            ", " + std::to_string(cntxt.m_requested_spans.size()) +
+                            ", " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(cntxt.m_sync_rtt).count()) + ")";
+
     ss << std::setw(25) << std::left << std::string(cntxt.m_is_income ? "[INC]" : "[OUT]") + Common::ipAddressToString(cntxt.m_remote_ip) + ":" + std::to_string(cntxt.m_remote_port)
        << std::setw(20) << std::hex << peer_id
        // << std::setw(25) << std::to_string(cntxt.m_recv_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_recv) + ")" + "/" + std::to_string(cntxt.m_send_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_send) + ")"
        << std::setw(25) << get_protocol_state_string(cntxt.m_state)
-       << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started) << ENDL;
+       << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started)
+       << std::setw(30) << syncStats << ENDL;
   });
   logger(INFO) << "Connections: " << ENDL << ss.str();
 }
@@ -269,6 +351,12 @@ int CryptoNoteProtocolHandler::handleCommand(bool is_notify, int command, const
     HANDLE_NOTIFY(NOTIFY_REQUEST_TX_POOL, &CryptoNoteProtocolHandler::handle_request_tx_pool)
     HANDLE_NOTIFY(NOTIFY_NEW_LITE_BLOCK, &CryptoNoteProtocolHandler::handle_notify_new_lite_block)
     HANDLE_NOTIFY(NOTIFY_MISSING_TXS, &CryptoNoteProtocolHandler::handle_notify_missing_txs)
+    HANDLE_NOTIFY(NOTIFY_TX_HASHES, &CryptoNoteProtocolHandler::handle_notify_tx_hashes)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_TX_POOL_SKETCH, &CryptoNoteProtocolHandler::handle_request_tx_pool_sketch)
+    HANDLE_NOTIFY(NOTIFY_TX_POOL_SKETCH_FAILED, &CryptoNoteProtocolHandler::handle_notify_tx_pool_sketch_failed)
+    HANDLE_NOTIFY(NOTIFY_NEW_COMPACT_BLOCK, &CryptoNoteProtocolHandler::handle_notify_new_compact_block)
+    HANDLE_NOTIFY(NOTIFY_REQUEST_COMPACT_BLOCK_TXS, &CryptoNoteProtocolHandler::handle_request_compact_block_txs)
+    HANDLE_NOTIFY(NOTIFY_COMPACT_BLOCK_TXS, &CryptoNoteProtocolHandler::handle_notify_compact_block_txs)
 
   default:
     handled = false;
@@ -320,10 +408,7 @@ int CryptoNoteProtocolHandler::handle_notify_new_block(int command, NOTIFY_NEW_B
   if (bvc.m_added_to_main_chain)
   {
     ++arg.hop;
-    //TODO: Add here announce protocol usage
-    //relay_post_notify<NOTIFY_NEW_BLOCK>(*m_p2p, arg, &context.m_connection_id);
-    relay_block(arg);
-    // relay_block(arg, context);
+    relayBlock(arg, &context.m_connection_id);
 
     if (bvc.m_switched_to_alt_chain)
     {
@@ -335,6 +420,7 @@ int CryptoNoteProtocolHandler::handle_notify_new_block(int command, NOTIFY_NEW_B
     context.m_state = CryptoNoteConnectionContext::state_synchronizing;
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
     r.block_ids = m_core.buildSparseChain();
+    context.m_chain_requested = true;
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
     post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
   }
@@ -367,6 +453,8 @@ int CryptoNoteProtocolHandler::handle_notify_new_transactions(int command, NOTIF
       auto transactionBinary = asBinaryArray(*tx_blob_it);
       Crypto::Hash transactionHash = Crypto::cn_fast_hash(transactionBinary.data(), transactionBinary.size());
       logger(DEBUGGING) << "transaction " << transactionHash << " came in NOTIFY_NEW_TRANSACTIONS";
+      addKnownTransaction(context, transactionHash);
+      m_requestedTransactions.erase(transactionHash);
 
       CryptoNote::tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
       m_core.handle_incoming_tx(transactionBinary, tvc, false);
@@ -386,8 +474,7 @@ int CryptoNoteProtocolHandler::handle_notify_new_transactions(int command, NOTIF
 
     if (arg.txs.size())
     {
-      //TODO: add announce usage here
-      relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, arg, &context.m_connection_id);
+      queueTransactionRelay(arg.txs);
     }
   }
 
@@ -423,13 +510,28 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
   context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-  size_t count = 0;
-  std::vector<Crypto::Hash> block_hashes;
-  block_hashes.reserve(arg.blocks.size());
-  std::vector<parsed_block_entry> parsed_blocks;
-  parsed_blocks.reserve(arg.blocks.size());
+  if (context.m_requested_spans.empty()) {
+    logger(Logging::ERROR) << context << "sent NOTIFY_RESPONSE_GET_OBJECTS that wasn't requested, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  // requests are answered in order, the response belongs to the oldest one
+  BlockSpanRequest request = std::move(context.m_requested_spans.front());
+  context.m_requested_spans.pop_front();
+
+  auto now = std::chrono::steady_clock::now();
+  context.m_sync_time += now - context.m_sync_request_time;
+  context.m_sync_request_time = now;
+  uint64_t responseBytes = context.m_sync_bytes;
+
+  std::unordered_map<Crypto::Hash, size_t> requestedIndexes;
+  for (size_t i = 0; i < request.blockIds.size(); ++i) {
+    requestedIndexes.emplace(request.blockIds[i], i);
+  }
+
+  std::vector<parsed_block_entry> parsed_blocks(request.blockIds.size());
   for (const block_complete_entry& block_entry : arg.blocks) {
-    ++count;
     Block b;
     BinaryArray block_blob = asBinaryArray(block_entry.block);
     if (block_blob.size() > m_currency.maxBlockBlobSize()) {
@@ -444,20 +546,9 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
       return 1;
     }
 
-    //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
     auto blockHash = get_block_hash(b);
-    if (count == 2) {
-      if (m_core.have_block(blockHash)) {
-        context.m_state = CryptoNoteConnectionContext::state_idle;
-        context.m_needed_objects.clear();
-        context.m_requested_objects.clear();
-        logger(DEBUGGING) << context << "Connection set to idle state.";
-        return 1;
-      }
-    }
-
-    auto req_it = context.m_requested_objects.find(blockHash);
-    if (req_it == context.m_requested_objects.end()) {
+    auto req_it = requestedIndexes.find(blockHash);
+    if (req_it == requestedIndexes.end()) {
       logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(blockHash)
         << " wasn't requested, dropping connection";
       context.m_state = CryptoNoteConnectionContext::state_shutdown;
@@ -470,132 +561,160 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
       return 1;
     }
 
-    context.m_requested_objects.erase(req_it);
-
-    block_hashes.push_back(blockHash);
+    context.m_sync_bytes += block_blob.size();
 
-    parsed_block_entry parsedBlock;
+    parsed_block_entry& parsedBlock = parsed_blocks[req_it->second];
     parsedBlock.block = std::move(b);
     for (auto& tx_blob : block_entry.txs) {
-      auto transactionBinary = asBinaryArray(tx_blob);
-      parsedBlock.txs.push_back(transactionBinary);
+      context.m_sync_bytes += tx_blob.size();
+      parsedBlock.txs.push_back(asBinaryArray(tx_blob));
     }
-    parsed_blocks.push_back(parsedBlock);
+
+    requestedIndexes.erase(req_it);
   }
 
-  if (context.m_requested_objects.size()) {
+  if (!requestedIndexes.empty()) {
     logger(Logging::ERROR, Logging::BRIGHT_RED) << context <<
-      "returned not all requested objects (context.m_requested_objects.size()="
-      << context.m_requested_objects.size() << "), dropping connection";
+      "returned not all requested objects (" << requestedIndexes.size() << " of " << request.blockIds.size() << " missing), dropping connection";
     context.m_state = CryptoNoteConnectionContext::state_shutdown;
     return 1;
   }
 
-  uint32_t height;
-  Crypto::Hash top;
-  {
-    m_core.pause_mining();
-
-    // we lock all the rest to avoid having multiple connections redo a lot
-    // of the same work, and one of them doing it for nothing: subsequent
-    // connections will wait until the current one's added its blocks, then
-    // will add any extra it has, if any
-    std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
-
-    // dismiss what another connection might already have done (likely everything)
-    m_core.get_blockchain_top(height, top);
-    uint64_t dismiss = 1;
-    for (const auto &h : block_hashes) {
-      if (top == h) {
-        logger(DEBUGGING) << "Found current top block in synced blocks, dismissing "
-          << dismiss << "/" << arg.blocks.size() << " blocks";
-        while (dismiss--) {
-          arg.blocks.erase(arg.blocks.begin());
-          parsed_blocks.erase(parsed_blocks.begin());
-        }
-        break;
-      }
-      ++dismiss;
+  context.m_sync_blocks += parsed_blocks.size();
+  updateSyncBatchSize(context, parsed_blocks.size(), static_cast<size_t>(context.m_sync_bytes - responseBytes), now - request.sendTime);
+
+  // a span taken away from a slow peer can arrive twice, the first copy wins
+  auto spanIt = m_syncSpans.find(request.startHeight);
+  if (spanIt != m_syncSpans.end() && !spanIt->second.received && spanIt->second.blockIds == request.blockIds) {
+    spanIt->second.blocks = std::move(parsed_blocks);
+    spanIt->second.supplier = context.m_connection_id;
+    spanIt->second.received = true;
+  } else {
+    logger(DEBUGGING) << context << "Blocks from height " << request.startHeight << " are not needed anymore, discarding";
+  }
+
+  // the next blocks are downloaded while the received ones are imported
+  if (context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
+    request_missing_objects(context);
+  }
+
+  importSyncSpans();
+
+  if (!m_stop) {
+    requestSyncSpans();
+  }
+
+  return 1;
+}
+
+void CryptoNoteProtocolHandler::importSyncSpans() {
+  // processObjects yields to the other connections, they only buffer their spans meanwhile
+  if (m_syncImporting) {
+    return;
+  }
+
+  m_syncImporting = true;
+  BOOST_SCOPE_EXIT_ALL(this) { m_syncImporting = false; };
+
+  while (!m_stop && !m_syncSpans.empty() && m_syncSpans.begin()->second.received) {
+    // the span stays scheduled until imported, so chain entries arriving meanwhile still match it
+    uint32_t startHeight = m_syncSpans.begin()->first;
+    uint64_t generation = m_syncGeneration;
+    boost::uuids::uuid supplier = m_syncSpans.begin()->second.supplier;
+    std::vector<parsed_block_entry> blocks = std::move(m_syncSpans.begin()->second.blocks);
+
+    int result;
+    {
+      m_core.pause_mining();
+
+      std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
+      BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
+
+      result = processObjects(blocks);
     }
 
-    BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
+    // the sync may have been reset meanwhile and the height scheduled again
+    if (m_syncGeneration == generation) {
+      m_syncSpans.erase(startHeight);
+    }
 
-    int result = processObjects(context, parsed_blocks);
     if (result != 0) {
-      return result;
+      m_p2p->for_each_connection([this, &supplier](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+        if (ctx.m_connection_id == supplier) {
+          logger(Logging::INFO) << ctx << "Sent blocks that can't be added to the blockchain, dropping connection";
+          m_p2p->drop_connection(ctx, true);
+        }
+      });
+
+      resetSync();
+      return;
     }
   }
 
+  uint32_t height;
+  Crypto::Hash top;
   m_core.get_blockchain_top(height, top);
   logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
-
-  if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
-    request_missing_objects(context, true);
-  }
-
-  return 1;
 }
 
-int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks) {
+int CryptoNoteProtocolHandler::processObjects(const std::vector<parsed_block_entry>& blocks) {
+  auto importStart = std::chrono::steady_clock::now();
+  size_t importedBlocks = 0;
 
+  // the slow hashes of the whole batch are computed up front, importBlock then only compares them to the difficulty.
+  // They are computed on another thread, the other connections are served meanwhile.
+  std::vector<const Block*> batch;
+  batch.reserve(blocks.size());
   for (const parsed_block_entry& block_entry : blocks) {
+    batch.push_back(&block_entry.block);
+  }
+
+  System::RemoteContext<std::vector<Crypto::Hash>> proofOfWorkContext(m_dispatcher, [this, &batch] { return m_core.computeProofsOfWork(batch); });
+  std::vector<Crypto::Hash> proofsOfWork = proofOfWorkContext.get();
+  auto proofOfWorkTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - importStart).count();
+
+  for (size_t i = 0; i < blocks.size(); ++i) {
     if (m_stop) {
       break;
     }
 
-    //process transactions
-    for (size_t i = 0; i < block_entry.txs.size(); ++i) {
-      auto transactionBinary = block_entry.txs[i];
-      Crypto::Hash transactionHash = Crypto::cn_fast_hash(transactionBinary.data(), transactionBinary.size());
-      logger(DEBUGGING) << "transaction " << transactionHash << " came in processObjects";
-
-      // check if tx hashes match
-      if (transactionHash != block_entry.block.transactionHashes[i]) {
-        logger(DEBUGGING) << context << "transaction mismatch on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
-          << Common::podToHex(transactionHash) << ", dropping connection";
-        context.m_state = CryptoNoteConnectionContext::state_shutdown;
-        return 1;
-      }
-
-      tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-      m_core.handle_incoming_tx(transactionBinary, tvc, true);
-      if (tvc.m_verification_failed) {
-        logger(DEBUGGING) << context << "transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
-          << Common::podToHex(transactionHash) << ", dropping connection";
-        context.m_state = CryptoNoteConnectionContext::state_shutdown;
-        return 1;
-      }
-    }
+    const parsed_block_entry& block_entry = blocks[i];
+    const Crypto::Hash* proofOfWork = proofsOfWork[i] != NULL_HASH ? &proofsOfWork[i] : nullptr;
 
-    // process block
+    // transactions go straight to the blockchain, they are checked against the block there
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    m_core.handle_incoming_block(block_entry.block, bvc, false, false);
+    m_core.importBlock(block_entry.block, block_entry.txs, bvc, proofOfWork);
 
     if (bvc.m_verification_failed) {
-      logger(DEBUGGING) << context << "Block verification failed, dropping connection";
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
+      logger(DEBUGGING) << "Block verification failed";
       return 1;
     } else if (bvc.m_marked_as_orphaned) {
-      logger(Logging::INFO) << context << "Block received at sync phase was marked as orphaned, dropping connection";
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
+      logger(Logging::INFO) << "Block received at sync phase was marked as orphaned";
       return 1;
     } else if (bvc.m_already_exists) {
-      logger(DEBUGGING) << context << "Block already exists, switching to idle state";
-      context.m_state = CryptoNoteConnectionContext::state_idle;
-      context.m_needed_objects.clear();
-      context.m_requested_objects.clear();
-      return 1;
+      // relayed to us while it was downloaded
+      logger(DEBUGGING) << "Block already exists, skipping";
+      continue;
     }
 
+    ++importedBlocks;
     m_dispatcher.yield();
   }
 
+  auto importTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - importStart).count();
+  logger(DEBUGGING) << "Imported " << importedBlocks << " blocks in " << importTime << " ms (" <<
+    (importTime > 0 ? importedBlocks * 1000 / importTime : importedBlocks) << " blocks/s), " << proofOfWorkTime << " ms of it hashing";
+
   return 0;
 
 }
 
 bool CryptoNoteProtocolHandler::on_idle()
 {
+  relayQueuedTransactions();
+  requestAnnouncedTransactions();
+  rescheduleSyncSpans();
+  requestSyncSpans();
   return m_core.on_idle();
 }
 
@@ -625,62 +744,232 @@ int CryptoNoteProtocolHandler::handle_request_chain(int command, NOTIFY_REQUEST_
   return 1;
 }
 
-bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext &context, bool check_having_blocks)
+bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionContext &context)
 {
-  if (context.m_needed_objects.size())
+  auto now = std::chrono::steady_clock::now();
+  uint32_t windowEnd = m_syncSpans.empty() ? 0 : m_syncSpans.begin()->first + static_cast<uint32_t>(BLOCKS_SYNCHRONIZING_DEFAULT_COUNT * BLOCKS_SYNCHRONIZING_WINDOW);
+  bool spansLeft = false;
+
+  for (auto &kv : m_syncSpans)
   {
-    //we know objects that we need, request this objects
-    NOTIFY_REQUEST_GET_OBJECTS::request req;
-    size_t count = 0;
-    auto it = context.m_needed_objects.begin();
+    SyncSpan &span = kv.second;
+    if (kv.first > context.m_last_response_height)
+    {
+      // the peer hasn't reported these blocks yet
+      break;
+    }
 
-    while (it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+    if (span.received || !span.peer.is_nil())
     {
-      if (!(check_having_blocks && m_core.have_block(*it)))
-      {
-        req.blocks.push_back(*it);
-        ++count;
-        context.m_requested_objects.insert(*it);
-      }
-      it = context.m_needed_objects.erase(it);
+      continue;
+    }
+
+    if (span.stalledPeer == context.m_connection_id && now - span.requestTime < std::chrono::seconds(2 * BLOCKS_SYNCHRONIZING_TIMEOUT))
+    {
+      continue;
     }
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
+
+    if (kv.first >= windowEnd || context.m_requested_spans.size() >= m_syncMaxRequests)
+    {
+      spansLeft = true;
+      break;
+    }
+
+    // request only the blocks the peer knows of, in batches of its size
+    size_t batchSize = context.m_sync_batch_size != 0 ? context.m_sync_batch_size : BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+    batchSize = std::min(batchSize, static_cast<size_t>(context.m_last_response_height - kv.first + 1));
+    if (span.blockIds.size() > batchSize)
+    {
+      SyncSpan &rest = m_syncSpans[kv.first + static_cast<uint32_t>(batchSize)];
+      rest.blockIds.assign(span.blockIds.begin() + batchSize, span.blockIds.end());
+      rest.stalledPeer = span.stalledPeer;
+      rest.requestTime = span.requestTime;
+      span.blockIds.resize(batchSize);
+    }
+
+    span.peer = context.m_connection_id;
+    span.requestTime = now;
+
+    if (context.m_requested_spans.empty())
+    {
+      context.m_sync_request_time = now;
+    }
+
+    context.m_requested_spans.push_back(BlockSpanRequest{kv.first, span.blockIds, now});
+
+    NOTIFY_REQUEST_GET_OBJECTS::request req;
+    req.blocks.assign(span.blockIds.begin(), span.blockIds.end());
+    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", start height " << kv.first;
     post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
   }
-  else if (context.m_last_response_height < context.m_remote_blockchain_height - 1)
-  { //we have to fetch more objects ids, request blockchain entry
 
+  if (spansLeft || context.m_chain_requested)
+  {
+    return true;
+  }
+
+  if (context.m_last_response_height + 1 < context.m_remote_blockchain_height)
+  {
+    //we have to fetch more objects ids, request blockchain entry while the requested blocks are downloaded
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
     r.block_ids = m_core.buildSparseChain();
+
+    // continue from the last block id the peer reported if it isn't in the blockchain yet
+    auto spanIt = findSyncSpan(context.m_last_response_height);
+    if (spanIt != m_syncSpans.end())
+    {
+      r.block_ids.insert(r.block_ids.begin(), spanIt->second.blockIds[context.m_last_response_height - spanIt->first]);
+    }
+
+    context.m_chain_requested = true;
     logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
     post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
+    return true;
   }
-  else
+
+  if (!context.m_requested_spans.empty() || (!m_syncSpans.empty() && m_syncSpans.begin()->first <= context.m_last_response_height))
+  {
+    // blocks known to the peer are still downloaded or imported
+    return true;
+  }
+
+  requestMissingPoolTransactions(context);
+
+  context.m_state = CryptoNoteConnectionContext::state_normal;
+  logger(Logging::INFO, Logging::BRIGHT_GREEN) << context << "Synchronization complete";
+  on_connection_synchronized();
+  return true;
+}
+
+void CryptoNoteProtocolHandler::requestSyncSpans()
+{
+  m_p2p->for_each_connection([this](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    if (ctx.m_state == CryptoNoteConnectionContext::state_synchronizing)
+    {
+      request_missing_objects(ctx);
+    }
+  });
+}
+
+void CryptoNoteProtocolHandler::rescheduleSyncSpans()
+{
+  auto now = std::chrono::steady_clock::now();
+  bool firstMissing = true;
+
+  for (auto it = m_syncSpans.begin(); it != m_syncSpans.end(); ++it)
   {
-    if (!(context.m_last_response_height ==
-              context.m_remote_blockchain_height - 1 &&
-          !context.m_needed_objects.size() &&
-          !context.m_requested_objects.size()))
+    SyncSpan &span = it->second;
+    if (span.received)
     {
-      logger(Logging::ERROR, Logging::BRIGHT_RED)
-          << "request_missing_blocks final condition failed!"
-          << "\r\nm_last_response_height=" << context.m_last_response_height
-          << "\r\nm_remote_blockchain_height=" << context.m_remote_blockchain_height
-          << "\r\nm_needed_objects.size()=" << context.m_needed_objects.size()
-          << "\r\nm_requested_objects.size()=" << context.m_requested_objects.size()
-          << "\r\non connection [" << context << "]";
-      return false;
+      continue;
     }
 
-    requestMissingPoolTransactions(context);
+    // the first missing span holds back the import of the spans received after it
+    bool blocking = firstMissing && std::next(it) != m_syncSpans.end() && std::next(it)->second.received;
+    firstMissing = false;
+
+    if (span.peer.is_nil())
+    {
+      continue;
+    }
 
-    context.m_state = CryptoNoteConnectionContext::state_normal;
-    logger(Logging::INFO, Logging::BRIGHT_GREEN)  << context << "Synchronization complete";
-    on_connection_synchronized();
+    auto elapsed = now - span.requestTime;
+    if (elapsed > std::chrono::seconds(BLOCKS_SYNCHRONIZING_TIMEOUT) || (blocking && elapsed > std::chrono::seconds(BLOCKS_SYNCHRONIZING_TIMEOUT / 4)))
+    {
+      logger(DEBUGGING) << "Blocks from height " << it->first << " weren't received in " << std::chrono::duration_cast<std::chrono::seconds>(elapsed).count()
+                        << " s, requesting them from another peer";
+      span.stalledPeer = span.peer;
+      span.peer = boost::uuids::nil_uuid();
+    }
   }
+}
+
+std::map<uint32_t, CryptoNoteProtocolHandler::SyncSpan>::iterator CryptoNoteProtocolHandler::findSyncSpan(uint32_t height)
+{
+  auto it = m_syncSpans.upper_bound(height);
+  if (it == m_syncSpans.begin())
+  {
+    return m_syncSpans.end();
+  }
+
+  --it;
+  return height < it->first + it->second.blockIds.size() ? it : m_syncSpans.end();
+}
+
+bool CryptoNoteProtocolHandler::addSyncChain(uint32_t startHeight, const std::vector<Crypto::Hash> &blockIds)
+{
+  for (size_t i = 0; i < blockIds.size(); ++i)
+  {
+    uint32_t height = startHeight + static_cast<uint32_t>(i);
+    auto spanIt = findSyncSpan(height);
+    if (spanIt != m_syncSpans.end())
+    {
+      if (spanIt->second.blockIds[height - spanIt->first] != blockIds[i])
+      {
+        return false;
+      }
+
+      continue;
+    }
+
+    if (m_core.have_block(blockIds[i]))
+    {
+      continue;
+    }
+
+    if (!m_syncSpans.empty())
+    {
+      auto last = std::prev(m_syncSpans.end());
+      if (height != last->first + last->second.blockIds.size())
+      {
+        // another branch than the one being downloaded
+        return false;
+      }
+
+      if (last->second.blockIds.size() < BLOCKS_SYNCHRONIZING_MAX_COUNT && last->second.peer.is_nil() && !last->second.received)
+      {
+        last->second.blockIds.push_back(blockIds[i]);
+        continue;
+      }
+    }
+
+    m_syncSpans[height].blockIds.push_back(blockIds[i]);
+  }
+
   return true;
 }
 
+void CryptoNoteProtocolHandler::updateSyncBatchSize(CryptoNoteConnectionContext &context, size_t blocks, size_t bytes, std::chrono::steady_clock::duration roundTripTime)
+{
+  if (blocks == 0)
+  {
+    return;
+  }
+
+  context.m_sync_rtt = context.m_sync_rtt == std::chrono::steady_clock::duration::zero() ? roundTripTime : (context.m_sync_rtt * 7 + roundTripTime) / 8;
+
+  // The round trip includes the requests queued at the peer before this one, so it grows with the batch size.
+  // Scale the batch so that a request is answered in BLOCKS_SYNCHRONIZING_BATCH_TIME, within the byte budget.
+  size_t current = context.m_sync_batch_size != 0 ? context.m_sync_batch_size : BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+  size_t blockSize = std::max<size_t>(bytes / blocks, 1);
+  uint64_t milliseconds = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(roundTripTime).count(), 1);
+  uint64_t timeTarget = static_cast<uint64_t>(blocks) * BLOCKS_SYNCHRONIZING_BATCH_TIME * 1000 / milliseconds;
+  size_t target = static_cast<size_t>(std::min<uint64_t>({timeTarget, BLOCKS_SYNCHRONIZING_BATCH_SIZE / blockSize, BLOCKS_SYNCHRONIZING_MAX_COUNT}));
+
+  // move halfway, so that a single slow or fast response doesn't swing the size
+  context.m_sync_batch_size = std::max<size_t>((current + target) / 2, 1);
+}
+
+void CryptoNoteProtocolHandler::resetSync()
+{
+  // peers fetch the block ids again, responses to the outstanding requests are discarded
+  m_syncSpans.clear();
+  ++m_syncGeneration;
+  m_p2p->for_each_connection([](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    ctx.m_last_response_height = 0;
+  });
+}
+
 bool CryptoNoteProtocolHandler::on_connection_synchronized()
 {
   bool val_expected = false;
@@ -719,7 +1008,11 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
     return 1;
   }
 
-  if (!m_core.have_block(arg.m_block_ids.front()))
+  context.m_chain_requested = false;
+
+  auto frontSpan = findSyncSpan(arg.start_height);
+  bool frontScheduled = frontSpan != m_syncSpans.end() && frontSpan->second.blockIds[arg.start_height - frontSpan->first] == arg.m_block_ids.front();
+  if (!frontScheduled && !m_core.have_block(arg.m_block_ids.front()))
   {
     logger(Logging::ERROR)
         << context << "sent m_block_ids starting from unknown id: "
@@ -740,15 +1033,18 @@ int CryptoNoteProtocolHandler::handle_response_chain_entry(int command, NOTIFY_R
         << arg.total_height << "\r\nm_start_height=" << arg.start_height
         << "\r\nm_block_ids.size()=" << arg.m_block_ids.size();
     context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
   }
 
-  for (auto &bl_id : arg.m_block_ids)
+  if (!addSyncChain(arg.start_height, arg.m_block_ids))
   {
-    if (!m_core.have_block(bl_id))
-      context.m_needed_objects.push_back(bl_id);
+    // retried on the next timed sync, when the current chain is downloaded
+    logger(DEBUGGING) << context << "Chain differs from the one being synchronized, connection set to idle state.";
+    context.m_state = CryptoNoteConnectionContext::state_idle;
+    return 1;
   }
 
-  request_missing_objects(context, false);
+  request_missing_objects(context);
   return 1;
 }
 
@@ -776,7 +1072,12 @@ int CryptoNoteProtocolHandler::handle_notify_missing_txs(int command, NOTIFY_MIS
   std::list<Transaction> txs;
   std::list<Crypto::Hash> missedHashes;
   m_core.getTransactions(arg.missing_txs, txs, missedHashes, true);
-  if (!missedHashes.empty())
+  if (!missedHashes.empty() && arg.blockHash == NULL_HASH)
+  {
+    // announced transactions can leave the pool before they are requested
+    logger(Logging::DEBUGGING) << context << missedHashes.size() << " requested transactions are not available anymore";
+  }
+  else if (!missedHashes.empty())
   {
     logger(Logging::DEBUGGING) << "Failed to Handle NOTIFY_MISSING_TXS, Unable to retrieve requested "
                                   "transactions, Dropping Connection";
@@ -806,11 +1107,218 @@ int CryptoNoteProtocolHandler::handle_notify_missing_txs(int command, NOTIFY_MIS
   return 1;
 }
 
+int CryptoNoteProtocolHandler::handle_request_tx_pool_sketch(int command, NOTIFY_REQUEST_TX_POOL_SKETCH::request &arg,
+                                                             CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_TX_POOL_SKETCH: sketch.size() = " << arg.sketch.size();
+
+  TransactionPoolSketch sketch;
+  if (!sketch.fromString(arg.sketch) || sketch.cellCount() > TX_POOL_SKETCH_MAX_CELLS)
+  {
+    logger(Logging::DEBUGGING) << context << "Sent invalid transaction pool sketch, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  std::vector<Transaction> addedTransactions;
+  std::vector<uint64_t> deletedTransactions;
+  if (!m_core.getPoolChanges(sketch, addedTransactions, deletedTransactions))
+  {
+    // the peer retries with a larger sketch or the full list
+    NOTIFY_TX_POOL_SKETCH_FAILED::request response;
+    response.cell_count = static_cast<uint32_t>(sketch.cellCount());
+    post_notify<NOTIFY_TX_POOL_SKETCH_FAILED>(*m_p2p, response, context);
+    return 1;
+  }
+
+  if (!addedTransactions.empty())
+  {
+    NOTIFY_NEW_TRANSACTIONS::request notification;
+    for (auto &tx : addedTransactions)
+    {
+      addKnownTransaction(context, getObjectHash(tx));
+      notification.txs.push_back(asString(toBinaryArray(tx)));
+    }
+
+    if (!post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, notification, context))
+    {
+      logger(Logging::WARNING, Logging::BRIGHT_YELLOW) << "Failed to post notification NOTIFY_NEW_TRANSACTIONS to " << context.m_connection_id;
+    }
+  }
+
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handle_notify_tx_pool_sketch_failed(int command, NOTIFY_TX_POOL_SKETCH_FAILED::request &arg,
+                                                                   CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_TX_POOL_SKETCH_FAILED: cell_count = " << arg.cell_count;
+
+  // a sketch twice as large, the full list once that is the smaller one or the limit is reached
+  requestMissingPoolTransactions(context, std::max<size_t>(arg.cell_count, TX_POOL_SKETCH_MIN_CELLS) * 2);
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request &arg,
+                                                               CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_NEW_COMPACT_BLOCK (hop " << arg.hop << ")";
+  updateObservedHeight(arg.current_blockchain_height, context);
+  context.m_remote_blockchain_height = arg.current_blockchain_height;
+  if (context.m_state != CryptoNoteConnectionContext::state_normal)
+  {
+    return 1;
+  }
+
+  // the same block usually arrives from several peers
+  if (m_core.have_block(arg.block_hash))
+  {
+    return 1;
+  }
+
+  Block b;
+  if (!fromBinaryArray(b, asBinaryArray(arg.block)) || !b.transactionHashes.empty() ||
+      arg.short_ids.size() % COMPACT_BLOCK_SHORT_ID_SIZE != 0)
+  {
+    logger(Logging::WARNING) << context << "Deserialization of compact block failed, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  // map the short ids of the pool transactions with the key of this block
+  CompactBlockShortIdKey shortIdKey = compactBlockShortIdKey(arg.block_hash, arg.salt);
+  std::unordered_map<std::string, Crypto::Hash> poolShortIds;
+  for (const auto &transactionHash : m_core.getPoolTransactionIds())
+  {
+    poolShortIds.emplace(compactBlockShortId(shortIdKey, transactionHash), transactionHash);
+  }
+
+  size_t transactionCount = arg.short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE;
+  b.transactionHashes.resize(transactionCount, NULL_HASH);
+  std::vector<uint32_t> missingIndexes;
+  for (uint32_t i = 0; i < transactionCount; ++i)
+  {
+    auto search = poolShortIds.find(arg.short_ids.substr(i * COMPACT_BLOCK_SHORT_ID_SIZE, COMPACT_BLOCK_SHORT_ID_SIZE));
+    if (search != poolShortIds.end())
+    {
+      b.transactionHashes[i] = search->second;
+    }
+    else
+    {
+      missingIndexes.push_back(i);
+    }
+  }
+
+  logger(Logging::DEBUGGING) << context << "Compact block " << arg.block_hash << ": " << (transactionCount - missingIndexes.size())
+                             << " of " << transactionCount << " transactions found in the pool";
+
+  context.m_pending_lite_block = boost::none;
+  context.m_pending_compact_block = PendingCompactBlock{std::move(arg), std::move(b), std::move(missingIndexes)};
+  return doPushCompactBlock(context, {});
+}
+
+int CryptoNoteProtocolHandler::handle_request_compact_block_txs(int command, NOTIFY_REQUEST_COMPACT_BLOCK_TXS::request &arg,
+                                                                CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_REQUEST_COMPACT_BLOCK_TXS: indexes.size() = " << arg.indexes.size();
+
+  Block b;
+  if (!m_core.getBlockByHash(arg.block_hash, b))
+  {
+    logger(Logging::DEBUGGING) << context << "Transactions of unknown block " << arg.block_hash << " requested";
+    return 1;
+  }
+
+  // every transaction is requested at most once
+  if (arg.indexes.size() > b.transactionHashes.size())
+  {
+    logger(Logging::DEBUGGING) << context << "More compact block transactions requested than the block has, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  std::vector<bool> requested(b.transactionHashes.size(), false);
+  NOTIFY_COMPACT_BLOCK_TXS::request rsp;
+  rsp.block_hash = arg.block_hash;
+  for (auto index : arg.indexes)
+  {
+    if (index >= b.transactionHashes.size() || requested[index])
+    {
+      logger(Logging::DEBUGGING) << context << "Invalid compact block transaction index requested, dropping connection";
+      context.m_state = CryptoNoteConnectionContext::state_shutdown;
+      return 1;
+    }
+
+    requested[index] = true;
+
+    Transaction tx;
+    if (!m_core.getTransaction(b.transactionHashes[index], tx, true))
+    {
+      logger(Logging::DEBUGGING) << context << "Transaction " << b.transactionHashes[index] << " of block " << arg.block_hash
+                                 << " is not available anymore";
+      return 1;
+    }
+    rsp.txs.push_back(asString(toBinaryArray(tx)));
+  }
+
+  if (!post_notify<NOTIFY_COMPACT_BLOCK_TXS>(*m_p2p, rsp, context))
+  {
+    logger(Logging::DEBUGGING) << context << "Failed to send NOTIFY_COMPACT_BLOCK_TXS";
+  }
+
+  return 1;
+}
+
+int CryptoNoteProtocolHandler::handle_notify_compact_block_txs(int command, NOTIFY_COMPACT_BLOCK_TXS::request &arg,
+                                                               CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_COMPACT_BLOCK_TXS: txs.size() = " << arg.txs.size();
+
+  if (context.m_state != CryptoNoteConnectionContext::state_normal)
+  {
+    return 1;
+  }
+
+  if (!context.m_pending_compact_block || context.m_pending_compact_block->request.block_hash != arg.block_hash)
+  {
+    logger(Logging::DEBUGGING) << context << "Transactions of block " << arg.block_hash << " were not requested, ignoring";
+    return 1;
+  }
+
+  auto &pending = *context.m_pending_compact_block;
+  if (arg.txs.size() != pending.missing_indexes.size())
+  {
+    logger(Logging::DEBUGGING) << context << "Peer didn't provide the missing transactions of a compact block, dropping connection";
+    context.m_pending_compact_block = boost::none;
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  std::vector<BinaryArray> txs;
+  txs.reserve(arg.txs.size());
+  for (size_t i = 0; i < arg.txs.size(); ++i)
+  {
+    auto transactionBinary = asBinaryArray(arg.txs[i]);
+    Crypto::Hash transactionHash = getBinaryArrayHash(transactionBinary);
+    pending.block.transactionHashes[pending.missing_indexes[i]] = transactionHash;
+    addKnownTransaction(context, transactionHash);
+    txs.push_back(std::move(transactionBinary));
+  }
+  pending.missing_indexes.clear();
+
+  return doPushCompactBlock(context, std::move(txs));
+}
+
 int CryptoNoteProtocolHandler::handle_request_tx_pool(int command, NOTIFY_REQUEST_TX_POOL::request &arg,
                                                       CryptoNoteConnectionContext &context)
 {
   logger(Logging::TRACE) << context << "NOTIFY_REQUEST_TX_POOL: txs.size() = " << arg.txs.size();
 
+  for (const auto &transactionHash : arg.txs)
+  {
+    addKnownTransaction(context, transactionHash);
+  }
+
   std::vector<Transaction> addedTransactions;
   std::vector<Crypto::Hash> deletedTransactions;
   m_core.getPoolChanges(arg.txs, addedTransactions, deletedTransactions);
@@ -835,57 +1343,325 @@ int CryptoNoteProtocolHandler::handle_request_tx_pool(int command, NOTIFY_REQUES
 
 void CryptoNoteProtocolHandler::relay_block(NOTIFY_NEW_BLOCK::request &arg)
 {
-  // generate a lite block request from the received normal block
-  NOTIFY_NEW_LITE_BLOCK::request lite_arg;
-  lite_arg.current_blockchain_height = arg.current_blockchain_height;
-  lite_arg.block = arg.b.block;
-  lite_arg.hop = arg.hop;
-
-  // encoding the request for sending the blocks to peers
-  auto buf = LevinProtocol::encode(arg);
-  auto lite_buf = LevinProtocol::encode(lite_arg);
+  // called from other threads as well, the connections are only walked on the dispatcher
+  m_dispatcher.remoteSpawn([this, arg] { relayBlock(arg, nullptr); });
+}
 
-  // logging the msg size to see the difference in payload size
-  logger(Logging::DEBUGGING) << "NOTIFY_NEW_BLOCK - MSG_SIZE = " << buf.size();
-  logger(Logging::DEBUGGING) << "NOTIFY_NEW_LITE_BLOCK - MSG_SIZE = " << lite_buf.size();
+void CryptoNoteProtocolHandler::relayBlock(const NOTIFY_NEW_BLOCK::request &arg, const net_connection_id *excludeConnection)
+{
+  std::list<boost::uuids::uuid> compactBlockConnections, liteBlockConnections, normalBlockConnections;
 
-  std::list<boost::uuids::uuid> liteBlockConnections, normalBlockConnections;
+  // sort the peers into their support categories, every peer gets exactly one message, the newest it supports
+  static_assert(P2P_COMPACT_BLOCKS_VERSION > P2P_LITE_BLOCKS_PROPOGATION_VERSION, "compact block peers support lite blocks as well");
+  m_p2p->for_each_connection([&](const CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    if ((excludeConnection && ctx.m_connection_id == *excludeConnection) ||
+        (ctx.m_state != CryptoNoteConnectionContext::state_normal && ctx.m_state != CryptoNoteConnectionContext::state_synchronizing))
+    {
+      return;
+    }
 
-  // sort the peers into their support categories
-  m_p2p->for_each_connection([this, &liteBlockConnections, &normalBlockConnections](
-                                 const CryptoNoteConnectionContext &ctx, uint64_t peerId) {
-    if (ctx.version >= P2P_LITE_BLOCKS_PROPOGATION_VERSION)
+    if (ctx.version >= P2P_COMPACT_BLOCKS_VERSION)
+    {
+      compactBlockConnections.push_back(ctx.m_connection_id);
+    }
+    else if (ctx.version >= P2P_LITE_BLOCKS_PROPOGATION_VERSION)
     {
-      logger(Logging::DEBUGGING) << ctx << "Peer supports lite-blocks... adding peer to lite block list";
       liteBlockConnections.push_back(ctx.m_connection_id);
     }
     else
     {
-      logger(Logging::DEBUGGING) << ctx << "Peer doesn't support lite-blocks... adding peer to normal block list";
       normalBlockConnections.push_back(ctx.m_connection_id);
     }
   });
 
-  // first send lite blocks as it's faster
+  if (!compactBlockConnections.empty())
+  {
+    Block b;
+    if (fromBinaryArray(b, asBinaryArray(arg.b.block)))
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg;
+      compact_arg.block_hash = get_block_hash(b);
+      compact_arg.salt = Crypto::rand<uint64_t>();
+      CompactBlockShortIdKey shortIdKey = compactBlockShortIdKey(compact_arg.block_hash, compact_arg.salt);
+      compact_arg.short_ids.reserve(b.transactionHashes.size() * COMPACT_BLOCK_SHORT_ID_SIZE);
+      for (const auto &transactionHash : b.transactionHashes)
+      {
+        compact_arg.short_ids += compactBlockShortId(shortIdKey, transactionHash);
+      }
+      b.transactionHashes.clear();
+      compact_arg.block = asString(toBinaryArray(b));
+      compact_arg.current_blockchain_height = arg.current_blockchain_height;
+      compact_arg.hop = arg.hop;
+
+      auto compact_buf = LevinProtocol::encode(compact_arg);
+      logger(Logging::DEBUGGING) << "NOTIFY_NEW_COMPACT_BLOCK - MSG_SIZE = " << compact_buf.size() << ", " << compactBlockConnections.size() << " peers";
+      m_p2p->externalRelayNotifyToList(NOTIFY_NEW_COMPACT_BLOCK::ID, compact_buf, compactBlockConnections);
+    }
+    else
+    {
+      logger(Logging::WARNING) << "Failed to parse the relayed block, sending it in full";
+      normalBlockConnections.splice(normalBlockConnections.end(), compactBlockConnections);
+    }
+  }
+
   if (!liteBlockConnections.empty())
   {
+    NOTIFY_NEW_LITE_BLOCK::request lite_arg;
+    lite_arg.current_blockchain_height = arg.current_blockchain_height;
+    lite_arg.block = arg.b.block;
+    lite_arg.hop = arg.hop;
+
+    auto lite_buf = LevinProtocol::encode(lite_arg);
+    logger(Logging::DEBUGGING) << "NOTIFY_NEW_LITE_BLOCK - MSG_SIZE = " << lite_buf.size() << ", " << liteBlockConnections.size() << " peers";
     m_p2p->externalRelayNotifyToList(NOTIFY_NEW_LITE_BLOCK::ID, lite_buf, liteBlockConnections);
   }
 
   if (!normalBlockConnections.empty())
   {
     auto buf = LevinProtocol::encode(arg);
-    m_p2p->externalRelayNotifyToAll(NOTIFY_NEW_BLOCK::ID, buf, nullptr);
+    logger(Logging::DEBUGGING) << "NOTIFY_NEW_BLOCK - MSG_SIZE = " << buf.size() << ", " << normalBlockConnections.size() << " peers";
+    m_p2p->externalRelayNotifyToList(NOTIFY_NEW_BLOCK::ID, buf, normalBlockConnections);
   }
 }
 
 void CryptoNoteProtocolHandler::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request &arg)
 {
-  auto buf = LevinProtocol::encode(arg);
-  m_p2p->externalRelayNotifyToAll(NOTIFY_NEW_TRANSACTIONS::ID, buf, nullptr);
+  queueTransactionRelay(arg.txs);
+}
+
+void CryptoNoteProtocolHandler::queueTransactionRelay(const std::vector<std::string> &transactions)
+{
+  // called from other threads as well, the queue is sent from the idle round
+  std::lock_guard<std::mutex> lock(m_relayTransactionsMutex);
+  for (const auto &transaction : transactions)
+  {
+    m_relayTransactions.emplace_back(Crypto::cn_fast_hash(transaction.data(), transaction.size()), transaction);
+  }
 }
 
-void CryptoNoteProtocolHandler::requestMissingPoolTransactions(const CryptoNoteConnectionContext &context)
+void CryptoNoteProtocolHandler::relayQueuedTransactions()
+{
+  std::vector<std::pair<Crypto::Hash, std::string>> transactions;
+  {
+    std::lock_guard<std::mutex> lock(m_relayTransactionsMutex);
+    transactions.swap(m_relayTransactions);
+  }
+
+  if (transactions.empty())
+  {
+    return;
+  }
+
+  size_t announcedPeers = 0;
+  size_t sentPeers = 0;
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    if (ctx.m_state != CryptoNoteConnectionContext::state_normal)
+    {
+      return;
+    }
+
+    // the peer that sent a transaction, or announced it, doesn't get it back
+    if (ctx.version >= P2P_TX_HASHES_RELAY_VERSION)
+    {
+      NOTIFY_TX_HASHES::request announcement;
+      for (const auto &transaction : transactions)
+      {
+        if (addKnownTransaction(ctx, transaction.first))
+        {
+          announcement.txs.push_back(transaction.first);
+        }
+      }
+
+      if (!announcement.txs.empty() && post_notify<NOTIFY_TX_HASHES>(*m_p2p, announcement, ctx))
+      {
+        ++announcedPeers;
+      }
+    }
+    else
+    {
+      NOTIFY_NEW_TRANSACTIONS::request notification;
+      for (const auto &transaction : transactions)
+      {
+        if (addKnownTransaction(ctx, transaction.first))
+        {
+          notification.txs.push_back(transaction.second);
+        }
+      }
+
+      if (!notification.txs.empty() && post_notify<NOTIFY_NEW_TRANSACTIONS>(*m_p2p, notification, ctx))
+      {
+        ++sentPeers;
+      }
+    }
+  });
+
+  logger(Logging::DEBUGGING) << "Relayed " << transactions.size() << " transactions, hashes to " << announcedPeers << " peers, bodies to " << sentPeers << " peers";
+}
+
+bool CryptoNoteProtocolHandler::addKnownTransaction(CryptoNoteConnectionContext &context, const Crypto::Hash &transactionHash)
+{
+  if (context.m_known_txs.size() >= P2P_TX_KNOWN_HASHES_LIMIT)
+  {
+    // forgetting only costs a repeated announcement
+    context.m_known_txs.clear();
+  }
+
+  return context.m_known_txs.insert(transactionHash).second;
+}
+
+int CryptoNoteProtocolHandler::handle_notify_tx_hashes(int command, NOTIFY_TX_HASHES::request &arg, CryptoNoteConnectionContext &context)
+{
+  logger(Logging::TRACE) << context << "NOTIFY_TX_HASHES: txs.size() = " << arg.txs.size();
+
+  if (context.m_state != CryptoNoteConnectionContext::state_normal)
+  {
+    return 1;
+  }
+
+  for (const auto &transactionHash : arg.txs)
+  {
+    addKnownTransaction(context, transactionHash);
+  }
+
+  // every body is requested from one announcing peer, the others are remembered and asked in turn when
+  // it doesn't arrive in time. A peer with a pending lite block is only remembered, its response would be
+  // taken for the transactions of the lite block.
+  auto now = std::chrono::steady_clock::now();
+  NOTIFY_MISSING_TXS::request request;
+  request.blockHash = NULL_HASH;
+  request.current_blockchain_height = get_current_blockchain_height();
+  for (const auto &transactionHash : arg.txs)
+  {
+    if (m_core.have_transaction(transactionHash))
+    {
+      continue;
+    }
+
+    auto it = m_requestedTransactions.find(transactionHash);
+    if (it == m_requestedTransactions.end())
+    {
+      if (m_requestedTransactions.size() >= P2P_TX_REQUESTED_LIMIT)
+      {
+        continue;
+      }
+
+      it = m_requestedTransactions.emplace(transactionHash, RequestedTransaction{boost::uuids::nil_uuid(), now, {}}).first;
+    }
+
+    RequestedTransaction &requested = it->second;
+    if (requested.peer.is_nil() && !context.m_pending_lite_block)
+    {
+      requested.peer = context.m_connection_id;
+      requested.requestTime = now;
+      request.missing_txs.push_back(transactionHash);
+    }
+    else if (requested.peer != context.m_connection_id && requested.announcers.size() < P2P_TX_ANNOUNCERS_LIMIT &&
+             std::find(requested.announcers.begin(), requested.announcers.end(), context.m_connection_id) == requested.announcers.end())
+    {
+      requested.announcers.push_back(context.m_connection_id);
+    }
+  }
+
+  if (!request.missing_txs.empty())
+  {
+    logger(Logging::TRACE) << context << "-->>NOTIFY_MISSING_TXS: missing_txs.size() = " << request.missing_txs.size();
+    post_notify<NOTIFY_MISSING_TXS>(*m_p2p, request, context);
+  }
+
+  return 1;
+}
+
+void CryptoNoteProtocolHandler::requestAnnouncedTransactions()
+{
+  if (m_requestedTransactions.empty())
+  {
+    return;
+  }
+
+  // connections that can be asked for bodies, the others may only become available later
+  std::unordered_map<boost::uuids::uuid, NOTIFY_MISSING_TXS::request, boost::hash<boost::uuids::uuid>> requests;
+  std::unordered_set<boost::uuids::uuid, boost::hash<boost::uuids::uuid>> busyConnections;
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    if (ctx.m_state == CryptoNoteConnectionContext::state_normal && !ctx.m_pending_lite_block)
+    {
+      requests[ctx.m_connection_id];
+    }
+    else
+    {
+      busyConnections.insert(ctx.m_connection_id);
+    }
+  });
+
+  auto now = std::chrono::steady_clock::now();
+  size_t expired = 0;
+  for (auto it = m_requestedTransactions.begin(); it != m_requestedTransactions.end();)
+  {
+    RequestedTransaction &requested = it->second;
+    if (!requested.peer.is_nil())
+    {
+      if (now - requested.requestTime < std::chrono::seconds(P2P_TX_REQUEST_TIMEOUT))
+      {
+        ++it;
+        continue;
+      }
+
+      requested.peer = boost::uuids::nil_uuid();
+    }
+
+    // the next announcer still connected is asked, busy ones keep their place in the queue
+    for (auto announcer = requested.announcers.begin(); announcer != requested.announcers.end();)
+    {
+      auto peerRequest = requests.find(*announcer);
+      if (peerRequest != requests.end())
+      {
+        requested.peer = *announcer;
+        requested.requestTime = now;
+        peerRequest->second.missing_txs.push_back(it->first);
+        requested.announcers.erase(announcer);
+        break;
+      }
+
+      if (busyConnections.count(*announcer) == 0)
+      {
+        announcer = requested.announcers.erase(announcer);
+      }
+      else
+      {
+        ++announcer;
+      }
+    }
+
+    if (requested.peer.is_nil() && requested.announcers.empty())
+    {
+      ++expired;
+      it = m_requestedTransactions.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  if (expired != 0)
+  {
+    logger(Logging::DEBUGGING) << expired << " announced transactions weren't received from any announcer";
+  }
+
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    auto peerRequest = requests.find(ctx.m_connection_id);
+    if (peerRequest == requests.end() || peerRequest->second.missing_txs.empty())
+    {
+      return;
+    }
+
+    peerRequest->second.blockHash = NULL_HASH;
+    peerRequest->second.current_blockchain_height = get_current_blockchain_height();
+    logger(Logging::TRACE) << ctx << "-->>NOTIFY_MISSING_TXS: missing_txs.size() = " << peerRequest->second.missing_txs.size();
+    post_notify<NOTIFY_MISSING_TXS>(*m_p2p, peerRequest->second, ctx);
+  });
+}
+
+void CryptoNoteProtocolHandler::requestMissingPoolTransactions(const CryptoNoteConnectionContext &context, size_t sketchCells)
 {
   if (context.version < CryptoNote::P2P_VERSION_1)
   {
@@ -894,6 +1670,27 @@ void CryptoNoteProtocolHandler::requestMissingPoolTransactions(const CryptoNoteC
 
   auto poolTxs = m_core.getPoolTransactions();
 
+  // the sketch costs the difference of the pools, the list the whole pool
+  if (context.version >= P2P_POOL_SKETCH_VERSION && sketchCells <= TX_POOL_SKETCH_MAX_CELLS &&
+      sketchCells * TransactionPoolSketch::CELL_SIZE < poolTxs.size() * sizeof(Crypto::Hash))
+  {
+    TransactionPoolSketch sketch(sketchCells, Crypto::rand<uint64_t>());
+    for (auto &tx : poolTxs)
+    {
+      sketch.insert(getObjectHash(tx));
+    }
+
+    NOTIFY_REQUEST_TX_POOL_SKETCH::request request;
+    request.sketch = sketch.toString();
+    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_TX_POOL_SKETCH: " << sketch.cellCount() << " cells for " << poolTxs.size() << " transactions";
+    if (!post_notify<NOTIFY_REQUEST_TX_POOL_SKETCH>(*m_p2p, request, context))
+    {
+      logger(Logging::WARNING, Logging::BRIGHT_YELLOW) << "Failed to post notification NOTIFY_REQUEST_TX_POOL_SKETCH to " << context.m_connection_id;
+    }
+
+    return;
+  }
+
   NOTIFY_REQUEST_TX_POOL::request notification;
   for (auto &tx : poolTxs)
   {
@@ -1074,8 +1871,15 @@ int CryptoNoteProtocolHandler::doPushLiteBlock(NOTIFY_NEW_LITE_BLOCK::request ar
     if (bvc.m_added_to_main_chain)
     {
       ++arg.hop;
-      //TODO: Add here announce protocol usage
-      relay_post_notify<NOTIFY_NEW_LITE_BLOCK>(*m_p2p, arg, &context.m_connection_id);
+      NOTIFY_NEW_BLOCK::request relayArg;
+      relayArg.b.block = arg.block;
+      for (const auto &transactionBinary : have_txs)
+      {
+        relayArg.b.txs.push_back(asString(transactionBinary));
+      }
+      relayArg.current_blockchain_height = arg.current_blockchain_height;
+      relayArg.hop = arg.hop;
+      relayBlock(relayArg, &context.m_connection_id);
 
       if (bvc.m_switched_to_alt_chain)
       {
@@ -1087,6 +1891,7 @@ int CryptoNoteProtocolHandler::doPushLiteBlock(NOTIFY_NEW_LITE_BLOCK::request ar
       context.m_state = CryptoNoteConnectionContext::state_synchronizing;
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       r.block_ids = m_core.buildSparseChain();
+      context.m_chain_requested = true;
       logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size();
       post_notify<NOTIFY_REQUEST_CHAIN>(*m_p2p, r, context);
     }
@@ -1122,4 +1927,51 @@ int CryptoNoteProtocolHandler::doPushLiteBlock(NOTIFY_NEW_LITE_BLOCK::request ar
   return 1;
 }
 
+
+int CryptoNoteProtocolHandler::doPushCompactBlock(CryptoNoteConnectionContext &context, std::vector<BinaryArray> missingTxs)
+{
+  auto &pending = *context.m_pending_compact_block;
+
+  if (!pending.missing_indexes.empty())
+  {
+    NOTIFY_REQUEST_COMPACT_BLOCK_TXS::request req;
+    req.block_hash = pending.request.block_hash;
+    req.indexes = pending.missing_indexes;
+    if (!post_notify<NOTIFY_REQUEST_COMPACT_BLOCK_TXS>(*m_p2p, req, context))
+    {
+      logger(Logging::DEBUGGING) << context << "Compact block is missing transactions but the publisher is not reachable, dropping connection.";
+      context.m_pending_compact_block = boost::none;
+      context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    }
+    return 1;
+  }
+
+  if (get_block_hash(pending.block) != pending.request.block_hash)
+  {
+    if (missingTxs.size() == pending.block.transactionHashes.size())
+    {
+      logger(Logging::DEBUGGING) << context << "Compact block doesn't match its hash, dropping connection";
+      context.m_pending_compact_block = boost::none;
+      context.m_state = CryptoNoteConnectionContext::state_shutdown;
+      return 1;
+    }
+
+    // a short id collided with another pool transaction, request all transactions of the block
+    logger(Logging::DEBUGGING) << context << "Compact block " << pending.request.block_hash << " reconstruction failed, requesting all transactions";
+    for (uint32_t i = 0; i < pending.block.transactionHashes.size(); ++i)
+    {
+      pending.missing_indexes.push_back(i);
+    }
+    return doPushCompactBlock(context, {});
+  }
+
+  NOTIFY_NEW_LITE_BLOCK::request lite_arg;
+  lite_arg.block = asString(toBinaryArray(pending.block));
+  lite_arg.current_blockchain_height = pending.request.current_blockchain_height;
+  lite_arg.hop = pending.request.hop;
+  context.m_pending_compact_block = boost::none;
+
+  return doPushLiteBlock(std::move(lite_arg), context, std::move(missingTxs));
+}
+
 }; // namespace CryptoNote
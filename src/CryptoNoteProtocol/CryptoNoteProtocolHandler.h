@@ -18,9 +18,14 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <unordered_map>
 
 #include <Common/ObserverManager.h>
 
+#include "CryptoNoteConfig.h"
 #include "CryptoNoteCore/ICore.h"
 
 #include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
@@ -65,6 +70,8 @@ namespace CryptoNote
     virtual bool removeObserver(ICryptoNoteProtocolObserver* observer) override;
 
     void set_p2p_endpoint(IP2pEndpoint* p2p);
+    // Block requests kept in flight per peer while synchronizing, BLOCKS_SYNCHRONIZING_MAX_REQUESTS by default
+    void setSyncMaxRequests(size_t count);
     // ICore& get_core() { return m_core; }
     virtual bool isSynchronized() const override { return m_synchronized; }
     void log_connections();
@@ -82,7 +89,7 @@ namespace CryptoNote
     int handleCommand(bool is_notify, int command, const BinaryArray& in_buff, BinaryArray& buff_out, CryptoNoteConnectionContext& context, bool& handled);
     virtual size_t getPeerCount() const override;
     virtual uint32_t getObservedHeight() const override;
-    void requestMissingPoolTransactions(const CryptoNoteConnectionContext& context);
+    void requestMissingPoolTransactions(const CryptoNoteConnectionContext& context, size_t sketchCells = TX_POOL_SKETCH_MIN_CELLS);
 
   private:
     //----------------- commands handlers ----------------------------------------------
@@ -95,6 +102,12 @@ namespace CryptoNote
     int handle_request_tx_pool(int command, NOTIFY_REQUEST_TX_POOL::request &arg, CryptoNoteConnectionContext &context);
     int handle_notify_new_lite_block(int command, NOTIFY_NEW_LITE_BLOCK::request &arg, CryptoNoteConnectionContext &context);
     int handle_notify_missing_txs(int command, NOTIFY_MISSING_TXS::request &arg, CryptoNoteConnectionContext &context);
+    int handle_notify_tx_hashes(int command, NOTIFY_TX_HASHES::request &arg, CryptoNoteConnectionContext &context);
+    int handle_request_tx_pool_sketch(int command, NOTIFY_REQUEST_TX_POOL_SKETCH::request &arg, CryptoNoteConnectionContext &context);
+    int handle_notify_tx_pool_sketch_failed(int command, NOTIFY_TX_POOL_SKETCH_FAILED::request &arg, CryptoNoteConnectionContext &context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request &arg, CryptoNoteConnectionContext &context);
+    int handle_request_compact_block_txs(int command, NOTIFY_REQUEST_COMPACT_BLOCK_TXS::request &arg, CryptoNoteConnectionContext &context);
+    int handle_notify_compact_block_txs(int command, NOTIFY_COMPACT_BLOCK_TXS::request &arg, CryptoNoteConnectionContext &context);
 
 
     //----------------- i_cryptonote_protocol ----------------------------------
@@ -103,15 +116,61 @@ namespace CryptoNote
 
     //----------------------------------------------------------------------------------
     uint32_t get_current_blockchain_height();
-    bool request_missing_objects(CryptoNoteConnectionContext& context, bool check_having_blocks);
+    bool request_missing_objects(CryptoNoteConnectionContext& context);
     bool on_connection_synchronized();
     void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext& context);
     void recalculateMaxObservedHeight(const CryptoNoteConnectionContext& context);
-    int processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks);
+    int processObjects(const std::vector<parsed_block_entry>& blocks);
     Logging::LoggerRef logger;
 
+    // Blocks of the chain being synchronized, split in spans of up to BLOCKS_SYNCHRONIZING_MAX_COUNT ids.
+    // A span is split further when requested, to the batch size of the peer.
+    // The spans are requested from all synchronizing peers, received spans wait until all spans
+    // below them arrived and are imported strictly in height order.
+    struct SyncSpan
+    {
+      std::vector<Crypto::Hash> blockIds;
+      boost::uuids::uuid peer;        // connection the span is requested from, nil if unassigned
+      boost::uuids::uuid stalledPeer; // connection the span was taken away from
+      std::chrono::steady_clock::time_point requestTime;
+      std::vector<parsed_block_entry> blocks;
+      boost::uuids::uuid supplier;    // connection the blocks came from
+      bool received;
+    };
+
+    bool addSyncChain(uint32_t startHeight, const std::vector<Crypto::Hash>& blockIds);
+    std::map<uint32_t, SyncSpan>::iterator findSyncSpan(uint32_t height);
+    void importSyncSpans();
+    void rescheduleSyncSpans();
+    void requestSyncSpans();
+    void resetSync();
+    void updateSyncBatchSize(CryptoNoteConnectionContext& context, size_t blocks, size_t bytes, std::chrono::steady_clock::duration roundTripTime);
+
+    // Transactions are relayed in batches on the idle round: peers from P2P_TX_HASHES_RELAY_VERSION get
+    // their hashes and request the bodies they lack, older peers get the bodies.
+    void queueTransactionRelay(const std::vector<std::string>& transactions);
+    void relayQueuedTransactions();
+    bool addKnownTransaction(CryptoNoteConnectionContext& context, const Crypto::Hash& transactionHash);
+
+    // An announced transaction is requested from one announcing peer at a time, the next announcer is asked
+    // on the idle round when the body doesn't arrive within P2P_TX_REQUEST_TIMEOUT or the peer disconnects.
+    struct RequestedTransaction
+    {
+      boost::uuids::uuid peer;                    // connection the body is requested from, nil if not requested
+      std::chrono::steady_clock::time_point requestTime;
+      std::deque<boost::uuids::uuid> announcers;  // other connections that announced it, up to P2P_TX_ANNOUNCERS_LIMIT
+    };
+
+    void requestAnnouncedTransactions();
+
+    // Blocks are sent once to every peer: peers from P2P_COMPACT_BLOCKS_VERSION get a compact block with the
+    // coinbase and short ids of the other transactions, lite block peers the block without transactions,
+    // older peers the full block. Must be called from the dispatcher thread.
+    void relayBlock(const NOTIFY_NEW_BLOCK::request& arg, const net_connection_id* excludeConnection);
+
   private:
     int doPushLiteBlock(NOTIFY_NEW_LITE_BLOCK::request block, CryptoNoteConnectionContext &context, std::vector<BinaryArray> missingTxs);
+    int doPushCompactBlock(CryptoNoteConnectionContext &context, std::vector<BinaryArray> missingTxs);
 
     System::Dispatcher& m_dispatcher;
     ICore& m_core;
@@ -122,6 +181,14 @@ namespace CryptoNote
     std::atomic<bool> m_synchronized;
     std::atomic<bool> m_stop;
     std::recursive_mutex m_sync_lock;    
+    std::map<uint32_t, SyncSpan> m_syncSpans; // by height of the first block
+    uint64_t m_syncGeneration; // changed by resetSync, spans scheduled before it are gone
+    bool m_syncImporting;
+    size_t m_syncMaxRequests;
+
+    std::mutex m_relayTransactionsMutex;
+    std::vector<std::pair<Crypto::Hash, std::string>> m_relayTransactions;
+    std::unordered_map<Crypto::Hash, RequestedTransaction> m_requestedTransactions; // up to P2P_TX_REQUESTED_LIMIT
 
     mutable std::mutex m_observedHeightMutex;
     uint32_t m_observedHeight;
@@ -64,6 +64,7 @@ namespace
   const command_line::arg_descriptor<bool>        arg_console     = {"no-console", "Disable daemon console commands"};
   const command_line::arg_descriptor<bool>        arg_testnet_on  = {"testnet", "Used to deploy test nets. Checkpoints and hardcoded seeds are ignored, "
     "network id is changed. Use it with --data-dir flag. The wallet must be launched with --testnet flag.", false};
+  const command_line::arg_descriptor<uint32_t>    arg_sync_max_requests = {"sync-max-requests", "Block requests kept in flight per peer while synchronizing", static_cast<uint32_t>(CryptoNote::BLOCKS_SYNCHRONIZING_MAX_REQUESTS)};
   const command_line::arg_descriptor<bool>        arg_print_genesis_tx = { "print-genesis-tx", "Prints genesis' block tx hex to insert it to config and exits" };
 }
 
@@ -152,6 +153,7 @@ int main(int argc, char* argv[])
    command_line::add_arg(desc_cmd_sett, arg_set_view_key);
    command_line::add_arg(desc_cmd_sett, arg_testnet_on);
    command_line::add_arg(desc_cmd_sett, arg_enable_cors);
+   command_line::add_arg(desc_cmd_sett, arg_sync_max_requests);
 
    command_line::add_arg(desc_cmd_sett, arg_print_genesis_tx);
    //command_line::add_arg(desc_cmd_sett, arg_genesis_block_reward_address);
@@ -297,6 +299,7 @@ int main(int argc, char* argv[])
     CryptoNote::RpcServer rpcServer(dispatcher, logManager, ccore, p2psrv, cprotocol);
 
     cprotocol.set_p2p_endpoint(&p2psrv);
+    cprotocol.setSyncMaxRequests(command_line::get_arg(vm, arg_sync_max_requests));
     ccore.set_cryptonote_protocol(&cprotocol);
     DaemonCommandsHandler dch(ccore, p2psrv, logManager, cprotocol);
 
@@ -350,6 +353,7 @@ int main(int argc, char* argv[])
       }
     }
  
+    rpcServer.setWorkerThreads(rpcConfig.workerThreads, rpcConfig.methodConcurrency);
     rpcServer.start(rpcConfig.bindIp, rpcConfig.bindPort);
     rpcServer.restrictRPC(command_line::get_arg(vm, arg_restricted_rpc));
     rpcServer.enableCors(command_line::get_arg(vm, arg_enable_cors));
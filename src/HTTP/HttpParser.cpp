@@ -18,25 +18,45 @@
 #include "HttpParser.h"
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 
+#include <System/TcpConnection.h>
 #include "HttpParserErrorCodes.h"
 
 namespace {
 
-void throwIfNotGood(std::istream& stream) {
-  if (!stream.good()) {
-    if (stream.eof()) {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::END_OF_STREAM));
-    } else {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::STREAM_NOT_GOOD));
-    }
-  }
+const size_t MAX_HEAD_SIZE = 64 * 1024;
+const size_t MAX_CHUNK_LINE_SIZE = 1024;
+const size_t MIN_READ_SIZE = 16 * 1024;
+const char CRLF[] = "\r\n";
+const char EMPTY_LINE[] = "\r\n\r\n";
+
+void throwError(CryptoNote::error::HttpParserErrorCodes code) {
+  throw std::system_error(make_error_code(code));
+}
+
+char* find(char* begin, char* end, const char* pattern, size_t patternSize) {
+  return std::search(begin, end, pattern, pattern + patternSize);
+}
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+// std::tolower is undefined for negative chars, bytes above 0x7f are passed as unsigned char
+char toLower(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
 }
 
 }
 
 namespace CryptoNote {
 
+HttpParser::HttpParser() : begin(0), end(0), messageSize(0) {
+  consume();
+}
+
 HttpResponse::HTTP_STATUS HttpParser::parseResponseStatusFromString(const std::string& status) {
   if (status == "200 OK" || status == "200 Ok") return CryptoNote::HttpResponse::STATUS_200;
   else if (status.substr(0, 4) == "401 ") return CryptoNote::HttpResponse::STATUS_401;
@@ -48,178 +68,366 @@ HttpResponse::HTTP_STATUS HttpParser::parseResponseStatusFromString(const std::s
   return CryptoNote::HttpResponse::STATUS_200; //unaccessible
 }
 
+bool HttpParser::receiveRequest(System::TcpConnection& connection, HttpRequest& request) {
+  while (!parseRequest()) {
+    if (read(connection) == 0) {
+      if (getBufferedSize() == 0) {
+        return false;
+      }
 
-void HttpParser::receiveRequest(std::istream& stream, HttpRequest& request) {
-  readWord(stream, request.method);
-  readWord(stream, request.url);
+      throwError(error::HttpParserErrorCodes::END_OF_STREAM);
+    }
+  }
+
+  request.method = static_cast<std::string>(getMethod());
+  request.url = static_cast<std::string>(getUrl());
+  for (const Header& header : headers) {
+    request.headers[static_cast<std::string>(header.name)] = static_cast<std::string>(header.value);
+  }
 
-  std::string httpVersion;
-  readWord(stream, httpVersion);
+  request.body.assign(getBody().getData(), getBody().getSize());
+  consume();
+  return true;
+}
 
-  readHeaders(stream, request.headers);
+void HttpParser::receiveResponse(System::TcpConnection& connection, HttpResponse& response) {
+  while (!parseResponse()) {
+    if (read(connection) == 0) {
+      throwError(error::HttpParserErrorCodes::END_OF_STREAM);
+    }
+  }
 
-  std::string body;
-  size_t bodyLen = getBodyLen(request.headers);
-  if (bodyLen) {
-    readBody(stream, request.body, bodyLen);
+  response.setStatus(parseResponseStatusFromString(static_cast<std::string>(getStatus())));
+  for (const Header& header : headers) {
+    response.addHeader(static_cast<std::string>(header.name), static_cast<std::string>(header.value));
   }
+
+  response.setBody(std::string(getBody().getData(), getBody().getSize()));
+  consume();
 }
 
+void HttpParser::append(const char* data, size_t size) {
+  std::memcpy(prepare(size), data, size);
+  end += size;
+}
 
-void HttpParser::receiveResponse(std::istream& stream, HttpResponse& response) {
-  std::string httpVersion;
-  readWord(stream, httpVersion);
-  
-  std::string status;
-  char c;
-  
-  stream.get(c);
-  while (stream.good() && c != '\r') { //Till the end
-    status += c;
-    stream.get(c);
-  }
+bool HttpParser::parseRequest() {
+  return parse(true);
+}
 
-  throwIfNotGood(stream);
+bool HttpParser::parseResponse() {
+  return parse(false);
+}
 
-  if (c == '\r') {
-    stream.get(c);
-    if (c != '\n') {
-      throw std::runtime_error("Parser error: '\\n' symbol is expected");
-    }
+void HttpParser::consume() {
+  begin += messageSize;
+  if (begin == end) {
+    begin = 0;
+    end = 0;
   }
 
-  response.setStatus(parseResponseStatusFromString(status));
-  
-  std::string name;
-  std::string value;
+  scanned = 0;
+  headSize = 0;
+  headerRanges.clear();
+  headers.clear();
+  bodyType = NO_BODY;
+  contentLength = 0;
+  chunkOffset = 0;
+  bodyEnd = 0;
+  messageSize = 0;
+}
+
+Common::StringView HttpParser::getMethod() const {
+  return view(firstWord);
+}
+
+Common::StringView HttpParser::getUrl() const {
+  return view(secondWord);
+}
+
+Common::StringView HttpParser::getStatus() const {
+  return view(secondWord);
+}
+
+const std::vector<HttpParser::Header>& HttpParser::getHeaders() const {
+  return headers;
+}
+
+Common::StringView HttpParser::getHeader(Common::StringView name) const {
+  const HeaderRange* header = findHeader(name);
+  return header != nullptr ? view(header->value) : Common::StringView::NIL;
+}
+
+Common::StringView HttpParser::getBody() const {
+  return view({headSize, bodyEnd - headSize});
+}
+
+size_t HttpParser::getBufferedSize() const {
+  return end - begin;
+}
 
-  while (readHeader(stream, name, value)) {
-    response.addHeader(name, value);
-    name.clear();
-    value.clear();
+bool HttpParser::parse(bool request) {
+  if (messageSize != 0) {
+    return true;
   }
 
-  response.addHeader(name, value);
-  auto headers = response.getHeaders();
-  size_t length = 0;
-  auto it = headers.find("content-length");
-  if (it != headers.end()) {
-    length = std::stoul(it->second);
+  if (headSize == 0 && !parseHead(request)) {
+    return false;
   }
-  
-  std::string body;
-  if (length) {
-    readBody(stream, body, length);
+
+  switch (bodyType) {
+  case NO_BODY:
+    bodyEnd = headSize;
+    messageSize = headSize;
+    break;
+  case CONTENT_LENGTH:
+    if (end - begin < headSize + contentLength) {
+      return false;
+    }
+
+    bodyEnd = headSize + contentLength;
+    messageSize = bodyEnd;
+    break;
+  case CHUNKED:
+    if (!parseChunks()) {
+      return false;
+    }
+
+    break;
   }
 
-  response.setBody(body);
+  complete();
+  return true;
 }
 
+bool HttpParser::parseHead(bool request) {
+  char* data = buffer.data() + begin;
+  size_t size = end - begin;
+  // continue the search where the previous one stopped, the terminator may straddle the boundary
+  size_t from = scanned < sizeof(EMPTY_LINE) - 2 ? 0 : scanned - (sizeof(EMPTY_LINE) - 2);
+  char* headEnd = find(data + from, data + size, EMPTY_LINE, sizeof(EMPTY_LINE) - 1);
+  if (headEnd == data + size) {
+    scanned = size;
+    if (size > MAX_HEAD_SIZE) {
+      throwError(error::HttpParserErrorCodes::HEADERS_TOO_LARGE);
+    }
+
+    return false;
+  }
 
-void HttpParser::readWord(std::istream& stream, std::string& word) {
-  char c;
+  headEnd += 2;
+  if (static_cast<size_t>(headEnd - data) > MAX_HEAD_SIZE) {
+    throwError(error::HttpParserErrorCodes::HEADERS_TOO_LARGE);
+  }
 
-  stream.get(c);
-  while (stream.good() && c != ' ' && c != '\r') {
-    word += c;
-    stream.get(c);
+  // request line is "method url version", status line is "version status"
+  char* lineEnd = find(data, headEnd, CRLF, sizeof(CRLF) - 1);
+  char* firstSpace = std::find(data, lineEnd, ' ');
+  if (firstSpace == data || firstSpace == lineEnd) {
+    throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
   }
 
-  throwIfNotGood(stream);
+  if (request) {
+    char* secondSpace = std::find(firstSpace + 1, lineEnd, ' ');
+    if (secondSpace == firstSpace + 1 || secondSpace == lineEnd || lineEnd - secondSpace < 6 || std::memcmp(secondSpace + 1, "HTTP/", 5) != 0) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
 
-  if (c == '\r') {
-    stream.get(c);
-    if (c != '\n') {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+    firstWord = {0, static_cast<size_t>(firstSpace - data)};
+    secondWord = {static_cast<size_t>(firstSpace + 1 - data), static_cast<size_t>(secondSpace - firstSpace - 1)};
+  } else {
+    if (firstSpace - data < 5 || std::memcmp(data, "HTTP/", 5) != 0) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
     }
+
+    firstWord = {0, static_cast<size_t>(firstSpace - data)};
+    secondWord = {static_cast<size_t>(firstSpace + 1 - data), static_cast<size_t>(lineEnd - firstSpace - 1)};
   }
-}
 
-void HttpParser::readHeaders(std::istream& stream, HttpRequest::Headers& headers) {
-  std::string name;
-  std::string value;
+  for (char* line = lineEnd + 2; line != headEnd; ) {
+    char* next = find(line, headEnd, CRLF, sizeof(CRLF) - 1);
+    char* colon = std::find(line, next, ':');
+    if (colon == next) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
 
-  while (readHeader(stream, name, value)) {
-    headers[name] = value; //use insert
-    name.clear();
-    value.clear();
+    if (colon == line) {
+      throwError(error::HttpParserErrorCodes::EMPTY_HEADER);
+    }
+
+    std::transform(line, colon, line, toLower);
+    char* valueBegin = colon + 1;
+    char* valueEnd = next;
+    while (valueBegin != valueEnd && isSpace(*valueBegin)) {
+      ++valueBegin;
+    }
+
+    while (valueEnd != valueBegin && isSpace(*(valueEnd - 1))) {
+      --valueEnd;
+    }
+
+    headerRanges.push_back({{static_cast<size_t>(line - data), static_cast<size_t>(colon - line)},
+      {static_cast<size_t>(valueBegin - data), static_cast<size_t>(valueEnd - valueBegin)}});
+    line = next + 2;
   }
 
-  headers[name] = value; //use insert
-}
+  headSize = headEnd + 2 - data;
+  bodyType = NO_BODY;
+  const HeaderRange* transferEncoding = findHeader("transfer-encoding");
+  const HeaderRange* length = findHeader("content-length");
+  if (transferEncoding != nullptr) {
+    std::string value = static_cast<std::string>(view(transferEncoding->value));
+    std::transform(value.begin(), value.end(), value.begin(), toLower);
+    if (value.find("chunked") != std::string::npos) {
+      bodyType = CHUNKED;
+      chunkOffset = headSize;
+      bodyEnd = headSize;
+    }
+  }
 
-bool HttpParser::readHeader(std::istream& stream, std::string& name, std::string& value) {
-  char c;
-  bool isName = true;
+  if (bodyType == NO_BODY && length != nullptr) {
+    Common::StringView value = view(length->value);
+    if (value.getSize() == 0 || value.getSize() > 18) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+    }
 
-  stream.get(c);
-  while (stream.good() && c != '\r') {
-    if (c == ':') {
-      if (stream.peek() == ' ') {
-        stream.get(c);
+    contentLength = 0;
+    for (size_t i = 0; i < value.getSize(); ++i) {
+      if (value[i] < '0' || value[i] > '9') {
+        throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
       }
 
-      if (name.empty()) {
-        throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::EMPTY_HEADER));
+      contentLength = contentLength * 10 + (value[i] - '0');
+    }
+
+    if (contentLength != 0) {
+      bodyType = CONTENT_LENGTH;
+    }
+  }
+
+  return true;
+}
+
+bool HttpParser::parseChunks() {
+  // chunk data is moved down in place to make the body contiguous
+  char* data = buffer.data() + begin;
+  size_t size = end - begin;
+  for (;;) {
+    char* lineEnd = find(data + chunkOffset, data + size, CRLF, sizeof(CRLF) - 1);
+    if (lineEnd == data + size) {
+      if (size - chunkOffset > MAX_CHUNK_LINE_SIZE) {
+        throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
       }
 
-      if (isName) {
-        isName = false;
-        stream.get(c);
-        continue;
+      return false;
+    }
+
+    size_t chunkSize = 0;
+    const char* digit = data + chunkOffset;
+    for (; digit != lineEnd && *digit != ';' && !isSpace(*digit); ++digit) {
+      int value;
+      if (*digit >= '0' && *digit <= '9') {
+        value = *digit - '0';
+      } else if (*digit >= 'a' && *digit <= 'f') {
+        value = *digit - 'a' + 10;
+      } else if (*digit >= 'A' && *digit <= 'F') {
+        value = *digit - 'A' + 10;
+      } else {
+        throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+      }
+
+      if (chunkSize >> 56 != 0) {
+        throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
       }
+
+      chunkSize = chunkSize * 16 + value;
     }
 
-    if (isName) {
-      name += c;
-      stream.get(c);
-    } else {
-      value += c;
-      stream.get(c);
+    if (digit == data + chunkOffset) {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
     }
-  }
 
-  throwIfNotGood(stream);
+    size_t dataOffset = lineEnd + 2 - data;
+    if (chunkSize == 0) {
+      // the last chunk is followed by optional trailer fields and an empty line
+      if (size - dataOffset < 2) {
+        return false;
+      }
+
+      if (data[dataOffset] == '\r' && data[dataOffset + 1] == '\n') {
+        messageSize = dataOffset + 2;
+        return true;
+      }
 
-  stream.get(c);
-  if (c != '\n') {
-    throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
-  }
+      char* trailerEnd = find(data + dataOffset, data + size, EMPTY_LINE, sizeof(EMPTY_LINE) - 1);
+      if (trailerEnd == data + size) {
+        if (size - dataOffset > MAX_HEAD_SIZE) {
+          throwError(error::HttpParserErrorCodes::HEADERS_TOO_LARGE);
+        }
+
+        return false;
+      }
+
+      messageSize = trailerEnd + 4 - data;
+      return true;
+    }
 
-  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (size - dataOffset < chunkSize + 2) {
+      return false;
+    }
 
-  c = stream.peek();
-  if (c == '\r') {
-    stream.get(c).get(c);
-    if (c != '\n') {
-      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+    if (data[dataOffset + chunkSize] != '\r' || data[dataOffset + chunkSize + 1] != '\n') {
+      throwError(error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
     }
 
-    return false; //no more headers
+    std::memmove(data + bodyEnd, data + dataOffset, chunkSize);
+    bodyEnd += chunkSize;
+    chunkOffset = dataOffset + chunkSize + 2;
   }
+}
 
-  return true;
+void HttpParser::complete() {
+  headers.clear();
+  for (const HeaderRange& header : headerRanges) {
+    headers.push_back({view(header.name), view(header.value)});
+  }
 }
 
-size_t HttpParser::getBodyLen(const HttpRequest::Headers& headers) {
-  auto it = headers.find("content-length");
-  if (it != headers.end()) {
-    size_t bytes = std::stoul(it->second);
-    return bytes;
+const HttpParser::HeaderRange* HttpParser::findHeader(Common::StringView name) const {
+  for (const HeaderRange& header : headerRanges) {
+    if (view(header.name) == name) {
+      return &header;
+    }
   }
 
-  return 0;
+  return nullptr;
 }
 
-void HttpParser::readBody(std::istream& stream, std::string& body, const size_t bodyLen) {
-  size_t read = 0;
+Common::StringView HttpParser::view(const Range& range) const {
+  return Common::StringView(buffer.data() + begin + range.offset, range.size);
+}
+
+char* HttpParser::prepare(size_t size) {
+  if (buffer.size() - end < size) {
+    if (begin != 0) {
+      std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+      end -= begin;
+      begin = 0;
+    }
 
-  while (stream.good() && read < bodyLen) {
-    body += stream.get();
-    ++read;
+    if (buffer.size() - end < size) {
+      buffer.resize(std::max(buffer.size() * 2, end + size));
+    }
   }
 
-  throwIfNotGood(stream);
+  return buffer.data() + end;
+}
+
+size_t HttpParser::read(System::TcpConnection& connection) {
+  char* data = prepare(MIN_READ_SIZE);
+  size_t transferred = connection.read(reinterpret_cast<uint8_t*>(data), buffer.size() - end);
+  end += transferred;
+  return transferred;
 }
 
 }
@@ -18,28 +18,94 @@
 #ifndef HTTPPARSER_H_
 #define HTTPPARSER_H_
 
-#include <iostream>
-#include <map>
 #include <string>
+#include <vector>
+#include <Common/StringView.h>
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 
+namespace System {
+class TcpConnection;
+}
+
 namespace CryptoNote {
 
-//Blocking HttpParser
+// Incremental HTTP/1.1 parser. Data read from a connection goes into one growable buffer, the start line, headers and
+// body of a parsed message are views into it, valid until the message is consumed or more data is appended.
+// Data following the message, such as pipelined keep-alive requests, stays buffered for the next message.
 class HttpParser {
 public:
-  HttpParser() {};
+  struct Header {
+    Common::StringView name; // lower case
+    Common::StringView value;
+  };
+
+  HttpParser();
+
+  // Read from the connection until a whole message is buffered, then consume it.
+  // receiveRequest returns false if the connection is closed between requests.
+  bool receiveRequest(System::TcpConnection& connection, HttpRequest& request);
+  void receiveResponse(System::TcpConnection& connection, HttpResponse& response);
+
+  void append(const char* data, size_t size);
+  // Return true once a whole message is buffered. A message with neither Content-Length nor chunked transfer
+  // encoding has an empty body.
+  bool parseRequest();
+  bool parseResponse();
+  void consume();
+
+  Common::StringView getMethod() const;
+  Common::StringView getUrl() const;
+  Common::StringView getStatus() const;
+  const std::vector<Header>& getHeaders() const;
+  // NIL if the message has no such header, name is lower case
+  Common::StringView getHeader(Common::StringView name) const;
+  Common::StringView getBody() const;
+  size_t getBufferedSize() const;
 
-  void receiveRequest(std::istream& stream, HttpRequest& request);
-  void receiveResponse(std::istream& stream, HttpResponse& response);
   static HttpResponse::HTTP_STATUS parseResponseStatusFromString(const std::string& status);
+
 private:
-  void readWord(std::istream& stream, std::string& word);
-  void readHeaders(std::istream& stream, HttpRequest::Headers &headers);
-  bool readHeader(std::istream& stream, std::string& name, std::string& value);
-  size_t getBodyLen(const HttpRequest::Headers& headers);
-  void readBody(std::istream& stream, std::string& body, const size_t bodyLen);
+  struct Range {
+    size_t offset;
+    size_t size;
+  };
+
+  struct HeaderRange {
+    Range name;
+    Range value;
+  };
+
+  enum BodyType {
+    NO_BODY,
+    CONTENT_LENGTH,
+    CHUNKED
+  };
+
+  // offsets are relative to the first byte of the current message
+  std::vector<char> buffer;
+  size_t begin;
+  size_t end;
+  size_t scanned;
+  size_t headSize;
+  Range firstWord;
+  Range secondWord;
+  std::vector<HeaderRange> headerRanges;
+  BodyType bodyType;
+  size_t contentLength;
+  size_t chunkOffset;
+  size_t bodyEnd;
+  size_t messageSize;
+  std::vector<Header> headers;
+
+  bool parse(bool request);
+  bool parseHead(bool request);
+  bool parseChunks();
+  void complete();
+  const HeaderRange* findHeader(Common::StringView name) const;
+  Common::StringView view(const Range& range) const;
+  char* prepare(size_t size);
+  size_t read(System::TcpConnection& connection);
 };
 
 } //namespace CryptoNote
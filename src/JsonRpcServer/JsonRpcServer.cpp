@@ -32,8 +32,7 @@
 #include "HTTP/HttpResponse.h"
 
 #include "Common/JsonValue.h"
-#include "Serialization/JsonInputValueSerializer.h"
-#include "Serialization/JsonOutputStreamSerializer.h"
+#include "Serialization/SerializationTools.h"
 
 namespace CryptoNote {
 
@@ -56,12 +55,22 @@ void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNot
     logger(Logging::TRACE) << "HTTP request came: \n" << req;
 
     if (req.getUrl() == "/json_rpc") {
-      std::istringstream jsonInputStream(req.getBody());
-      Common::JsonValue jsonRpcRequest;
+      Common::JsonValue jsonRpcRequest(Common::JsonValue::OBJECT);
       Common::JsonValue jsonRpcResponse(Common::JsonValue::OBJECT);
+      Common::StringView params = Common::StringView::NIL;
 
       try {
-        jsonInputStream >> jsonRpcRequest;
+        JsonInputStringSerializer serializer(req.getBody());
+        Common::StringView text;
+        if (serializer.rawValue(text, "id")) {
+          jsonRpcRequest.insert("id", Common::JsonValue::fromString(std::string(text)));
+        }
+
+        if (serializer.rawValue(text, "method")) {
+          jsonRpcRequest.insert("method", Common::JsonValue::fromString(std::string(text)));
+        }
+
+        serializer.rawValue(params, "params");
       } catch (std::runtime_error&) {
         logger(Logging::DEBUGGING) << "Couldn't parse request: \"" << req.getBody() << "\"";
         makeJsonParsingErrorResponse(jsonRpcResponse);
@@ -70,13 +79,15 @@ void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNot
         return;
       }
 
-      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse);
-
-      std::ostringstream jsonOutputStream;
-      jsonOutputStream << jsonRpcResponse;
+      std::string result;
+      processJsonRpcRequest(jsonRpcRequest, params, jsonRpcResponse, result);
 
       resp.setStatus(CryptoNote::HttpResponse::STATUS_200);
-      resp.setBody(jsonOutputStream.str());
+      if (result.empty() || jsonRpcResponse.contains("error")) {
+        resp.setBody(jsonRpcResponse.toString());
+      } else {
+        resp.setBody(storeToJsonWithMember(jsonRpcResponse, "result", result));
+      }
 
     } else {
       logger(Logging::WARNING) << "Requested url \"" << req.getUrl() << "\" is not found";
@@ -164,10 +175,6 @@ void JsonRpcServer::makeMethodNotFoundResponse(Common::JsonValue& resp) {
   resp.insert("error", error);
 }
 
-void JsonRpcServer::fillJsonResponse(const Common::JsonValue& v, Common::JsonValue& resp) {
-  resp.insert("result", v);
-}
-
 void JsonRpcServer::makeJsonParsingErrorResponse(Common::JsonValue& resp) {
   using Common::JsonValue;
 
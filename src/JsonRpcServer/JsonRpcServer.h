@@ -19,6 +19,8 @@
 
 #include <system_error>
 
+#include <Common/StringView.h>
+
 #include <System/Dispatcher.h>
 #include <System/Event.h>
 #include "Logging/ILogger.h"
@@ -52,11 +54,12 @@ protected:
   static void makeErrorResponse(const std::error_code& ec, Common::JsonValue& resp);
   static void makeMethodNotFoundResponse(Common::JsonValue& resp);
   static void makeGenericErrorReponse(Common::JsonValue& resp, const char* what, int errorCode = -32001);
-  static void fillJsonResponse(const Common::JsonValue& v, Common::JsonValue& resp);
   static void prepareJsonResponse(const Common::JsonValue& req, Common::JsonValue& resp);
   static void makeJsonParsingErrorResponse(Common::JsonValue& resp);
 
-  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) = 0;
+  // 'req' carries the id and method members, 'params' is the unparsed text of the params member or NIL if it is absent.
+  // 'result' receives the serialized result member, it is only sent when 'resp' does not contain an error
+  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::StringView params, Common::JsonValue& resp, std::string& result) = 0;
 
 private:
   // HttpServer
@@ -21,6 +21,7 @@
 #include <atomic>
 #include <system_error>
 #include <thread>
+#include <unordered_map>
 
 #include <HTTP/HttpRequest.h>
 #include <HTTP/HttpResponse.h>
@@ -32,9 +33,11 @@
 #include <CryptoNoteCore/TransactionApi.h>
 
 #include "Common/StringTools.h"
+#include "CryptoNoteConfig.h"
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionPoolSketch.h"
 #include "Rpc/CoreRpcServerCommandsDefinitions.h"
 #include "Rpc/HttpClient.h"
 #include "Rpc/JsonRpc.h"
@@ -575,7 +578,19 @@ std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(std::vector<Crypto::H
   CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_LITE::response rsp = AUTO_VAL_INIT(rsp);
 
   req.tailBlockId = knownBlockId;
-  req.knownTxsIds = knownPoolTxIds;
+
+  // the sketch costs the difference of the pools, the list the whole known pool
+  bool useSketch = m_poolSketchSupported && TX_POOL_SKETCH_MIN_CELLS * TransactionPoolSketch::CELL_SIZE < knownPoolTxIds.size() * sizeof(Crypto::Hash);
+  TransactionPoolSketch sketch(TX_POOL_SKETCH_MIN_CELLS, Crypto::rand<uint64_t>());
+  if (useSketch) {
+    for (const auto& id : knownPoolTxIds) {
+      sketch.insert(id);
+    }
+
+    req.knownTxsSketch = sketch.toString();
+  } else {
+    req.knownTxsIds = knownPoolTxIds;
+  }
 
   std::error_code ec = binaryCommand("/get_pool_changes_lite.bin", req, rsp);
 
@@ -583,9 +598,36 @@ std::error_code NodeRpcProxy::doGetPoolSymmetricDifference(std::vector<Crypto::H
     return ec;
   }
 
+  if (useSketch && !rsp.knownTxsSketchDecoded) {
+    // older node or too large a difference, ask again with the list
+    m_poolSketchSupported = rsp.knownTxsSketchSupported;
+    useSketch = false;
+    req.knownTxsSketch.clear();
+    req.knownTxsIds = knownPoolTxIds;
+    rsp = CryptoNote::COMMAND_RPC_GET_POOL_CHANGES_LITE::response();
+    ec = binaryCommand("/get_pool_changes_lite.bin", req, rsp);
+    if (ec) {
+      return ec;
+    }
+  }
+
   isBcActual = rsp.isTailBlockActual;
 
-  deletedTxIds = std::move(rsp.deletedTxsIds);
+  if (useSketch) {
+    std::unordered_map<uint64_t, Crypto::Hash> knownShortIds;
+    for (const auto& id : knownPoolTxIds) {
+      knownShortIds.emplace(sketch.shortId(id), id);
+    }
+
+    for (uint64_t shortId : rsp.deletedTxsShortIds) {
+      auto it = knownShortIds.find(shortId);
+      if (it != knownShortIds.end()) {
+        deletedTxIds.push_back(it->second);
+      }
+    }
+  } else {
+    deletedTxIds = std::move(rsp.deletedTxsIds);
+  }
 
   for (const auto& tpi : rsp.addedTxs) {
     newTxs.push_back(createTransactionPrefix(tpi.txPrefix, tpi.txHash));
@@ -151,6 +151,7 @@ private:
   Crypto::Hash m_lastKnowHash;
   std::atomic<uint64_t> m_lastLocalBlockTimestamp;
   std::unordered_set<Crypto::Hash> m_knownTxs;
+  bool m_poolSketchSupported = true;
 
   bool m_connected;
 };
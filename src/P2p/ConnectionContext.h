@@ -8,17 +8,27 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
 #include <list>
 #include <ostream>
 #include <unordered_set>
+#include <vector>
 #include <boost/optional.hpp>
 #include <boost/uuid/uuid.hpp>
 #include "Common/StringTools.h"
+#include "P2p/PendingCompactBlock.h"
 #include "P2p/PendingLiteBlock.h"
 #include "crypto/hash.h"
 
 namespace CryptoNote {
 
+struct BlockSpanRequest {
+  uint32_t startHeight;
+  std::vector<Crypto::Hash> blockIds;
+  std::chrono::steady_clock::time_point sendTime;
+};
+
 struct CryptoNoteConnectionContext {
   uint8_t version;
   boost::uuids::uuid m_connection_id;
@@ -39,10 +49,20 @@ struct CryptoNoteConnectionContext {
 
   state m_state = state_befor_handshake;
   boost::optional<PendingLiteBlock> m_pending_lite_block;
-  std::list<Crypto::Hash> m_needed_objects;
-  std::unordered_set<Crypto::Hash> m_requested_objects;
+  boost::optional<PendingCompactBlock> m_pending_compact_block;
+  std::unordered_set<Crypto::Hash> m_known_txs; // transactions the peer has announced, sent or been announced
+  std::deque<BlockSpanRequest> m_requested_spans; // block requests in flight while synchronizing, oldest first
+  bool m_chain_requested = false;
   uint32_t m_remote_blockchain_height = 0;
   uint32_t m_last_response_height = 0;
+
+  // synchronization throughput: blocks and bytes received, time spent with block requests in flight
+  uint64_t m_sync_blocks = 0;
+  uint64_t m_sync_bytes = 0;
+  std::chrono::steady_clock::duration m_sync_time = std::chrono::steady_clock::duration::zero();
+  std::chrono::steady_clock::time_point m_sync_request_time;
+  std::chrono::steady_clock::duration m_sync_rtt = std::chrono::steady_clock::duration::zero(); // smoothed time from a block request to its response
+  size_t m_sync_batch_size = 0; // blocks per request adapted to the block size and the round trip time, 0 until measured
 };
 
 inline std::string get_protocol_state_string(CryptoNoteConnectionContext::state s) {
@@ -27,6 +27,8 @@ const uint32_t LEVIN_PACKET_REQUEST = 0x00000001;
 const uint32_t LEVIN_PACKET_RESPONSE = 0x00000002;
 const uint32_t LEVIN_DEFAULT_MAX_PACKET_SIZE = 100000000;      //100MB by default
 const uint32_t LEVIN_PROTOCOL_VER_1 = 1;
+// bodies up to this size are sent together with the header in one write
+const size_t LEVIN_COALESCE_BODY_SIZE = 16 * 1024;
 
 #pragma pack(push)
 #pragma pack(1)
@@ -60,15 +62,7 @@ void LevinProtocol::sendMessage(uint32_t command, const BinaryArray& out, bool n
   head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
   head.m_flags = LEVIN_PACKET_REQUEST;
 
-  // write header and body in one operation
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  writePacket(reinterpret_cast<const uint8_t*>(&head), sizeof(head), out);
 }
 
 bool LevinProtocol::readCommand(Command& cmd) {
@@ -113,12 +107,23 @@ void LevinProtocol::sendReply(uint32_t command, const BinaryArray& out, int32_t
   head.m_flags = LEVIN_PACKET_RESPONSE;
   head.m_return_code = returnCode;
 
+  writePacket(reinterpret_cast<const uint8_t*>(&head), sizeof(head), out);
+}
+
+void LevinProtocol::writePacket(const uint8_t* head, size_t headSize, const BinaryArray& body) {
+  if (body.size() > LEVIN_COALESCE_BODY_SIZE) {
+    // large bodies may be shared between connections, they are written in place instead of being copied behind the header
+    writeStrict(head, headSize);
+    writeStrict(body.data(), body.size());
+    return;
+  }
+
   BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
+  writeBuffer.reserve(headSize + body.size());
 
   Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
+  stream.writeSome(head, headSize);
+  stream.writeSome(body.data(), body.size());
 
   writeStrict(writeBuffer.data(), writeBuffer.size());
 }
@@ -107,6 +107,7 @@ private:
 
   bool readStrict(uint8_t* ptr, size_t size);
   void writeStrict(const uint8_t* ptr, size_t size);
+  void writePacket(const uint8_t* head, size_t headSize, const BinaryArray& body);
   System::TcpConnection& m_conn;
 };
 
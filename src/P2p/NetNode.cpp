@@ -356,12 +356,13 @@ namespace CryptoNote
   void NodeServer::externalRelayNotifyToList(int command, const BinaryArray &data_buff, const std::list<boost::uuids::uuid> relayList)
   {
     m_dispatcher.remoteSpawn([this, command, data_buff, relayList] {
+      auto payload = std::make_shared<const BinaryArray>(data_buff);
       forEachConnection([&](P2pConnectionContext &conn) {
         if (std::find(relayList.begin(), relayList.end(), conn.m_connection_id) != relayList.end())
         {
           if (conn.peerId && (conn.m_state == CryptoNoteConnectionContext::state_normal || conn.m_state == CryptoNoteConnectionContext::state_synchronizing))
           {
-            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, payload));
           }
         }
       });
@@ -1269,13 +1270,20 @@ namespace CryptoNote
   void NodeServer::relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) {
     net_connection_id excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<net_connection_id>();
 
+    // one copy of the payload is queued to every peer
+    auto payload = std::make_shared<const BinaryArray>(data_buff);
+    size_t peerCount = 0;
     forEachConnection([&](P2pConnectionContext& conn) {
       if (conn.peerId && conn.m_connection_id != excludeId &&
           (conn.m_state == CryptoNoteConnectionContext::state_normal ||
            conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+        if (conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, payload))) {
+          ++peerCount;
+        }
       }
     });
+
+    logger(DEBUGGING) << "Relayed command " << command << " of " << payload->size() << " bytes to " << peerCount << " peers";
   }
 
   //-----------------------------------------------------------------------------------
@@ -1694,13 +1702,13 @@ namespace CryptoNote
           logger(DEBUGGING) << ctx << "msg " << msg.type << ':' << msg.command;
           switch (msg.type) {
           case P2pMessage::COMMAND:
-            proto.sendMessage(msg.command, msg.buffer, true);
+            proto.sendMessage(msg.command, *msg.buffer, true);
             break;
           case P2pMessage::NOTIFY:
-            proto.sendMessage(msg.command, msg.buffer, false);
+            proto.sendMessage(msg.command, *msg.buffer, false);
             break;
           case P2pMessage::REPLY:
-            proto.sendReply(msg.command, msg.buffer, msg.returnCode);
+            proto.sendReply(msg.command, *msg.buffer, msg.returnCode);
             break;
           default:
             assert(false);
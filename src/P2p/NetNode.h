@@ -9,6 +9,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
 
 #include <boost/functional/hash.hpp>
@@ -53,6 +54,15 @@ namespace CryptoNote
     };
 
     P2pMessage(Type type, uint32_t command, const BinaryArray& buffer, int32_t returnCode = 0) :
+      type(type), command(command), buffer(std::make_shared<const BinaryArray>(buffer)), returnCode(returnCode) {
+    }
+
+    P2pMessage(Type type, uint32_t command, BinaryArray&& buffer, int32_t returnCode = 0) :
+      type(type), command(command), buffer(std::make_shared<const BinaryArray>(std::move(buffer))), returnCode(returnCode) {
+    }
+
+    // the payload is shared with every other message built from the same buffer, e.g. when relaying to all peers
+    P2pMessage(Type type, uint32_t command, const std::shared_ptr<const BinaryArray>& buffer, int32_t returnCode = 0) :
       type(type), command(command), buffer(buffer), returnCode(returnCode) {
     }
 
@@ -61,12 +71,12 @@ namespace CryptoNote
     }
 
     size_t size() {
-      return buffer.size();
+      return buffer->size();
     }
 
     Type type;
     uint32_t command;
-    const BinaryArray buffer;
+    std::shared_ptr<const BinaryArray> buffer;
     int32_t returnCode;
   };
 
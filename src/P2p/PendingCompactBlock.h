@@ -0,0 +1,20 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include "CryptoNoteProtocol/CryptoNoteProtocolDefinitions.h"
+
+#include <vector>
+
+namespace CryptoNote
+{
+    struct PendingCompactBlock
+    {
+        NOTIFY_NEW_COMPACT_BLOCK_request request;
+        Block block;                            // transaction hashes found in the pool, null hashes for the missing ones
+        std::vector<uint32_t> missing_indexes;  // indexes of the transactions requested from the sender
+    };
+} // namespace CryptoNote
@@ -81,7 +81,7 @@ PaymentServiceJsonRpcServer::PaymentServiceJsonRpcServer(System::Dispatcher& sys
   handlers.emplace("sendFusionTransaction", jsonHandler<SendFusionTransaction::Request, SendFusionTransaction::Response>(std::bind(&PaymentServiceJsonRpcServer::handleSendFusionTransaction, this, std::placeholders::_1, std::placeholders::_2)));
 }
 
-void PaymentServiceJsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) {
+void PaymentServiceJsonRpcServer::processJsonRpcRequest(const Common::JsonValue& req, Common::StringView params, Common::JsonValue& resp, std::string& result) {
   try {
     prepareJsonResponse(req, resp);
 
@@ -108,12 +108,7 @@ void PaymentServiceJsonRpcServer::processJsonRpcRequest(const Common::JsonValue&
 
     logger(Logging::DEBUGGING) << method << " request came";
 
-    Common::JsonValue params(Common::JsonValue::OBJECT);
-    if (req.contains("params")) {
-      params = req("params");
-    }
-
-    it->second(params, resp);
+    it->second(params, resp, result);
   } catch (std::exception& e) {
     logger(Logging::WARNING) << "Error occurred while processing JsonRpc request: " << e.what();
     makeGenericErrorReponse(resp, e.what());
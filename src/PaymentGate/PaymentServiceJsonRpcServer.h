@@ -22,8 +22,8 @@
 #include "Common/JsonValue.h"
 #include "JsonRpcServer/JsonRpcServer.h"
 #include "PaymentServiceJsonRpcMessages.h"
-#include "Serialization/JsonInputValueSerializer.h"
-#include "Serialization/JsonOutputStreamSerializer.h"
+#include "Serialization/JsonInputStringSerializer.h"
+#include "Serialization/SerializationTools.h"
 
 namespace PaymentService {
 
@@ -35,22 +35,22 @@ public:
   PaymentServiceJsonRpcServer(const PaymentServiceJsonRpcServer&) = delete;
 
 protected:
-  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) override;
+  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::StringView params, Common::JsonValue& resp, std::string& result) override;
 
 private:
   WalletService& service;
   Logging::LoggerRef logger;
 
-  typedef std::function<void (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse)> HandlerFunction;
+  typedef std::function<void (Common::StringView jsonRpcParams, Common::JsonValue& jsonResponse, std::string& result)> HandlerFunction;
 
   template <typename RequestType, typename ResponseType, typename RequestHandler>
   HandlerFunction jsonHandler(RequestHandler handler) {
-    return [handler] (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse) mutable {
+    return [handler] (Common::StringView jsonRpcParams, Common::JsonValue& jsonResponse, std::string& result) mutable {
       RequestType request;
       ResponseType response;
 
       try {
-        CryptoNote::JsonInputValueSerializer inputSerializer(const_cast<Common::JsonValue&>(jsonRpcParams));
+        CryptoNote::JsonInputStringSerializer inputSerializer(jsonRpcParams.isNil() ? Common::StringView("{}") : jsonRpcParams);
         serialize(request, inputSerializer);
       } catch (std::exception&) {
         makeGenericErrorReponse(jsonResponse, "Invalid Request", -32600);
@@ -63,9 +63,7 @@ private:
         return;
       }
 
-      CryptoNote::JsonOutputStreamSerializer outputSerializer;
-      serialize(response, outputSerializer);
-      fillJsonResponse(outputSerializer.getValue(), jsonResponse);
+      result = CryptoNote::storeToJson(response);
     };
   }
 
@@ -0,0 +1,162 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ContextSwitch.h"
+
+#ifdef SYSTEM_REGISTER_CONTEXT_SWITCH
+
+#include <cstdint>
+
+extern "C" void systemContextTrampoline();
+
+#if defined(__x86_64__)
+
+// Frame left on the stack of a suspended context, from the saved stack pointer up:
+// mxcsr and x87 control word, r15, r14, r13, r12, rbx, rbp, return address
+__asm__(
+  ".text\n"
+  ".globl systemSwitchContext\n"
+  ".hidden systemSwitchContext\n"
+  ".type systemSwitchContext, @function\n"
+  ".align 16\n"
+  "systemSwitchContext:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $16, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $16, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size systemSwitchContext, .-systemSwitchContext\n"
+
+  // entered by the ret above with the entry point in r12 and its argument in r13
+  ".globl systemContextTrampoline\n"
+  ".hidden systemContextTrampoline\n"
+  ".type systemContextTrampoline, @function\n"
+  ".align 16\n"
+  "systemContextTrampoline:\n"
+  "  movq %r13, %rdi\n"
+  "  callq *%r12\n"
+  "  ud2\n"
+  ".size systemContextTrampoline, .-systemContextTrampoline\n"
+);
+
+namespace System {
+
+void* makeSwitchContext(void* stack, size_t stackSize, void (*entry)(void*), void* argument) {
+  uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + stackSize) & ~static_cast<uintptr_t>(15);
+  // the trampoline is entered by ret with a 16 byte aligned stack, as if the call had just returned
+  uint64_t* frame = reinterpret_cast<uint64_t*>(top - 16) - 9;
+  frame[0] = 0x037F00001F80; // default mxcsr and x87 control word
+  frame[1] = 0;
+  frame[2] = 0; // r15
+  frame[3] = 0; // r14
+  frame[4] = reinterpret_cast<uint64_t>(argument); // r13
+  frame[5] = reinterpret_cast<uint64_t>(entry); // r12
+  frame[6] = 0; // rbx
+  frame[7] = 0; // rbp
+  frame[8] = reinterpret_cast<uint64_t>(&systemContextTrampoline);
+  return frame;
+}
+
+}
+
+#elif defined(__aarch64__)
+
+// Frame left on the stack of a suspended context, from the saved stack pointer up:
+// x19 - x28, x29 (frame pointer), x30 (return address), d8 - d15
+__asm__(
+  ".text\n"
+  ".globl systemSwitchContext\n"
+  ".hidden systemSwitchContext\n"
+  ".type systemSwitchContext, %function\n"
+  ".align 4\n"
+  "systemSwitchContext:\n"
+  "  sub sp, sp, #160\n"
+  "  stp x19, x20, [sp, #0]\n"
+  "  stp x21, x22, [sp, #16]\n"
+  "  stp x23, x24, [sp, #32]\n"
+  "  stp x25, x26, [sp, #48]\n"
+  "  stp x27, x28, [sp, #64]\n"
+  "  stp x29, x30, [sp, #80]\n"
+  "  stp d8, d9, [sp, #96]\n"
+  "  stp d10, d11, [sp, #112]\n"
+  "  stp d12, d13, [sp, #128]\n"
+  "  stp d14, d15, [sp, #144]\n"
+  "  mov x9, sp\n"
+  "  str x9, [x0]\n"
+  "  mov sp, x1\n"
+  "  ldp x19, x20, [sp, #0]\n"
+  "  ldp x21, x22, [sp, #16]\n"
+  "  ldp x23, x24, [sp, #32]\n"
+  "  ldp x25, x26, [sp, #48]\n"
+  "  ldp x27, x28, [sp, #64]\n"
+  "  ldp x29, x30, [sp, #80]\n"
+  "  ldp d8, d9, [sp, #96]\n"
+  "  ldp d10, d11, [sp, #112]\n"
+  "  ldp d12, d13, [sp, #128]\n"
+  "  ldp d14, d15, [sp, #144]\n"
+  "  add sp, sp, #160\n"
+  "  ret\n"
+  ".size systemSwitchContext, .-systemSwitchContext\n"
+
+  // entered by the ret above with the entry point in x19 and its argument in x20
+  ".globl systemContextTrampoline\n"
+  ".hidden systemContextTrampoline\n"
+  ".type systemContextTrampoline, %function\n"
+  ".align 4\n"
+  "systemContextTrampoline:\n"
+  "  mov x0, x20\n"
+  "  blr x19\n"
+  "  brk #0\n"
+  ".size systemContextTrampoline, .-systemContextTrampoline\n"
+);
+
+namespace System {
+
+void* makeSwitchContext(void* stack, size_t stackSize, void (*entry)(void*), void* argument) {
+  uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + stackSize) & ~static_cast<uintptr_t>(15);
+  uint64_t* frame = reinterpret_cast<uint64_t*>(top) - 20;
+  for (size_t i = 0; i < 20; ++i) {
+    frame[i] = 0;
+  }
+
+  frame[0] = reinterpret_cast<uint64_t>(entry); // x19
+  frame[1] = reinterpret_cast<uint64_t>(argument); // x20
+  frame[11] = reinterpret_cast<uint64_t>(&systemContextTrampoline); // x30
+  return frame;
+}
+
+}
+
+#endif
+
+#endif
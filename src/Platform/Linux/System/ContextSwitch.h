@@ -0,0 +1,43 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+
+// The dispatcher switches coroutines with a few instructions saving the callee saved registers and the stack pointer.
+// Other architectures, or builds configured with USE_UCONTEXT, use getcontext/makecontext/swapcontext, which also
+// save the signal mask and make a system call on every switch.
+#if !defined(USE_UCONTEXT) && (defined(__x86_64__) || defined(__aarch64__))
+#define SYSTEM_REGISTER_CONTEXT_SWITCH
+#endif
+
+#ifdef SYSTEM_REGISTER_CONTEXT_SWITCH
+
+namespace System {
+
+// Saves the callee saved registers on the current stack, stores the stack pointer to *from
+// and continues the context whose stack pointer is to.
+extern "C" void systemSwitchContext(void** from, void* to);
+
+// Prepares a stack so that the first systemSwitchContext to the returned stack pointer calls entry(argument).
+// entry must never return.
+void* makeSwitchContext(void* stack, size_t stackSize, void (*entry)(void*), void* argument);
+
+}
+
+#endif
@@ -16,8 +16,10 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Dispatcher.h"
+#include "ContextSwitch.h"
 
 #include <System/ErrorMessage.h>
+#include <algorithm>
 #include <cassert>
 #include <fcntl.h>
 #include <pthread.h>
@@ -25,6 +27,7 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/timerfd.h>
 #include <ucontext.h>
 #include <unistd.h>
@@ -57,19 +60,144 @@ private:
 
 static_assert(Dispatcher::SIZEOF_PTHREAD_MUTEX_T == sizeof(pthread_mutex_t), "invalid pthread mutex size");
 
-//const size_t STACK_SIZE = 64 * 1024;
-const size_t STACK_SIZE = 512 * 1024;
+const size_t MIN_STACK_SIZE = 16 * 1024;
+// Reusable contexts past this many most recently used ones give their stack pages back to the kernel
+const size_t MAX_WARM_REUSABLE_CONTEXTS = 64;
+
+size_t pageSize() {
+  static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return size;
+}
+
+size_t roundUpToPage(size_t size) {
+  return (size + pageSize() - 1) & ~(pageSize() - 1);
+}
+
+// A stack is a private anonymous mapping with a PROT_NONE guard page at its lowest address, so an overflow faults
+// instead of corrupting the heap. Pages are committed by the kernel on first touch.
+uint8_t* allocateStack(size_t stackSize) {
+  void* stack = mmap(nullptr, pageSize() + stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED) {
+    throw std::runtime_error("Dispatcher::getReusableContext, mmap failed, " + lastErrorMessage());
+  }
+
+  if (mprotect(stack, pageSize(), PROT_NONE) == -1) {
+    std::string message = "Dispatcher::getReusableContext, mprotect failed, " + lastErrorMessage();
+    munmap(stack, pageSize() + stackSize);
+    throw std::runtime_error(message);
+  }
+
+  return static_cast<uint8_t*>(stack);
+}
+
+void freeStack(uint8_t* stack, size_t stackSize) {
+  auto result = munmap(stack, pageSize() + stackSize);
+  assert(result == 0);
+  (void)result;
+}
+
+// Returns the pages of a stack below the given stack pointer to the kernel, they are zero filled again on next touch
+void releaseStackBelow(uint8_t* stack, const void* stackPointer) {
+  uintptr_t top = (reinterpret_cast<uintptr_t>(stackPointer) & ~(pageSize() - 1)) - pageSize();
+  uintptr_t bottom = reinterpret_cast<uintptr_t>(stack) + pageSize();
+  if (top > bottom) {
+    madvise(reinterpret_cast<void*>(bottom), top - bottom, MADV_DONTNEED);
+  }
+}
+
+// CLOCK_MONOTONIC in nanoseconds, the clock of the timer wheel event
+uint64_t monotonicTime() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+}
+
+size_t residentStackBytes(uint8_t* stack, size_t stackSize) {
+  std::vector<unsigned char> pages(stackSize / pageSize());
+  if (mincore(stack + pageSize(), stackSize, pages.data()) == -1) {
+    return 0;
+  }
+
+  return std::count_if(pages.begin(), pages.end(), [](unsigned char page) { return (page & 1) != 0; }) * pageSize();
+}
+
+#ifdef SYSTEM_REGISTER_CONTEXT_SWITCH
+// NativeContext::ucontext holds the stack pointer of a suspended context, it is written by switchContext
+
+bool createMainContext(void*& context) {
+  context = nullptr;
+  return true;
+}
+
+void* createContext(uint8_t* stack, size_t stackSize, void (*procedure)(void*), ContextMakingData& data) {
+  data.ucontext = makeSwitchContext(stack, stackSize, procedure, &data);
+  return data.ucontext;
+}
+
+void deleteContext(void*) {
+}
+
+void switchContext(void** from, void* to, const char*) {
+  systemSwitchContext(from, to);
+}
+
+const void* suspendedStackPointer(void* context) {
+  return context;
+}
+#else
+bool createMainContext(void*& context) {
+  ucontext_t* mainContext = new ucontext_t;
+  if (getcontext(mainContext) == -1) {
+    delete mainContext;
+    return false;
+  }
+
+  context = mainContext;
+  return true;
+}
+
+void* createContext(uint8_t* stack, size_t stackSize, void (*procedure)(void*), ContextMakingData& data) {
+  ucontext_t* context = new ucontext_t;
+  if (getcontext(context) == -1) { //makecontext precondition
+    delete context;
+    throw std::runtime_error("Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage());
+  }
+
+  context->uc_stack.ss_sp = stack;
+  context->uc_stack.ss_size = stackSize;
+  data.ucontext = context;
+  makecontext(context, (void(*)())procedure, 1, reinterpret_cast<int*>(&data));
+  return context;
+}
+
+void deleteContext(void* context) {
+  delete static_cast<ucontext_t*>(context);
+}
+
+void switchContext(void** from, void* to, const char* caller) {
+  if (swapcontext(static_cast<ucontext_t*>(*from), static_cast<ucontext_t*>(to)) == -1) {
+    throw std::runtime_error(std::string(caller) + ", swapcontext failed, " + lastErrorMessage());
+  }
+}
+
+// The stack pointer saved in ucontext_t is machine specific, stacks of suspended contexts are kept as is
+const void* suspendedStackPointer(void*) {
+  return nullptr;
+}
+#endif
 
 };
 
-Dispatcher::Dispatcher() {
+Dispatcher::Dispatcher() : Dispatcher(DEFAULT_STACK_SIZE) {
+}
+
+Dispatcher::Dispatcher(size_t stackSize) : stackSize(roundUpToPage(std::max(stackSize, MIN_STACK_SIZE))) {
   std::string message;
   epoll = ::epoll_create1(0);
   if (epoll == -1) {
     message = "epoll_create1 failed, " + lastErrorMessage();
   } else {
-    mainContext.ucontext = new ucontext_t;
-    if (getcontext(reinterpret_cast<ucontext_t*>(mainContext.ucontext)) == -1) {
+    if (!createMainContext(mainContext.ucontext)) {
       message = "getcontext failed, " + lastErrorMessage();
     } else {
       remoteSpawnEvent = eventfd(0, O_NONBLOCK);
@@ -86,21 +214,45 @@ Dispatcher::Dispatcher() {
         if (epoll_ctl(epoll, EPOLL_CTL_ADD, remoteSpawnEvent, &remoteSpawnEventEpollEvent) == -1) {
           message = "epoll_ctl failed, " + lastErrorMessage();
         } else {
-          *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
-
-          mainContext.interrupted = false;
-          mainContext.group = &contextGroup;
-          mainContext.groupPrev = nullptr;
-          mainContext.groupNext = nullptr;
-          contextGroup.firstContext = nullptr;
-          contextGroup.lastContext = nullptr;
-          contextGroup.firstWaiter = nullptr;
-          contextGroup.lastWaiter = nullptr;
-          currentContext = &mainContext;
-          firstResumingContext = nullptr;
-          firstReusableContext = nullptr;
-          runningContextCount = 0;
-          return;
+          timerWheelEvent = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+          if (timerWheelEvent == -1) {
+            message = "timerfd_create failed, " + lastErrorMessage();
+          } else {
+            timerWheelEventContext.writeContext = nullptr;
+            timerWheelEventContext.readContext = nullptr;
+
+            epoll_event timerWheelEpollEvent;
+            timerWheelEpollEvent.events = EPOLLIN;
+            timerWheelEpollEvent.data.ptr = &timerWheelEventContext;
+
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, timerWheelEvent, &timerWheelEpollEvent) == -1) {
+              message = "epoll_ctl failed, " + lastErrorMessage();
+            } else {
+              *reinterpret_cast<pthread_mutex_t*>(this->mutex) = pthread_mutex_t(PTHREAD_MUTEX_INITIALIZER);
+
+              mainContext.interrupted = false;
+              mainContext.group = &contextGroup;
+              mainContext.groupPrev = nullptr;
+              mainContext.groupNext = nullptr;
+              contextGroup.firstContext = nullptr;
+              contextGroup.lastContext = nullptr;
+              contextGroup.firstWaiter = nullptr;
+              contextGroup.lastWaiter = nullptr;
+              currentContext = &mainContext;
+              firstResumingContext = nullptr;
+              firstReusableContext = nullptr;
+              lastReusableContext = nullptr;
+              firstColdReusableContext = nullptr;
+              reusableContextCount = 0;
+              runningContextCount = 0;
+              timerWheelArmedTime = TimerWheel::NO_TIMERS;
+              return;
+            }
+
+            auto result = close(timerWheelEvent);
+            assert(result == 0);
+            (void)result;
+          }
         }
 
         auto result = close(remoteSpawnEvent);
@@ -126,44 +278,35 @@ Dispatcher::~Dispatcher() {
   assert(firstResumingContext == nullptr);
   assert(runningContextCount == 0);
   while (firstReusableContext != nullptr) {
-    auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-    auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
+    NativeContext* context = firstReusableContext;
     firstReusableContext = firstReusableContext->next;
-    delete[] stackPtr;
-    delete ucontext;
+    destroyReusableContext(context);
   }
 
-  while (!timers.empty()) {
-    int result = ::close(timers.top());
-    assert(result == 0);
-    timers.pop();
-  }
+  lastReusableContext = nullptr;
+  firstColdReusableContext = nullptr;
+  reusableContextCount = 0;
 
   auto result = close(epoll);
   assert(result == 0);
   result = close(remoteSpawnEvent);
   assert(result == 0);
+  result = close(timerWheelEvent);
+  assert(result == 0);
   result = pthread_mutex_destroy(reinterpret_cast<pthread_mutex_t*>(this->mutex));
   assert(result == 0);
 }
 
 void Dispatcher::clear() {
   while (firstReusableContext != nullptr) {
-    auto ucontext = static_cast<ucontext_t*>(firstReusableContext->ucontext);
-    auto stackPtr = static_cast<uint8_t *>(firstReusableContext->stackPtr);
+    NativeContext* context = firstReusableContext;
     firstReusableContext = firstReusableContext->next;
-    delete[] stackPtr;
-    delete ucontext;
+    destroyReusableContext(context);
   }
 
-  while (!timers.empty()) {
-    int result = ::close(timers.top());
-    if (result == -1) {
-      throw std::runtime_error("Dispatcher::clear, close failed, "  + lastErrorMessage());
-    }
-
-    timers.pop();
-  }
+  lastReusableContext = nullptr;
+  firstColdReusableContext = nullptr;
+  reusableContextCount = 0;
 }
 
 void Dispatcher::dispatch() {
@@ -179,6 +322,11 @@ void Dispatcher::dispatch() {
     int count = epoll_wait(epoll, &event, 1, -1);
     if (count == 1) {
       ContextPair *contextPair = static_cast<ContextPair*>(event.data.ptr);
+      if (contextPair == &timerWheelEventContext) {
+        expireTimers();
+        continue;
+      }
+
       if(((event.events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
         uint64_t buf;
         auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
@@ -215,11 +363,9 @@ void Dispatcher::dispatch() {
   }
 
   if (context != currentContext) {
-    ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext->ucontext);
+    NativeContext* oldContext = currentContext;
     currentContext = context;
-    if (swapcontext(oldContext, static_cast<ucontext_t *>(context->ucontext)) == -1) {
-      throw std::runtime_error("Dispatcher::dispatch, swapcontext failed, " + lastErrorMessage());
-    }
+    switchContext(&oldContext->ucontext, context->ucontext, "Dispatcher::dispatch");
   }
 }
 
@@ -308,6 +454,11 @@ void Dispatcher::yield() {
     if(count > 0) {
       for(int i = 0; i < count; ++i) {
         ContextPair *contextPair = static_cast<ContextPair*>(events[i].data.ptr);
+        if (contextPair == &timerWheelEventContext) {
+          expireTimers();
+          continue;
+        }
+
         if(((events[i].events & (EPOLLIN | EPOLLOUT)) != 0) && contextPair->readContext == nullptr && contextPair->writeContext == nullptr) {
           uint64_t buf;
           auto transferred = read(remoteSpawnEvent, &buf, sizeof buf);
@@ -365,60 +516,147 @@ int Dispatcher::getEpoll() const {
 
 NativeContext& Dispatcher::getReusableContext() {
   if(firstReusableContext == nullptr) {
-    ucontext_t* newlyCreatedContext = new ucontext_t;
-    if (getcontext(newlyCreatedContext) == -1) { //makecontext precondition
-      throw std::runtime_error("Dispatcher::getReusableContext, getcontext failed, " + lastErrorMessage());
+    auto stackPointer = allocateStack(stackSize);
+    ContextMakingData makingContextData {this, nullptr};
+    void* newlyCreatedContext;
+    try {
+      stacks.push_back(stackPointer);
+      newlyCreatedContext = createContext(stackPointer + pageSize(), stackSize, contextProcedureStatic, makingContextData);
+    } catch (...) {
+      stacks.erase(std::find(stacks.begin(), stacks.end(), stackPointer));
+      freeStack(stackPointer, stackSize);
+      throw;
     }
 
-    auto stackPointer = new uint8_t[STACK_SIZE];
-    newlyCreatedContext->uc_stack.ss_sp = stackPointer;
-    newlyCreatedContext->uc_stack.ss_size = STACK_SIZE;
-
-    ContextMakingData makingContextData {this, newlyCreatedContext};
-    makecontext(newlyCreatedContext, (void(*)())contextProcedureStatic, 1, reinterpret_cast<int*>(&makingContextData));
-
-    ucontext_t* oldContext = static_cast<ucontext_t*>(currentContext->ucontext);
-    if (swapcontext(oldContext, newlyCreatedContext) == -1) {
-      throw std::runtime_error("Dispatcher::getReusableContext, swapcontext failed, " + lastErrorMessage());
-    }
+    switchContext(&currentContext->ucontext, newlyCreatedContext, "Dispatcher::getReusableContext");
 
     assert(firstReusableContext != nullptr);
-    assert(firstReusableContext->ucontext == newlyCreatedContext);
     firstReusableContext->stackPtr = stackPointer;
+    ++reusableContextCount;
   };
 
   NativeContext* context = firstReusableContext;
-  firstReusableContext = firstReusableContext-> next;
+  firstReusableContext = firstReusableContext->next;
+  if (firstReusableContext != nullptr) {
+    firstReusableContext->prev = nullptr;
+  } else {
+    lastReusableContext = nullptr;
+  }
+
+  // the last warm context moved up, the first cold one takes its place
+  if (firstColdReusableContext != nullptr) {
+    firstColdReusableContext = firstColdReusableContext->next;
+  }
+
+  --reusableContextCount;
   return *context;
 }
 
 void Dispatcher::pushReusableContext(NativeContext& context) {
+  context.prev = nullptr;
   context.next = firstReusableContext;
+  if (firstReusableContext != nullptr) {
+    firstReusableContext->prev = &context;
+  } else {
+    lastReusableContext = &context;
+  }
+
   firstReusableContext = &context;
+  ++reusableContextCount;
   --runningContextCount;
+  if (reusableContextCount > MAX_WARM_REUSABLE_CONTEXTS) {
+    // The context pushed out of the warm ones is suspended, its stack isn't touched until it is reused.
+    // The pushed context itself may still be running on its stack and is left alone.
+    NativeContext* coldContext = firstColdReusableContext != nullptr ? firstColdReusableContext->prev : lastReusableContext;
+    firstColdReusableContext = coldContext;
+    const void* stackPointer = suspendedStackPointer(coldContext->ucontext);
+    if (stackPointer != nullptr) {
+      releaseStackBelow(static_cast<uint8_t*>(coldContext->stackPtr), stackPointer);
+    }
+  }
+
+  if (reusableContextCount > MAX_REUSABLE_CONTEXTS) {
+    NativeContext* oldestContext = lastReusableContext;
+    lastReusableContext = oldestContext->prev;
+    lastReusableContext->next = nullptr;
+    --reusableContextCount;
+    destroyReusableContext(oldestContext);
+  }
 }
 
-int Dispatcher::getTimer() {
-  int timer;
-  if (timers.empty()) {
-    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-    epoll_event timerEvent;
-    timerEvent.events = 0;
-    timerEvent.data.ptr = nullptr;
+// The context lives on its own stack, it is gone once the stack is unmapped
+void Dispatcher::destroyReusableContext(NativeContext* context) {
+  context->procedure = nullptr;
+  context->interruptProcedure = nullptr;
+  void* ucontext = context->ucontext;
+  uint8_t* stackPtr = static_cast<uint8_t*>(context->stackPtr);
+  stacks.erase(std::find(stacks.begin(), stacks.end(), stackPtr));
+  freeStack(stackPtr, stackSize);
+  deleteContext(ucontext);
+}
 
-    if (epoll_ctl(getEpoll(), EPOLL_CTL_ADD, timer, &timerEvent) == -1) {
-      throw std::runtime_error("Dispatcher::getTimer, epoll_ctl failed, "  + lastErrorMessage());
-    }
-  } else {
-    timer = timers.top();
-    timers.pop();
+DispatcherStackStatistics Dispatcher::getStackStatistics() const {
+  DispatcherStackStatistics statistics;
+  statistics.stackSize = stackSize;
+  statistics.stackCount = stacks.size();
+  statistics.reusableStackCount = reusableContextCount;
+  statistics.residentBytes = 0;
+  for (auto stack : stacks) {
+    statistics.residentBytes += residentStackBytes(stack, stackSize);
+  }
+
+  return statistics;
+}
+
+void Dispatcher::addTimer(TimerContext* timer, std::chrono::nanoseconds duration) {
+  uint64_t now = monotonicTime();
+  if (timerWheel.empty()) {
+    timerWheel.advance(now / 1000000);
   }
 
-  return timer;
+  // round up, a timer never expires before its duration
+  timerWheel.insert(*timer, (now + duration.count() + 999999) / 1000000);
+  armTimerWheelEvent();
 }
 
-void Dispatcher::pushTimer(int timer) {
-  timers.push(timer);
+void Dispatcher::interruptTimer(TimerContext* timer) {
+  // the event stays armed, waking up once for nothing is cheaper than a system call per cancelled timer
+  timerWheel.remove(*timer);
+}
+
+void Dispatcher::expireTimers() {
+  uint64_t expirations;
+  if (read(timerWheelEvent, &expirations, sizeof expirations) == -1 && errno != EAGAIN) {
+    throw std::runtime_error("Dispatcher::expireTimers, read failed, " + lastErrorMessage());
+  }
+
+  timerWheelArmedTime = TimerWheel::NO_TIMERS;
+  TimerContext* timer = timerWheel.advance(monotonicTime() / 1000000);
+  while (timer != nullptr) {
+    TimerContext* next = timer->next;
+    timer->context->interruptProcedure = nullptr;
+    pushContext(timer->context);
+    timer = next;
+  }
+
+  armTimerWheelEvent();
+}
+
+void Dispatcher::armTimerWheelEvent() {
+  uint64_t nextTime = timerWheel.getNextTime();
+  if (nextTime >= timerWheelArmedTime) {
+    return;
+  }
+
+  itimerspec expires;
+  expires.it_interval.tv_sec = expires.it_interval.tv_nsec = 0;
+  expires.it_value.tv_sec = nextTime / 1000;
+  expires.it_value.tv_nsec = (nextTime % 1000) * 1000000;
+  if (timerfd_settime(timerWheelEvent, TFD_TIMER_ABSTIME, &expires, NULL) == -1) {
+    throw std::runtime_error("Dispatcher::armTimerWheelEvent, timerfd_settime failed, " + lastErrorMessage());
+  }
+
+  timerWheelArmedTime = nextTime;
 }
 
 void Dispatcher::contextProcedure(void* ucontext) {
@@ -427,11 +665,10 @@ void Dispatcher::contextProcedure(void* ucontext) {
   context.ucontext = ucontext;
   context.interrupted = false;
   context.next = nullptr;
+  context.prev = nullptr;
   firstReusableContext = &context;
-  ucontext_t* oldContext = static_cast<ucontext_t*>(context.ucontext);
-  if (swapcontext(oldContext, static_cast<ucontext_t*>(currentContext->ucontext)) == -1) {
-    throw std::runtime_error("Dispatcher::contextProcedure, swapcontext failed, " + lastErrorMessage());
-  }
+  lastReusableContext = &context;
+  switchContext(&context.ucontext, currentContext->ucontext, "Dispatcher::contextProcedure");
 
   for (;;) {
     ++runningContextCount;
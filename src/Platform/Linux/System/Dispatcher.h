@@ -21,21 +21,27 @@
 #include <cstdint>
 #include <functional>
 #include <queue>
-#include <stack>
+#include <chrono>
+#include <vector>
 #ifndef __GLIBC__
 #include <bits/reg.h>
 #endif
 
+#include "TimerWheel.h"
+
 namespace System {
 
 struct NativeContextGroup;
 
 struct NativeContext {
+  // ucontext_t, or the saved stack pointer with the register context switch, see ContextSwitch.h
   void* ucontext;
   void* stackPtr;
   bool interrupted;
   bool inExecutionQueue;
   NativeContext* next;
+  // previous context in the reusable list, the list is walked back from its cold end
+  NativeContext* prev;
   NativeContextGroup* group;
   NativeContext* groupPrev;
   NativeContext* groupNext;
@@ -61,9 +67,21 @@ struct ContextPair {
   OperationContext *writeContext;
 };
 
+struct DispatcherStackStatistics {
+  size_t stackSize;
+  size_t stackCount;
+  size_t reusableStackCount;
+  size_t residentBytes;
+};
+
 class Dispatcher {
 public:
+  static const size_t DEFAULT_STACK_SIZE = 512 * 1024;
+  // Finished contexts above this count are destroyed and their stacks unmapped
+  static const size_t MAX_REUSABLE_CONTEXTS = 1024;
+
   Dispatcher();
+  explicit Dispatcher(size_t stackSize);
   Dispatcher(const Dispatcher&) = delete;
   ~Dispatcher();
   Dispatcher& operator=(const Dispatcher&) = delete;
@@ -76,13 +94,14 @@ public:
   void pushContext(NativeContext* context);
   void remoteSpawn(std::function<void()>&& procedure);
   void yield();
+  DispatcherStackStatistics getStackStatistics() const;
 
   // system-dependent
   int getEpoll() const;
   NativeContext& getReusableContext();
   void pushReusableContext(NativeContext&);
-  int getTimer();
-  void pushTimer(int timer);
+  void addTimer(TimerContext* timer, std::chrono::nanoseconds duration);
+  void interruptTimer(TimerContext* timer);
 
 #ifdef __x86_64__
 #if __WORDSIZE == 64
@@ -105,16 +124,28 @@ private:
   int remoteSpawnEvent;
   ContextPair remoteSpawnEventContext;
   std::queue<std::function<void()>> remoteSpawningProcedures;
-  std::stack<int> timers;
+  int timerWheelEvent;
+  ContextPair timerWheelEventContext;
+  TimerWheel timerWheel;
+  uint64_t timerWheelArmedTime;
 
   NativeContext mainContext;
   NativeContextGroup contextGroup;
   NativeContext* currentContext;
   NativeContext* firstResumingContext;
   NativeContext* lastResumingContext;
+  // Reusable contexts are kept most recently used first, the ones past the warm count are cold
   NativeContext* firstReusableContext;
+  NativeContext* lastReusableContext;
+  NativeContext* firstColdReusableContext;
+  size_t reusableContextCount;
   size_t runningContextCount;
+  size_t stackSize;
+  std::vector<uint8_t*> stacks;
 
+  void destroyReusableContext(NativeContext* context);
+  void expireTimers();
+  void armTimerWheelEvent();
   void contextProcedure(void* ucontext);
   static void contextProcedureStatic(void* context);
 };
@@ -0,0 +1,171 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace System {
+
+const uint64_t TimerWheel::NO_TIMERS;
+
+TimerWheel::TimerWheel() : currentTime(0), timerCount(0) {
+  for (unsigned level = 0; level < LEVEL_COUNT; ++level) {
+    std::fill(slots[level], slots[level] + SLOT_COUNT, nullptr);
+    occupiedSlots[level] = 0;
+  }
+}
+
+bool TimerWheel::empty() const {
+  return timerCount == 0;
+}
+
+size_t TimerWheel::size() const {
+  return timerCount;
+}
+
+uint64_t TimerWheel::getCurrentTime() const {
+  return currentTime;
+}
+
+uint64_t TimerWheel::getNextTime() const {
+  uint64_t nextTime = NO_TIMERS;
+  for (unsigned level = 0; level < LEVEL_COUNT; ++level) {
+    if (occupiedSlots[level] == 0) {
+      continue;
+    }
+
+    // find the first occupied slot after the current one, slots of level n are reached at multiples of 64^n
+    unsigned shift = level * LEVEL_BITS;
+    uint64_t currentBlock = currentTime >> shift;
+    unsigned start = static_cast<unsigned>((currentBlock + 1) % SLOT_COUNT);
+    uint64_t rotated = start == 0 ? occupiedSlots[level] : (occupiedSlots[level] >> start) | (occupiedSlots[level] << (SLOT_COUNT - start));
+    uint64_t distance = static_cast<uint64_t>(__builtin_ctzll(rotated)) + 1;
+    nextTime = std::min(nextTime, (currentBlock + distance) << shift);
+  }
+
+  return nextTime;
+}
+
+void TimerWheel::insert(TimerContext& timer, uint64_t expireTime) {
+  // the slot of the current time has already been expired
+  timer.expireTime = std::max(expireTime, currentTime + 1);
+  link(timer);
+  ++timerCount;
+}
+
+void TimerWheel::remove(TimerContext& timer) {
+  assert(timerCount > 0);
+  unlink(timer);
+  --timerCount;
+}
+
+TimerContext* TimerWheel::advance(uint64_t time) {
+  TimerContext* firstExpired = nullptr;
+  TimerContext* lastExpired = nullptr;
+  for (;;) {
+    uint64_t nextTime = getNextTime();
+    if (nextTime > time) {
+      break;
+    }
+
+    // nothing happens between the current and the next time, the wheel jumps over it
+    currentTime = nextTime;
+    for (unsigned level = LEVEL_COUNT - 1; level > 0; --level) {
+      unsigned shift = level * LEVEL_BITS;
+      if ((currentTime & ((uint64_t(1) << shift) - 1)) != 0) {
+        continue;
+      }
+
+      TimerContext* timer = takeSlot(level, static_cast<unsigned>((currentTime >> shift) % SLOT_COUNT));
+      while (timer != nullptr) {
+        TimerContext* next = timer->next;
+        link(*timer);
+        timer = next;
+      }
+    }
+
+    TimerContext* timer = takeSlot(0, static_cast<unsigned>(currentTime % SLOT_COUNT));
+    while (timer != nullptr) {
+      assert(timer->expireTime == currentTime);
+      TimerContext* next = timer->next;
+      timer->prev = lastExpired;
+      timer->next = nullptr;
+      if (lastExpired != nullptr) {
+        lastExpired->next = timer;
+      } else {
+        firstExpired = timer;
+      }
+
+      lastExpired = timer;
+      --timerCount;
+      timer = next;
+    }
+  }
+
+  currentTime = std::max(currentTime, time);
+  return firstExpired;
+}
+
+void TimerWheel::link(TimerContext& timer) {
+  assert(timer.expireTime >= currentTime);
+  unsigned level = 0;
+  while (level + 1 < LEVEL_COUNT && (timer.expireTime >> (level * LEVEL_BITS)) - (currentTime >> (level * LEVEL_BITS)) >= SLOT_COUNT) {
+    ++level;
+  }
+
+  uint64_t currentBlock = currentTime >> (level * LEVEL_BITS);
+  // timers beyond the range of the wheel wait in its last slot and are placed again when it is reached
+  uint64_t block = std::min(timer.expireTime >> (level * LEVEL_BITS), currentBlock + SLOT_COUNT - 1);
+  unsigned slot = static_cast<unsigned>(block % SLOT_COUNT);
+  timer.level = static_cast<uint8_t>(level);
+  timer.slot = static_cast<uint8_t>(slot);
+  timer.prev = nullptr;
+  timer.next = slots[level][slot];
+  if (timer.next != nullptr) {
+    timer.next->prev = &timer;
+  }
+
+  slots[level][slot] = &timer;
+  occupiedSlots[level] |= uint64_t(1) << slot;
+}
+
+void TimerWheel::unlink(TimerContext& timer) {
+  if (timer.prev != nullptr) {
+    timer.prev->next = timer.next;
+  } else {
+    assert(slots[timer.level][timer.slot] == &timer);
+    slots[timer.level][timer.slot] = timer.next;
+    if (timer.next == nullptr) {
+      occupiedSlots[timer.level] &= ~(uint64_t(1) << timer.slot);
+    }
+  }
+
+  if (timer.next != nullptr) {
+    timer.next->prev = timer.prev;
+  }
+}
+
+TimerContext* TimerWheel::takeSlot(unsigned level, unsigned slot) {
+  TimerContext* first = slots[level][slot];
+  slots[level][slot] = nullptr;
+  occupiedSlots[level] &= ~(uint64_t(1) << slot);
+  return first;
+}
+
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace System {
+
+struct NativeContext;
+
+struct TimerContext {
+  uint64_t expireTime;
+  NativeContext* context;
+  TimerContext* prev;
+  TimerContext* next;
+  uint8_t level;
+  uint8_t slot;
+  bool interrupted;
+};
+
+// Hierarchical timer wheel, times are in milliseconds. Each level has 64 slots, a slot of level n covers 64^n
+// milliseconds, timers move to a lower level when the wheel reaches their slot. Insertion and removal are O(1).
+class TimerWheel {
+public:
+  static const uint64_t NO_TIMERS = UINT64_MAX;
+
+  TimerWheel();
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  bool empty() const;
+  size_t size() const;
+  uint64_t getCurrentTime() const;
+  // Earliest time at which advance has work to do, a timer expiry or a cascade to a lower level
+  uint64_t getNextTime() const;
+
+  // Times in the past expire on the next advance
+  void insert(TimerContext& timer, uint64_t expireTime);
+  void remove(TimerContext& timer);
+  // Moves the wheel to the given time and returns the expired timers linked by next, in expiry order
+  TimerContext* advance(uint64_t time);
+
+private:
+  static const unsigned LEVEL_BITS = 6;
+  static const unsigned SLOT_COUNT = 1 << LEVEL_BITS;
+  static const unsigned LEVEL_COUNT = 6;
+
+  TimerContext* slots[LEVEL_COUNT][SLOT_COUNT];
+  uint64_t occupiedSlots[LEVEL_COUNT];
+  uint64_t currentTime;
+  size_t timerCount;
+
+  void link(TimerContext& timer);
+  void unlink(TimerContext& timer);
+  TimerContext* takeSlot(unsigned level, unsigned slot);
+};
+
+}
@@ -16,6 +16,7 @@
 // along with Bytecoin.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Dispatcher.h"
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <sys/errno.h>
@@ -55,13 +56,15 @@ private:
   pthread_mutex_t& mutex;
 };
 
-//const size_t STACK_SIZE = 64 * 1024;
-const size_t STACK_SIZE = 512 * 1024;
+const size_t MIN_STACK_SIZE = 16 * 1024;
 }
 
 static_assert(Dispatcher::SIZEOF_PTHREAD_MUTEX_T == sizeof(pthread_mutex_t), "invalid pthread mutex size");
 
-Dispatcher::Dispatcher() : lastCreatedTimer(0) {
+Dispatcher::Dispatcher() : Dispatcher(DEFAULT_STACK_SIZE) {
+}
+
+Dispatcher::Dispatcher(size_t stackSize) : lastCreatedTimer(0), stackSize(std::max(stackSize, MIN_STACK_SIZE)), stackCount(0) {
   std::string message;
   kqueue = ::kqueue();
   if (kqueue == -1) {
@@ -93,6 +96,7 @@ Dispatcher::Dispatcher() : lastCreatedTimer(0) {
           currentContext = &mainContext;
           firstResumingContext = nullptr;
           firstReusableContext = nullptr;
+          reusableContextCount = 0;
           runningContextCount = 0;
           return;
         }
@@ -122,8 +126,11 @@ Dispatcher::~Dispatcher() {
     firstReusableContext = firstReusableContext->next;
     delete[] stackPtr;
     delete ucontext;
+    --stackCount;
   }
 
+  reusableContextCount = 0;
+
   auto result = close(kqueue);
   assert(result != -1);
   result = pthread_mutex_destroy(reinterpret_cast<pthread_mutex_t*>(this->mutex));
@@ -137,7 +144,10 @@ void Dispatcher::clear() {
     firstReusableContext = firstReusableContext->next;
     delete[] stackPtr;
     delete ucontext;
+    --stackCount;
   }
+
+  reusableContextCount = 0;
 }
 
 void Dispatcher::dispatch() {
@@ -343,9 +353,9 @@ int Dispatcher::getKqueue() const {
 NativeContext& Dispatcher::getReusableContext() {
   if(firstReusableContext == nullptr) {
    uctx* newlyCreatedContext = new uctx;
-   uint8_t* stackPointer = new uint8_t[STACK_SIZE];
+   uint8_t* stackPointer = new uint8_t[stackSize];
    static_cast<uctx*>(newlyCreatedContext)->uc_stack.ss_sp = stackPointer;
-   static_cast<uctx*>(newlyCreatedContext)->uc_stack.ss_size = STACK_SIZE;
+   static_cast<uctx*>(newlyCreatedContext)->uc_stack.ss_size = stackSize;
 
    ContextMakingData makingData{ newlyCreatedContext, this};
    makecontext(static_cast<uctx*>(newlyCreatedContext), reinterpret_cast<void(*)()>(contextProcedureStatic), reinterpret_cast<intptr_t>(&makingData));
@@ -358,19 +368,33 @@ NativeContext& Dispatcher::getReusableContext() {
    assert(firstReusableContext != nullptr);
    assert(firstReusableContext->uctx == newlyCreatedContext);
    firstReusableContext->stackPtr = stackPointer;
+   ++reusableContextCount;
+   ++stackCount;
   }
 
   NativeContext* context = firstReusableContext;
   firstReusableContext = firstReusableContext->next;
+  --reusableContextCount;
   return *context;
 }
 
 void Dispatcher::pushReusableContext(NativeContext& context) {
   context.next = firstReusableContext;
   firstReusableContext = &context;
+  ++reusableContextCount;
   --runningContextCount;
 }
 
+DispatcherStackStatistics Dispatcher::getStackStatistics() const {
+  // Stacks are allocated on the heap, their resident size is not tracked
+  DispatcherStackStatistics statistics;
+  statistics.stackSize = stackSize;
+  statistics.stackCount = stackCount;
+  statistics.reusableStackCount = reusableContextCount;
+  statistics.residentBytes = stackCount * stackSize;
+  return statistics;
+}
+
 int Dispatcher::getTimer() {
   int timer;
   if (timers.empty()) {
@@ -52,9 +52,19 @@ struct OperationContext {
   bool interrupted;
 };
 
+struct DispatcherStackStatistics {
+  size_t stackSize;
+  size_t stackCount;
+  size_t reusableStackCount;
+  size_t residentBytes;
+};
+
 class Dispatcher {
 public:
+  static const size_t DEFAULT_STACK_SIZE = 512 * 1024;
+
   Dispatcher();
+  explicit Dispatcher(size_t stackSize);
   Dispatcher(const Dispatcher&) = delete;
   ~Dispatcher();
   Dispatcher& operator=(const Dispatcher&) = delete;
@@ -67,6 +77,7 @@ public:
   void pushContext(NativeContext* context);
   void remoteSpawn(std::function<void()>&& procedure);
   void yield();
+  DispatcherStackStatistics getStackStatistics() const;
 
   int getKqueue() const;
   NativeContext& getReusableContext();
@@ -96,7 +107,10 @@ private:
   NativeContext* firstResumingContext;
   NativeContext* lastResumingContext;
   NativeContext* firstReusableContext;
+  size_t reusableContextCount;
   size_t runningContextCount;
+  size_t stackSize;
+  size_t stackCount;
 
   void contextProcedure(void* uctx);
   static void contextProcedureStatic(intptr_t context);
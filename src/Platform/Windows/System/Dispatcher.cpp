@@ -36,11 +36,15 @@ struct DispatcherContext : public OVERLAPPED {
   NativeContext* context;
 };
 
+// Initially committed part of a fiber stack, the rest of the stack size is reserved and committed on demand
 const size_t STACK_SIZE = 16384;
-const size_t RESERVE_STACK_SIZE = 2097152;
+const size_t MIN_STACK_SIZE = 65536;
 }
 
-Dispatcher::Dispatcher() {
+Dispatcher::Dispatcher() : Dispatcher(DEFAULT_STACK_SIZE) {
+}
+
+Dispatcher::Dispatcher(size_t stackSize) : stackSize(stackSize < MIN_STACK_SIZE ? MIN_STACK_SIZE : stackSize), stackCount(0) {
   static_assert(sizeof(CRITICAL_SECTION) == sizeof(Dispatcher::criticalSection), "CRITICAL_SECTION size doesn't fit sizeof(Dispatcher::criticalSection)");
   BOOL result = InitializeCriticalSectionAndSpinCount(reinterpret_cast<LPCRITICAL_SECTION>(criticalSection), 4000);
   assert(result != FALSE);
@@ -74,6 +78,7 @@ Dispatcher::Dispatcher() {
         currentContext = &mainContext;
         firstResumingContext = nullptr;
         firstReusableContext = nullptr;
+        reusableContextCount = 0;
         runningContextCount = 0;
         return;
       }
@@ -106,8 +111,11 @@ Dispatcher::~Dispatcher() {
     void* fiber = firstReusableContext->fiber;
     firstReusableContext = firstReusableContext->next;
     DeleteFiber(fiber);
+    --stackCount;
   }
 
+  reusableContextCount = 0;
+
   int wsaResult = WSACleanup();
   assert(wsaResult == 0);
   BOOL result = CloseHandle(completionPort);
@@ -123,7 +131,10 @@ void Dispatcher::clear() {
     void* fiber = firstReusableContext->fiber;
     firstReusableContext = firstReusableContext->next;
     DeleteFiber(fiber);
+    --stackCount;
   }
+
+  reusableContextCount = 0;
 }
 
 void Dispatcher::dispatch() {
@@ -338,7 +349,7 @@ void* Dispatcher::getCompletionPort() const {
 
 NativeContext& Dispatcher::getReusableContext() {
   if (firstReusableContext == nullptr) {
-    void* fiber = CreateFiberEx(STACK_SIZE, RESERVE_STACK_SIZE, 0, contextProcedureStatic, this);
+    void* fiber = CreateFiberEx(STACK_SIZE, stackSize, 0, contextProcedureStatic, this);
     if (fiber == NULL) {
       throw std::runtime_error("Dispatcher::getReusableContext, CreateFiberEx failed, " + lastErrorMessage());
     }
@@ -346,19 +357,33 @@ NativeContext& Dispatcher::getReusableContext() {
     SwitchToFiber(fiber);
     assert(firstReusableContext != nullptr);
     firstReusableContext->fiber = fiber;
+    ++reusableContextCount;
+    ++stackCount;
   }
 
   NativeContext* context = firstReusableContext;
   firstReusableContext = context->next;
+  --reusableContextCount;
   return *context;
 }
 
 void Dispatcher::pushReusableContext(NativeContext& context) {
   context.next = firstReusableContext;
   firstReusableContext = &context;
+  ++reusableContextCount;
   --runningContextCount;
 }
 
+DispatcherStackStatistics Dispatcher::getStackStatistics() const {
+  // Only the initially committed part of each fiber stack is counted
+  DispatcherStackStatistics statistics;
+  statistics.stackSize = stackSize;
+  statistics.stackCount = stackCount;
+  statistics.reusableStackCount = reusableContextCount;
+  statistics.residentBytes = stackCount * STACK_SIZE;
+  return statistics;
+}
+
 void Dispatcher::interruptTimer(uint64_t time, NativeContext* context) {
   assert(GetCurrentThreadId() == threadId);
   if (context->inExecutionQueue) {
@@ -45,9 +45,19 @@ struct NativeContextGroup {
   NativeContext* lastWaiter;
 };
 
+struct DispatcherStackStatistics {
+  size_t stackSize;
+  size_t stackCount;
+  size_t reusableStackCount;
+  size_t residentBytes;
+};
+
 class Dispatcher {
 public:
+  static const size_t DEFAULT_STACK_SIZE = 2097152;
+
   Dispatcher();
+  explicit Dispatcher(size_t stackSize);
   Dispatcher(const Dispatcher&) = delete;
   ~Dispatcher();
   Dispatcher& operator=(const Dispatcher&) = delete;
@@ -60,6 +70,7 @@ public:
   void pushContext(NativeContext* context);
   void remoteSpawn(std::function<void()>&& procedure);
   void yield();
+  DispatcherStackStatistics getStackStatistics() const;
 
   // Platform-specific
   void addTimer(uint64_t time, NativeContext* context);
@@ -84,7 +95,10 @@ private:
   NativeContext* firstResumingContext;
   NativeContext* lastResumingContext;
   NativeContext* firstReusableContext;
+  size_t reusableContextCount;
   size_t runningContextCount;
+  size_t stackSize;
+  size_t stackCount;
 
   void contextProcedure();
   static void __stdcall contextProcedureStatic(void* context);
@@ -127,10 +127,12 @@ struct COMMAND_RPC_GET_POOL_CHANGES {
   struct request {
     Crypto::Hash tailBlockId;
     std::vector<Crypto::Hash> knownTxsIds;
+    std::string knownTxsSketch; // TransactionPoolSketch of the known transactions, replaces knownTxsIds when set
 
     void serialize(ISerializer &s) {
       KV_MEMBER(tailBlockId)
       serializeAsBinary(knownTxsIds, "knownTxsIds", s);
+      KV_MEMBER(knownTxsSketch)
     }
   };
 
@@ -138,12 +140,18 @@ struct COMMAND_RPC_GET_POOL_CHANGES {
     bool isTailBlockActual;
     std::vector<BinaryArray> addedTxs;          // Added transactions blobs
     std::vector<Crypto::Hash> deletedTxsIds; // IDs of not found transactions
+    bool knownTxsSketchSupported;
+    bool knownTxsSketchDecoded;               // when not, the request is repeated with knownTxsIds
+    std::vector<uint64_t> deletedTxsShortIds; // short IDs of not found transactions, when knownTxsSketch is set
     std::string status;
 
     void serialize(ISerializer &s) {
       KV_MEMBER(isTailBlockActual)
       KV_MEMBER(addedTxs)
       serializeAsBinary(deletedTxsIds, "deletedTxsIds", s);
+      KV_MEMBER(knownTxsSketchSupported)
+      KV_MEMBER(knownTxsSketchDecoded)
+      serializeAsBinary(deletedTxsShortIds, "deletedTxsShortIds", s);
       KV_MEMBER(status)
     }
   };
@@ -170,10 +178,12 @@ struct COMMAND_RPC_GET_POOL_CHANGES_LITE {
   struct request {
     Crypto::Hash tailBlockId;
     std::vector<Crypto::Hash> knownTxsIds;
+    std::string knownTxsSketch; // TransactionPoolSketch of the known transactions, replaces knownTxsIds when set
 
     void serialize(ISerializer &s) {
       KV_MEMBER(tailBlockId)
       serializeAsBinary(knownTxsIds, "knownTxsIds", s);
+      KV_MEMBER(knownTxsSketch)
     }
   };
 
@@ -181,12 +191,18 @@ struct COMMAND_RPC_GET_POOL_CHANGES_LITE {
     bool isTailBlockActual;
     std::vector<TransactionPrefixInfo> addedTxs;          // Added transactions blobs
     std::vector<Crypto::Hash> deletedTxsIds; // IDs of not found transactions
+    bool knownTxsSketchSupported;
+    bool knownTxsSketchDecoded;               // when not, the request is repeated with knownTxsIds
+    std::vector<uint64_t> deletedTxsShortIds; // short IDs of not found transactions, when knownTxsSketch is set
     std::string status;
 
     void serialize(ISerializer &s) {
       KV_MEMBER(isTailBlockActual)
       KV_MEMBER(addedTxs)
       serializeAsBinary(deletedTxsIds, "deletedTxsIds", s);
+      KV_MEMBER(knownTxsSketchSupported)
+      KV_MEMBER(knownTxsSketchDecoded)
+      serializeAsBinary(deletedTxsShortIds, "deletedTxsShortIds", s);
       KV_MEMBER(status)
     }
   };
@@ -325,6 +341,9 @@ struct COMMAND_RPC_GET_INFO {
     uint64_t last_block_reward;
     uint64_t last_block_timestamp;
     uint64_t last_block_difficulty;
+    uint64_t rpc_queued_requests;
+    uint64_t rpc_stack_count;
+    uint64_t rpc_stack_resident_bytes;
     std::vector<std::string> connections;
 
     void serialize(ISerializer &s) {
@@ -348,6 +367,9 @@ struct COMMAND_RPC_GET_INFO {
       KV_MEMBER(last_block_reward)
       KV_MEMBER(last_block_timestamp)
       KV_MEMBER(last_block_difficulty)
+      KV_MEMBER(rpc_queued_requests)
+      KV_MEMBER(rpc_stack_count)
+      KV_MEMBER(rpc_stack_resident_bytes)
       KV_MEMBER(connections)      
     }
   };
@@ -40,11 +40,10 @@ void HttpClient::request(const HttpRequest &req, HttpResponse &res) {
   }
 
   try {
-    std::iostream stream(m_streamBuf.get());
-    HttpParser parser;
+    std::ostream stream(m_streamBuf.get());
     stream << req;
     stream.flush();
-    parser.receiveResponse(stream, res);
+    m_parser->receiveResponse(m_connection, res);
   } catch (const std::exception &) {
     disconnect();
     throw;
@@ -56,6 +55,7 @@ void HttpClient::connect() {
     auto ipAddr = System::Ipv4Resolver(m_dispatcher).resolve(m_address);
     m_connection = System::TcpConnector(m_dispatcher).connect(ipAddr, m_port);
     m_streamBuf.reset(new System::TcpStreambuf(m_connection));
+    m_parser.reset(new HttpParser);
     m_connected = true;
   } catch (const std::exception& e) {
     throw ConnectException(e.what());
@@ -68,6 +68,7 @@ bool HttpClient::isConnected() const {
 
 void HttpClient::disconnect() {
   m_streamBuf.reset();
+  m_parser.reset();
   try {
     m_connection.write(nullptr, 0); //Socket shutdown.
   } catch (std::exception&) {
@@ -89,7 +89,7 @@ void HttpServer::acceptLoop() {
     logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
 
     System::TcpStreambuf streambuf(connection);
-    std::iostream stream(&streambuf);
+    std::ostream stream(&streambuf);
     HttpParser parser;
 
     for (;;) {
@@ -98,7 +98,10 @@ void HttpServer::acceptLoop() {
 	  resp.addHeader("Access-Control-Allow-Origin", "*");
 	  resp.addHeader("content-type", "application/json");
 	
-      parser.receiveRequest(stream, req);
+      if (!parser.receiveRequest(connection, req)) {
+        break;
+      }
+
 				if (authenticate(req)) {
 					processRequest(req, resp);
 				}
@@ -109,10 +112,6 @@ void HttpServer::acceptLoop() {
 
       stream << resp;
       stream.flush();
-
-      if (stream.peek() == std::iostream::traits_type::eof()) {
-        break;
-      }
     }
 
     logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
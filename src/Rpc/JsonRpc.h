@@ -68,31 +68,41 @@ public:
   
   JsonRpcRequest() : psReq(Common::JsonValue::OBJECT) {}
 
+  // Only the envelope is read here, params are kept as text and deserialized by loadParams
   bool parseRequest(const std::string& requestBody) {
     try {
-      psReq = Common::JsonValue::fromString(requestBody);
+      JsonInputStringSerializer serializer(requestBody);
+      Common::StringView text;
+      if (!serializer.rawValue(text, "method") || text[0] != '"') {
+        throw JsonRpcError(errInvalidRequest);
+      }
+
+      method.assign(text.getData() + 1, text.getSize() - 2);
+
+      if (serializer.rawValue(text, "id")) {
+        id = Common::JsonValue::fromString(std::string(text));
+      }
+
+      if (serializer.rawValue(text, "params")) {
+        params.assign(text.getData(), text.getSize());
+      }
+    } catch (JsonRpcError&) {
+      throw;
     } catch (std::exception&) {
       throw JsonRpcError(errParseError);
     }
 
-    if (!psReq.contains("method")) {
-      throw JsonRpcError(errInvalidRequest);
-    }
-
-    method = psReq("method").getString();
-
-    if (psReq.contains("id")) {
-      id = psReq("id");
-    }
-
     return true;
   }
 
   template <typename T>
   bool loadParams(T& v) const {
-    loadFromJsonValue(v, psReq.contains("params") ? 
-      psReq("params") : Common::JsonValue(Common::JsonValue::NIL));
-    return true;
+    if (params.empty()) {
+      loadFromJsonValue(v, Common::JsonValue(Common::JsonValue::NIL));
+      return true;
+    }
+
+    return loadFromJson(v, params);
   }
 
   template <typename T>
@@ -124,6 +134,7 @@ private:
   Common::JsonValue psReq;
   OptionalId id;
   std::string method;
+  std::string params;
 };
 
 
@@ -161,12 +172,16 @@ public:
 
   std::string getBody() {
     psResp.set("jsonrpc", std::string("2.0"));
-    return psResp.toString();
+    if (result.empty() || psResp.contains("error")) {
+      return psResp.toString();
+    }
+
+    return storeToJsonWithMember(psResp, "result", result);
   }
 
   template <typename T>
   bool setResult(const T& v) {
-    psResp.set("result", storeToJsonValue(v));
+    result = storeToJson(v);
     return true;
   }
 
@@ -182,6 +197,7 @@ public:
 
 private:
   Common::JsonValue psResp;
+  std::string result;
 };
 
 
@@ -31,6 +31,7 @@
 #include "CryptoNoteCore/IBlock.h"
 #include "CryptoNoteCore/Miner.h"
 #include "CryptoNoteCore/TransactionExtra.h"
+#include "CryptoNoteCore/TransactionPoolSketch.h"
 #include "CryptoNoteProtocol/ICryptoNoteProtocolQuery.h"
 
 #include "P2p/NetNode.h"
@@ -90,35 +91,54 @@ RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Comman
 std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>> RpcServer::s_handlers = {
 
   // binary handlers
-  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false } },
-  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false } },
-  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false } },
-  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false } },
-  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false } },
-  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false } },
-  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false } },
+  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false, true } },
+  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false, true } },
+  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false, true } },
+  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false, true } },
+  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false, true } },
+  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false, true } },
+  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false, true } },
 
   // json handlers
-  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true } },
-  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true } },
-  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false } },
-  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false } },
-  { "/feeaddress", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_address), true } },
-  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/paymentid", { jsonMethod<COMMAND_RPC_GEN_PAYMENT_ID>(&RpcServer::on_get_payment_id), true } },
+  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true, false } },
+  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true, false } },
+  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false, true } },
+  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false, false } },
+  { "/feeaddress", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_address), true, false } },
+  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false } },
+  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false } },
+  { "/paymentid", { jsonMethod<COMMAND_RPC_GEN_PAYMENT_ID>(&RpcServer::on_get_payment_id), true, false } },
 
   // disabled in restricted rpc mode
-  { "/start_mining", { jsonMethod<COMMAND_RPC_START_MINING>(&RpcServer::on_start_mining), false } },
-  { "/stop_mining", { jsonMethod<COMMAND_RPC_STOP_MINING>(&RpcServer::on_stop_mining), false } },
-  { "/stop_daemon", { jsonMethod<COMMAND_RPC_STOP_DAEMON>(&RpcServer::on_stop_daemon), true } },
+  { "/start_mining", { jsonMethod<COMMAND_RPC_START_MINING>(&RpcServer::on_start_mining), false, false } },
+  { "/stop_mining", { jsonMethod<COMMAND_RPC_STOP_MINING>(&RpcServer::on_stop_mining), false, false } },
+  { "/stop_daemon", { jsonMethod<COMMAND_RPC_STOP_DAEMON>(&RpcServer::on_stop_daemon), true, false } },
 
   // json rpc
-  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true } }
+  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true, false } }
 };
 
 RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery) :
-  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery) {
+  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery),
+  m_workers(dispatcher, log) {
+}
+
+void RpcServer::setWorkerThreads(size_t threadCount, size_t methodConcurrency) {
+  m_workers.setThreads(threadCount, methodConcurrency);
+}
+
+size_t RpcServer::getQueuedRequestsCount() const {
+  return m_workers.getQueuedRequestsCount();
+}
+
+// Runs on the dispatcher, the handler itself runs on a thread of its own while other contexts continue
+void RpcServer::execute(const std::string& method, bool runOnWorker, const std::function<void()>& handler) {
+  if (!runOnWorker) {
+    handler();
+    return;
+  }
+
+  m_workers.execute(method, handler);
 }
 
 void RpcServer::processRequest(const HttpRequest& request, HttpResponse& response) {
@@ -136,7 +156,8 @@ void RpcServer::processRequest(const HttpRequest& request, HttpResponse& respons
     return;
   }
 
-  it->second.handler(this, request, response);
+  const RpcHandler<HandlerFunction>& rpcHandler = it->second;
+  execute(url, rpcHandler.runOnWorker, [&] { rpcHandler.handler(this, request, response); });
 }
 
 bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse& response) {
@@ -157,21 +178,21 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
     jsonResponse.setId(jsonRequest.getId()); // copy id
 
     static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod>> jsonRpcHandlers = {
-        {"getaltblockslist", {makeMemberMethod(&RpcServer::on_alt_blocks_list_json), true}},
-        {"f_blocks_list_json", {makeMemberMethod(&RpcServer::f_on_blocks_list_json), false}},
-        {"f_block_json", {makeMemberMethod(&RpcServer::f_on_block_json), false}},
-        {"f_transaction_json", {makeMemberMethod(&RpcServer::f_on_transaction_json), false}},
-        {"f_on_transactions_pool_json", {makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false}},
-        {"check_tx_proof", {makeMemberMethod(&RpcServer::k_on_check_tx_proof), false}},
-        {"check_reserve_proof", {makeMemberMethod(&RpcServer::k_on_check_reserve_proof), false}},
-        {"getblockcount", {makeMemberMethod(&RpcServer::on_getblockcount), true}},
-        {"on_getblockhash", {makeMemberMethod(&RpcServer::on_getblockhash), false}},
-        {"getblocktemplate", {makeMemberMethod(&RpcServer::on_getblocktemplate), false}},
-        {"getcurrencyid", {makeMemberMethod(&RpcServer::on_get_currency_id), true}},
-        {"submitblock", {makeMemberMethod(&RpcServer::on_submitblock), false}},
-        {"getlastblockheader", {makeMemberMethod(&RpcServer::on_get_last_block_header), false}},
-        {"getblockheaderbyhash", {makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false}},
-        {"getblockheaderbyheight", {makeMemberMethod(&RpcServer::on_get_block_header_by_height), false}}};
+        {"getaltblockslist", {makeMemberMethod(&RpcServer::on_alt_blocks_list_json), true, true}},
+        {"f_blocks_list_json", {makeMemberMethod(&RpcServer::f_on_blocks_list_json), false, true}},
+        {"f_block_json", {makeMemberMethod(&RpcServer::f_on_block_json), false, true}},
+        {"f_transaction_json", {makeMemberMethod(&RpcServer::f_on_transaction_json), false, true}},
+        {"f_on_transactions_pool_json", {makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false, true}},
+        {"check_tx_proof", {makeMemberMethod(&RpcServer::k_on_check_tx_proof), false, true}},
+        {"check_reserve_proof", {makeMemberMethod(&RpcServer::k_on_check_reserve_proof), false, true}},
+        {"getblockcount", {makeMemberMethod(&RpcServer::on_getblockcount), true, false}},
+        {"on_getblockhash", {makeMemberMethod(&RpcServer::on_getblockhash), false, true}},
+        {"getblocktemplate", {makeMemberMethod(&RpcServer::on_getblocktemplate), false, false}},
+        {"getcurrencyid", {makeMemberMethod(&RpcServer::on_get_currency_id), true, false}},
+        {"submitblock", {makeMemberMethod(&RpcServer::on_submitblock), false, false}},
+        {"getlastblockheader", {makeMemberMethod(&RpcServer::on_get_last_block_header), false, true}},
+        {"getblockheaderbyhash", {makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false, true}},
+        {"getblockheaderbyheight", {makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, true}}};
 
     auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
     if (it == jsonRpcHandlers.end()) {
@@ -182,7 +203,8 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
     }
 
-    it->second.handler(this, jsonRequest, jsonResponse);
+    const RpcHandler<JsonMemberMethod>& rpcHandler = it->second;
+    execute(jsonRequest.getMethod(), rpcHandler.runOnWorker, [&] { rpcHandler.handler(this, jsonRequest, jsonResponse); });
 
   } catch (const JsonRpcError& err) {
     jsonResponse.setError(err);
@@ -190,8 +212,9 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
     jsonResponse.setError(JsonRpcError(JsonRpc::errInternalError, e.what()));
   }
 
-  response.setBody(jsonResponse.getBody());
-  logger(TRACE) << "JSON-RPC response: " << jsonResponse.getBody();
+  std::string body = jsonResponse.getBody();
+  logger(TRACE) << "JSON-RPC response: " << body;
+  response.setBody(std::move(body));
   return true;
 }
 
@@ -591,7 +614,18 @@ bool RpcServer::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOU
 bool RpcServer::onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& rsp) {
   rsp.status = CORE_RPC_STATUS_OK;
   std::vector<CryptoNote::Transaction> addedTransactions;
-  rsp.isTailBlockActual = m_core.getPoolChanges(req.tailBlockId, req.knownTxsIds, addedTransactions, rsp.deletedTxsIds);
+  rsp.knownTxsSketchSupported = true;
+  if (!req.knownTxsSketch.empty()) {
+    if (!getPoolChangesBySketch(req.knownTxsSketch, addedTransactions, rsp.deletedTxsShortIds, rsp.knownTxsSketchDecoded)) {
+      rsp.status = "Invalid known transactions sketch";
+      return true;
+    }
+
+    rsp.isTailBlockActual = req.tailBlockId == m_core.get_tail_id();
+  } else {
+    rsp.isTailBlockActual = m_core.getPoolChanges(req.tailBlockId, req.knownTxsIds, addedTransactions, rsp.deletedTxsIds);
+  }
+
   for (auto& tx : addedTransactions) {
     BinaryArray txBlob;
     if (!toBinaryArray(tx, txBlob)) {
@@ -607,7 +641,40 @@ bool RpcServer::onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& re
 
 bool RpcServer::onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::request& req, COMMAND_RPC_GET_POOL_CHANGES_LITE::response& rsp) {
   rsp.status = CORE_RPC_STATUS_OK;
-  rsp.isTailBlockActual = m_core.getPoolChangesLite(req.tailBlockId, req.knownTxsIds, rsp.addedTxs, rsp.deletedTxsIds);
+  rsp.knownTxsSketchSupported = true;
+  if (req.knownTxsSketch.empty()) {
+    rsp.isTailBlockActual = m_core.getPoolChangesLite(req.tailBlockId, req.knownTxsIds, rsp.addedTxs, rsp.deletedTxsIds);
+    return true;
+  }
+
+  std::vector<CryptoNote::Transaction> addedTransactions;
+  if (!getPoolChangesBySketch(req.knownTxsSketch, addedTransactions, rsp.deletedTxsShortIds, rsp.knownTxsSketchDecoded)) {
+    rsp.status = "Invalid known transactions sketch";
+    return true;
+  }
+
+  rsp.isTailBlockActual = req.tailBlockId == m_core.get_tail_id();
+  for (const auto& tx : addedTransactions) {
+    TransactionPrefixInfo tpi;
+    tpi.txPrefix = tx;
+    tpi.txHash = getObjectHash(tx);
+    rsp.addedTxs.push_back(std::move(tpi));
+  }
+
+  return true;
+}
+
+bool RpcServer::getPoolChangesBySketch(const std::string& knownTxsSketch, std::vector<Transaction>& addedTxs, std::vector<uint64_t>& deletedTxsShortIds, bool& decoded) {
+  TransactionPoolSketch sketch;
+  if (!sketch.fromString(knownTxsSketch) || sketch.cellCount() > TX_POOL_SKETCH_MAX_CELLS) {
+    return false;
+  }
+
+  decoded = m_core.getPoolChanges(sketch, addedTxs, deletedTxsShortIds);
+  if (!decoded) {
+    addedTxs.clear();
+    deletedTxsShortIds.clear();
+  }
 
   return true;
 }
@@ -675,6 +742,10 @@ bool RpcServer::on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RP
   res.last_block_reward = block_header.reward;
   m_core.getBlockDifficulty(static_cast<uint32_t>(last_block_height), res.last_block_difficulty);
 
+  res.rpc_queued_requests = getQueuedRequestsCount();
+  System::DispatcherStackStatistics stackStatistics = m_dispatcher.getStackStatistics();
+  res.rpc_stack_count = stackStatistics.stackCount;
+  res.rpc_stack_resident_bytes = stackStatistics.residentBytes;
   res.connections = m_p2p.get_payload_object().all_connections();
   return true;
 }
@@ -23,6 +23,7 @@
 #include <Logging/LoggerRef.h>
 #include "Common/Math.h"
 #include "CoreRpcServerCommandsDefinitions.h"
+#include "RpcWorkers.h"
 
 namespace CryptoNote {
 
@@ -40,6 +41,10 @@ public:
   bool k_on_check_tx_proof(const K_COMMAND_RPC_CHECK_TX_PROOF::request& req, K_COMMAND_RPC_CHECK_TX_PROOF::response& res);
   bool k_on_check_reserve_proof(const K_COMMAND_RPC_CHECK_RESERVE_PROOF::request& req, K_COMMAND_RPC_CHECK_RESERVE_PROOF::response& res);  
   bool enableCors(const std::string domain);  
+  // Requests to read only methods run on up to threadCount threads, at most methodConcurrency (0 - no limit) of them per method
+  void setWorkerThreads(size_t threadCount, size_t methodConcurrency);
+  // Number of requests waiting for a worker thread
+  size_t getQueuedRequestsCount() const;
   bool remotenode_check_incoming_tx(const BinaryArray& tx_blob);
 
 private:
@@ -48,6 +53,8 @@ private:
   struct RpcHandler {
     const Handler handler;
     const bool allowBusyCore;
+    // the handler only queries the core and may run outside of the dispatcher thread
+    const bool runOnWorker;
   };
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
@@ -56,6 +63,7 @@ private:
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) override;
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
   bool isCoreReady();
+  void execute(const std::string& method, bool runOnWorker, const std::function<void()>& handler);
 
   // binary handlers
   bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
@@ -65,6 +73,7 @@ private:
   bool on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
   bool onGetPoolChanges(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& rsp);
   bool onGetPoolChangesLite(const COMMAND_RPC_GET_POOL_CHANGES_LITE::request& req, COMMAND_RPC_GET_POOL_CHANGES_LITE::response& rsp);
+  bool getPoolChangesBySketch(const std::string& knownTxsSketch, std::vector<Transaction>& addedTxs, std::vector<uint64_t>& deletedTxsShortIds, bool& decoded);
 
   // json handlers
   bool on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res);
@@ -106,6 +115,8 @@ private:
   std::string m_fee_address;
   Crypto::SecretKey m_view_key = NULL_SECRET_KEY;
   AccountPublicAddress m_fee_acc; 
+
+  RpcWorkers m_workers;
 };
 
 }
@@ -28,10 +28,12 @@ namespace CryptoNote {
 
     const command_line::arg_descriptor<std::string> arg_rpc_bind_ip = { "rpc-bind-ip", "", DEFAULT_RPC_IP };
     const command_line::arg_descriptor<uint16_t> arg_rpc_bind_port = { "rpc-bind-port", "", DEFAULT_RPC_PORT };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_threads = { "rpc-threads", "Number of threads running read only RPC requests, 0 runs them on the network thread", 0 };
+    const command_line::arg_descriptor<uint32_t> arg_rpc_method_concurrency = { "rpc-method-concurrency", "Maximum number of concurrent requests to one RPC method, 0 - no limit besides rpc-threads", 0 };
   }
 
 
-  RpcServerConfig::RpcServerConfig() : bindIp(DEFAULT_RPC_IP), bindPort(DEFAULT_RPC_PORT) {
+  RpcServerConfig::RpcServerConfig() : bindIp(DEFAULT_RPC_IP), bindPort(DEFAULT_RPC_PORT), workerThreads(0), methodConcurrency(0) {
   }
 
   std::string RpcServerConfig::getBindAddress() const {
@@ -41,11 +43,15 @@ namespace CryptoNote {
   void RpcServerConfig::initOptions(boost::program_options::options_description& desc) {
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_method_concurrency);
   }
 
   void RpcServerConfig::init(const boost::program_options::variables_map& vm)  {
     bindIp = command_line::get_arg(vm, arg_rpc_bind_ip);
     bindPort = command_line::get_arg(vm, arg_rpc_bind_port);
+    workerThreads = command_line::get_arg(vm, arg_rpc_threads);
+    methodConcurrency = command_line::get_arg(vm, arg_rpc_method_concurrency);
   }
 
 }
@@ -33,6 +33,10 @@ public:
 
   std::string bindIp;
   uint16_t bindPort;
+  // 0 runs every request on the dispatcher
+  size_t workerThreads;
+  // 0 lets one method use all worker threads
+  size_t methodConcurrency;
 };
 
 }
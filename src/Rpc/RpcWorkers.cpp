@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "RpcWorkers.h"
+
+#include <boost/scope_exit.hpp>
+#include <System/RemoteContext.h>
+
+using namespace Logging;
+
+namespace CryptoNote {
+
+RpcWorkers::RpcWorkers(System::Dispatcher& dispatcher, Logging::ILogger& log) :
+  m_dispatcher(dispatcher), logger(log, "RpcWorkers"), m_threads(0), m_methodConcurrency(0), m_activeRequests(0),
+  m_queuedRequests(0), m_workerReleased(dispatcher) {
+}
+
+void RpcWorkers::setThreads(size_t threadCount, size_t methodConcurrency) {
+  m_threads = threadCount;
+  m_methodConcurrency = methodConcurrency == 0 ? threadCount : methodConcurrency;
+}
+
+size_t RpcWorkers::getThreads() const {
+  return m_threads;
+}
+
+void RpcWorkers::execute(const std::string& method, const std::function<void()>& handler) {
+  if (m_threads == 0) {
+    handler();
+    return;
+  }
+
+  size_t& methodRequests = m_activeRequestsByMethod[method];
+  {
+    ++m_queuedRequests;
+    BOOST_SCOPE_EXIT_ALL(this) { --m_queuedRequests; };
+    while (m_activeRequests >= m_threads || methodRequests >= m_methodConcurrency) {
+      logger(TRACE) << "Request to " << method << " is waiting for a worker, " << m_queuedRequests << " request(s) queued";
+      m_workerReleased.clear();
+      m_workerReleased.wait();
+    }
+  }
+
+  ++m_activeRequests;
+  ++methodRequests;
+  BOOST_SCOPE_EXIT_ALL(this, &methodRequests) {
+    --m_activeRequests;
+    --methodRequests;
+    m_workerReleased.set();
+  };
+
+  System::RemoteContext<void> context(m_dispatcher, std::function<void()>(handler));
+  context.get();
+}
+
+size_t RpcWorkers::getActiveRequestsCount() const {
+  return m_activeRequests;
+}
+
+size_t RpcWorkers::getQueuedRequestsCount() const {
+  return m_queuedRequests;
+}
+
+}
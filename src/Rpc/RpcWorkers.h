@@ -0,0 +1,57 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <Logging/LoggerRef.h>
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+
+namespace CryptoNote {
+
+// Runs RPC handlers on threads of their own, at most threadCount at a time and at most methodConcurrency
+// of them per method. Requests over a limit wait on the dispatcher without blocking it.
+// All methods are called on the dispatcher thread.
+class RpcWorkers {
+public:
+  RpcWorkers(System::Dispatcher& dispatcher, Logging::ILogger& log);
+
+  // methodConcurrency 0 - no limit other than threadCount, threadCount 0 - handlers run inline
+  void setThreads(size_t threadCount, size_t methodConcurrency);
+  size_t getThreads() const;
+
+  // Returns once the handler is done, rethrows what it throws
+  void execute(const std::string& method, const std::function<void()>& handler);
+
+  // Requests running on a thread
+  size_t getActiveRequestsCount() const;
+  // Requests waiting for a thread
+  size_t getQueuedRequestsCount() const;
+
+private:
+  System::Dispatcher& m_dispatcher;
+  Logging::LoggerRef logger;
+  size_t m_threads;
+  size_t m_methodConcurrency;
+  size_t m_activeRequests;
+  size_t m_queuedRequests;
+  std::unordered_map<std::string, size_t> m_activeRequestsByMethod;
+  System::Event m_workerReleased;
+};
+
+}
@@ -0,0 +1,582 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "JsonInputStringSerializer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "Common/StringTools.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+// Nesting limit for the validating pass, deeper documents are rejected instead of exhausting the stack
+const size_t MAX_DEPTH = 128;
+
+void throwParseError() {
+  throw std::runtime_error("Unable to parse");
+}
+
+bool isSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+const char* skipSpaces(const char* p, const char* end) {
+  while (p != end && isSpace(*p)) {
+    ++p;
+  }
+
+  return p;
+}
+
+void expect(const char* p, const char* end, char c) {
+  if (p == end || *p != c) {
+    throwParseError();
+  }
+}
+
+// Returns the position after the closing quote of a string starting at 'p', or nullptr if it is not terminated.
+// Escape sequences are kept as is, the same way JsonValue does, so a quote only needs an even number of backslashes before it.
+const char* findStringEnd(const char* p, const char* end) {
+  for (;;) {
+    const char* quote = static_cast<const char*>(memchr(p, '"', end - p));
+    if (quote == nullptr) {
+      return nullptr;
+    }
+
+    // the opening quote stops the scan
+    const char* escape = quote;
+    while (escape[-1] == '\\') {
+      --escape;
+    }
+
+    if (((quote - escape) & 1) == 0) {
+      return quote + 1;
+    }
+
+    p = quote + 1;
+  }
+}
+
+const char* validateString(const char* p, const char* end) {
+  p = findStringEnd(p, end);
+  if (p == nullptr) {
+    throwParseError();
+  }
+
+  return p;
+}
+
+const char* validateLiteral(const char* p, const char* end, const char* literal) {
+  for (; *literal != '\0'; ++p, ++literal) {
+    if (p == end || *p != *literal) {
+      throwParseError();
+    }
+  }
+
+  return p;
+}
+
+const char* validateNumber(const char* p, const char* end) {
+  if (*p == '-') {
+    ++p;
+  }
+
+  if (p == end || !isDigit(*p)) {
+    throwParseError();
+  }
+
+  if (*p == '0') {
+    ++p;
+    if (p != end && isDigit(*p)) {
+      throwParseError();
+    }
+  } else {
+    while (p != end && isDigit(*p)) {
+      ++p;
+    }
+  }
+
+  if (p != end && *p == '.') {
+    ++p;
+    while (p != end && isDigit(*p)) {
+      ++p;
+    }
+  }
+
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    if (p != end && (*p == '+' || *p == '-')) {
+      ++p;
+    }
+
+    if (p == end || !isDigit(*p)) {
+      throwParseError();
+    }
+
+    while (p != end && isDigit(*p)) {
+      ++p;
+    }
+  }
+
+  return p;
+}
+
+// Keys of the objects being validated and the objects found to repeat a key, by position of their opening brace
+struct Validation {
+  std::vector<Common::StringView> keys;
+  std::vector<const char*> duplicateKeyObjects;
+};
+
+const char* validateValue(const char* p, const char* end, size_t depth, Validation& validation) {
+  p = skipSpaces(p, end);
+  if (p == end) {
+    throwParseError();
+  }
+
+  switch (*p) {
+  case '{':
+  case '[': {
+    if (depth == MAX_DEPTH) {
+      throwParseError();
+    }
+
+    const char* open = p;
+    char close = *p == '{' ? '}' : ']';
+    p = skipSpaces(p + 1, end);
+    if (p != end && *p == close) {
+      return p + 1;
+    }
+
+    size_t firstKey = validation.keys.size();
+    for (;;) {
+      if (close == '}') {
+        expect(p, end, '"');
+        const char* keyEnd = validateString(p + 1, end);
+        validation.keys.emplace_back(p + 1, keyEnd - p - 2);
+        p = skipSpaces(keyEnd, end);
+        expect(p, end, ':');
+        ++p;
+      }
+
+      p = skipSpaces(validateValue(p, end, depth + 1, validation), end);
+      if (p != end && *p == close) {
+        if (validation.keys.size() - firstKey > 1) {
+          auto keys = validation.keys.begin() + firstKey;
+          std::sort(keys, validation.keys.end());
+          if (std::adjacent_find(keys, validation.keys.end()) != validation.keys.end()) {
+            validation.duplicateKeyObjects.push_back(open);
+          }
+        }
+
+        validation.keys.resize(firstKey);
+        return p + 1;
+      }
+
+      expect(p, end, ',');
+      p = skipSpaces(p + 1, end);
+    }
+  }
+
+  case '"':
+    return validateString(p + 1, end);
+  case 't':
+    return validateLiteral(p, end, "true");
+  case 'f':
+    return validateLiteral(p, end, "false");
+  case 'n':
+    return validateLiteral(p, end, "null");
+  default:
+    if (*p == '-' || isDigit(*p)) {
+      return validateNumber(p, end);
+    }
+
+    throwParseError();
+    return p;
+  }
+}
+
+// The functions below only run over validated text, where every value is followed by a delimiter
+const char* skipSpaces(const char* p) {
+  while (isSpace(*p)) {
+    ++p;
+  }
+
+  return p;
+}
+
+const char* skipValue(const char* p, const char* end) {
+  if (*p == '"') {
+    return findStringEnd(p + 1, end);
+  }
+
+  if (*p == '{' || *p == '[') {
+    size_t depth = 0;
+    for (;;) {
+      char c = *p++;
+      if (c == '"') {
+        p = findStringEnd(p, end);
+      } else if (c == '{' || c == '[') {
+        ++depth;
+      } else if ((c == '}' || c == ']') && --depth == 0) {
+        return p;
+      }
+    }
+  }
+
+  while (*p != ',' && *p != '}' && *p != ']' && !isSpace(*p)) {
+    ++p;
+  }
+
+  return p;
+}
+
+// Moves 'p' past the next member of an object, returns false at the end of the object
+bool nextMember(const char*& p, const char* end, Common::StringView& key, const char*& value) {
+  p = skipSpaces(p);
+  if (*p == '}') {
+    return false;
+  }
+
+  const char* keyEnd = findStringEnd(p + 1, end);
+  key = Common::StringView(p + 1, keyEnd - p - 2);
+  value = skipSpaces(skipSpaces(keyEnd) + 1);
+  p = skipSpaces(skipValue(value, end));
+  if (*p == ',') {
+    ++p;
+  }
+
+  return true;
+}
+
+uint8_t hexValue(const char* p) {
+  return Common::fromHex(p[0]) << 4 | Common::fromHex(p[1]);
+}
+
+}
+
+JsonInputStringSerializer::JsonInputStringSerializer(Common::StringView json) : end(json.getData() + json.getSize()) {
+  const char* begin = skipSpaces(json.getData(), end);
+  Validation validation;
+  if (skipSpaces(validateValue(begin, end, 0, validation), end) != end) {
+    throwParseError();
+  }
+
+  if (*begin != '{') {
+    throw std::runtime_error("Serializer doesn't support this type of serialization: Object expected.");
+  }
+
+  // inner objects are closed before the objects holding them, the list is sorted for the lookups
+  duplicateKeyObjects = std::move(validation.duplicateKeyObjects);
+  std::sort(duplicateKeyObjects.begin(), duplicateKeyObjects.end());
+  scopes.push_back({ begin + 1, begin + 1, false, hasDuplicateKeys(begin) });
+}
+
+JsonInputStringSerializer::~JsonInputStringSerializer() {
+}
+
+ISerializer::SerializerType JsonInputStringSerializer::type() const {
+  return ISerializer::INPUT;
+}
+
+bool JsonInputStringSerializer::beginObject(Common::StringView name) {
+  const char* value = findValue(name);
+  if (value == nullptr) {
+    return false;
+  }
+
+  if (*value != '{') {
+    throw std::runtime_error("JsonInputStringSerializer: object expected");
+  }
+
+  scopes.push_back({ value + 1, value + 1, false, hasDuplicateKeys(value) });
+  return true;
+}
+
+void JsonInputStringSerializer::endObject() {
+  assert(!scopes.empty());
+  scopes.pop_back();
+}
+
+bool JsonInputStringSerializer::beginArray(size_t& size, Common::StringView name) {
+  const char* value = findValue(name);
+  if (value == nullptr) {
+    size = 0;
+    return false;
+  }
+
+  if (*value != '[') {
+    throw std::runtime_error("JsonInputStringSerializer: array expected");
+  }
+
+  size = 0;
+  const char* p = skipSpaces(value + 1);
+  while (*p != ']') {
+    ++size;
+    p = skipSpaces(skipValue(p, end));
+    if (*p == ',') {
+      p = skipSpaces(p + 1);
+    }
+  }
+
+  scopes.push_back({ value + 1, value + 1, true, false });
+  return true;
+}
+
+void JsonInputStringSerializer::endArray() {
+  assert(!scopes.empty());
+  scopes.pop_back();
+}
+
+bool JsonInputStringSerializer::operator()(uint16_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(int16_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(uint32_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(int32_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(int64_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(uint64_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(uint8_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStringSerializer::operator()(double& value, Common::StringView name) {
+  Common::StringView text;
+  if (!rawValue(text, name)) {
+    return false;
+  }
+
+  if (text.isEmpty() || (text[0] != '-' && !isDigit(text[0]))) {
+    throw std::runtime_error("JsonInputStringSerializer: number expected");
+  }
+
+  std::istringstream stream{ std::string(text) };
+  stream >> value;
+  return true;
+}
+
+bool JsonInputStringSerializer::operator()(std::string& value, Common::StringView name) {
+  Common::StringView text;
+  if (!readString(text, name)) {
+    return false;
+  }
+
+  value.assign(text.getData(), text.getSize());
+  return true;
+}
+
+bool JsonInputStringSerializer::operator()(bool& value, Common::StringView name) {
+  const char* p = findValue(name);
+  if (p == nullptr) {
+    return false;
+  }
+
+  if (*p != 't' && *p != 'f') {
+    throw std::runtime_error("JsonInputStringSerializer: bool expected");
+  }
+
+  value = *p == 't';
+  return true;
+}
+
+bool JsonInputStringSerializer::binary(void* value, size_t size, Common::StringView name) {
+  Common::StringView text;
+  if (!readString(text, name)) {
+    return false;
+  }
+
+  if ((text.getSize() & 1) != 0) {
+    throw std::runtime_error("fromHex: invalid string size");
+  }
+
+  if (text.getSize() >> 1 > size) {
+    throw std::runtime_error("fromHex: invalid buffer size");
+  }
+
+  for (size_t i = 0; i < text.getSize() >> 1; ++i) {
+    static_cast<uint8_t*>(value)[i] = hexValue(text.getData() + (i << 1));
+  }
+
+  return true;
+}
+
+bool JsonInputStringSerializer::binary(std::string& value, Common::StringView name) {
+  Common::StringView text;
+  if (!readString(text, name)) {
+    return false;
+  }
+
+  if ((text.getSize() & 1) != 0) {
+    throw std::runtime_error("fromHex: invalid string size");
+  }
+
+  value.resize(text.getSize() >> 1);
+  for (size_t i = 0; i < value.size(); ++i) {
+    value[i] = static_cast<char>(hexValue(text.getData() + (i << 1)));
+  }
+
+  return true;
+}
+
+bool JsonInputStringSerializer::rawValue(Common::StringView& value, Common::StringView name) {
+  const char* p = findValue(name);
+  if (p == nullptr) {
+    return false;
+  }
+
+  value = Common::StringView(p, skipValue(p, end) - p);
+  return true;
+}
+
+// Returns the start of the member value, or nullptr if an object has no such member.
+// Array elements are returned in order and the name is ignored.
+const char* JsonInputStringSerializer::findValue(Common::StringView name) {
+  assert(!scopes.empty());
+  Scope& scope = scopes.back();
+  if (scope.array) {
+    const char* p = skipSpaces(scope.cursor);
+    if (*p == ']') {
+      throw std::runtime_error("JsonInputStringSerializer: array index out of range");
+    }
+
+    scope.cursor = skipSpaces(skipValue(p, end));
+    if (*scope.cursor == ',') {
+      ++scope.cursor;
+    }
+
+    return p;
+  }
+
+  // JsonValue keeps the last of repeated members, such objects are searched to the end
+  if (scope.duplicateKeys) {
+    const char* p = scope.begin;
+    const char* found = nullptr;
+    Common::StringView key;
+    const char* value;
+    while (nextMember(p, end, key, value)) {
+      if (key == name) {
+        found = value;
+      }
+    }
+
+    return found;
+  }
+
+  const char* start = scope.cursor;
+  const char* p = start;
+  bool wrapped = false;
+  for (;;) {
+    if (wrapped && p == start) {
+      return nullptr;
+    }
+
+    Common::StringView key;
+    const char* value;
+    if (!nextMember(p, end, key, value)) {
+      if (wrapped || start == scope.begin) {
+        return nullptr;
+      }
+
+      p = scope.begin;
+      wrapped = true;
+      continue;
+    }
+
+    if (key == name) {
+      scope.cursor = p;
+      return value;
+    }
+  }
+}
+
+bool JsonInputStringSerializer::hasDuplicateKeys(const char* object) const {
+  return std::binary_search(duplicateKeyObjects.begin(), duplicateKeyObjects.end(), object);
+}
+
+bool JsonInputStringSerializer::readInteger(int64_t& value, Common::StringView name) {
+  const char* p = findValue(name);
+  if (p == nullptr) {
+    return false;
+  }
+
+  bool negative = *p == '-';
+  if (negative) {
+    ++p;
+  }
+
+  if (!isDigit(*p)) {
+    throw std::runtime_error("JsonInputStringSerializer: integer expected");
+  }
+
+  uint64_t magnitude = 0;
+  for (; isDigit(*p); ++p) {
+    uint64_t digit = static_cast<uint64_t>(*p - '0');
+    if (magnitude > (UINT64_MAX - digit) / 10) {
+      throw std::runtime_error("JsonInputStringSerializer: integer is too large");
+    }
+
+    magnitude = magnitude * 10 + digit;
+  }
+
+  if (*p == '.' || *p == 'e' || *p == 'E') {
+    throw std::runtime_error("JsonInputStringSerializer: integer expected");
+  }
+
+  // values above INT64_MAX keep their bits, so they come back intact when assigned to an unsigned field
+  value = static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+  return true;
+}
+
+bool JsonInputStringSerializer::readString(Common::StringView& value, Common::StringView name) {
+  const char* p = findValue(name);
+  if (p == nullptr) {
+    return false;
+  }
+
+  if (*p != '"') {
+    throw std::runtime_error("JsonInputStringSerializer: string expected");
+  }
+
+  const char* stringEnd = findStringEnd(p + 1, end);
+  value = Common::StringView(p + 1, stringEnd - p - 2);
+  return true;
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <vector>
+#include "ISerializer.h"
+
+namespace CryptoNote {
+
+//deserialization
+// Reads fields straight from JSON text without building a JsonValue tree.
+// The text is validated once on construction, after that members are looked up lazily,
+// starting after the previously read member, so fields requested in document order are found in one pass.
+// As with JsonValue, the last of repeated members is read.
+// The text is not copied and has to outlive the serializer.
+class JsonInputStringSerializer : public ISerializer {
+public:
+  explicit JsonInputStringSerializer(Common::StringView json);
+  virtual ~JsonInputStringSerializer();
+
+  SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(size_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
+  virtual bool binary(void* value, size_t size, Common::StringView name) override;
+  virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+  // Assigns the unparsed JSON text of a member to 'value', for members that are handled by other means
+  bool rawValue(Common::StringView& value, Common::StringView name);
+
+private:
+  struct Scope {
+    const char* begin;
+    const char* cursor;
+    bool array;
+    bool duplicateKeys;
+  };
+
+  const char* end;
+  std::vector<Scope> scopes;
+  // opening braces of the objects that repeat a member name, sorted
+  std::vector<const char*> duplicateKeyObjects;
+
+  const char* findValue(Common::StringView name);
+  bool hasDuplicateKeys(const char* object) const;
+  bool readInteger(int64_t& value, Common::StringView name);
+  bool readString(Common::StringView& value, Common::StringView name);
+
+  template <typename T>
+  bool getNumber(Common::StringView name, T& v) {
+    int64_t value;
+    if (!readInteger(value, name)) {
+      return false;
+    }
+
+    v = static_cast<T>(value);
+    return true;
+  }
+};
+
+}
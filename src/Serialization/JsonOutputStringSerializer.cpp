@@ -0,0 +1,236 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "JsonOutputStringSerializer.h"
+#include <cassert>
+#include <cstdio>
+
+using namespace CryptoNote;
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+}
+
+JsonOutputStringSerializer::JsonOutputStringSerializer(std::string& output) : output(output) {
+}
+
+JsonOutputStringSerializer::~JsonOutputStringSerializer() {
+}
+
+ISerializer::SerializerType JsonOutputStringSerializer::type() const {
+  return ISerializer::OUTPUT;
+}
+
+bool JsonOutputStringSerializer::beginObject(Common::StringView name) {
+  writeName(name);
+  output += '{';
+  scopes.push_back({ false, true, false });
+  return true;
+}
+
+void JsonOutputStringSerializer::endObject() {
+  assert(!scopes.empty() && !scopes.back().array);
+  scopes.pop_back();
+  output += '}';
+}
+
+bool JsonOutputStringSerializer::beginArray(size_t& size, Common::StringView name) {
+  writeName(name);
+  output += '[';
+  scopes.push_back({ true, true, false });
+  return true;
+}
+
+void JsonOutputStringSerializer::endArray() {
+  assert(!scopes.empty() && scopes.back().array);
+  scopes.pop_back();
+  output += ']';
+}
+
+// Unsigned values are written as signed ones, the same way JsonOutputStreamSerializer stores them in a JsonValue
+bool JsonOutputStringSerializer::operator()(uint64_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(static_cast<int64_t>(value));
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(uint16_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(value);
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(int16_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(value);
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(uint32_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(value);
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(int32_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(value);
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(int64_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(value);
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(uint8_t& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  writeInteger(value);
+  return true;
+}
+
+// Same format as JsonValue uses for REAL values: 11 fractional digits with trailing zeroes removed
+bool JsonOutputStringSerializer::operator()(double& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  char buffer[512];
+  int size = snprintf(buffer, sizeof(buffer), "%.11f", value);
+  assert(size > 0 && static_cast<size_t>(size) < sizeof(buffer));
+  while (size > 1 && buffer[size - 2] != '.' && buffer[size - 1] == '0') {
+    --size;
+  }
+
+  output.append(buffer, size);
+  return true;
+}
+
+// Strings are written as is, JsonValue keeps escape sequences unchanged both when reading and writing
+bool JsonOutputStringSerializer::operator()(std::string& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  output += '"';
+  output += value;
+  output += '"';
+  return true;
+}
+
+bool JsonOutputStringSerializer::operator()(bool& value, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  output += value ? "true" : "false";
+  return true;
+}
+
+bool JsonOutputStringSerializer::binary(void* value, size_t size, Common::StringView name) {
+  if (!writeName(name)) {
+    return true;
+  }
+
+  size_t offset = output.size();
+  output.resize(offset + size * 2 + 2);
+  char* out = &output[offset];
+  *out++ = '"';
+  const uint8_t* data = static_cast<const uint8_t*>(value);
+  for (size_t i = 0; i < size; ++i) {
+    *out++ = HEX_DIGITS[data[i] >> 4];
+    *out++ = HEX_DIGITS[data[i] & 15];
+  }
+
+  *out = '"';
+  return true;
+}
+
+bool JsonOutputStringSerializer::binary(std::string& value, Common::StringView name) {
+  return binary(const_cast<char*>(value.data()), value.size(), name);
+}
+
+// JsonValue objects keep only the first of several unnamed members, transaction signatures rely on that.
+// Repeated unnamed values are skipped the same way, nested objects and arrays are always written.
+bool JsonOutputStringSerializer::writeName(Common::StringView name) {
+  if (scopes.empty()) {
+    return true;
+  }
+
+  Scope& scope = scopes.back();
+  if (!scope.array && name.isEmpty()) {
+    if (scope.unnamed) {
+      return false;
+    }
+
+    scope.unnamed = true;
+  }
+
+  if (!scope.empty) {
+    output += ',';
+  }
+
+  scope.empty = false;
+  if (!scope.array) {
+    output += '"';
+    output.append(name.getData(), name.getSize());
+    output += "\":";
+  }
+
+  return true;
+}
+
+void JsonOutputStringSerializer::writeInteger(int64_t value) {
+  char buffer[20];
+  char* end = buffer + sizeof(buffer);
+  char* begin = end;
+  uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  do {
+    *--begin = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  if (value < 0) {
+    output += '-';
+  }
+
+  output.append(begin, end);
+}
@@ -17,12 +17,15 @@
 
 #pragma once
 
+#include <cassert>
 #include <list>
 #include <vector>
 #include <Common/MemoryInputStream.h>
 #include <Common/StringOutputStream.h>
 #include "JsonInputStreamSerializer.h"
+#include "JsonInputStringSerializer.h"
 #include "JsonOutputStreamSerializer.h"
+#include "JsonOutputStringSerializer.h"
 #include "KVBinaryInputStreamSerializer.h"
 #include "KVBinaryOutputStreamSerializer.h"
 
@@ -91,7 +94,27 @@ void loadFromJsonValue(std::list<T>& v, const Common::JsonValue& js) {
 
 template <typename T>
 std::string storeToJson(const T& v) {
-  return storeToJsonValue(v).toString();
+  std::string json;
+  JsonOutputStringSerializer s(json);
+  s(const_cast<T&>(v), "");
+  return json;
+}
+
+// Returns 'object' as JSON text with 'json', an already serialized value, added as its last member 'name'
+inline std::string storeToJsonWithMember(const Common::JsonValue& object, Common::StringView name, const std::string& json) {
+  std::string result = object.toString();
+  assert(!result.empty() && result.back() == '}');
+  result.pop_back();
+  if (result.size() > 1) {
+    result += ',';
+  }
+
+  result += '"';
+  result.append(name.getData(), name.getSize());
+  result += "\":";
+  result += json;
+  result += '}';
+  return result;
 }
 
 template <typename T>
@@ -100,14 +123,35 @@ bool loadFromJson(T& v, const std::string& buf) {
     if (buf.empty()) {
       return true;
     }
-    auto js = Common::JsonValue::fromString(buf);
-    loadFromJsonValue(v, js);
+    JsonInputStringSerializer s(buf);
+    serialize(v, s);
+  } catch (std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+// JsonInputStringSerializer only reads objects, arrays at the top level go through JsonValue
+template <typename T>
+bool loadContainerFromJson(T& v, const std::string& buf) {
+  try {
+    if (buf.empty()) {
+      return true;
+    }
+
+    loadFromJsonValue(v, Common::JsonValue::fromString(buf));
   } catch (std::exception&) {
     return false;
   }
   return true;
 }
 
+template <typename T>
+bool loadFromJson(std::vector<T>& v, const std::string& buf) { return loadContainerFromJson(v, buf); }
+
+template <typename T>
+bool loadFromJson(std::list<T>& v, const std::string& buf) { return loadContainerFromJson(v, buf); }
+
 template <typename T>
 std::string storeToBinaryKeyValue(const T& v) {
   KVBinaryOutputStreamSerializer s;
@@ -47,6 +47,7 @@
 #include "WalletSerializationV1.h"
 #include "WalletSerializationV2.h"
 #include "WalletErrors.h"
+#include "WalletJournal.h"
 #include "WalletUtils.h"
 
 using namespace Common;
@@ -276,6 +277,17 @@ namespace
     return address;
   }
 
+  const char WALLET_JOURNAL_SUFFIX[] = ".journal";
+
+  Crypto::chacha8_iv getContainerDataIv(CryptoNote::ContainerStorage &storage)
+  {
+    Common::MemoryInputStream suffixStream(storage.suffix(), storage.suffixSize());
+    CryptoNote::BinaryInputStreamSerializer suffixSerializer(suffixStream);
+    Crypto::chacha8_iv suffixIv;
+    suffixSerializer(suffixIv, "suffixIv");
+    return suffixIv;
+  }
+
 } // namespace
 
 namespace CryptoNote
@@ -296,7 +308,9 @@ namespace CryptoNote
                                                                                                                                                                 m_pendingBalance(0),
                                                                                                                                                                 m_lockedDepositBalance(0),
                                                                                                                                                                 m_unlockedDepositBalance(0),
-                                                                                                                                                                m_transactionSoftLockTime(transactionSoftLockTime)
+                                                                                                                                                                m_transactionSoftLockTime(transactionSoftLockTime),
+                                                                                                                                                                m_journalSnapshotRequired(true),
+                                                                                                                                                                m_journalSize(0)
   {
     m_upperTransactionSizeLimit = m_currency.transactionMaxSize();
     m_readyEvent.set();
@@ -845,6 +859,16 @@ namespace CryptoNote
     encryptAndSaveContainerData(storage, key, containerData.data(), containerData.size());
     storage.flush();
 
+    if (&storage == &m_containerStorage)
+    {
+      // Journal records can only extend a full cache whose transaction ids match the ones in memory
+      m_journalTransactions.clear();
+      m_journalDeposits.clear();
+      m_journalSnapshotRequired = saveLevel != WalletSaveLevel::SAVE_ALL || transactions.size() != m_transactions.size();
+      m_journalSynchronizerState = s.transfersSynchronizerState();
+      m_journalSize = 0;
+    }
+
     m_extra = extra;
 
     m_logger(INFO) << "Container saving finished";
@@ -932,7 +956,10 @@ namespace CryptoNote
 
     try
     {
-      saveWalletCache(m_containerStorage, m_key, saveLevel, extra);
+      if (!saveWalletJournal(saveLevel, extra))
+      {
+        saveWalletCache(m_containerStorage, m_key, saveLevel, extra);
+      }
     }
     catch (const std::exception &e)
     {
@@ -1175,7 +1202,58 @@ namespace CryptoNote
     chacha8(encryptedContainer.data(), encryptedContainer.size(), key, suffixIv, reinterpret_cast<char *>(containerData.data()));
   }
 
-  void WalletGreen::loadWalletCache(std::unordered_set<Crypto::PublicKey> &addedKeys, std::unordered_set<Crypto::PublicKey> &deletedKeys, std::string &extra)
+  bool WalletGreen::saveWalletJournal(WalletSaveLevel saveLevel, const std::string &extra)
+  {
+    if (saveLevel != WalletSaveLevel::SAVE_ALL || m_journalSnapshotRequired || m_containerStorage.suffixSize() == 0)
+    {
+      return false;
+    }
+
+    std::string journalData;
+    Common::StringOutputStream journalStream(journalData);
+    WalletSerializerV2 s(
+        *this,
+        m_viewPublicKey,
+        m_viewSecretKey,
+        m_actualBalance,
+        m_pendingBalance,
+        m_lockedDepositBalance,
+        m_unlockedDepositBalance,
+        m_walletsContainer,
+        m_synchronizer,
+        m_unlockTransactionsJob,
+        m_transactions,
+        m_transfers,
+        m_deposits,
+        m_uncommitedTransactions,
+        const_cast<std::string &>(extra),
+        m_transactionSoftLockTime);
+    s.saveJournal(journalStream, m_journalTransactions, m_journalDeposits, m_journalSynchronizerState);
+
+    // Once the journal outgrows the cache it is cheaper to rewrite the cache
+    size_t recordSize = walletJournalRecordSize(journalData.size()) + (m_journalSize == 0 ? sizeof(Crypto::chacha8_iv) : 0);
+    if (m_journalSize + recordSize > m_containerStorage.suffixSize())
+    {
+      m_logger(DEBUGGING) << "Wallet journal exceeds container cache, compacting";
+      return false;
+    }
+
+    Crypto::chacha8_iv iv = reinterpret_cast<const ContainerStoragePrefix *>(m_containerStorage.prefix())->nextIv;
+    incNextIv();
+    m_containerStorage.flush();
+
+    m_journalSize = appendWalletJournal(m_path + WALLET_JOURNAL_SUFFIX, m_journalSize, m_key, getContainerDataIv(m_containerStorage), iv,
+                                        BinaryArray(journalData.begin(), journalData.end()));
+    m_journalSynchronizerState = s.transfersSynchronizerState();
+    m_journalTransactions.clear();
+    m_journalDeposits.clear();
+    m_extra = extra;
+
+    m_logger(INFO) << "Container journal saved";
+    return true;
+  }
+
+  void WalletGreen::loadWalletCache(const std::string &path, std::unordered_set<Crypto::PublicKey> &addedKeys, std::unordered_set<Crypto::PublicKey> &deletedKeys, std::string &extra)
   {
     assert(m_containerStorage.isOpened());
 
@@ -1202,6 +1280,30 @@ namespace CryptoNote
 
     Common::MemoryInputStream containerStream(contanerData.data(), contanerData.size());
     s.load(containerStream, reinterpret_cast<const ContainerStoragePrefix *>(m_containerStorage.prefix())->version);
+
+    WalletJournalRecords journal = loadWalletJournal(path + WALLET_JOURNAL_SUFFIX, m_key, getContainerDataIv(m_containerStorage));
+    if (journal.truncated)
+    {
+      m_logger(WARNING, BRIGHT_YELLOW) << "Incomplete record at the end of the wallet journal is skipped";
+    }
+
+    for (size_t i = 0; i < journal.records.size(); ++i)
+    {
+      Common::MemoryInputStream journalStream(journal.records[i].data(), journal.records[i].size());
+      s.loadJournal(journalStream, i + 1 == journal.records.size());
+    }
+
+    m_journalTransactions.clear();
+    m_journalDeposits.clear();
+    m_journalSnapshotRequired = s.saveLevel() != WalletSaveLevel::SAVE_ALL;
+    m_journalSynchronizerState = s.transfersSynchronizerState();
+    m_journalSize = journal.validSize;
+
+    if (!journal.records.empty())
+    {
+      m_logger(INFO) << "Applied " << journal.records.size() << " wallet journal records";
+    }
+
     addedKeys = std::move(s.addedKeys());
     deletedKeys = std::move(s.deletedKeys());
 
@@ -1320,7 +1422,7 @@ namespace CryptoNote
         {
           std::unordered_set<Crypto::PublicKey> addedSpendKeys;
           std::unordered_set<Crypto::PublicKey> deletedSpendKeys;
-          loadWalletCache(addedSpendKeys, deletedSpendKeys, extra);
+          loadWalletCache(path, addedSpendKeys, deletedSpendKeys, extra);
 
           if (!addedSpendKeys.empty())
           {
@@ -1406,6 +1508,14 @@ namespace CryptoNote
 
   void WalletGreen::clearCaches(bool clearTransactions, bool clearCachedData)
   {
+    if (clearTransactions || clearCachedData)
+    {
+      m_journalTransactions.clear();
+      m_journalDeposits.clear();
+      m_journalSnapshotRequired = true;
+      m_journalSynchronizerState.clear();
+    }
+
     if (clearTransactions)
     {
       m_transactions.clear();
@@ -2213,6 +2323,8 @@ namespace CryptoNote
 
       m_transfers.emplace_back(txId, std::move(d));
     }
+
+    m_journalTransactions.insert(txId);
   }
 
   size_t WalletGreen::insertOutgoingTransactionAndPushEvent(const Hash &transactionHash, uint64_t fee, const BinaryArray &extra, uint64_t unlockTimestamp)
@@ -2233,6 +2345,7 @@ namespace CryptoNote
 
     size_t txId = m_transactions.get<RandomAccessIndex>().size();
     m_transactions.get<RandomAccessIndex>().push_back(std::move(insertTx));
+    m_journalTransactions.insert(txId);
 
     pushEvent(makeTransactionCreatedEvent(txId));
 
@@ -2248,6 +2361,7 @@ namespace CryptoNote
       m_transactions.get<RandomAccessIndex>().modify(it, [state](WalletTransaction &tx) {
         tx.state = state;
       });
+      m_journalTransactions.insert(transactionId);
 
       pushEvent(makeTransactionUpdatedEvent(transactionId));
     }
@@ -2270,6 +2384,11 @@ namespace CryptoNote
 
     assert(r);
 
+    if (updated)
+    {
+      m_journalDeposits.insert(depositId);
+    }
+
     return updated;
   }
 
@@ -2334,6 +2453,11 @@ namespace CryptoNote
 
     assert(r);
 
+    if (updated)
+    {
+      m_journalTransactions.insert(transactionId);
+    }
+
     return updated;
   }
 
@@ -2365,6 +2489,7 @@ namespace CryptoNote
 
     size_t txId = index.size();
     index.push_back(std::move(tx));
+    m_journalTransactions.insert(txId);
 
     return txId;
   }
@@ -2620,6 +2745,7 @@ namespace CryptoNote
 
     WalletTransfer transfer{WalletTransferType::USUAL, address, amount};
     m_transfers.emplace(insertIt, std::piecewise_construct, std::forward_as_tuple(transactionId), std::forward_as_tuple(transfer));
+    m_journalTransactions.insert(transactionId);
   }
 
   bool WalletGreen::adjustTransfer(size_t transactionId, size_t firstTransferIdx, const std::string &address, int64_t amount)
@@ -2666,6 +2792,11 @@ namespace CryptoNote
       updated = true;
     }
 
+    if (updated)
+    {
+      m_journalTransactions.insert(transactionId);
+    }
+
     return updated;
   }
 
@@ -2687,6 +2818,11 @@ namespace CryptoNote
       }
     }
 
+    if (erased)
+    {
+      m_journalTransactions.insert(transactionId);
+    }
+
     return erased;
   }
 
@@ -3470,6 +3606,7 @@ namespace CryptoNote
 
     DepositId id = m_deposits.size();
     m_deposits.push_back(std::move(info));
+    m_journalDeposits.insert(id);
 
     m_logger(DEBUGGING, BRIGHT_GREEN) << "New deposit created, id "
                                       << id << ", locking "
@@ -3669,6 +3806,11 @@ namespace CryptoNote
       }
     });
 
+    if (updated)
+    {
+      m_journalTransactions.insert(std::distance(m_transactions.get<RandomAccessIndex>().begin(), m_transactions.project<RandomAccessIndex>(it)));
+    }
+
     if (updated)
     {
       auto transactionId = getTransactionId(transactionHash);
@@ -4513,6 +4655,7 @@ namespace CryptoNote
 
         auto &randomIndex = m_transactions.get<RandomAccessIndex>();
 
+        m_journalTransactions.insert(transactionId);
         randomIndex.modify(std::next(randomIndex.begin(), transactionId), [transfersLeft, deletedInputs, deletedOutputs](WalletTransaction &transaction) {
           transaction.totalAmount -= deletedInputs + deletedOutputs;
 
@@ -4525,6 +4668,8 @@ namespace CryptoNote
         if (!transfersLeft)
         {
           deletedTransactions.push_back(transactionId);
+          // deleted transactions are dropped by the next full save, which renumbers the rest
+          m_journalSnapshotRequired = true;
         }
 
         if (deletedInputs != 0 || deletedOutputs != 0)
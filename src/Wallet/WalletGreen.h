@@ -20,6 +20,7 @@
 #include "IWallet.h"
 
 #include <queue>
+#include <set>
 #include <unordered_map>
 
 #include "IFusionManager.h"
@@ -335,7 +336,8 @@ protected:
   void initTransactionPool();
   static void loadAndDecryptContainerData(ContainerStorage& storage, const Crypto::chacha8_key& key, BinaryArray& containerData);
   static void encryptAndSaveContainerData(ContainerStorage& storage, const Crypto::chacha8_key& key, const void* containerData, size_t containerDataSize);
-  void loadWalletCache(std::unordered_set<Crypto::PublicKey>& addedKeys, std::unordered_set<Crypto::PublicKey>& deletedKeys, std::string& extra);
+  void loadWalletCache(const std::string& path, std::unordered_set<Crypto::PublicKey>& addedKeys, std::unordered_set<Crypto::PublicKey>& deletedKeys, std::string& extra);
+  bool saveWalletJournal(WalletSaveLevel saveLevel, const std::string& extra);
 
   void copyContainerStorageKeys(ContainerStorage& src, const Crypto::chacha8_key& srcKey, ContainerStorage& dst, const Crypto::chacha8_key& dstKey);
   static void copyContainerStoragePrefix(ContainerStorage& src, const Crypto::chacha8_key& srcKey, ContainerStorage& dst, const Crypto::chacha8_key& dstKey);
@@ -423,6 +425,12 @@ protected:
   uint64_t m_upperTransactionSizeLimit;
   uint32_t m_transactionSoftLockTime;
 
+  std::set<size_t> m_journalTransactions; // transactions and their transfers changed since the last save
+  std::set<size_t> m_journalDeposits;     // deposits changed since the last save
+  bool m_journalSnapshotRequired;         // next save has to rewrite the whole container cache
+  uint64_t m_journalSize;                 // valid bytes of the journal file, 0 if it doesn't extend the current cache
+  std::string m_journalSynchronizerState; // transfers synchronizer as of the last cache or journal record, the base of the next delta
+
   BlockHashesContainer m_blockchain;
 };
 
@@ -0,0 +1,275 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "WalletJournal.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Common/MemoryInputStream.h"
+#include "Common/StreamTools.h"
+#include "Common/StringOutputStream.h"
+#include "crypto/hash.h"
+
+namespace {
+
+const size_t DELTA_BLOCK_SIZE = 64;
+
+// rsync style weak checksum, cheap to roll one byte forward
+struct RollingHash {
+  uint32_t a;
+  uint32_t b;
+
+  RollingHash(const char* data) : a(0), b(0) {
+    for (size_t i = 0; i < DELTA_BLOCK_SIZE; ++i) {
+      a += static_cast<uint8_t>(data[i]);
+      b += static_cast<uint32_t>(DELTA_BLOCK_SIZE - i) * static_cast<uint8_t>(data[i]);
+    }
+  }
+
+  void roll(char out, char in) {
+    a += static_cast<uint8_t>(in) - static_cast<uint32_t>(static_cast<uint8_t>(out));
+    b += a - static_cast<uint32_t>(DELTA_BLOCK_SIZE) * static_cast<uint8_t>(out);
+  }
+
+  uint32_t value() const {
+    return (a & 0xffff) | (b << 16);
+  }
+};
+
+void writeDeltaOp(Common::IOutputStream& out, const std::string& target, size_t literalBegin, size_t literalEnd, size_t copyOffset, size_t copyLength) {
+  Common::writeVarint(out, literalEnd - literalBegin);
+  Common::write(out, target.data() + literalBegin, literalEnd - literalBegin);
+  Common::writeVarint(out, copyOffset);
+  Common::writeVarint(out, copyLength);
+}
+
+void syncPath(const std::string& path) {
+#ifdef _WIN32
+  int fd = ::_open(path.c_str(), _O_RDWR | _O_BINARY);
+  bool synced = fd != -1 && ::_commit(fd) == 0;
+  if (fd != -1) {
+    ::_close(fd);
+  }
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  bool synced = fd != -1 && ::fsync(fd) == 0;
+  if (fd != -1) {
+    ::close(fd);
+  }
+#endif
+
+  if (!synced) {
+    throw std::runtime_error("Failed to sync " + path);
+  }
+}
+
+}
+
+namespace CryptoNote {
+
+std::string makeBinaryDelta(const std::string& base, const std::string& target) {
+  std::unordered_map<uint32_t, size_t> blocks;
+  for (size_t offset = 0; offset + DELTA_BLOCK_SIZE <= base.size(); offset += DELTA_BLOCK_SIZE) {
+    blocks.emplace(RollingHash(base.data() + offset).value(), offset);
+  }
+
+  std::string delta;
+  Common::StringOutputStream out(delta);
+  size_t literalBegin = 0;
+  size_t position = 0;
+  if (!blocks.empty() && target.size() >= DELTA_BLOCK_SIZE) {
+    RollingHash hash(target.data());
+    for (;;) {
+      auto block = blocks.find(hash.value());
+      if (block != blocks.end() && memcmp(base.data() + block->second, target.data() + position, DELTA_BLOCK_SIZE) == 0) {
+        size_t copyOffset = block->second;
+        size_t copyLength = DELTA_BLOCK_SIZE;
+        while (position + copyLength < target.size() && copyOffset + copyLength < base.size() &&
+          base[copyOffset + copyLength] == target[position + copyLength]) {
+          ++copyLength;
+        }
+
+        while (position > literalBegin && copyOffset > 0 && base[copyOffset - 1] == target[position - 1]) {
+          --position;
+          --copyOffset;
+          ++copyLength;
+        }
+
+        writeDeltaOp(out, target, literalBegin, position, copyOffset, copyLength);
+        position += copyLength;
+        literalBegin = position;
+        if (position + DELTA_BLOCK_SIZE > target.size()) {
+          break;
+        }
+
+        hash = RollingHash(target.data() + position);
+        continue;
+      }
+
+      if (position + DELTA_BLOCK_SIZE == target.size()) {
+        break;
+      }
+
+      hash.roll(target[position], target[position + DELTA_BLOCK_SIZE]);
+      ++position;
+    }
+  }
+
+  if (literalBegin < target.size() || delta.empty()) {
+    writeDeltaOp(out, target, literalBegin, target.size(), 0, 0);
+  }
+
+  return delta;
+}
+
+std::string applyBinaryDelta(const std::string& base, const std::string& delta) {
+  std::string target;
+  Common::MemoryInputStream in(delta.data(), delta.size());
+  while (!in.endOfStream()) {
+    uint64_t literalSize = Common::readVarint<uint64_t>(in);
+    if (literalSize > delta.size()) {
+      throw std::runtime_error("Binary delta literal is out of range");
+    }
+
+    std::string literal;
+    Common::read(in, literal, static_cast<size_t>(literalSize));
+    target += literal;
+
+    uint64_t copyOffset = Common::readVarint<uint64_t>(in);
+    uint64_t copyLength = Common::readVarint<uint64_t>(in);
+    if (copyOffset > base.size() || copyLength > base.size() - copyOffset) {
+      throw std::runtime_error("Binary delta copy is out of range");
+    }
+
+    target.append(base, static_cast<size_t>(copyOffset), static_cast<size_t>(copyLength));
+  }
+
+  return target;
+}
+
+size_t walletJournalRecordSize(size_t dataSize) {
+  return sizeof(Crypto::chacha8_iv) + sizeof(uint64_t) + dataSize + sizeof(Crypto::Hash);
+}
+
+WalletJournalRecords loadWalletJournal(const std::string& path, const Crypto::chacha8_key& key, const Crypto::chacha8_iv& cacheIv) {
+  WalletJournalRecords result;
+  result.validSize = 0;
+  result.truncated = false;
+
+  std::ifstream journalFile(path, std::ios_base::binary);
+  if (!journalFile) {
+    return result;
+  }
+
+  std::string journal((std::istreambuf_iterator<char>(journalFile)), std::istreambuf_iterator<char>());
+
+  // A journal written for an earlier cache is already part of the current one
+  if (journal.size() < sizeof(cacheIv) || memcmp(journal.data(), &cacheIv, sizeof(cacheIv)) != 0) {
+    return result;
+  }
+
+  size_t offset = sizeof(cacheIv);
+  while (journal.size() - offset >= sizeof(Crypto::chacha8_iv) + sizeof(uint64_t)) {
+    Crypto::chacha8_iv iv;
+    uint64_t dataSize;
+    memcpy(&iv, journal.data() + offset, sizeof(iv));
+    memcpy(&dataSize, journal.data() + offset + sizeof(iv), sizeof(dataSize));
+
+    size_t dataOffset = offset + sizeof(iv) + sizeof(dataSize);
+    if (dataSize > journal.size() - dataOffset || journal.size() - dataOffset - dataSize < sizeof(Crypto::Hash)) {
+      break;
+    }
+
+    Crypto::Hash checksum;
+    memcpy(&checksum, journal.data() + dataOffset + dataSize, sizeof(checksum));
+    if (Crypto::cn_fast_hash(journal.data() + dataOffset, static_cast<size_t>(dataSize)) != checksum) {
+      break;
+    }
+
+    BinaryArray record(static_cast<size_t>(dataSize));
+    Crypto::chacha8(journal.data() + dataOffset, record.size(), key, iv, reinterpret_cast<char*>(record.data()));
+    result.records.push_back(std::move(record));
+
+    offset = dataOffset + static_cast<size_t>(dataSize) + sizeof(checksum);
+  }
+
+  result.validSize = offset;
+  result.truncated = offset != journal.size();
+  return result;
+}
+
+uint64_t appendWalletJournal(const std::string& path, uint64_t validSize, const Crypto::chacha8_key& key, const Crypto::chacha8_iv& cacheIv,
+  const Crypto::chacha8_iv& iv, const BinaryArray& data) {
+  std::string record;
+  if (validSize == 0) {
+    record.append(reinterpret_cast<const char*>(&cacheIv), sizeof(cacheIv));
+  }
+
+  uint64_t dataSize = data.size();
+  std::string encryptedData(data.size(), '\0');
+  Crypto::chacha8(data.data(), data.size(), key, iv, &encryptedData[0]);
+  Crypto::Hash checksum = Crypto::cn_fast_hash(encryptedData.data(), encryptedData.size());
+
+  record.append(reinterpret_cast<const char*>(&iv), sizeof(iv));
+  record.append(reinterpret_cast<const char*>(&dataSize), sizeof(dataSize));
+  record.append(encryptedData);
+  record.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+  std::fstream journalFile;
+  if (validSize == 0) {
+    journalFile.open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+  } else {
+    journalFile.open(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    journalFile.seekp(validSize);
+  }
+
+  journalFile.write(record.data(), record.size());
+  journalFile.close();
+  if (journalFile.fail()) {
+    throw std::runtime_error("Failed to write wallet journal " + path);
+  }
+
+  validSize += record.size();
+  if (boost::filesystem::file_size(path) > validSize) {
+    // drop a torn record left behind by an earlier crash
+    boost::filesystem::resize_file(path, validSize);
+  }
+
+  syncPath(path);
+#ifndef _WIN32
+  if (validSize == record.size()) {
+    // a new journal file is only durable once its directory entry is
+    boost::filesystem::path directory = boost::filesystem::absolute(path).parent_path();
+    syncPath(directory.string());
+  }
+#endif
+
+  return validSize;
+}
+
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "CryptoNote.h"
+#include "crypto/chacha8.h"
+
+namespace CryptoNote {
+
+// Delta of target against base: literal bytes interleaved with copies of base ranges.
+// Unchanged runs of at least DELTA_BLOCK_SIZE bytes are found wherever they moved to.
+std::string makeBinaryDelta(const std::string& base, const std::string& target);
+std::string applyBinaryDelta(const std::string& base, const std::string& delta);
+
+// The journal extends the container cache whose suffix iv it starts with:
+// [cache iv]([iv][uint64 size][encrypted data][cn_fast_hash of encrypted data])*
+// The hash detects a record torn by a crash, it and everything after it are ignored.
+struct WalletJournalRecords {
+  std::vector<BinaryArray> records;
+  uint64_t validSize;  // bytes of the file up to the end of the last valid record, 0 if it doesn't extend the cache
+  bool truncated;      // an incomplete or corrupted record follows the valid ones
+};
+
+size_t walletJournalRecordSize(size_t dataSize);
+
+WalletJournalRecords loadWalletJournal(const std::string& path, const Crypto::chacha8_key& key, const Crypto::chacha8_iv& cacheIv);
+
+// Writes the record at validSize, 0 starts a new journal for the cache, and drops whatever followed it.
+// The file is synced before returning, so the record survives a crash once this returns. Returns the new valid size.
+uint64_t appendWalletJournal(const std::string& path, uint64_t validSize, const Crypto::chacha8_key& key, const Crypto::chacha8_iv& cacheIv,
+  const Crypto::chacha8_iv& iv, const BinaryArray& data);
+
+}
@@ -16,10 +16,15 @@
 // along with Fuego. If not, see <https://www.gnu.org/licenses/>.
 
 #include "WalletSerializationV2.h"
+
+#include <algorithm>
+#include <map>
+
 #include "IWallet.h"
 #include "CryptoNoteCore/CryptoNoteSerialization.h"
 #include "Serialization/BinaryInputStreamSerializer.h"
 #include "Serialization/BinaryOutputStreamSerializer.h"
+#include "WalletJournal.h"
 
 using namespace Common;
 using namespace Crypto;
@@ -161,6 +166,47 @@ void serialize(WalletDepositDtoV2& value, CryptoNote::ISerializer& serializer) {
   serializer(value.address, "address");
 }
 
+CryptoNote::WalletTransaction toWalletTransaction(const WalletTransactionDtoV2& dto) {
+  CryptoNote::WalletTransaction tx;
+  tx.state = dto.state;
+  tx.timestamp = dto.timestamp;
+  tx.blockHeight = dto.blockHeight;
+  tx.hash = dto.hash;
+  tx.depositCount = dto.depositCount;
+  tx.firstDepositId = dto.firstDepositId;
+  tx.totalAmount = dto.totalAmount;
+  tx.fee = dto.fee;
+  tx.creationTime = dto.creationTime;
+  tx.unlockTime = dto.unlockTime;
+  tx.extra = dto.extra;
+  tx.isBase = dto.isBase;
+  return tx;
+}
+
+CryptoNote::WalletTransfer toWalletTransfer(const WalletTransferDtoV2& dto) {
+  CryptoNote::WalletTransfer tr;
+  tr.address = dto.address;
+  tr.amount = dto.amount;
+  tr.type = static_cast<CryptoNote::WalletTransferType>(dto.type);
+  return tr;
+}
+
+CryptoNote::Deposit toDeposit(const WalletDepositDtoV2& dto) {
+  CryptoNote::Deposit dp;
+  dp.creatingTransactionId = dto.creatingTransactionId;
+  dp.spendingTransactionId = dto.spendingTransactionId;
+  dp.term = dto.term;
+  dp.amount = dto.amount;
+  dp.interest = dto.interest;
+  dp.height = dto.height;
+  dp.unlockHeight = dto.unlockHeight;
+  dp.locked = dto.locked;
+  dp.transactionHash = dto.transactionHash;
+  dp.outputInTransaction = dto.outputInTransaction;
+  dp.address = dto.address;
+  return dp;
+}
+
 }
 
 namespace CryptoNote {
@@ -196,7 +242,8 @@ WalletSerializerV2::WalletSerializerV2(
   m_deposits(deposits),
   m_uncommitedTransactions(uncommitedTransactions),
   m_extra(extra),
-  m_transactionSoftLockTime(transactionSoftLockTime)
+  m_transactionSoftLockTime(transactionSoftLockTime),
+  m_saveLevel(WalletSaveLevel::SAVE_ALL)
 {
 }
 
@@ -206,6 +253,7 @@ void WalletSerializerV2::load(Common::IInputStream& source, uint8_t version) {
   uint8_t saveLevelValue;
   s(saveLevelValue, "saveLevel");
   WalletSaveLevel saveLevel = static_cast<WalletSaveLevel>(saveLevelValue);
+  m_saveLevel = saveLevel;
 
   loadKeyListAndBanalces(s, saveLevel == WalletSaveLevel::SAVE_ALL);
 
@@ -247,6 +295,181 @@ void WalletSerializerV2::save(Common::IOutputStream& destination, WalletSaveLeve
   s(m_extra, "extra");
 }
 
+void WalletSerializerV2::loadJournal(Common::IInputStream& source, bool loadSynchronizer) {
+  CryptoNote::BinaryInputStreamSerializer s(source);
+
+  loadKeyListAndBanalces(s, true);
+
+  auto& transactions = m_transactions.get<RandomAccessIndex>();
+  uint64_t transactionCount = 0;
+  uint64_t updatedCount = 0;
+  s(transactionCount, "transactionCount");
+  s(updatedCount, "updatedTransactionCount");
+
+  std::map<size_t, std::vector<WalletTransfer>> updatedTransfers;
+  for (uint64_t i = 0; i < updatedCount; ++i) {
+    uint64_t txId = 0;
+    WalletTransactionDtoV2 dto;
+    s(txId, "transactionId");
+    s(dto, "transaction");
+
+    if (txId < transactions.size()) {
+      transactions.replace(std::next(transactions.begin(), txId), toWalletTransaction(dto));
+    } else if (txId == transactions.size()) {
+      transactions.push_back(toWalletTransaction(dto));
+    } else {
+      throw std::runtime_error("Wallet journal refers to an unknown transaction");
+    }
+
+    uint64_t transferCount = 0;
+    s(transferCount, "transferCount");
+
+    auto& txTransfers = updatedTransfers[txId];
+    for (uint64_t j = 0; j < transferCount; ++j) {
+      WalletTransferDtoV2 tr;
+      s(tr, "transfer");
+      txTransfers.push_back(toWalletTransfer(tr));
+    }
+  }
+
+  if (transactions.size() != transactionCount) {
+    throw std::runtime_error("Wallet journal transaction count mismatch");
+  }
+
+  if (!updatedTransfers.empty()) {
+    // m_transfers is sorted by transaction id, merge the replaced transfer lists in
+    WalletTransfers transfers;
+    transfers.reserve(m_transfers.size());
+
+    auto appendUpdated = [&transfers](const std::pair<const size_t, std::vector<WalletTransfer>>& updated) {
+      for (const auto& tr : updated.second) {
+        transfers.emplace_back(updated.first, tr);
+      }
+    };
+
+    auto updatedIt = updatedTransfers.begin();
+    for (auto& kv : m_transfers) {
+      while (updatedIt != updatedTransfers.end() && updatedIt->first < kv.first) {
+        appendUpdated(*updatedIt++);
+      }
+
+      if (updatedTransfers.count(kv.first) == 0) {
+        transfers.push_back(std::move(kv));
+      }
+    }
+
+    for (; updatedIt != updatedTransfers.end(); ++updatedIt) {
+      appendUpdated(*updatedIt);
+    }
+
+    m_transfers.swap(transfers);
+  }
+
+  auto& deposits = m_deposits.get<RandomAccessIndex>();
+  uint64_t depositCount = 0;
+  s(depositCount, "depositCount");
+  s(updatedCount, "updatedDepositCount");
+
+  for (uint64_t i = 0; i < updatedCount; ++i) {
+    uint64_t depositId = 0;
+    WalletDepositDtoV2 dto;
+    s(depositId, "depositId");
+    s(dto, "deposit");
+
+    if (depositId < deposits.size()) {
+      deposits.replace(std::next(deposits.begin(), depositId), toDeposit(dto));
+    } else if (depositId == deposits.size()) {
+      deposits.push_back(toDeposit(dto));
+    } else {
+      throw std::runtime_error("Wallet journal refers to an unknown deposit");
+    }
+  }
+
+  if (deposits.size() != depositCount) {
+    throw std::runtime_error("Wallet journal deposit count mismatch");
+  }
+
+  std::string synchronizerDelta;
+  s(synchronizerDelta, "transfersSynchronizerDelta");
+  m_transfersSynchronizerState = applyBinaryDelta(m_transfersSynchronizerState, synchronizerDelta);
+  if (loadSynchronizer) {
+    std::stringstream stream(m_transfersSynchronizerState);
+    m_synchronizer.load(stream);
+  }
+
+  m_unlockTransactions.clear();
+  loadUnlockTransactionsJobs(s);
+  m_uncommitedTransactions.clear();
+  s(m_uncommitedTransactions, "uncommitedTransactions");
+  s(m_extra, "extra");
+}
+
+void WalletSerializerV2::saveJournal(Common::IOutputStream& destination, const std::set<size_t>& transactionIds, const std::set<size_t>& depositIds,
+  const std::string& previousSynchronizerState) {
+  CryptoNote::BinaryOutputStreamSerializer s(destination);
+
+  saveKeyListAndBanalces(s, true);
+
+  const auto& transactions = m_transactions.get<RandomAccessIndex>();
+  uint64_t transactionCount = transactions.size();
+  uint64_t updatedCount = transactionIds.size();
+  s(transactionCount, "transactionCount");
+  s(updatedCount, "updatedTransactionCount");
+
+  for (size_t id : transactionIds) {
+    uint64_t txId = id;
+    WalletTransactionDtoV2 dto(transactions[id]);
+    s(txId, "transactionId");
+    s(dto, "transaction");
+
+    auto first = std::lower_bound(m_transfers.begin(), m_transfers.end(), id, [](const TransactionTransferPair& pair, size_t txId) {
+      return pair.first < txId;
+    });
+    auto last = first;
+    while (last != m_transfers.end() && last->first == id) {
+      ++last;
+    }
+
+    uint64_t transferCount = std::distance(first, last);
+    s(transferCount, "transferCount");
+    for (auto it = first; it != last; ++it) {
+      WalletTransferDtoV2 tr(it->second);
+      s(tr, "transfer");
+    }
+  }
+
+  const auto& deposits = m_deposits.get<RandomAccessIndex>();
+  uint64_t depositCount = deposits.size();
+  updatedCount = depositIds.size();
+  s(depositCount, "depositCount");
+  s(updatedCount, "updatedDepositCount");
+
+  for (size_t id : depositIds) {
+    uint64_t depositId = id;
+    WalletDepositDtoV2 dto(deposits[id]);
+    s(depositId, "depositId");
+    s(dto, "deposit");
+  }
+
+  std::stringstream stream;
+  m_synchronizer.save(stream);
+  m_transfersSynchronizerState = stream.str();
+  std::string synchronizerDelta = makeBinaryDelta(previousSynchronizerState, m_transfersSynchronizerState);
+  s(synchronizerDelta, "transfersSynchronizerDelta");
+
+  saveUnlockTransactionsJobs(s);
+  s(m_uncommitedTransactions, "uncommitedTransactions");
+  s(m_extra, "extra");
+}
+
+WalletSaveLevel WalletSerializerV2::saveLevel() const {
+  return m_saveLevel;
+}
+
+const std::string& WalletSerializerV2::transfersSynchronizerState() const {
+  return m_transfersSynchronizerState;
+}
+
 std::unordered_set<Crypto::PublicKey>& WalletSerializerV2::addedKeys() {
   return m_addedKeys;
 }
@@ -263,6 +486,7 @@ void WalletSerializerV2::loadKeyListAndBanalces(CryptoNote::ISerializer& seriali
   m_pendingBalance = 0;
   m_lockedDepositBalance = 0;
   m_unlockedDepositBalance = 0;
+  m_addedKeys.clear();
   m_deletedKeys.clear();
 
   std::unordered_set<Crypto::PublicKey> cachedKeySet;
@@ -335,21 +559,7 @@ void WalletSerializerV2::loadTransactions(CryptoNote::ISerializer& serializer) {
     WalletTransactionDtoV2 dto;
     serializer(dto, "transaction");
 
-    WalletTransaction tx;
-    tx.state = dto.state;
-    tx.timestamp = dto.timestamp;
-    tx.blockHeight = dto.blockHeight;
-    tx.hash = dto.hash;
-    tx.depositCount = dto.depositCount;
-    tx.firstDepositId = dto.firstDepositId;
-    tx.totalAmount = dto.totalAmount;
-    tx.fee = dto.fee;
-    tx.creationTime = dto.creationTime;
-    tx.unlockTime = dto.unlockTime;
-    tx.extra = dto.extra;
-    tx.isBase = dto.isBase;
-
-    m_transactions.get<RandomAccessIndex>().emplace_back(std::move(tx));
+    m_transactions.get<RandomAccessIndex>().emplace_back(toWalletTransaction(dto));
   }
 }
 
@@ -363,20 +573,7 @@ void WalletSerializerV2::loadDeposits(CryptoNote::ISerializer& serializer) {
     WalletDepositDtoV2 dto;
     serializer(dto, "deposit");
 
-    Deposit dp;
-    dp.creatingTransactionId = dto.creatingTransactionId;
-    dp.spendingTransactionId = dto.spendingTransactionId;
-    dp.term = dto.term;
-    dp.amount = dto.amount;
-    dp.interest = dto.interest;
-    dp.height = dto.height;
-    dp.unlockHeight = dto.unlockHeight;
-    dp.locked = dto.locked;
-    dp.transactionHash = dto.transactionHash;
-    dp.outputInTransaction = dto.outputInTransaction;
-    dp.address = dto.address;
-
-    m_deposits.get<RandomAccessIndex>().emplace_back(std::move(dp));
+    m_deposits.get<RandomAccessIndex>().emplace_back(toDeposit(dto));
   }
 }
 
@@ -413,12 +610,7 @@ void WalletSerializerV2::loadTransfers(CryptoNote::ISerializer& serializer) {
     WalletTransferDtoV2 dto;
     serializer(dto, "transfer");
 
-    WalletTransfer tr;
-    tr.address = dto.address;
-    tr.amount = dto.amount;
-    tr.type = static_cast<WalletTransferType>(dto.type);
-
-    m_transfers.emplace_back(std::piecewise_construct, std::forward_as_tuple(txId), std::forward_as_tuple(std::move(tr)));
+    m_transfers.emplace_back(std::piecewise_construct, std::forward_as_tuple(txId), std::forward_as_tuple(toWalletTransfer(dto)));
   }
 }
 
@@ -437,10 +629,9 @@ void WalletSerializerV2::saveTransfers(CryptoNote::ISerializer& serializer) {
 }
 
 void WalletSerializerV2::loadTransfersSynchronizer(CryptoNote::ISerializer& serializer) {
-  std::string transfersSynchronizerData;
-  serializer(transfersSynchronizerData, "transfersSynchronizer");
+  serializer(m_transfersSynchronizerState, "transfersSynchronizer");
 
-  std::stringstream stream(transfersSynchronizerData);
+  std::stringstream stream(m_transfersSynchronizerState);
   m_synchronizer.load(stream);
 }
 
@@ -449,8 +640,8 @@ void WalletSerializerV2::saveTransfersSynchronizer(CryptoNote::ISerializer& seri
   m_synchronizer.save(stream);
   stream.flush();
 
-  std::string transfersSynchronizerData = stream.str();
-  serializer(transfersSynchronizerData, "transfersSynchronizer");
+  m_transfersSynchronizerState = stream.str();
+  serializer(m_transfersSynchronizerState, "transfersSynchronizer");
 }
 
 void WalletSerializerV2::loadUnlockTransactionsJobs(CryptoNote::ISerializer& serializer) {
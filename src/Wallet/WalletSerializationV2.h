@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <set>
+
 #include "Common/IInputStream.h"
 #include "Common/IOutputStream.h"
 #include "Serialization/ISerializer.h"
@@ -50,6 +52,17 @@ public:
   void load(Common::IInputStream& source, uint8_t version);
   void save(Common::IOutputStream& destination, WalletSaveLevel saveLevel);
 
+  // Journal records carry the state changed since the previous record: transactions and deposits
+  // listed by id, the transfers synchronizer as a delta of its previous state, everything else in full.
+  // They are applied on top of a cache saved with SAVE_ALL, loaded by the same serializer.
+  void loadJournal(Common::IInputStream& source, bool loadSynchronizer);
+  void saveJournal(Common::IOutputStream& destination, const std::set<size_t>& transactionIds, const std::set<size_t>& depositIds,
+    const std::string& previousSynchronizerState);
+
+  WalletSaveLevel saveLevel() const;
+  // Serialized transfers synchronizer of the last cache or journal record loaded or saved
+  const std::string& transfersSynchronizerState() const;
+
   std::unordered_set<Crypto::PublicKey>& addedKeys();
   std::unordered_set<Crypto::PublicKey>& deletedKeys();
 
@@ -90,6 +103,8 @@ private:
   std::string& m_extra;
   uint32_t m_transactionSoftLockTime;
 
+  WalletSaveLevel m_saveLevel;
+  std::string m_transfersSynchronizerState;
   std::unordered_set<Crypto::PublicKey> m_addedKeys;
   std::unordered_set<Crypto::PublicKey> m_deletedKeys;
 };
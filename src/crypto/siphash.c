@@ -0,0 +1,71 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "siphash.h"
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                 \
+  do {                                                           \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32);    \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                       \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                       \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32);    \
+  } while (0)
+
+static uint64_t read64(const uint8_t *p) {
+  uint64_t value = 0;
+  int i;
+  for (i = 7; i >= 0; --i) {
+    value = (value << 8) | p[i];
+  }
+
+  return value;
+}
+
+uint64_t siphash24(uint64_t k0, uint64_t k1, const void *data, size_t length) {
+  const uint8_t *in = (const uint8_t *) data;
+  const uint8_t *end = in + length - (length % 8);
+  uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+  uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+  uint64_t v3 = 0x7465646279746573ULL ^ k1;
+  uint64_t last = ((uint64_t) length) << 56;
+  uint64_t m;
+  size_t i;
+
+  for (; in != end; in += 8) {
+    m = read64(in);
+    v3 ^= m;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= m;
+  }
+
+  for (i = length % 8; i > 0; --i) {
+    last |= ((uint64_t) in[i - 1]) << (8 * (i - 1));
+  }
+
+  v3 ^= last;
+  SIPROUND;
+  SIPROUND;
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope
+// it will be useful, but WITHOUT ANY WARRANTY; without even an
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+namespace Crypto {
+extern "C" {
+#endif
+
+// SipHash-2-4 with the key k0, k1: a fast keyed hash for short ids a peer can't find collisions of in advance
+uint64_t siphash24(uint64_t k0, uint64_t k1, const void *data, size_t length);
+
+#if defined(__cplusplus)
+}
+}
+#endif
@@ -27,6 +27,7 @@ struct TestNodeConfiguration {
   std::string logFile;
   std::string daemonPath; // only for rpc node
   bool cleanupDataDir = true;
+  uint32_t syncMaxRequests = 0; // daemon default if 0
 
   std::vector<std::string> exclusiveNodes;
 
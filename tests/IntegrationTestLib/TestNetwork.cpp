@@ -31,6 +31,10 @@ void writeConfiguration(const std::string& confFile, const TestNodeConfiguration
     << "log-level=4" << std::endl
     << "log-file=" << cfg.logFile << std::endl;
 
+  if (cfg.syncMaxRequests != 0) {
+    config << "sync-max-requests=" << cfg.syncMaxRequests << std::endl;
+  }
+
   for (const auto& ex : cfg.exclusiveNodes) {
     config << "add-exclusive-node=" << ex << std::endl;
   }
@@ -6,6 +6,8 @@
 
 #include "TestWalletLegacy.h"
 
+#include <thread>
+
 namespace Tests
 {
 namespace Common
@@ -8,6 +8,8 @@
 
 #include <fstream>
 
+#include <boost/filesystem.hpp>
+
 #include <Common/StringTools.h>
 #include <System/Dispatcher.h>
 #include <System/Timer.h>
@@ -16,6 +18,7 @@
 #include <Serialization/JsonInputStreamSerializer.h>
 #include <Serialization/SerializationOverloads.h>
 
+#include "CryptoNoteCore/Account.h"
 #include "CryptoNoteCore/Currency.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "Wallet/WalletGreen.h"
@@ -205,7 +208,8 @@ TEST_F(NodeTest, generateBlockchain)
     std::string password = "pass";
     CryptoNote::WalletGreen wallet(dispatcher, currency, *mainNode, logger);
 
-    wallet.initialize(password);
+    boost::filesystem::remove("wallet.bin");
+    wallet.initialize("wallet.bin", password);
 
     std::string minerAddress = wallet.createAddress();
     daemon.startMining(1, minerAddress);
@@ -220,8 +224,7 @@ TEST_F(NodeTest, generateBlockchain)
 
     daemon.stopMining();
 
-    std::ofstream walletFile("wallet.bin", std::ios::binary | std::ios::trunc);
-    wallet.save(walletFile);
+    wallet.save();
     wallet.shutdown();
 
     dumpBlockchainInfo(*mainNode);
@@ -256,10 +259,7 @@ TEST_F(NodeTest, addMoreBlocks)
     std::string password = "pass";
     CryptoNote::WalletGreen wallet(dispatcher, currency, *mainNode, logger);
 
-    {
-      std::ifstream walletFile("wallet.bin", std::ios::binary);
-      wallet.load(walletFile, password);
-    }
+    wallet.load("wallet.bin", password);
 
     std::string minerAddress = wallet.getAddress(0);
     daemon.startMining(1, minerAddress);
@@ -274,8 +274,7 @@ TEST_F(NodeTest, addMoreBlocks)
 
     daemon.stopMining();
 
-    std::ofstream walletFile("wallet.bin", std::ios::binary | std::ios::trunc);
-    wallet.save(walletFile);
+    wallet.save();
     wallet.shutdown();
 
     dumpBlockchainInfo(*mainNode);
@@ -392,3 +391,53 @@ TEST_F(NodeTest, observerHeightNotifications)
     EXPECT_EQ(newKnownHeight, mainNode->getLastKnownBlockHeight());
   }
 }
+
+// Block download rate of a fresh node from a node ahead of it, with one and with the default number of block requests in flight
+TEST_F(NodeTest, syncRate)
+{
+  const uint32_t blockCount = 3000;
+  auto networkCfg = TestNetworkBuilder(3, Topology::Star).build();
+  networkCfg[0].exclusiveNodes.clear();
+  network.addNode(networkCfg[0]);
+  network.waitNodesReady();
+
+  auto &source = network.getNode(0);
+  AccountBase miner;
+  miner.generate();
+  std::string minerAddress = currency.accountAddressAsString(miner);
+  for (uint32_t i = 0; i < blockCount; ++i)
+  {
+    Block block;
+    uint64_t difficulty;
+    ASSERT_TRUE(source.getBlockTemplate(minerAddress, block, difficulty));
+    auto blockData = toBinaryArray(block);
+    ASSERT_TRUE(source.submitBlock(Common::toHex(blockData.data(), blockData.size())));
+  }
+
+  uint64_t sourceHeight = source.getLocalHeight();
+  ASSERT_EQ(blockCount + 1, sourceHeight);
+
+  networkCfg[1].syncMaxRequests = 1;
+  for (size_t index = 1; index < networkCfg.size(); ++index)
+  {
+    networkCfg[index].exclusiveNodes = {networkCfg[0].getP2pAddress()};
+    network.addNode(networkCfg[index]);
+    network.waitNodesReady();
+    auto &node = network.getNode(index);
+
+    // counted from the moment the daemon answers, not including its startup
+    auto start = std::chrono::steady_clock::now();
+    uint64_t startHeight = node.getLocalHeight();
+    System::Timer timer(dispatcher);
+    while (node.getLocalHeight() < sourceHeight)
+    {
+      ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::minutes(10));
+      timer.sleep(std::chrono::milliseconds(100));
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t synchronized = sourceHeight - startHeight;
+    std::cout << "Node " << index << " with " << (networkCfg[index].syncMaxRequests != 0 ? std::to_string(networkCfg[index].syncMaxRequests) : "default") <<
+      " requests in flight synchronized " << synchronized << " blocks in " << seconds << " s, " << synchronized / seconds << " blocks/s" << std::endl;
+  }
+}
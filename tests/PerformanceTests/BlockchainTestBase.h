@@ -0,0 +1,179 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/Blockchain.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "CryptoNoteCore/TransactionPool.h"
+
+#include "Logging/ConsoleLogger.h"
+
+// Mines a short chain to a single account in a temporary directory and reopens it as a
+// standalone Blockchain, the way core owns it. Proof of work isn't checked that low, so
+// mining is just asking the core for templates. The coinbases of the first spendableBlocks
+// blocks are unlocked at the top of the chain.
+class blockchain_test_base
+{
+protected:
+  struct storage
+  {
+    storage(const CryptoNote::Currency& currency, Logging::ILogger& logger) :
+      pool(currency, blockchain, timeProvider, logger),
+      blockchain(currency, pool, logger, false, false),
+      opened(false)
+    {
+    }
+
+    ~storage()
+    {
+      if (opened)
+      {
+        blockchain.deinit();
+        pool.deinit();
+      }
+    }
+
+    CryptoNote::RealTimeProvider timeProvider;
+    CryptoNote::tx_memory_pool pool;
+    CryptoNote::Blockchain blockchain;
+    bool opened;
+  };
+
+public:
+  blockchain_test_base() :
+    m_logger(Logging::ERROR),
+    m_currency(CryptoNote::CurrencyBuilder(m_logger).testnet(true).currency()),
+    m_dataDir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("performance_tests_%%%%%%%%"))
+  {
+  }
+
+  ~blockchain_test_base()
+  {
+    m_storage.reset();
+
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(m_dataDir, ignore);
+  }
+
+  bool init(uint32_t spendableBlocks)
+  {
+    using namespace CryptoNote;
+
+    m_miner.generate();
+    if (!boost::filesystem::create_directories(m_dataDir))
+      return false;
+
+    CoreConfig coreConfig;
+    coreConfig.configFolder = m_dataDir.string();
+
+    {
+      core miningCore(m_currency, nullptr, m_logger, false, false);
+      if (!miningCore.init(coreConfig, MinerConfig(), false))
+        return false;
+
+      uint32_t blockCount = spendableBlocks + static_cast<uint32_t>(m_currency.minedMoneyUnlockWindow());
+      for (uint32_t i = 0; i < blockCount; ++i)
+      {
+        Block block;
+        difficulty_type difficulty;
+        uint32_t height;
+        if (!miningCore.get_block_template(block, m_miner.getAccountKeys().address, difficulty, height, BinaryArray()) ||
+          !miningCore.handle_block_found(block))
+          return false;
+
+        if (i < spendableBlocks)
+          m_minerTransactions.push_back(block.baseTransaction);
+
+        m_minedBlocks.push_back(block);
+      }
+
+      miningCore.deinit();
+    }
+
+    return openStorage(m_dataDir, true, m_storage);
+  }
+
+  // A Blockchain with its pool on the given directory, a new one holds the genesis block only
+  bool openStorage(const boost::filesystem::path& directory, bool loadExisting, std::unique_ptr<storage>& result)
+  {
+    result.reset(new storage(m_currency, m_logger));
+    if (!result->pool.init(directory.string()) || !result->blockchain.init(directory.string(), loadExisting))
+    {
+      result.reset();
+      return false;
+    }
+
+    result->opened = true;
+    return true;
+  }
+
+  // Picks count outputs of the same amount from the spendable coinbases as the ring of a single input,
+  // the real one being in the middle
+  bool makeSource(size_t count, CryptoNote::TransactionSourceEntry& source)
+  {
+    using namespace CryptoNote;
+
+    std::map<uint64_t, std::vector<std::pair<size_t, size_t>>> outputsByAmount;
+    for (size_t i = 0; i < m_minerTransactions.size(); ++i)
+    {
+      for (size_t j = 0; j < m_minerTransactions[i].outputs.size(); ++j)
+      {
+        outputsByAmount[m_minerTransactions[i].outputs[j].amount].emplace_back(i, j);
+      }
+    }
+
+    for (const auto& amountOutputs : outputsByAmount)
+    {
+      if (amountOutputs.second.size() < count)
+        continue;
+
+      source.amount = amountOutputs.first;
+      source.outputs.clear();
+      for (size_t k = 0; k < count; ++k)
+      {
+        const Transaction& tx = m_minerTransactions[amountOutputs.second[k].first];
+        size_t outputIndex = amountOutputs.second[k].second;
+        std::vector<uint32_t> globalIndexes;
+        if (!m_storage->blockchain.getTransactionOutputGlobalIndexes(getObjectHash(tx), globalIndexes))
+          return false;
+
+        source.outputs.emplace_back(globalIndexes[outputIndex], boost::get<KeyOutput>(tx.outputs[outputIndex].target).key);
+        if (k == count / 2)
+        {
+          source.realOutput = k;
+          source.realTransactionPublicKey = getTransactionPublicKeyFromExtra(tx.extra);
+          source.realOutputIndexInTransaction = outputIndex;
+        }
+      }
+
+      return true;
+    }
+
+    return false;
+  }
+
+protected:
+  Logging::ConsoleLogger m_logger;
+  CryptoNote::Currency m_currency;
+  boost::filesystem::path m_dataDir;
+  CryptoNote::AccountBase m_miner;
+  std::vector<CryptoNote::Transaction> m_minerTransactions;
+  std::vector<CryptoNote::Block> m_minedBlocks;
+  std::unique_ptr<storage> m_storage;
+};
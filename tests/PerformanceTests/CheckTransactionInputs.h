@@ -0,0 +1,80 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <vector>
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/CryptoNoteBasic.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+
+#include "BlockchainTestBase.h"
+
+// Checks the inputs of a transaction with a single KeyInput the way pushBlock does, on a mined chain.
+// a_verified == false: the transaction wasn't seen before, Blockchain::validateTransactionInputs
+//                      checks the ring signature.
+// a_verified == true:  the pool already admitted it through Blockchain::checkTransactionInputs,
+//                      the rings are only resolved and the signature check is skipped on the cache hit.
+template<size_t a_ring_size, bool a_verified>
+class test_check_tx_inputs : private blockchain_test_base
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+
+public:
+  static const size_t loop_count = 1000;
+  static const size_t ring_size = a_ring_size;
+
+  bool init()
+  {
+    using namespace CryptoNote;
+
+    // enough coinbases for ring_size outputs of the same amount, unlocked at the top
+    if (!blockchain_test_base::init(static_cast<uint32_t>(ring_size * 2 + 4)))
+      return false;
+
+    std::vector<TransactionSourceEntry> sources(1);
+    if (!makeSource(ring_size, sources[0]))
+      return false;
+
+    m_alice.generate();
+
+    std::vector<TransactionDestinationEntry> destinations;
+    destinations.push_back(TransactionDestinationEntry(sources[0].amount, m_alice.getAccountKeys().address));
+    Crypto::SecretKey txSK;
+    if (!constructTransaction(m_miner.getAccountKeys(), sources, destinations, std::vector<uint8_t>(), m_tx, 0, m_logger, txSK))
+      return false;
+
+    m_txHash = getObjectHash(m_tx);
+
+    if (a_verified)
+    {
+      uint32_t maxUsedBlockHeight;
+      Crypto::Hash maxUsedBlockId;
+      if (!m_storage->blockchain.checkTransactionInputs(m_tx, maxUsedBlockHeight, maxUsedBlockId))
+        return false;
+    }
+
+    return m_storage->blockchain.isTransactionVerified(m_txHash) == a_verified;
+  }
+
+  bool test()
+  {
+    CryptoNote::Blockchain::TransactionInputsValidation validation;
+    if (a_verified)
+    {
+      return m_storage->blockchain.validateTransactionInputs(m_tx, validation, false) &&
+        m_storage->blockchain.isTransactionVerified(m_txHash);
+    }
+
+    return m_storage->blockchain.validateTransactionInputs(m_tx, validation, true);
+  }
+
+private:
+  CryptoNote::AccountBase m_alice;
+  CryptoNote::Transaction m_tx;
+  Crypto::Hash m_txHash;
+};
@@ -36,7 +36,7 @@ public:
 
   bool test() {
     Crypto::Hash hash;
-    Crypto::cn_slow_hash_v0(m_context, &m_data, sizeof(m_data), hash);
+    Crypto::cn_slow_hash(m_context, &m_data, sizeof(m_data), hash);
     return hash == m_expected_hash;
   }
 
@@ -0,0 +1,62 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "HTTP/HttpParser.h"
+
+// Parses a buffer of pipelined keep-alive requests, like a batch of json_rpc calls arriving on one connection
+template<size_t bodySize, bool chunked>
+class test_http_parse_requests {
+public:
+  static const size_t loop_count = bodySize < 65536 ? 10000 : 100;
+  static const size_t request_count = 16;
+  static const size_t chunk_size = 4096;
+
+  bool init() {
+    std::string body(bodySize, 'x');
+    for (size_t i = 0; i < request_count; ++i) {
+      m_data += "POST /json_rpc HTTP/1.1\r\nHost: 127.0.0.1:18180\r\nUser-Agent: performance_tests\r\nContent-Type: application/json\r\n";
+      if (chunked) {
+        m_data += "Transfer-Encoding: chunked\r\n\r\n";
+        for (size_t offset = 0; offset < body.size(); offset += chunk_size) {
+          size_t size = std::min(chunk_size, body.size() - offset);
+          char sizeLine[32];
+          snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", size);
+          m_data += sizeLine;
+          m_data.append(body, offset, size);
+          m_data += "\r\n";
+        }
+
+        m_data += "0\r\n\r\n";
+      } else {
+        m_data += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+      }
+    }
+
+    return true;
+  }
+
+  bool test() {
+    CryptoNote::HttpParser parser;
+    parser.append(m_data.data(), m_data.size());
+    for (size_t i = 0; i < request_count; ++i) {
+      if (!parser.parseRequest() || parser.getBody().getSize() != bodySize || parser.getHeader("host").isNil()) {
+        return false;
+      }
+
+      parser.consume();
+    }
+
+    return parser.getBufferedSize() == 0;
+  }
+
+private:
+  std::string m_data;
+};
@@ -0,0 +1,116 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/JsonValue.h"
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+#include "PaymentGate/PaymentServiceJsonRpcMessages.h"
+#include "Serialization/SerializationOverloads.h"
+#include "Serialization/SerializationTools.h"
+
+// Serializes a response carrying a thousand transactions, either through a JsonValue tree or straight into a string
+template<bool streaming>
+class test_json_serialize_transactions {
+public:
+  static const size_t loop_count = 100;
+  static const size_t transaction_count = 1000;
+  static const size_t input_count = 2;
+  static const size_t output_count = 3;
+  static const size_t mixin = 10;
+
+  struct response {
+    std::vector<CryptoNote::Transaction> txs;
+    std::string status;
+
+    void serialize(CryptoNote::ISerializer& s) {
+      KV_MEMBER(txs)
+      KV_MEMBER(status)
+    }
+  };
+
+  bool init() {
+    CryptoNote::Transaction tx;
+    tx.version = 1;
+    tx.unlockTime = 0;
+    for (size_t i = 0; i < input_count; ++i) {
+      CryptoNote::KeyInput input;
+      input.amount = 1000000 * (i + 1);
+      for (size_t j = 0; j < mixin; ++j) {
+        input.outputIndexes.push_back(static_cast<uint32_t>(12345 + j));
+      }
+
+      input.keyImage = Crypto::KeyImage();
+      tx.inputs.push_back(input);
+      tx.signatures.push_back(std::vector<Crypto::Signature>(mixin));
+    }
+
+    for (size_t i = 0; i < output_count; ++i) {
+      tx.outputs.push_back({ 500000 * (i + 1), CryptoNote::KeyOutput{ Crypto::PublicKey() } });
+    }
+
+    tx.extra.resize(67, 1);
+    m_response.txs.assign(transaction_count, tx);
+    m_response.status = "OK";
+    return true;
+  }
+
+  bool test() {
+    std::string json = streaming ? CryptoNote::storeToJson(m_response) : CryptoNote::storeToJsonValue(m_response).toString();
+    return json.size() > transaction_count * 1000;
+  }
+
+private:
+  response m_response;
+};
+
+// PaymentGate requests refuse to serialize on output when optional members exclude each other, so they are written by hand
+inline std::string makeJsonRequest(PaymentService::SendTransaction::Request&) {
+  const std::string address = "\"" + std::string(98, 'f') + "\"";
+  std::string json = "{\"addresses\":[" + address + "," + address + "],\"transfers\":[";
+  for (size_t i = 0; i < 20; ++i) {
+    json += (i == 0 ? "{\"address\":" : ",{\"address\":") + address + ",\"amount\":" + std::to_string(1000000000 + i) + "}";
+  }
+
+  return json + "],\"changeAddress\":" + address + ",\"fee\":800000,\"anonymity\":4,\"paymentId\":\"" + std::string(64, 'b') + "\",\"unlockTime\":0}";
+}
+
+inline std::string makeJsonRequest(PaymentService::GetTransactions::Request&) {
+  std::string json = "{\"addresses\":[";
+  for (size_t i = 0; i < 50; ++i) {
+    json += (i == 0 ? "\"" : ",\"") + std::string(98, 'f') + "\"";
+  }
+
+  return json + "],\"firstBlockIndex\":100000,\"blockCount\":1000,\"paymentId\":\"" + std::string(64, 'b') + "\"}";
+}
+
+// Deserializes a PaymentGate request either through a JsonValue tree or straight from the text
+template<typename Request, bool streaming>
+class test_json_parse_request {
+public:
+  static const size_t loop_count = 10000;
+
+  bool init() {
+    Request request;
+    m_json = makeJsonRequest(request);
+    return true;
+  }
+
+  bool test() {
+    Request request;
+    if (streaming) {
+      return CryptoNote::loadFromJson(request, m_json);
+    }
+
+    CryptoNote::loadFromJsonValue(request, Common::JsonValue::fromString(m_json));
+    return true;
+  }
+
+private:
+  std::string m_json;
+};
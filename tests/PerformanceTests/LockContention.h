@@ -0,0 +1,100 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "BlockchainTestBase.h"
+
+// Models RPC queries hitting the blockchain while it is syncing: reader threads look blocks up
+// by height, the way getblockheaderbyheight does, while the chain applies previously mined blocks.
+// Prints the sync rate without readers and with them, and the query throughput meanwhile.
+class test_lock_contention : private blockchain_test_base
+{
+public:
+  static const uint32_t block_count = 1000;
+  static const size_t reader_count = 8;
+
+  void run()
+  {
+    if (!init(block_count - static_cast<uint32_t>(m_currency.minedMoneyUnlockWindow())))
+    {
+      std::cout << "lock contention - FAILED" << std::endl;
+      return;
+    }
+
+    std::cout << "lock contention (syncing " << m_minedBlocks.size() << " blocks):" << std::endl;
+    measure(0);
+    measure(reader_count);
+  }
+
+private:
+  void measure(size_t readerCount)
+  {
+    std::unique_ptr<storage> target;
+    if (!openStorage(m_dataDir / ("sync" + std::to_string(readerCount)), false, target))
+    {
+      std::cout << "  " << readerCount << " readers - FAILED" << std::endl;
+      return;
+    }
+
+    CryptoNote::Blockchain& blockchain = target->blockchain;
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> queries(0);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < readerCount; ++i)
+    {
+      readers.emplace_back([&, i] {
+        uint64_t random = i;
+        uint64_t count = 0;
+        while (!stop)
+        {
+          random = random * 2862933555777941757ULL + 3037000493ULL;
+          uint32_t height = static_cast<uint32_t>(random % blockchain.getCurrentBlockchainHeight());
+          CryptoNote::Block block;
+          if (blockchain.getBlockByHash(blockchain.getBlockIdByHeight(height), block))
+          {
+            ++count;
+          }
+        }
+
+        queries += count;
+      });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    size_t added = 0;
+    for (const CryptoNote::Block& block : m_minedBlocks)
+    {
+      CryptoNote::block_verification_context bvc = boost::value_initialized<CryptoNote::block_verification_context>();
+      blockchain.addNewBlock(block, bvc);
+      if (bvc.m_added_to_main_chain)
+      {
+        ++added;
+      }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stop = true;
+    for (auto& reader : readers)
+    {
+      reader.join();
+    }
+
+    std::cout << "  " << readerCount << " readers - " << static_cast<uint64_t>(added / elapsed.count()) << " blocks/sec";
+    if (readerCount != 0)
+    {
+      std::cout << ", " << static_cast<uint64_t>(queries / elapsed.count()) << " queries/sec";
+    }
+
+    std::cout << (added == m_minedBlocks.size() ? "" : " (some blocks were rejected)") << std::endl;
+  }
+};
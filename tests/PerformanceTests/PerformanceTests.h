@@ -7,6 +7,7 @@
 
 #include <iostream>
 #include <stdint.h>
+#include <string>
 
 #include <boost/chrono.hpp>
 
@@ -31,6 +32,12 @@ public:
     return static_cast<int>(boost::chrono::duration_cast<boost::chrono::milliseconds>(elapsed).count());
   }
 
+  int64_t elapsed_us()
+  {
+    clock::duration elapsed = clock::now() - m_start;
+    return boost::chrono::duration_cast<boost::chrono::microseconds>(elapsed).count();
+  }
+
 private:
   clock::time_point m_base;
   clock::time_point m_start;
@@ -63,17 +70,18 @@ public:
       if (!test.test())
         return false;
     }
-    m_elapsed = timer.elapsed_ms();
+    m_elapsed = timer.elapsed_us();
 
     return true;
   }
 
-  int elapsed_time() const { return m_elapsed; }
+  int elapsed_time() const { return static_cast<int>(m_elapsed / 1000); }
 
-  int time_per_call() const
+  // in microseconds, most of the calls take less than a millisecond
+  int64_t time_per_call() const
   {
     static_assert(0 < T::loop_count, "T::loop_count must be greater than 0");
-    return m_elapsed / T::loop_count;
+    return m_elapsed / static_cast<int64_t>(T::loop_count);
   }
 
 private:
@@ -93,23 +101,41 @@ private:
 
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
-  int m_elapsed;
+  int64_t m_elapsed;
 };
 
+// Only the tests whose name contains it are run, all of them if it is empty
+inline std::string& test_filter()
+{
+  static std::string filter;
+  return filter;
+}
+
+// Number of the tests that failed so far, main() exits with an error if any did
+inline size_t& failed_tests()
+{
+  static size_t count = 0;
+  return count;
+}
+
 template <typename T>
 void run_test(const char* test_name)
 {
+  if (std::string(test_name).find(test_filter()) == std::string::npos)
+    return;
+
   test_runner<T> runner;
   if (runner.run())
   {
     std::cout << test_name << " - OK:\n";
     std::cout << "  loop count:    " << T::loop_count << '\n';
     std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
-    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n" << std::endl;
+    std::cout << "  time per call: " << runner.time_per_call() << " us/call\n" << std::endl;
   }
   else
   {
     std::cout << test_name << " - FAILED" << std::endl;
+    ++failed_tests();
   }
 }
 
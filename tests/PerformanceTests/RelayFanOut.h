@@ -0,0 +1,69 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+#include "P2p/NetNode.h"
+
+// Queues a relayed block to every peer the way NodeServer::relay_notify_to_all does, either copying the
+// payload into each message as before or sharing one buffer between them. Prints the payload memory
+// held by the write queues per relayed block, the time per call is the dispatcher time spent on the fan-out.
+template<size_t peerCount, bool shared>
+class test_relay_block {
+public:
+  static const size_t loop_count = 100;
+  static const size_t block_size = 512 * 1024;
+
+  bool init() {
+    m_block.resize(block_size);
+    for (size_t i = 0; i < m_block.size(); ++i) {
+      m_block[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    if (!test()) {
+      return false;
+    }
+
+    std::unordered_set<const CryptoNote::BinaryArray*> buffers;
+    size_t bytes = 0;
+    for (const std::vector<CryptoNote::P2pMessage>& queue : m_writeQueues) {
+      for (const CryptoNote::P2pMessage& message : queue) {
+        if (buffers.insert(message.buffer.get()).second) {
+          bytes += message.buffer->capacity();
+        }
+      }
+    }
+
+    std::cout << "relay of a " << block_size / 1024 << " KiB block to " << peerCount << " peers" << (shared ? ", shared payload" : ", copied payload") <<
+      ": " << buffers.size() << " buffers, " << bytes / 1024 << " KiB queued" << std::endl;
+    return true;
+  }
+
+  bool test() {
+    m_writeQueues.clear();
+    m_writeQueues.resize(peerCount);
+    if (shared) {
+      auto payload = std::make_shared<const CryptoNote::BinaryArray>(m_block);
+      for (std::vector<CryptoNote::P2pMessage>& queue : m_writeQueues) {
+        queue.push_back(CryptoNote::P2pMessage(CryptoNote::P2pMessage::NOTIFY, m_command, payload));
+      }
+    } else {
+      for (std::vector<CryptoNote::P2pMessage>& queue : m_writeQueues) {
+        queue.push_back(CryptoNote::P2pMessage(CryptoNote::P2pMessage::NOTIFY, m_command, m_block));
+      }
+    }
+
+    return m_writeQueues.back().back().size() == block_size;
+  }
+
+private:
+  static const uint32_t m_command = 2001;
+  CryptoNote::BinaryArray m_block;
+  std::vector<std::vector<CryptoNote::P2pMessage>> m_writeQueues;
+};
@@ -0,0 +1,177 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "BlockchainTestBase.h"
+
+// Replays mined blocks carrying transactions into an empty core the way processObjects does during sync:
+// once through the transaction pool (handle_incoming_tx kept by block, then handle_incoming_block) and
+// once through core::importBlock. Only the blocks with transactions are timed.
+class test_resync : private blockchain_test_base
+{
+public:
+  static const size_t block_count = 100;
+  static const size_t transactions_per_block = 10;
+
+  void run()
+  {
+    if (!init(static_cast<uint32_t>(block_count * transactions_per_block / 4)) || !mineTransactions())
+    {
+      std::cout << "resync - FAILED" << std::endl;
+      return;
+    }
+
+    std::cout << "resync (" << m_transactionBlocks.size() << " blocks, " << m_transactionBlobs.size() << " transactions):" << std::endl;
+    measure("pool", true);
+    measure("import", false);
+  }
+
+private:
+  // Spends the spendable coinbases one output at a time, transactions_per_block transactions per block
+  bool mineTransactions()
+  {
+    using namespace CryptoNote;
+
+    std::vector<Transaction> transactions;
+    for (const Transaction& minerTx : m_minerTransactions)
+    {
+      std::vector<uint32_t> globalIndexes;
+      if (!m_storage->blockchain.getTransactionOutputGlobalIndexes(getObjectHash(minerTx), globalIndexes))
+        return false;
+
+      for (size_t i = 0; i < minerTx.outputs.size() && transactions.size() < block_count * transactions_per_block; ++i)
+      {
+        uint64_t amount = minerTx.outputs[i].amount;
+        if (amount <= m_currency.minimumFee())
+          continue;
+
+        std::vector<TransactionSourceEntry> sources(1);
+        sources[0].amount = amount;
+        sources[0].outputs.emplace_back(globalIndexes[i], boost::get<KeyOutput>(minerTx.outputs[i].target).key);
+        sources[0].realOutput = 0;
+        sources[0].realTransactionPublicKey = getTransactionPublicKeyFromExtra(minerTx.extra);
+        sources[0].realOutputIndexInTransaction = i;
+
+        std::vector<TransactionDestinationEntry> destinations;
+        destinations.push_back(TransactionDestinationEntry(amount - m_currency.minimumFee(), m_miner.getAccountKeys().address));
+        Transaction tx;
+        Crypto::SecretKey txKey;
+        if (!constructTransaction(m_miner.getAccountKeys(), sources, destinations, std::vector<uint8_t>(), tx, 0, m_logger, txKey))
+          return false;
+
+        transactions.push_back(tx);
+      }
+    }
+
+    m_storage.reset();
+
+    core miningCore(m_currency, nullptr, m_logger, false, false);
+    CoreConfig coreConfig;
+    coreConfig.configFolder = m_dataDir.string();
+    if (!miningCore.init(coreConfig, MinerConfig(), true))
+      return false;
+
+    for (size_t first = 0; first < transactions.size(); first += transactions_per_block)
+    {
+      size_t last = std::min(first + transactions_per_block, transactions.size());
+      for (size_t i = first; i < last; ++i)
+      {
+        BinaryArray blob = toBinaryArray(transactions[i]);
+        tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+        if (!miningCore.handle_incoming_tx(blob, tvc, false) || !tvc.m_added_to_pool)
+          return false;
+
+        m_transactionBlobs[getObjectHash(transactions[i])] = blob;
+      }
+
+      Block block;
+      difficulty_type difficulty;
+      uint32_t height;
+      if (!miningCore.get_block_template(block, m_miner.getAccountKeys().address, difficulty, height, BinaryArray()) ||
+        block.transactionHashes.size() != last - first || !miningCore.handle_block_found(block))
+        return false;
+
+      m_transactionBlocks.push_back(block);
+    }
+
+    miningCore.deinit();
+    return true;
+  }
+
+  void measure(const char* name, bool throughPool)
+  {
+    using namespace CryptoNote;
+
+    boost::filesystem::path directory = m_dataDir / name;
+    boost::filesystem::create_directories(directory);
+    core target(m_currency, nullptr, m_logger, false, false);
+    CoreConfig coreConfig;
+    coreConfig.configFolder = directory.string();
+    if (!target.init(coreConfig, MinerConfig(), false))
+    {
+      std::cout << "  " << name << " - FAILED" << std::endl;
+      return;
+    }
+
+    bool added = true;
+    for (const Block& block : m_minedBlocks)
+      added = added && addBlock(target, block, throughPool);
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Block& block : m_transactionBlocks)
+      added = added && addBlock(target, block, throughPool);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    target.deinit();
+
+    if (!added)
+    {
+      std::cout << "  " << name << " - FAILED" << std::endl;
+      return;
+    }
+
+    std::cout << "  " << name << " - " << static_cast<uint64_t>(m_transactionBlocks.size() / elapsed.count()) << " blocks/sec, " <<
+      static_cast<uint64_t>(m_transactionBlobs.size() / elapsed.count()) << " transactions/sec" << std::endl;
+  }
+
+  bool addBlock(CryptoNote::ICore& target, const CryptoNote::Block& block, bool throughPool)
+  {
+    using namespace CryptoNote;
+
+    std::vector<BinaryArray> blobs;
+    for (const Crypto::Hash& transactionHash : block.transactionHashes)
+      blobs.push_back(m_transactionBlobs[transactionHash]);
+
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    if (throughPool)
+    {
+      for (const BinaryArray& blob : blobs)
+      {
+        tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+        target.handle_incoming_tx(blob, tvc, true);
+        if (tvc.m_verification_failed)
+          return false;
+      }
+
+      target.handle_incoming_block(block, bvc, false, false);
+    }
+    else
+    {
+      target.importBlock(block, blobs, bvc, nullptr);
+    }
+
+    return bvc.m_added_to_main_chain;
+  }
+
+  std::vector<CryptoNote::Block> m_transactionBlocks;
+  std::unordered_map<Crypto::Hash, CryptoNote::BinaryArray> m_transactionBlobs;
+};
@@ -9,16 +9,43 @@
 // tests
 #include "ConstructTransaction.h"
 #include "CheckRingSignature.h"
+#include "CheckTransactionInputs.h"
 #include "CryptoNoteSlowHash.h"
 #include "DerivePublicKey.h"
 #include "DeriveSecretKey.h"
 #include "GenerateKeyDerivation.h"
 #include "GenerateKeyImage.h"
 #include "GenerateKeyImageHelper.h"
+#include "HttpParsing.h"
 #include "IsOutToAccount.h"
+#include "JsonSerialization.h"
+#include "LockContention.h"
+#include "RelayFanOut.h"
+#include "Resync.h"
 
 int main(int argc, char** argv)
 {
+  // --lock-contention: also measure RPC reads during sync, --resync: also measure the sync rate
+  // through the pool and through core::importBlock, the other argument filters the tests by name
+  bool lockContention = false;
+  bool resync = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--lock-contention")
+      lockContention = true;
+    else if (std::string(argv[i]) == "--resync")
+      resync = true;
+    else
+      test_filter() = argv[i];
+  }
+
+  // runs before the process is pinned to a single core
+  if (lockContention)
+    test_lock_contention().run();
+
+  if (resync)
+    test_resync().run();
+
   set_process_affinity(1);
   set_thread_high_priority();
 
@@ -51,6 +78,11 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_check_ring_signature, 10);
   TEST_PERFORMANCE1(test_check_ring_signature, 100);
 
+  TEST_PERFORMANCE2(test_check_tx_inputs, 2, false);
+  TEST_PERFORMANCE2(test_check_tx_inputs, 2, true);
+  TEST_PERFORMANCE2(test_check_tx_inputs, 10, false);
+  TEST_PERFORMANCE2(test_check_tx_inputs, 10, true);
+
   TEST_PERFORMANCE0(test_is_out_to_acc);
   TEST_PERFORMANCE0(test_generate_key_image_helper);
   TEST_PERFORMANCE0(test_generate_key_derivation);
@@ -60,7 +92,24 @@ int main(int argc, char** argv)
 
   TEST_PERFORMANCE0(test_cn_slow_hash);
 
+  TEST_PERFORMANCE2(test_http_parse_requests, 256, false);
+  TEST_PERFORMANCE2(test_http_parse_requests, 1048576, false);
+  TEST_PERFORMANCE2(test_http_parse_requests, 1048576, true);
+
+  TEST_PERFORMANCE1(test_json_serialize_transactions, false);
+  TEST_PERFORMANCE1(test_json_serialize_transactions, true);
+
+  TEST_PERFORMANCE2(test_json_parse_request, PaymentService::SendTransaction::Request, false);
+  TEST_PERFORMANCE2(test_json_parse_request, PaymentService::SendTransaction::Request, true);
+  TEST_PERFORMANCE2(test_json_parse_request, PaymentService::GetTransactions::Request, false);
+  TEST_PERFORMANCE2(test_json_parse_request, PaymentService::GetTransactions::Request, true);
+
+  TEST_PERFORMANCE2(test_relay_block, 8, false);
+  TEST_PERFORMANCE2(test_relay_block, 8, true);
+  TEST_PERFORMANCE2(test_relay_block, 128, false);
+  TEST_PERFORMANCE2(test_relay_block, 128, true);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
-  return 0;
+  return failed_tests() == 0 ? 0 : 1;
 }
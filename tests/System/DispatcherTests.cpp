@@ -3,12 +3,19 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chrono>
 #include <future>
+#include <iostream>
+#include <memory>
+#include <thread>
 #include <System/Context.h>
 #include <System/Dispatcher.h>
 #include <System/Event.h>
 #include <System/Timer.h>
 #include <gtest/gtest.h>
+#ifdef __linux__
+#include <System/ContextSwitch.h>
+#endif
 
 using namespace System;
 
@@ -374,3 +381,129 @@ TEST_F(DispatcherTests, yieldExecutesIoOnItsFront) {
   dispatcher.yield();
   ASSERT_TRUE(spawnDone);
 }
+
+TEST_F(DispatcherTests, contextSwitchRate) {
+#ifdef SYSTEM_REGISTER_CONTEXT_SWITCH
+  const char* backend = "register context switch";
+#else
+  const char* backend = "platform context switch";
+#endif
+  const size_t SWITCH_COUNT = 1000000;
+  size_t switches = 0;
+  auto start = std::chrono::steady_clock::now();
+  {
+    // both contexts queue themselves and dispatch the other one, no system calls besides the switch itself
+    Context<> context(dispatcher, [&]() {
+      while (switches < SWITCH_COUNT) {
+        ++switches;
+        dispatcher.pushContext(dispatcher.getCurrentContext());
+        dispatcher.dispatch();
+      }
+    });
+
+    while (switches < SWITCH_COUNT) {
+      ++switches;
+      dispatcher.pushContext(dispatcher.getCurrentContext());
+      dispatcher.dispatch();
+    }
+  }
+
+  auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+  std::cout << backend << ": " << static_cast<uint64_t>(switches / seconds) << " switches per second" << std::endl;
+  ASSERT_GE(switches, SWITCH_COUNT);
+}
+
+TEST_F(DispatcherTests, stackSizeIsConfigurable) {
+  Dispatcher smallStackDispatcher(128 * 1024);
+  ASSERT_EQ(128 * 1024, smallStackDispatcher.getStackStatistics().stackSize);
+  size_t defaultStackSize = Dispatcher::DEFAULT_STACK_SIZE;
+  ASSERT_EQ(defaultStackSize, dispatcher.getStackStatistics().stackSize);
+}
+
+TEST_F(DispatcherTests, finishedContextsKeepTheirStacksForReuse) {
+  ASSERT_EQ(0, dispatcher.getStackStatistics().stackCount);
+  {
+    Event event(dispatcher);
+    Context<> context1(dispatcher, [&]() { event.wait(); });
+    Context<> context2(dispatcher, [&]() { event.wait(); });
+    dispatcher.yield();
+    ASSERT_EQ(2, dispatcher.getStackStatistics().stackCount);
+    ASSERT_EQ(0, dispatcher.getStackStatistics().reusableStackCount);
+    ASSERT_GT(dispatcher.getStackStatistics().residentBytes, 0);
+    event.set();
+  }
+
+  ASSERT_EQ(2, dispatcher.getStackStatistics().reusableStackCount);
+  Context<> context(dispatcher, []() {});
+  context.get();
+  ASSERT_EQ(2, dispatcher.getStackStatistics().stackCount);
+}
+
+namespace {
+size_t recurse(size_t depth) {
+  volatile uint8_t frame[1024];
+  frame[0] = static_cast<uint8_t>(depth);
+  return depth == 0 ? frame[0] : recurse(depth - 1) + frame[0];
+}
+}
+
+#ifdef __linux__
+TEST_F(DispatcherTests, stacksAboveReuseLimitAreReleased) {
+  const size_t CONTEXT_COUNT = 256;
+  size_t residentBytes;
+  {
+    Event event(dispatcher);
+    std::vector<std::unique_ptr<Context<>>> contexts;
+    for (size_t i = 0; i < CONTEXT_COUNT; ++i) {
+      contexts.emplace_back(new Context<>(dispatcher, [&]() {
+        recurse(64);
+        event.wait();
+      }));
+    }
+
+    dispatcher.yield();
+    residentBytes = dispatcher.getStackStatistics().residentBytes;
+    ASSERT_GE(residentBytes, CONTEXT_COUNT * 64 * 1024);
+    event.set();
+  }
+
+  ASSERT_EQ(CONTEXT_COUNT, dispatcher.getStackStatistics().reusableStackCount);
+  ASSERT_LT(dispatcher.getStackStatistics().residentBytes, residentBytes / 2);
+}
+
+TEST_F(DispatcherTests, stacksAboveReusableLimitAreUnmapped) {
+  const size_t MAX_CONTEXTS = Dispatcher::MAX_REUSABLE_CONTEXTS;
+  const size_t CONTEXT_COUNT = MAX_CONTEXTS + 16;
+  Dispatcher smallStackDispatcher(64 * 1024);
+  {
+    Event event(smallStackDispatcher);
+    std::vector<std::unique_ptr<Context<>>> contexts;
+    for (size_t i = 0; i < CONTEXT_COUNT; ++i) {
+      contexts.emplace_back(new Context<>(smallStackDispatcher, [&]() { event.wait(); }));
+    }
+
+    smallStackDispatcher.yield();
+    ASSERT_EQ(CONTEXT_COUNT, smallStackDispatcher.getStackStatistics().stackCount);
+    event.set();
+  }
+
+  ASSERT_EQ(MAX_CONTEXTS, smallStackDispatcher.getStackStatistics().stackCount);
+  ASSERT_EQ(MAX_CONTEXTS, smallStackDispatcher.getStackStatistics().reusableStackCount);
+
+  std::vector<std::unique_ptr<Context<>>> contexts;
+  for (size_t i = 0; i < CONTEXT_COUNT; ++i) {
+    contexts.emplace_back(new Context<>(smallStackDispatcher, []() {}));
+  }
+
+  contexts.clear();
+  ASSERT_EQ(MAX_CONTEXTS, smallStackDispatcher.getStackStatistics().stackCount);
+}
+
+TEST_F(DispatcherTests, stackOverflowHitsGuardPage) {
+  ASSERT_DEATH({
+    Dispatcher smallStackDispatcher(64 * 1024);
+    Context<size_t> context(smallStackDispatcher, []() { return recurse(1024); });
+    context.get();
+  }, "");
+}
+#endif
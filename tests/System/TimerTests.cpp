@@ -3,7 +3,9 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <iostream>
 #include <thread>
+#include <vector>
 #include <System/Context.h>
 #include <System/Dispatcher.h>
 #include <System/ContextGroup.h>
@@ -266,3 +268,46 @@ TEST_F(TimerTests, timerWithZeroTimeIsYielding) {
   Timer(dispatcher).sleep(std::chrono::milliseconds(0));
   ASSERT_TRUE(done);
 }
+
+TEST_F(TimerTests, timersExpireInOrderOfDuration) {
+  std::vector<int> order;
+  for (int duration : {40, 10, 30, 20}) {
+    contextGroup.spawn([&, duration]() {
+      Timer(dispatcher).sleep(std::chrono::milliseconds(duration));
+      order.push_back(duration);
+    });
+  }
+
+  contextGroup.wait();
+  ASSERT_EQ(std::vector<int>({10, 20, 30, 40}), order);
+}
+
+TEST_F(TimerTests, tenThousandConcurrentTimeouts) {
+  const size_t TIMER_COUNT = 10000;
+  size_t expired = 0;
+  size_t interrupted = 0;
+  auto start = std::chrono::steady_clock::now();
+  {
+    ContextGroup timeouts(dispatcher);
+    for (size_t i = 0; i < TIMER_COUNT; ++i) {
+      timeouts.spawn([&, i]() {
+        try {
+          // every other timeout is cancelled before it expires, like an operation that completes in time
+          Timer(dispatcher).sleep(std::chrono::milliseconds(i % 2 == 0 ? 50 + i % 200 : 60000));
+          ++expired;
+        } catch (InterruptedException&) {
+          ++interrupted;
+        }
+      });
+    }
+
+    Timer(dispatcher).sleep(std::chrono::milliseconds(300));
+    timeouts.interrupt();
+    timeouts.wait();
+  }
+
+  auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  std::cout << TIMER_COUNT << " concurrent timeouts: " << milliseconds << " ms" << std::endl;
+  ASSERT_EQ(TIMER_COUNT / 2, expired);
+  ASSERT_EQ(TIMER_COUNT / 2, interrupted);
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef __linux__
+#include <vector>
+#include <System/TimerWheel.h>
+#include <gtest/gtest.h>
+
+using namespace System;
+
+namespace {
+
+std::vector<uint64_t> expireTimes(TimerContext* timer) {
+  std::vector<uint64_t> times;
+  for (; timer != nullptr; timer = timer->next) {
+    times.push_back(timer->expireTime);
+  }
+
+  return times;
+}
+
+}
+
+TEST(TimerWheelTests, emptyWheelHasNoNextTime) {
+  TimerWheel wheel;
+  ASSERT_TRUE(wheel.empty());
+  ASSERT_EQ(TimerWheel::NO_TIMERS, wheel.getNextTime());
+  ASSERT_EQ(nullptr, wheel.advance(1000));
+  ASSERT_EQ(1000, wheel.getCurrentTime());
+}
+
+TEST(TimerWheelTests, timersExpireExactlyAtTheirTimeOnEveryLevel) {
+  TimerWheel wheel;
+  wheel.advance(1000);
+  std::vector<uint64_t> delays = {1, 2, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000, 20000000, 3000000000, 100000000000};
+  std::vector<TimerContext> timers(delays.size());
+  for (size_t i = 0; i < delays.size(); ++i) {
+    wheel.insert(timers[i], 1000 + delays[i]);
+  }
+
+  ASSERT_EQ(delays.size(), wheel.size());
+  for (uint64_t delay : delays) {
+    // nothing expires before the timer, and it expires alone
+    ASSERT_EQ(std::vector<uint64_t>(), expireTimes(wheel.advance(1000 + delay - 1)));
+    ASSERT_EQ(std::vector<uint64_t>({1000 + delay}), expireTimes(wheel.advance(1000 + delay)));
+  }
+
+  ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTests, nextTimeIsNeverAfterTheEarliestTimer) {
+  TimerWheel wheel;
+  wheel.advance(123456);
+  TimerContext timer;
+  wheel.insert(timer, 123456 + 5000);
+  uint64_t time = wheel.getCurrentTime();
+  size_t wakeUps = 0;
+  while (!wheel.empty()) {
+    time = wheel.getNextTime();
+    ASSERT_LE(time, 123456 + 5000);
+    wheel.advance(time);
+    ++wakeUps;
+  }
+
+  ASSERT_EQ(123456 + 5000, time);
+  ASSERT_LT(wakeUps, 4);
+}
+
+TEST(TimerWheelTests, removedTimersDoNotExpire) {
+  TimerWheel wheel;
+  std::vector<TimerContext> timers(100);
+  for (size_t i = 0; i < timers.size(); ++i) {
+    wheel.insert(timers[i], 10 + i * 100);
+  }
+
+  for (size_t i = 0; i < timers.size(); i += 2) {
+    wheel.remove(timers[i]);
+  }
+
+  ASSERT_EQ(50, wheel.size());
+  std::vector<uint64_t> expected;
+  for (size_t i = 1; i < timers.size(); i += 2) {
+    expected.push_back(10 + i * 100);
+  }
+
+  std::vector<uint64_t> expired;
+  while (!wheel.empty()) {
+    auto times = expireTimes(wheel.advance(wheel.getNextTime()));
+    expired.insert(expired.end(), times.begin(), times.end());
+  }
+
+  ASSERT_EQ(expected, expired);
+}
+
+TEST(TimerWheelTests, timersInThePastExpireOnNextAdvance) {
+  TimerWheel wheel;
+  wheel.advance(500);
+  TimerContext timer;
+  wheel.insert(timer, 100);
+  ASSERT_EQ(501, wheel.getNextTime());
+  ASSERT_EQ(std::vector<uint64_t>({501}), expireTimes(wheel.advance(1000)));
+}
+#endif
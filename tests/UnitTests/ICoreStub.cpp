@@ -101,6 +101,14 @@ std::vector<CryptoNote::Transaction> ICoreStub::getPoolTransactions() {
   return std::vector<CryptoNote::Transaction>();
 }
 
+std::vector<Crypto::Hash> ICoreStub::getPoolTransactionIds() {
+  std::vector<Crypto::Hash> ids;
+  for (const auto& entry : transactionPool) {
+    ids.push_back(entry.first);
+  }
+  return ids;
+}
+
 bool ICoreStub::getPoolChanges(const Crypto::Hash& tailBlockId, const std::vector<Crypto::Hash>& knownTxsIds,
                                std::vector<CryptoNote::Transaction>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) {
   std::unordered_set<Crypto::Hash> knownSet;
@@ -137,6 +145,11 @@ bool ICoreStub::getPoolChangesLite(const Crypto::Hash& tailBlockId, const std::v
   return returnStatus;
 }
 
+bool ICoreStub::getPoolChanges(const CryptoNote::TransactionPoolSketch& knownTxsSketch, std::vector<CryptoNote::Transaction>& addedTxs,
+                               std::vector<uint64_t>& deletedTxsShortIds) {
+  return false;
+}
+
 void ICoreStub::getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vector<CryptoNote::Transaction>& addedTxs,
                                std::vector<Crypto::Hash>& deletedTxsIds) {
 }
@@ -239,6 +252,26 @@ void ICoreStub::getTransactions(const std::vector<Crypto::Hash>& txs_ids, std::l
   }
 }
 
+bool ICoreStub::getTransaction(const Crypto::Hash& id, CryptoNote::Transaction& tx, bool checkTxPool) {
+  auto iter = transactions.find(id);
+  if (iter != transactions.end()) {
+    tx = iter->second;
+    return true;
+  }
+
+  return checkTxPool && getPoolTransaction(id, tx);
+}
+
+bool ICoreStub::getPoolTransaction(const Crypto::Hash& tx_hash, CryptoNote::Transaction& transaction) {
+  auto iter = transactionPool.find(tx_hash);
+  if (iter == transactionPool.end()) {
+    return false;
+  }
+
+  transaction = iter->second;
+  return true;
+}
+
 bool ICoreStub::getBackwardBlocksSizes(uint32_t fromHeight, std::vector<size_t>& sizes, size_t count) {
   return true;
 }
@@ -251,7 +284,7 @@ bool ICoreStub::getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& gen
   return true;
 }
 
-bool ICoreStub::getBlockReward(size_t medianSize, size_t currentBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint32_t height,
+bool ICoreStub::getBlockReward(uint8_t blockMajorVersion, size_t medianSize, size_t currentBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint32_t height,
     uint64_t& reward, int64_t& emissionChange) {
   return true;
 }
@@ -303,6 +336,11 @@ void ICoreStub::addTransaction(const CryptoNote::Transaction& tx) {
   transactions.emplace(std::make_pair(hash, tx));
 }
 
+void ICoreStub::addPoolTransaction(const CryptoNote::Transaction& tx) {
+  Crypto::Hash hash = CryptoNote::getObjectHash(tx);
+  transactionPool.emplace(std::make_pair(hash, tx));
+}
+
 bool ICoreStub::getGeneratedTransactionsNumber(uint32_t height, uint64_t& generatedTransactions) {
   return true;
 }
@@ -343,6 +381,10 @@ bool ICoreStub::have_block(const Crypto::Hash& id) {
   return blocks.count(id) > 0;
 }
 
+bool ICoreStub::have_transaction(const Crypto::Hash& id) {
+  return transactions.count(id) > 0 || transactionPool.count(id) > 0;
+}
+
 void ICoreStub::setPoolTxVerificationResult(bool result) {
   poolTxVerificationResult = result;
 }
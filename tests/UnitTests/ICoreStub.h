@@ -34,10 +34,13 @@ public:
   virtual CryptoNote::i_cryptonote_protocol* get_protocol() override;
   virtual bool handle_incoming_tx(CryptoNote::BinaryArray const& tx_blob, CryptoNote::tx_verification_context& tvc, bool keeped_by_block) override;
   virtual std::vector<CryptoNote::Transaction> getPoolTransactions() override;
+  virtual std::vector<Crypto::Hash> getPoolTransactionIds() override;
   virtual bool getPoolChanges(const Crypto::Hash& tailBlockId, const std::vector<Crypto::Hash>& knownTxsIds,
                               std::vector<CryptoNote::Transaction>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) override;
   virtual bool getPoolChangesLite(const Crypto::Hash& tailBlockId, const std::vector<Crypto::Hash>& knownTxsIds,
           std::vector<CryptoNote::TransactionPrefixInfo>& addedTxs, std::vector<Crypto::Hash>& deletedTxsIds) override;
+  virtual bool getPoolChanges(const CryptoNote::TransactionPoolSketch& knownTxsSketch, std::vector<CryptoNote::Transaction>& addedTxs,
+                              std::vector<uint64_t>& deletedTxsShortIds) override;
   virtual void getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vector<CryptoNote::Transaction>& addedTxs,
                               std::vector<Crypto::Hash>& deletedTxsIds) override;
   virtual bool queryBlocks(const std::vector<Crypto::Hash>& block_ids, uint64_t timestamp,
@@ -46,13 +49,18 @@ public:
     uint32_t& start_height, uint32_t& current_height, uint32_t& full_offset, std::vector<CryptoNote::BlockShortInfo>& entries) override;
 
   virtual bool have_block(const Crypto::Hash& id) override;
+  virtual bool have_transaction(const Crypto::Hash& id) override;
   std::vector<Crypto::Hash> buildSparseChain() override;
   std::vector<Crypto::Hash> buildSparseChain(const Crypto::Hash& startBlockId) override;
   virtual bool get_stat_info(CryptoNote::core_stat_info& st_inf) override { return false; }
   virtual bool on_idle() override { return false; }
   virtual void pause_mining() override {}
   virtual void update_block_template_and_resume_mining() override {}
+  virtual bool saveBlockchain() override { return true; }
+  virtual bool handle_incoming_block(const CryptoNote::Block& b, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) override { return false; }
   virtual bool handle_incoming_block_blob(const CryptoNote::BinaryArray& block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) override { return false; }
+  virtual bool importBlock(const CryptoNote::Block& block, const std::vector<CryptoNote::BinaryArray>& transactions, CryptoNote::block_verification_context& bvc, const Crypto::Hash* proofOfWork) override { return false; }
+  virtual std::vector<Crypto::Hash> computeProofsOfWork(const std::vector<const CryptoNote::Block*>& blocks) override { return std::vector<Crypto::Hash>(blocks.size(), CryptoNote::NULL_HASH); }
   virtual bool handle_get_objects(CryptoNote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, CryptoNote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) override { return false; }
   virtual void on_synchronized() override {}
   virtual bool getOutByMSigGIndex(uint64_t amount, uint64_t gindex, CryptoNote::MultisignatureOutput& out) override { return true; }
@@ -62,10 +70,12 @@ public:
   virtual bool getBlockByHash(const Crypto::Hash &h, CryptoNote::Block &blk) override;
   virtual bool getBlockHeight(const Crypto::Hash& blockId, uint32_t& blockHeight) override;
   virtual void getTransactions(const std::vector<Crypto::Hash>& txs_ids, std::list<CryptoNote::Transaction>& txs, std::list<Crypto::Hash>& missed_txs, bool checkTxPool = false) override;
+  virtual bool getTransaction(const Crypto::Hash& id, CryptoNote::Transaction& tx, bool checkTxPool = false) override;
+  virtual bool getPoolTransaction(const Crypto::Hash& tx_hash, CryptoNote::Transaction& transaction) override;
   virtual bool getBackwardBlocksSizes(uint32_t fromHeight, std::vector<size_t>& sizes, size_t count) override;
   virtual bool getBlockSize(const Crypto::Hash& hash, size_t& size) override;
   virtual bool getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& generatedCoins) override;
-  virtual bool getBlockReward(size_t medianSize, size_t currentBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint32_t height,
+  virtual bool getBlockReward(uint8_t blockMajorVersion, size_t medianSize, size_t currentBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint32_t height,
       uint64_t& reward, int64_t& emissionChange) override;
   virtual bool scanOutputkeysForIndices(const CryptoNote::KeyInput& txInToKey, std::list<std::pair<Crypto::Hash, size_t>>& outputReferences) override;
   virtual bool getBlockDifficulty(uint32_t height, CryptoNote::difficulty_type& difficulty) override;
@@ -91,6 +101,7 @@ public:
 
   void addBlock(const CryptoNote::Block& block);
   void addTransaction(const CryptoNote::Transaction& tx);
+  void addPoolTransaction(const CryptoNote::Transaction& tx);
 
   void setPoolTxVerificationResult(bool result);
   void setPoolChangesResult(bool result);
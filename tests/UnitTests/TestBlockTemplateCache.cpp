@@ -0,0 +1,200 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+class BlockTemplateCacheTest : public ::testing::Test {
+public:
+  BlockTemplateCacheTest() :
+    currency(CurrencyBuilder(logger).testnet(true).currency()),
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("BlockTemplateCacheTest_%%%%%%%%")) {
+    boost::filesystem::create_directories(directory);
+    miner.generate();
+    otherMiner.generate();
+
+    CoreConfig coreConfig;
+    coreConfig.configFolder = directory.string();
+    node.reset(new core(currency, nullptr, logger, false, false));
+    if (!node->init(coreConfig, MinerConfig(), false)) {
+      throw std::runtime_error("Failed to initialize core");
+    }
+  }
+
+  ~BlockTemplateCacheTest() {
+    node->deinit();
+    node.reset();
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  Block getTemplate(const AccountBase& account, const BinaryArray& extraNonce) {
+    Block block;
+    difficulty_type difficulty;
+    uint32_t height;
+    EXPECT_TRUE(node->get_block_template(block, account.getAccountKeys().address, difficulty, height, extraNonce));
+    EXPECT_EQ(node->get_current_blockchain_height(), height);
+    return block;
+  }
+
+  void mineBlocks(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      Block block = getTemplate(miner, BinaryArray());
+      ASSERT_TRUE(node->handle_block_found(block));
+    }
+  }
+
+  // Puts a transaction spending the coinbase of the first mined block into the pool
+  void addPoolTransaction() {
+    mineBlocks(1);
+    Block first;
+    ASSERT_TRUE(node->getBlockByHash(node->getBlockIdByHeight(1), first));
+    mineBlocks(currency.minedMoneyUnlockWindow());
+
+    const Transaction& coinbase = first.baseTransaction;
+    std::vector<uint32_t> globalIndexes;
+    ASSERT_TRUE(node->get_tx_outputs_gindexs(getObjectHash(coinbase), globalIndexes));
+    size_t output = 0;
+    while (coinbase.outputs[output].amount <= currency.minimumFee()) {
+      ++output;
+    }
+
+    std::vector<TransactionSourceEntry> sources(1);
+    sources[0].amount = coinbase.outputs[output].amount;
+    sources[0].outputs.emplace_back(globalIndexes[output], boost::get<KeyOutput>(coinbase.outputs[output].target).key);
+    sources[0].realOutput = 0;
+    sources[0].realTransactionPublicKey = getTransactionPublicKeyFromExtra(coinbase.extra);
+    sources[0].realOutputIndexInTransaction = output;
+
+    std::vector<TransactionDestinationEntry> destinations;
+    destinations.push_back(TransactionDestinationEntry(sources[0].amount - currency.minimumFee(), miner.getAccountKeys().address));
+    Transaction tx;
+    Crypto::SecretKey txKey;
+    ASSERT_TRUE(constructTransaction(miner.getAccountKeys(), sources, destinations, std::vector<uint8_t>(), tx, 0, logger, txKey));
+
+    tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+    ASSERT_TRUE(node->handle_incoming_tx(toBinaryArray(tx), tvc, false));
+    ASSERT_TRUE(tvc.m_added_to_pool);
+    poolTransactionHash = getObjectHash(tx);
+  }
+
+  Logging::LoggerGroup logger;
+  Currency currency;
+  AccountBase miner;
+  AccountBase otherMiner;
+  boost::filesystem::path directory;
+  std::unique_ptr<core> node;
+  Crypto::Hash poolTransactionHash;
+};
+
+// Each template miner transaction gets a fresh key, an unchanged key means the template was served from the cache
+Crypto::PublicKey minerTransactionKey(const Block& block) {
+  return getTransactionPublicKeyFromExtra(block.baseTransaction.extra);
+}
+
+BinaryArray extraNonce(const Block& block) {
+  std::vector<TransactionExtraField> fields;
+  TransactionExtraNonce nonce;
+  if (!parseTransactionExtra(block.baseTransaction.extra, fields) || !findTransactionExtraFieldByType(fields, nonce)) {
+    return BinaryArray();
+  }
+
+  return BinaryArray(nonce.nonce.begin(), nonce.nonce.end());
+}
+
+TEST_F(BlockTemplateCacheTest, sameRequestReusesTemplateWithOwnNonce) {
+  mineBlocks(1);
+  BinaryArray firstNonce = {1, 2, 3, 4};
+  BinaryArray secondNonce = {TX_EXTRA_NONCE, 0, 0xff, 9};
+  Block first = getTemplate(miner, firstNonce);
+  Block second = getTemplate(miner, secondNonce);
+
+  ASSERT_EQ(minerTransactionKey(first), minerTransactionKey(second));
+  ASSERT_EQ(firstNonce, extraNonce(first));
+  ASSERT_EQ(secondNonce, extraNonce(second));
+  ASSERT_EQ(first.baseTransaction.extra.size(), second.baseTransaction.extra.size());
+  ASSERT_EQ(getObjectBinarySize(first.baseTransaction), getObjectBinarySize(second.baseTransaction));
+
+  ASSERT_TRUE(node->handle_block_found(second));
+  ASSERT_EQ(get_block_hash(second), node->get_tail_id());
+}
+
+TEST_F(BlockTemplateCacheTest, otherAddressOrNonceSizeRebuildsTemplate) {
+  Block block = getTemplate(miner, BinaryArray(4, 1));
+  Block otherSize = getTemplate(miner, BinaryArray(8, 2));
+  ASSERT_NE(minerTransactionKey(block), minerTransactionKey(otherSize));
+  ASSERT_EQ(BinaryArray(8, 2), extraNonce(otherSize));
+
+  Block withoutNonce = getTemplate(miner, BinaryArray());
+  ASSERT_NE(minerTransactionKey(otherSize), minerTransactionKey(withoutNonce));
+  ASSERT_TRUE(extraNonce(withoutNonce).empty());
+  ASSERT_EQ(minerTransactionKey(withoutNonce), minerTransactionKey(getTemplate(miner, BinaryArray())));
+
+  Block otherAddress = getTemplate(otherMiner, BinaryArray());
+  ASSERT_NE(minerTransactionKey(withoutNonce), minerTransactionKey(otherAddress));
+  ASSERT_TRUE(node->handle_block_found(otherAddress));
+}
+
+TEST_F(BlockTemplateCacheTest, newBlockInvalidatesTemplate) {
+  Block before = getTemplate(miner, BinaryArray(4, 1));
+  Block other = getTemplate(otherMiner, BinaryArray());
+  ASSERT_TRUE(node->handle_block_found(other));
+
+  Block after = getTemplate(miner, BinaryArray(4, 1));
+  ASSERT_NE(minerTransactionKey(before), minerTransactionKey(after));
+  ASSERT_EQ(node->get_tail_id(), after.previousBlockHash);
+  ASSERT_EQ(node->get_current_blockchain_height(), boost::get<BaseInput>(after.baseTransaction.inputs[0]).blockIndex);
+  ASSERT_TRUE(node->handle_block_found(after));
+}
+
+TEST_F(BlockTemplateCacheTest, poolChangeRebuildsTemplate) {
+  mineBlocks(1);
+  Block empty = getTemplate(miner, BinaryArray(4, 1));
+  ASSERT_TRUE(empty.transactionHashes.empty());
+
+  addPoolTransaction();
+  Block before = getTemplate(miner, BinaryArray(4, 1));
+  ASSERT_EQ(1, before.transactionHashes.size());
+  ASSERT_EQ(poolTransactionHash, before.transactionHashes[0]);
+  ASSERT_EQ(minerTransactionKey(before), minerTransactionKey(getTemplate(miner, BinaryArray(4, 2))));
+
+  Block withTransaction = getTemplate(miner, BinaryArray(4, 3));
+  ASSERT_TRUE(node->handle_block_found(withTransaction));
+  ASSERT_EQ(0, node->get_pool_transactions_count());
+
+  Block after = getTemplate(miner, BinaryArray(4, 1));
+  ASSERT_TRUE(after.transactionHashes.empty());
+  ASSERT_NE(minerTransactionKey(withTransaction), minerTransactionKey(after));
+}
+
+}
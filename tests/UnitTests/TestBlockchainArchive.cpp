@@ -0,0 +1,209 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include "BlockchainTool/BlockchainArchive.h"
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+class BlockchainArchiveTest : public ::testing::Test {
+public:
+  BlockchainArchiveTest() :
+    currency(CurrencyBuilder(logger).testnet(true).currency()),
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("BlockchainArchiveTest_%%%%%%%%")),
+    archiveFile((directory / "blockchain.bin").string()) {
+    boost::filesystem::create_directories(directory);
+    miner.generate();
+  }
+
+  ~BlockchainArchiveTest() {
+    for (auto& node : nodes) {
+      node->deinit();
+    }
+
+    nodes.clear();
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  core& openNode(const std::string& name) {
+    boost::filesystem::path nodeDirectory = directory / name;
+    boost::filesystem::create_directories(nodeDirectory);
+    CoreConfig coreConfig;
+    coreConfig.configFolder = nodeDirectory.string();
+
+    nodes.emplace_back(new core(currency, nullptr, logger, false, false));
+    if (!nodes.back()->init(coreConfig, MinerConfig(), false)) {
+      throw std::runtime_error("Failed to initialize core");
+    }
+
+    return *nodes.back();
+  }
+
+  void mineBlocks(core& node, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      Block block;
+      difficulty_type difficulty;
+      uint32_t height;
+      ASSERT_TRUE(node.get_block_template(block, miner.getAccountKeys().address, difficulty, height, BinaryArray()));
+      ASSERT_TRUE(node.handle_block_found(block));
+    }
+  }
+
+  // Mines a chain whose last block spends the coinbase of the first mined block
+  void mineChain(core& node) {
+    mineBlocks(node, 1);
+    Block first;
+    ASSERT_TRUE(node.getBlockByHash(node.getBlockIdByHeight(1), first));
+    mineBlocks(node, currency.minedMoneyUnlockWindow());
+
+    const Transaction& coinbase = first.baseTransaction;
+    std::vector<uint32_t> globalIndexes;
+    ASSERT_TRUE(node.get_tx_outputs_gindexs(getObjectHash(coinbase), globalIndexes));
+    size_t output = 0;
+    while (coinbase.outputs[output].amount <= currency.minimumFee()) {
+      ++output;
+    }
+
+    std::vector<TransactionSourceEntry> sources(1);
+    sources[0].amount = coinbase.outputs[output].amount;
+    sources[0].outputs.emplace_back(globalIndexes[output], boost::get<KeyOutput>(coinbase.outputs[output].target).key);
+    sources[0].realOutput = 0;
+    sources[0].realTransactionPublicKey = getTransactionPublicKeyFromExtra(coinbase.extra);
+    sources[0].realOutputIndexInTransaction = output;
+
+    std::vector<TransactionDestinationEntry> destinations;
+    destinations.push_back(TransactionDestinationEntry(sources[0].amount - currency.minimumFee(), miner.getAccountKeys().address));
+    Transaction tx;
+    Crypto::SecretKey txKey;
+    ASSERT_TRUE(constructTransaction(miner.getAccountKeys(), sources, destinations, std::vector<uint8_t>(), tx, 0, logger, txKey));
+
+    tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+    ASSERT_TRUE(node.handle_incoming_tx(toBinaryArray(tx), tvc, false));
+    ASSERT_TRUE(tvc.m_added_to_pool);
+    mineBlocks(node, 1);
+
+    Block last;
+    ASSERT_TRUE(node.getBlockByHash(node.get_tail_id(), last));
+    ASSERT_EQ(1, last.transactionHashes.size());
+  }
+
+  void checkSameChain(core& source, core& target) {
+    ASSERT_EQ(source.get_current_blockchain_height(), target.get_current_blockchain_height());
+    for (uint32_t height = 0; height < source.get_current_blockchain_height(); ++height) {
+      ASSERT_EQ(source.getBlockIdByHeight(height), target.getBlockIdByHeight(height));
+    }
+  }
+
+  Logging::LoggerGroup logger;
+  Currency currency;
+  AccountBase miner;
+  boost::filesystem::path directory;
+  std::string archiveFile;
+  std::vector<std::unique_ptr<core>> nodes;
+};
+
+TEST_F(BlockchainArchiveTest, exportedChainIsImported) {
+  core& source = openNode("source");
+  mineChain(source);
+  ASSERT_TRUE(exportBlockchain(source, archiveFile, 0, logger));
+
+  core& target = openNode("target");
+  ASSERT_TRUE(importBlockchain(target, archiveFile, logger));
+  checkSameChain(source, target);
+
+  Block last;
+  ASSERT_TRUE(target.getBlockByHash(target.get_tail_id(), last));
+  std::list<Crypto::Hash> missed;
+  std::list<Transaction> transactions;
+  target.getTransactions(last.transactionHashes, transactions, missed);
+  ASSERT_EQ(1, transactions.size());
+  ASSERT_TRUE(missed.empty());
+}
+
+TEST_F(BlockchainArchiveTest, knownBlocksAreSkipped) {
+  core& source = openNode("source");
+  mineBlocks(source, 10);
+  ASSERT_TRUE(exportBlockchain(source, archiveFile, 0, logger));
+  ASSERT_TRUE(importBlockchain(source, archiveFile, logger));
+  ASSERT_EQ(11, source.get_current_blockchain_height());
+}
+
+TEST_F(BlockchainArchiveTest, divergingChainIsRejected) {
+  core& source = openNode("source");
+  mineBlocks(source, 10);
+  ASSERT_TRUE(exportBlockchain(source, archiveFile, 0, logger));
+
+  core& target = openNode("target");
+  mineBlocks(target, 1);
+  ASSERT_FALSE(importBlockchain(target, archiveFile, logger));
+  ASSERT_EQ(2, target.get_current_blockchain_height());
+}
+
+TEST_F(BlockchainArchiveTest, archiveFromStartHeightContinuesChain) {
+  core& source = openNode("source");
+  mineBlocks(source, 5);
+  std::string headFile = (directory / "head.bin").string();
+  ASSERT_TRUE(exportBlockchain(source, headFile, 0, logger));
+  mineBlocks(source, 5);
+  ASSERT_TRUE(exportBlockchain(source, archiveFile, 6, logger));
+  ASSERT_FALSE(exportBlockchain(source, archiveFile, 11, logger));
+
+  core& target = openNode("target");
+  ASSERT_FALSE(importBlockchain(target, archiveFile, logger));
+  ASSERT_TRUE(importBlockchain(target, headFile, logger));
+  ASSERT_EQ(6, target.get_current_blockchain_height());
+  ASSERT_TRUE(importBlockchain(target, archiveFile, logger));
+  checkSameChain(source, target);
+}
+
+TEST_F(BlockchainArchiveTest, damagedArchiveIsRejected) {
+  core& source = openNode("source");
+  mineBlocks(source, 3);
+  ASSERT_TRUE(exportBlockchain(source, archiveFile, 0, logger));
+
+  {
+    std::fstream file(archiveFile, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-10, std::ios::end);
+    char byte = static_cast<char>(file.get());
+    file.seekp(-10, std::ios::end);
+    file.put(static_cast<char>(byte ^ 1));
+  }
+
+  core& target = openNode("target");
+  ASSERT_THROW(importBlockchain(target, archiveFile, logger), std::runtime_error);
+
+  std::ofstream(archiveFile, std::ios::binary | std::ios::trunc) << "not an archive";
+  ASSERT_THROW(importBlockchain(target, archiveFile, logger), std::runtime_error);
+}
+
+}
@@ -0,0 +1,165 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <system_error>
+
+#include "HTTP/HttpParser.h"
+#include "HTTP/HttpParserErrorCodes.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+void append(HttpParser& parser, const std::string& data) {
+  parser.append(data.data(), data.size());
+}
+
+std::string body(const HttpParser& parser) {
+  return static_cast<std::string>(parser.getBody());
+}
+
+void expectError(HttpParser& parser, error::HttpParserErrorCodes code) {
+  try {
+    parser.parseRequest();
+    FAIL() << "no error";
+  } catch (const std::system_error& e) {
+    ASSERT_EQ(make_error_code(code), e.code());
+  }
+}
+
+const std::string REQUEST = "POST /json_rpc HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 5\r\n\r\nhello";
+
+TEST(HttpParserTests, requestIsParsed) {
+  HttpParser parser;
+  append(parser, REQUEST);
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ("POST", static_cast<std::string>(parser.getMethod()));
+  ASSERT_EQ("/json_rpc", static_cast<std::string>(parser.getUrl()));
+  ASSERT_EQ("127.0.0.1", static_cast<std::string>(parser.getHeader("host")));
+  ASSERT_EQ("hello", body(parser));
+  ASSERT_TRUE(parser.getHeader("content-type").isNil());
+  parser.consume();
+  ASSERT_EQ(0, parser.getBufferedSize());
+}
+
+TEST(HttpParserTests, partialRequestWaitsForMoreData) {
+  HttpParser parser;
+  for (size_t i = 0; i + 1 < REQUEST.size(); ++i) {
+    parser.append(&REQUEST[i], 1);
+    ASSERT_FALSE(parser.parseRequest()) << i;
+  }
+
+  parser.append(&REQUEST.back(), 1);
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ("hello", body(parser));
+}
+
+TEST(HttpParserTests, headerNamesAreLowerCase) {
+  HttpParser parser;
+  append(parser, "GET / HTTP/1.1\r\nX-CUSTOM-\xC4\xD6: Value\r\n\r\n");
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ(1, parser.getHeaders().size());
+  ASSERT_EQ("x-custom-\xC4\xD6", static_cast<std::string>(parser.getHeaders()[0].name));
+  ASSERT_EQ("Value", static_cast<std::string>(parser.getHeaders()[0].value));
+  ASSERT_EQ("", body(parser));
+}
+
+TEST(HttpParserTests, chunkedBodyIsJoined) {
+  const std::string request = "POST / HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n5;ext=1\r\nhello\r\nA\r\n, chunked!\r\n0\r\nTrailer: x\r\n\r\n";
+  HttpParser parser;
+  for (size_t i = 0; i < request.size(); ++i) {
+    ASSERT_FALSE(parser.parseRequest()) << i;
+    parser.append(&request[i], 1);
+  }
+
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ("hello, chunked!", body(parser));
+  parser.consume();
+  ASSERT_EQ(0, parser.getBufferedSize());
+}
+
+TEST(HttpParserTests, pipelinedRequestsAreParsedInOrder) {
+  HttpParser parser;
+  append(parser, REQUEST + "POST /second HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n" + "GET /third HTTP/1.1\r\n");
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ("hello", body(parser));
+  parser.consume();
+
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ("/second", static_cast<std::string>(parser.getUrl()));
+  ASSERT_EQ("abc", body(parser));
+  parser.consume();
+
+  ASSERT_FALSE(parser.parseRequest());
+  append(parser, "\r\n");
+  ASSERT_TRUE(parser.parseRequest());
+  ASSERT_EQ("/third", static_cast<std::string>(parser.getUrl()));
+  parser.consume();
+  ASSERT_EQ(0, parser.getBufferedSize());
+}
+
+TEST(HttpParserTests, responseIsParsed) {
+  HttpParser parser;
+  append(parser, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n{}");
+  ASSERT_TRUE(parser.parseResponse());
+  ASSERT_EQ("200 OK", static_cast<std::string>(parser.getStatus()));
+  ASSERT_EQ("{}", body(parser));
+}
+
+TEST(HttpParserTests, oversizedHeadIsRejected) {
+  HttpParser parser;
+  append(parser, "GET / HTTP/1.1\r\nX-Padding: " + std::string(64 * 1024, 'x'));
+  expectError(parser, error::HttpParserErrorCodes::HEADERS_TOO_LARGE);
+
+  HttpParser terminated;
+  append(terminated, "GET / HTTP/1.1\r\nX-Padding: " + std::string(64 * 1024, 'x') + "\r\n\r\n");
+  expectError(terminated, error::HttpParserErrorCodes::HEADERS_TOO_LARGE);
+}
+
+TEST(HttpParserTests, oversizedChunkLineIsRejected) {
+  HttpParser parser;
+  append(parser, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;" + std::string(2048, 'x'));
+  expectError(parser, error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+
+  HttpParser overflow;
+  append(overflow, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" + std::string(17, 'f') + "\r\n");
+  expectError(overflow, error::HttpParserErrorCodes::UNEXPECTED_SYMBOL);
+}
+
+TEST(HttpParserTests, malformedRequestsAreRejected) {
+  const char* requests[] = {
+    "GET\r\n\r\n",
+    "GET / FTP/1.0\r\n\r\n",
+    "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+    "POST / HTTP/1.1\r\nContent-Length: 12a\r\n\r\n",
+    "POST / HTTP/1.1\r\nContent-Length: 1234567890123456789\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nabc\r\n",
+  };
+
+  for (const char* request : requests) {
+    HttpParser parser;
+    append(parser, request);
+    ASSERT_THROW(parser.parseRequest(), std::system_error) << request;
+  }
+
+  HttpParser parser;
+  append(parser, "GET / HTTP/1.1\r\n: value\r\n\r\n");
+  expectError(parser, error::HttpParserErrorCodes::EMPTY_HEADER);
+}
+
+}
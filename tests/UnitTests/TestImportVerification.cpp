@@ -0,0 +1,104 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "Common/StringTools.h"
+#include "CryptoNoteCore/Blockchain.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/ITimeProvider.h"
+#include "CryptoNoteCore/TransactionPool.h"
+#include "crypto/crypto.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+const uint32_t LAST_CHECKPOINT_HEIGHT = 900000;
+// proof of work isn't checked below this height at any level
+const uint32_t HISTORICAL_HEIGHT = 10000;
+const uint32_t CHECKPOINTED_HEIGHT = 850000;
+const uint32_t UNCHECKPOINTED_HEIGHT = LAST_CHECKPOINT_HEIGHT + 1;
+
+class ImportVerificationTest : public ::testing::Test {
+public:
+  ImportVerificationTest() :
+    currency(CurrencyBuilder(logger).currency()),
+    pool(currency, blockchain, timeProvider, logger),
+    blockchain(currency, pool, logger, false, false) {
+    Checkpoints checkpoints(logger);
+    checkpoints.add_checkpoint(LAST_CHECKPOINT_HEIGHT, Common::podToHex(Crypto::rand<Crypto::Hash>()));
+    blockchain.setCheckpoints(std::move(checkpoints));
+  }
+
+  Logging::LoggerGroup logger;
+  Currency currency;
+  RealTimeProvider timeProvider;
+  tx_memory_pool pool;
+  Blockchain blockchain;
+};
+
+TEST_F(ImportVerificationTest, trustCheckpointsSkipsCheckpointedBlocks) {
+  blockchain.setImportVerification(Blockchain::ImportVerification::TrustCheckpoints);
+
+  ASSERT_FALSE(blockchain.checksProofOfWork(CHECKPOINTED_HEIGHT));
+  ASSERT_FALSE(blockchain.checksSignatures(CHECKPOINTED_HEIGHT));
+  ASSERT_FALSE(blockchain.checksSignatures(HISTORICAL_HEIGHT));
+
+  ASSERT_TRUE(blockchain.checksProofOfWork(UNCHECKPOINTED_HEIGHT));
+  ASSERT_TRUE(blockchain.checksSignatures(UNCHECKPOINTED_HEIGHT));
+}
+
+TEST_F(ImportVerificationTest, headersOnlySkipsSignatures) {
+  blockchain.setImportVerification(Blockchain::ImportVerification::HeadersOnly);
+
+  ASSERT_TRUE(blockchain.checksProofOfWork(CHECKPOINTED_HEIGHT));
+  ASSERT_TRUE(blockchain.checksProofOfWork(UNCHECKPOINTED_HEIGHT));
+
+  ASSERT_FALSE(blockchain.checksSignatures(HISTORICAL_HEIGHT));
+  ASSERT_FALSE(blockchain.checksSignatures(CHECKPOINTED_HEIGHT));
+  ASSERT_FALSE(blockchain.checksSignatures(UNCHECKPOINTED_HEIGHT));
+}
+
+TEST_F(ImportVerificationTest, fullChecksEverything) {
+  blockchain.setImportVerification(Blockchain::ImportVerification::Full);
+
+  ASSERT_TRUE(blockchain.checksProofOfWork(CHECKPOINTED_HEIGHT));
+  ASSERT_TRUE(blockchain.checksProofOfWork(UNCHECKPOINTED_HEIGHT));
+
+  ASSERT_TRUE(blockchain.checksSignatures(HISTORICAL_HEIGHT));
+  ASSERT_TRUE(blockchain.checksSignatures(CHECKPOINTED_HEIGHT));
+  ASSERT_TRUE(blockchain.checksSignatures(UNCHECKPOINTED_HEIGHT));
+}
+
+TEST_F(ImportVerificationTest, historicalBlocksSkipProofOfWork) {
+  for (auto verification : { Blockchain::ImportVerification::TrustCheckpoints, Blockchain::ImportVerification::HeadersOnly,
+    Blockchain::ImportVerification::Full }) {
+    blockchain.setImportVerification(verification);
+    ASSERT_FALSE(blockchain.checksProofOfWork(HISTORICAL_HEIGHT));
+  }
+}
+
+TEST_F(ImportVerificationTest, withoutCheckpointsTrustCheckpointsVerifiesEverything) {
+  blockchain.setCheckpoints(Checkpoints(logger));
+  blockchain.setImportVerification(Blockchain::ImportVerification::TrustCheckpoints);
+
+  ASSERT_TRUE(blockchain.checksProofOfWork(CHECKPOINTED_HEIGHT));
+  ASSERT_TRUE(blockchain.checksSignatures(HISTORICAL_HEIGHT));
+  ASSERT_TRUE(blockchain.checksSignatures(CHECKPOINTED_HEIGHT));
+}
+
+}
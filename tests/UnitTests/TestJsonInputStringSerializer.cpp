@@ -0,0 +1,212 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/utility/value_init.hpp>
+
+#include <Common/JsonValue.h>
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+#include "Serialization/JsonInputStringSerializer.h"
+#include "Serialization/JsonInputValueSerializer.h"
+#include "Serialization/SerializationOverloads.h"
+#include "Serialization/SerializationTools.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+struct Inner {
+  uint64_t amount = 7;
+  std::string name = "inner";
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(amount)
+    KV_MEMBER(name)
+  }
+};
+
+struct Request {
+  int32_t number = -1;
+  uint8_t small = 1;
+  bool flag = false;
+  double ratio = 0.5;
+  std::string text = "default";
+  Crypto::Hash hash = boost::value_initialized<Crypto::Hash>();
+  Inner inner;
+  std::vector<Inner> list;
+  std::vector<uint32_t> numbers;
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(number)
+    KV_MEMBER(small)
+    KV_MEMBER(flag)
+    KV_MEMBER(ratio)
+    KV_MEMBER(text)
+    KV_MEMBER(hash)
+    KV_MEMBER(inner)
+    KV_MEMBER(list)
+    KV_MEMBER(numbers)
+  }
+};
+
+const char* const ERROR = "error";
+
+// The loaded request printed back as JSON, or ERROR if loading threw
+std::string loadThroughString(const std::string& json) {
+  try {
+    Request request;
+    JsonInputStringSerializer serializer(json);
+    serialize(request, serializer);
+    return storeToJson(request);
+  } catch (std::exception&) {
+    return ERROR;
+  }
+}
+
+std::string loadThroughValue(const std::string& json) {
+  try {
+    Request request;
+    loadFromJsonValue(request, Common::JsonValue::fromString(json));
+    return storeToJson(request);
+  } catch (std::exception&) {
+    return ERROR;
+  }
+}
+
+void checkSameAsValue(const std::string& json) {
+  std::string loaded = loadThroughString(json);
+  ASSERT_EQ(loadThroughValue(json), loaded) << json;
+}
+
+std::string nest(size_t depth, const std::string& value) {
+  return std::string(depth, '[') + value + std::string(depth, ']');
+}
+
+TEST(JsonInputStringSerializerTests, requestMatchesValueSerializer) {
+  const std::string json = "{\"number\":-42,\"small\":200,\"flag\":true,\"ratio\":3,\"text\":\"a\\\"b\\\\\",\"hash\":\"" + std::string(64, 'f') +
+    "\",\"inner\":{\"amount\":9223372036854775807,\"name\":\"x\"},\"list\":[{\"amount\":1},{\"name\":\"y\"},{}],\"numbers\":[1,2,3]}";
+  ASSERT_NE(ERROR, loadThroughString(json));
+  checkSameAsValue(json);
+}
+
+// JsonValue saturates integers above INT64_MAX and JsonInputValueSerializer reads doubles as integers only
+TEST(JsonInputStringSerializerTests, valuesJsonValueCannotHoldAreRead) {
+  Request request;
+  JsonInputStringSerializer serializer("{\"ratio\":-1.25e1,\"inner\":{\"amount\":18446744073709551615}}");
+  serialize(request, serializer);
+  ASSERT_EQ(-12.5, request.ratio);
+  ASSERT_EQ(UINT64_MAX, request.inner.amount);
+  ASSERT_EQ(ERROR, loadThroughString("{\"inner\":{\"amount\":18446744073709551616}}"));
+  ASSERT_EQ(ERROR, loadThroughString("{\"number\":99999999999999999999}"));
+}
+
+TEST(JsonInputStringSerializerTests, membersInAnyOrderMatchValueSerializer) {
+  checkSameAsValue(" { \"numbers\" : [ 4 , 5 ] ,\n\"inner\":{ \"name\":\"n\" , \"amount\" : 3 },\t\"text\":\"t\", \"number\":9 , \"unknown\":{\"a\":[1,{}]} } ");
+}
+
+TEST(JsonInputStringSerializerTests, missingMembersKeepDefaults) {
+  ASSERT_EQ(loadThroughString("{}"), storeToJson(Request()));
+  checkSameAsValue("{}");
+  checkSameAsValue("{\"inner\":{}}");
+  checkSameAsValue("{\"list\":[],\"numbers\":[]}");
+  checkSameAsValue("{\"other\":1,\"text\":\"only\"}");
+}
+
+TEST(JsonInputStringSerializerTests, lastOfDuplicateMembersIsRead) {
+  const std::string json = "{\"number\":1,\"text\":\"first\",\"number\":2,\"inner\":{\"name\":\"a\",\"name\":\"b\"},\"text\":\"last\"}";
+  Request request;
+  JsonInputStringSerializer serializer(json);
+  serialize(request, serializer);
+  ASSERT_EQ(2, request.number);
+  ASSERT_EQ("last", request.text);
+  ASSERT_EQ("b", request.inner.name);
+  checkSameAsValue(json);
+
+  checkSameAsValue("{\"list\":[{\"amount\":1,\"amount\":2},{\"amount\":3}],\"list\":[{\"amount\":4}]}");
+  checkSameAsValue("{\"inner\":{\"amount\":1},\"inner\":{\"name\":\"n\"}}");
+}
+
+TEST(JsonInputStringSerializerTests, malformedInputIsRejected) {
+  const char* documents[] = {
+    "",
+    "   ",
+    "{",
+    "}",
+    "{\"number\":}",
+    "{\"number\" 1}",
+    "{\"number\":1,}",
+    "{,\"number\":1}",
+    "{\"number\":1 \"text\":\"a\"}",
+    "{\"text\":\"unterminated}",
+    "{\"text\":\"escaped quote\\\"}",
+    "{number:1}",
+    "{\"number\":01}",
+    "{\"number\":-}",
+    "{\"number\":1.5e}",
+    "{\"flag\":tru}",
+    "{\"flag\":nul}",
+    "{\"numbers\":[1,2}",
+    "{\"numbers\":[1,,2]}",
+    "{\"number\":1}}",
+    "{\"number\":1} x",
+  };
+
+  for (const char* document : documents) {
+    ASSERT_EQ(ERROR, loadThroughString(document)) << document;
+  }
+}
+
+TEST(JsonInputStringSerializerTests, mistypedMembersAreRejected) {
+  const char* documents[] = {
+    "{\"number\":\"1\"}",
+    "{\"number\":1.5}",
+    "{\"flag\":1}",
+    "{\"text\":1}",
+    "{\"ratio\":\"1\"}",
+    "{\"hash\":\"abc\"}",
+    "{\"hash\":\"" "zz" "}",
+    "{\"numbers\":[\"1\"]}",
+  };
+
+  for (const char* document : documents) {
+    ASSERT_EQ(ERROR, loadThroughString(document)) << document;
+    ASSERT_EQ(ERROR, loadThroughValue(document)) << document;
+  }
+
+  // JsonInputValueSerializer doesn't check the container types, it isn't run on these
+  ASSERT_EQ(ERROR, loadThroughString("{\"inner\":[]}"));
+  ASSERT_EQ(ERROR, loadThroughString("{\"inner\":1}"));
+  ASSERT_EQ(ERROR, loadThroughString("{\"list\":{}}"));
+  ASSERT_EQ(ERROR, loadThroughString("{\"list\":[1]}"));
+}
+
+TEST(JsonInputStringSerializerTests, onlyObjectsAreAccepted) {
+  ASSERT_THROW(JsonInputStringSerializer("[]"), std::runtime_error);
+  ASSERT_THROW(JsonInputStringSerializer("1"), std::runtime_error);
+  ASSERT_THROW(JsonInputStringSerializer("\"text\""), std::runtime_error);
+}
+
+TEST(JsonInputStringSerializerTests, deepNestingIsLimited) {
+  ASSERT_NE(ERROR, loadThroughString("{\"unknown\":" + nest(127, "1") + "}"));
+  checkSameAsValue("{\"unknown\":" + nest(127, "1") + ",\"number\":3}");
+  ASSERT_EQ(ERROR, loadThroughString("{\"unknown\":" + nest(128, "1") + "}"));
+  ASSERT_EQ(ERROR, loadThroughString("{\"unknown\":" + nest(100000, "") + "}"));
+  ASSERT_EQ(ERROR, loadThroughString("{\"unknown\":" + std::string(100000, '[')));
+}
+
+}
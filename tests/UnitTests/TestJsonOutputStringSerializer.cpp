@@ -0,0 +1,205 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <limits>
+#include <string>
+
+#include <Common/JsonValue.h>
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+#include "Rpc/CoreRpcServerCommandsDefinitions.h"
+#include "Serialization/SerializationTools.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+template<typename T>
+void fill(T& pod, uint8_t seed) {
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(&pod);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    bytes[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+}
+
+// storeToJson keeps the members in serialization order, JsonValue sorts them by name. The text written directly
+// is read back into a JsonValue, which has to print byte for byte what the JsonValue path prints.
+template<typename T>
+void checkSameAsJsonValue(const T& value) {
+  std::string direct = storeToJson(value);
+  Common::JsonValue reparsed = Common::JsonValue::fromString(direct);
+  ASSERT_EQ(storeToJsonValue(value).toString(), reparsed.toString()) << direct;
+}
+
+Transaction createTransaction() {
+  Transaction tx;
+  tx.version = 1;
+  tx.unlockTime = 12345;
+
+  KeyInput input;
+  input.amount = std::numeric_limits<uint64_t>::max();
+  input.outputIndexes = {1, 20, 300};
+  fill(input.keyImage, 1);
+  tx.inputs.push_back(input);
+
+  BaseInput baseInput;
+  baseInput.blockIndex = 77;
+  tx.inputs.push_back(baseInput);
+
+  TransactionOutput output;
+  output.amount = 1000000;
+  KeyOutput keyOutput;
+  fill(keyOutput.key, 2);
+  output.target = keyOutput;
+  tx.outputs.push_back(output);
+
+  tx.extra = {1, 2, 3, 0xff};
+  tx.signatures.resize(2);
+  tx.signatures[0].resize(3);
+  for (size_t i = 0; i < tx.signatures[0].size(); ++i) {
+    fill(tx.signatures[0][i], static_cast<uint8_t>(10 + i));
+  }
+
+  return tx;
+}
+
+TEST(JsonOutputStringSerializerTests, membersKeepSerializationOrder) {
+  COMMAND_RPC_GET_TRANSACTIONS::response response;
+  response.txs_as_hex = {"00ff"};
+  response.status = CORE_RPC_STATUS_OK;
+  ASSERT_EQ("{\"txs_as_hex\":[\"00ff\"],\"missed_tx\":[],\"status\":\"OK\"}", storeToJson(response));
+  checkSameAsJsonValue(response);
+}
+
+TEST(JsonOutputStringSerializerTests, getInfoMatchesJsonValue) {
+  COMMAND_RPC_GET_INFO::response response;
+  response.status = CORE_RPC_STATUS_OK;
+  response.version = "1.2.3 (\\\"quoted\\\")";
+  response.fee_address = "";
+  response.top_block_hash = std::string(64, 'a');
+  response.height = 1;
+  response.difficulty = std::numeric_limits<uint64_t>::max();
+  response.tx_count = 0;
+  response.tx_pool_size = 42;
+  response.alt_blocks_count = 3;
+  response.outgoing_connections_count = 8;
+  response.incoming_connections_count = 0;
+  response.white_peerlist_size = 1000;
+  response.grey_peerlist_size = 5000;
+  response.block_major_version = 255;
+  response.block_minor_version = 0;
+  response.last_known_block_index = std::numeric_limits<uint32_t>::max();
+  response.full_deposit_amount = 1ULL << 63;
+  response.last_block_reward = 123456789;
+  response.last_block_timestamp = 1600000000;
+  response.last_block_difficulty = 10;
+  response.rpc_queued_requests = 0;
+  response.rpc_stack_count = 4;
+  response.rpc_stack_resident_bytes = 65536;
+  response.connections = {"1.2.3.4:10808", "5.6.7.8:10808"};
+  checkSameAsJsonValue(response);
+}
+
+TEST(JsonOutputStringSerializerTests, blockDetailsMatchJsonValue) {
+  F_COMMAND_RPC_GET_BLOCK_DETAILS::response response;
+  response.status = CORE_RPC_STATUS_OK;
+  f_block_details_response& block = response.block;
+  block.major_version = 8;
+  block.minor_version = 0;
+  block.timestamp = 1600000000;
+  block.prev_hash = std::string(64, 'b');
+  block.nonce = 0xdeadbeef;
+  block.orphan_status = true;
+  block.height = 100;
+  block.depth = 0;
+  block.hash = std::string(64, 'c');
+  block.difficulty = 999;
+  block.reward = 8000000;
+  block.blockSize = 500;
+  block.sizeMedian = 400;
+  block.effectiveSizeMedian = 300;
+  block.transactionsCumulativeSize = 200;
+  block.alreadyGeneratedCoins = "123456789012345";
+  block.alreadyGeneratedTransactions = 10;
+  block.baseReward = 7000000;
+  block.penalty = 1.0 / 3;
+  block.totalFeeAmount = 100;
+  for (uint64_t i = 0; i < 3; ++i) {
+    f_transaction_short_response transaction;
+    transaction.hash = std::string(64, static_cast<char>('0' + i));
+    transaction.fee = i;
+    transaction.amount_out = i * 1000;
+    transaction.size = i * 100;
+    block.transactions.push_back(transaction);
+  }
+
+  checkSameAsJsonValue(response);
+  block.penalty = 0;
+  block.transactions.clear();
+  checkSameAsJsonValue(response);
+}
+
+TEST(JsonOutputStringSerializerTests, binaryMembersMatchJsonValue) {
+  COMMAND_RPC_GET_BLOCKS_FAST::response blocks;
+  blocks.start_height = 0;
+  blocks.current_height = 2;
+  blocks.status = CORE_RPC_STATUS_OK;
+  blocks.blocks.resize(2);
+  blocks.blocks[0].block = std::string("\x00\x01\x7f\x80\xff", 5);
+  blocks.blocks[1].block = "block";
+  blocks.blocks[1].txs = {"tx1", std::string(1, '\0')};
+  checkSameAsJsonValue(blocks);
+
+  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response outputs;
+  outputs.status = CORE_RPC_STATUS_OK;
+  outputs.outs.resize(2);
+  outputs.outs[0].amount = 10;
+  outputs.outs[0].outs.resize(3);
+  for (size_t i = 0; i < outputs.outs[0].outs.size(); ++i) {
+    outputs.outs[0].outs[i].global_amount_index = i * 11;
+    fill(outputs.outs[0].outs[i].out_key, static_cast<uint8_t>(i));
+  }
+
+  outputs.outs[1].amount = 20;
+  checkSameAsJsonValue(outputs);
+}
+
+// Transaction signatures are unnamed members, only the first one of an object is kept on both paths
+TEST(JsonOutputStringSerializerTests, transactionMatchesJsonValue) {
+  Transaction tx = createTransaction();
+  checkSameAsJsonValue(tx);
+
+  Block block;
+  block.majorVersion = 1;
+  block.minorVersion = 0;
+  block.timestamp = 1;
+  fill(block.previousBlockHash, 3);
+  block.nonce = 5;
+  block.baseTransaction = tx;
+  block.transactionHashes.resize(2);
+  fill(block.transactionHashes[0], 4);
+  fill(block.transactionHashes[1], 5);
+  checkSameAsJsonValue(block);
+}
+
+TEST(JsonOutputStringSerializerTests, emptyResponsesMatchJsonValue) {
+  checkSameAsJsonValue(STATUS_STRUCT());
+  ASSERT_EQ("{\"status\":\"\"}", storeToJson(STATUS_STRUCT()));
+
+  COMMAND_RPC_GET_TRANSACTIONS::response response;
+  checkSameAsJsonValue(response);
+}
+
+}
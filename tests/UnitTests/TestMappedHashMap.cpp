@@ -0,0 +1,256 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <random>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+#include "CryptoNoteCore/MappedHashMap.h"
+
+namespace {
+
+// Only four home slots, so entries form long clusters and erase has to move them back
+struct ClusteringHash {
+  size_t operator()(uint64_t key) const {
+    return static_cast<size_t>(key % 4);
+  }
+};
+
+typedef MappedHashMap<uint64_t, uint64_t> Map;
+typedef MappedHashMap<uint64_t, uint64_t, ClusteringHash> ClusteredMap;
+
+// More than 2/3 of the initial capacity of 1 << 16, so the table grows once
+const uint64_t GROW_COUNT = 50000;
+
+class MappedHashMapTest : public ::testing::Test {
+public:
+  MappedHashMapTest() :
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("MappedHashMapTest_%%%%%%%%")),
+    path((directory / "map.dat").string()) {
+    boost::filesystem::create_directories(directory);
+  }
+
+  ~MappedHashMapTest() {
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  void fill(Map& map, uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i) {
+      ASSERT_TRUE(map.insert(i, i * 3).second);
+    }
+  }
+
+  void checkFilled(const Map& map, uint64_t count) {
+    ASSERT_EQ(count, map.size());
+    for (uint64_t i = 0; i < count; ++i) {
+      ASSERT_EQ(i * 3, map.at(i)) << i;
+    }
+
+    ASSERT_EQ(0, map.count(count));
+  }
+
+  uintmax_t fileSize() const {
+    return boost::filesystem::file_size(path);
+  }
+
+  boost::filesystem::path directory;
+  std::string path;
+};
+
+TEST_F(MappedHashMapTest, insertFindErase) {
+  Map map;
+  map.open(path);
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(0, map.tag());
+
+  auto result = map.insert(1, 10);
+  ASSERT_TRUE(result.second);
+  ASSERT_EQ(1, result.first->first);
+  ASSERT_EQ(10, result.first->second);
+
+  result = map.insert(1, 20);
+  ASSERT_FALSE(result.second);
+  ASSERT_EQ(10, result.first->second);
+
+  ASSERT_FALSE(map.insert_or_assign(1, 30).second);
+  ASSERT_TRUE(map.insert_or_assign(2, 40).second);
+  ASSERT_EQ(2, map.size());
+  ASSERT_EQ(30, map.at(1));
+  ASSERT_EQ(40, map.find(2)->second);
+  ASSERT_TRUE(map.find(3) == map.end());
+  ASSERT_THROW(map.at(3), std::out_of_range);
+
+  ASSERT_EQ(1, map.erase(1));
+  ASSERT_EQ(0, map.erase(1));
+  ASSERT_EQ(0, map.count(1));
+  ASSERT_EQ(1, map.size());
+}
+
+TEST_F(MappedHashMapTest, eraseKeepsClusteredEntriesReachable) {
+  ClusteredMap map;
+  map.open(path);
+  std::unordered_map<uint64_t, uint64_t> expected;
+  std::mt19937_64 random(1);
+  for (size_t step = 0; step < 20000; ++step) {
+    uint64_t key = random() % 2000;
+    if (random() % 3 == 0) {
+      ASSERT_EQ(expected.erase(key), map.erase(key)) << step;
+    } else {
+      ASSERT_EQ(expected.emplace(key, step).second, map.insert(key, step).second) << step;
+    }
+  }
+
+  ASSERT_EQ(expected.size(), map.size());
+  for (const auto& entry : expected) {
+    ASSERT_EQ(entry.second, map.at(entry.first)) << entry.first;
+  }
+
+  size_t iterated = 0;
+  for (const auto& entry : map) {
+    ASSERT_EQ(expected.at(entry.first), entry.second);
+    ++iterated;
+  }
+
+  ASSERT_EQ(expected.size(), iterated);
+}
+
+TEST_F(MappedHashMapTest, growKeepsEntries) {
+  Map map;
+  map.open(path);
+  uintmax_t initialSize = fileSize();
+  fill(map, GROW_COUNT);
+  ASSERT_GT(fileSize(), initialSize);
+  checkFilled(map, GROW_COUNT);
+
+  for (uint64_t i = 0; i < GROW_COUNT; i += 2) {
+    ASSERT_EQ(1, map.erase(i));
+  }
+
+  ASSERT_EQ(GROW_COUNT / 2, map.size());
+  for (uint64_t i = 0; i < GROW_COUNT; ++i) {
+    ASSERT_EQ(i % 2, map.count(i)) << i;
+  }
+}
+
+TEST_F(MappedHashMapTest, reopenAfterGrowKeepsEntriesAndTag) {
+  {
+    Map map;
+    map.open(path);
+    fill(map, GROW_COUNT);
+    map.setTag(42);
+  }
+
+  ASSERT_FALSE(boost::filesystem::exists(path + ".bak"));
+  ASSERT_FALSE(boost::filesystem::exists(path + ".tmp"));
+
+  Map map;
+  map.open(path);
+  ASSERT_EQ(42, map.tag());
+  checkFilled(map, GROW_COUNT);
+  ASSERT_TRUE(map.insert(GROW_COUNT, 0).second);
+}
+
+TEST_F(MappedHashMapTest, reserveGrowsBeforeInsertion) {
+  Map map;
+  map.open(path);
+  map.setTag(7);
+  map.reserve(GROW_COUNT);
+  uintmax_t reservedSize = fileSize();
+  ASSERT_EQ(7, map.tag());
+  ASSERT_TRUE(map.empty());
+
+  fill(map, GROW_COUNT);
+  ASSERT_EQ(reservedSize, fileSize());
+  checkFilled(map, GROW_COUNT);
+
+  map.reserve(1);
+  ASSERT_EQ(reservedSize, fileSize());
+}
+
+TEST_F(MappedHashMapTest, tagIsKeptAcrossReopenAndResetByClear) {
+  {
+    Map map;
+    map.open(path);
+    map.insert(1, 1);
+    map.setTag(UINT64_MAX);
+  }
+
+  Map map;
+  map.open(path);
+  ASSERT_EQ(UINT64_MAX, map.tag());
+  ASSERT_EQ(1, map.size());
+
+  map.clear();
+  ASSERT_EQ(0, map.tag());
+  ASSERT_TRUE(map.empty());
+}
+
+// grow() renames the old table to .bak before the new one takes its name
+TEST_F(MappedHashMapTest, previousTableIsRestoredAfterInterruptedGrow) {
+  {
+    Map map;
+    map.open(path);
+    fill(map, 100);
+    map.setTag(5);
+  }
+
+  boost::filesystem::rename(path, path + ".bak");
+
+  Map map;
+  map.open(path);
+  ASSERT_EQ(5, map.tag());
+  checkFilled(map, 100);
+  ASSERT_FALSE(boost::filesystem::exists(path + ".bak"));
+}
+
+TEST_F(MappedHashMapTest, staleBackupIsRemoved) {
+  {
+    Map map;
+    map.open(path);
+    fill(map, 100);
+  }
+
+  boost::filesystem::copy_file(path, path + ".bak");
+  {
+    Map map;
+    map.open(path);
+    map.insert(100, 300);
+  }
+
+  Map map;
+  map.open(path);
+  checkFilled(map, 101);
+  ASSERT_FALSE(boost::filesystem::exists(path + ".bak"));
+}
+
+TEST_F(MappedHashMapTest, unreadableFileIsReplaced) {
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "not a table";
+  }
+
+  Map map;
+  map.open(path);
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(0, map.tag());
+  fill(map, 10);
+  checkFilled(map, 10);
+}
+
+}
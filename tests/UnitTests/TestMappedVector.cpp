@@ -0,0 +1,210 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "CryptoNoteCore/MappedVector.h"
+#include "Serialization/ISerializer.h"
+
+namespace {
+
+struct Item {
+  uint64_t number;
+  std::string text;
+};
+
+void serialize(Item& item, CryptoNote::ISerializer& s) {
+  s(item.number, "number");
+  s(item.text, "text");
+}
+
+Item makeItem(uint64_t number) {
+  return Item{ number, std::string(static_cast<size_t>(number % 100), 'a' + number % 26) };
+}
+
+class MappedVectorTest : public ::testing::Test {
+public:
+  MappedVectorTest() :
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("MappedVectorTest_%%%%%%%%")) {
+    boost::filesystem::create_directories(directory);
+    itemsFile = (directory / "items.bin").string();
+    indexFile = (directory / "index.bin").string();
+  }
+
+  ~MappedVectorTest() {
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  void checkItems(MappedVector<Item>& vector, uint64_t count) {
+    ASSERT_EQ(count, vector.size());
+    for (uint64_t i = 0; i < count; ++i) {
+      std::shared_ptr<const Item> item = vector[i];
+      ASSERT_EQ(i, item->number);
+      ASSERT_EQ(makeItem(i).text, item->text);
+    }
+  }
+
+  boost::filesystem::path directory;
+  std::string itemsFile;
+  std::string indexFile;
+};
+
+TEST_F(MappedVectorTest, openFailsWithEmptyPool) {
+  MappedVector<Item> vector;
+  ASSERT_FALSE(vector.open(itemsFile, indexFile, 0));
+}
+
+TEST_F(MappedVectorTest, pushedItemsAreReadBack) {
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 4));
+  ASSERT_TRUE(vector.empty());
+
+  for (uint64_t i = 0; i < 20; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  checkItems(vector, 20);
+  ASSERT_EQ(0, vector.front()->number);
+  ASSERT_EQ(19, vector.back()->number);
+  ASSERT_THROW(vector[20], std::runtime_error);
+}
+
+TEST_F(MappedVectorTest, popBackDropsCachedItem) {
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 4));
+  vector.push_back(makeItem(0));
+  vector.push_back(makeItem(1));
+
+  vector.pop_back();
+  vector.push_back(makeItem(7));
+
+  ASSERT_EQ(2, vector.size());
+  ASSERT_EQ(7, vector[1]->number);
+  vector.clear();
+  ASSERT_TRUE(vector.empty());
+  ASSERT_THROW(vector.pop_back(), std::runtime_error);
+}
+
+TEST_F(MappedVectorTest, itemsSurviveReopening) {
+  {
+    MappedVector<Item> vector;
+    ASSERT_TRUE(vector.open(itemsFile, indexFile, 4));
+    for (uint64_t i = 0; i < 50; ++i) {
+      vector.push_back(makeItem(i));
+    }
+
+    vector.pop_back();
+  }
+
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 4));
+  checkItems(vector, 49);
+}
+
+TEST_F(MappedVectorTest, rawItemsCanBePushedToAnotherVector) {
+  MappedVector<Item> source;
+  ASSERT_TRUE(source.open(itemsFile, indexFile, 4));
+  for (uint64_t i = 0; i < 10; ++i) {
+    source.push_back(makeItem(i));
+  }
+
+  MappedVector<Item> copy;
+  ASSERT_TRUE(copy.open((directory / "copy.bin").string(), (directory / "copyindex.bin").string(), 4));
+  for (uint64_t i = 0; i < source.size(); ++i) {
+    copy.pushRaw(source.raw(i));
+  }
+
+  checkItems(copy, 10);
+  ASSERT_THROW(source.raw(10), std::runtime_error);
+}
+
+TEST_F(MappedVectorTest, importSwappedVectorAppendsItems) {
+  // SwappedVector files: the item count and sizes in the index, the serialized items back to back in the items file
+  MappedVector<Item> serializer;
+  ASSERT_TRUE(serializer.open((directory / "tmp.bin").string(), (directory / "tmpindex.bin").string(), 4));
+  std::ofstream swappedItems((directory / "swapped.bin").string(), std::ios::binary);
+  std::ofstream swappedIndex((directory / "swappedindex.bin").string(), std::ios::binary);
+  uint64_t count = 5;
+  swappedIndex.write(reinterpret_cast<const char*>(&count), sizeof count);
+  for (uint64_t i = 0; i < count; ++i) {
+    serializer.push_back(makeItem(i));
+    Common::ArrayView<uint8_t> data = serializer.raw(i);
+    uint32_t size = static_cast<uint32_t>(data.getSize());
+    swappedIndex.write(reinterpret_cast<const char*>(&size), sizeof size);
+    swappedItems.write(reinterpret_cast<const char*>(data.getData()), size);
+  }
+
+  swappedItems.close();
+  swappedIndex.close();
+
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 4));
+  ASSERT_TRUE(vector.importSwappedVector((directory / "swapped.bin").string(), (directory / "swappedindex.bin").string()));
+  checkItems(vector, count);
+  ASSERT_FALSE(vector.importSwappedVector((directory / "missing.bin").string(), (directory / "swappedindex.bin").string()));
+}
+
+TEST_F(MappedVectorTest, pushesAreNotCountedAsMisses) {
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 4));
+  for (uint64_t i = 0; i < 4; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  ASSERT_EQ(0, vector.cacheHits());
+  ASSERT_EQ(0, vector.cacheMisses());
+
+  vector[3];
+  ASSERT_EQ(1, vector.cacheHits());
+  ASSERT_EQ(0, vector.cacheMisses());
+}
+
+TEST_F(MappedVectorTest, evictedItemsAreDeserializedAgain) {
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 2));
+  for (uint64_t i = 0; i < 3; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  // the pool keeps items 1 and 2
+  ASSERT_EQ(0, vector[0]->number);
+  ASSERT_EQ(1, vector.cacheMisses());
+  ASSERT_EQ(2, vector[2]->number);
+  ASSERT_EQ(1, vector.cacheHits());
+  ASSERT_EQ(1, vector[1]->number);
+  ASSERT_EQ(2, vector.cacheMisses());
+}
+
+TEST_F(MappedVectorTest, evictedItemsStayValidWhileReferenced) {
+  MappedVector<Item> vector;
+  ASSERT_TRUE(vector.open(itemsFile, indexFile, 1));
+  for (uint64_t i = 0; i < 1000; ++i) {
+    vector.push_back(makeItem(i));
+  }
+
+  std::shared_ptr<const Item> first = vector[0];
+  for (uint64_t i = 1; i < 1000; ++i) {
+    ASSERT_EQ(i, vector[i]->number);
+  }
+
+  ASSERT_EQ(0, first->number);
+  ASSERT_EQ(makeItem(0).text, first->text);
+}
+
+}
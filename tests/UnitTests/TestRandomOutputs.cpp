@@ -0,0 +1,228 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/Core.h"
+#include "CryptoNoteCore/CoreConfig.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteCore/MinerConfig.h"
+#include "Rpc/CoreRpcServerCommandsDefinitions.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+class RandomOutputsTest : public ::testing::Test {
+public:
+  RandomOutputsTest() :
+    currency(CurrencyBuilder(logger).testnet(true).currency()),
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("RandomOutputsTest_%%%%%%%%")) {
+    boost::filesystem::create_directories(directory);
+    miner.generate();
+  }
+
+  ~RandomOutputsTest() {
+    for (auto& node : nodes) {
+      node->deinit();
+    }
+
+    nodes.clear();
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  core& openNode(const std::string& name) {
+    boost::filesystem::path nodeDirectory = directory / name;
+    boost::filesystem::create_directories(nodeDirectory);
+    CoreConfig coreConfig;
+    coreConfig.configFolder = nodeDirectory.string();
+
+    nodes.emplace_back(new core(currency, nullptr, logger, false, false));
+    if (!nodes.back()->init(coreConfig, MinerConfig(), false)) {
+      throw std::runtime_error("Failed to initialize core");
+    }
+
+    return *nodes.back();
+  }
+
+  void mineBlocks(core& node, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      Block block;
+      difficulty_type difficulty;
+      uint32_t height;
+      ASSERT_TRUE(node.get_block_template(block, miner.getAccountKeys().address, difficulty, height, BinaryArray()));
+      ASSERT_TRUE(node.handle_block_found(block));
+    }
+  }
+
+  // Output keys of every amount in global index order, read from the blocks
+  std::map<uint64_t, std::vector<std::pair<uint32_t, Crypto::PublicKey>>> chainOutputs(core& node) {
+    std::map<uint64_t, std::vector<std::pair<uint32_t, Crypto::PublicKey>>> outputs;
+    for (uint32_t height = 0; height < node.get_current_blockchain_height(); ++height) {
+      Block block;
+      EXPECT_TRUE(node.getBlockByHash(node.getBlockIdByHeight(height), block));
+      for (const TransactionOutput& output : block.baseTransaction.outputs) {
+        outputs[output.amount].emplace_back(height, boost::get<KeyOutput>(output.target).key);
+      }
+    }
+
+    return outputs;
+  }
+
+  // Asking for more outputs than there are returns every one old enough to be a mixin
+  void checkUnlockedOutputs(core& node) {
+    auto outputs = chainOutputs(node);
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request request;
+    for (const auto& amount : outputs) {
+      request.amounts.push_back(amount.first);
+    }
+
+    request.outs_count = 1 << 20;
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response response;
+    ASSERT_TRUE(node.get_random_outs_for_amounts(request, response));
+    ASSERT_EQ(request.amounts.size(), response.outs.size());
+
+    uint32_t chainHeight = node.get_current_blockchain_height();
+    for (const auto& result : response.outs) {
+      const auto& amountOutputs = outputs.at(result.amount);
+      size_t unlocked = 0;
+      while (unlocked < amountOutputs.size() && amountOutputs[unlocked].first + currency.minedMoneyUnlockWindow() <= chainHeight) {
+        ++unlocked;
+      }
+
+      ASSERT_EQ(unlocked, result.outs.size()) << result.amount << " at height " << chainHeight;
+      for (size_t i = 0; i < result.outs.size(); ++i) {
+        ASSERT_EQ(i, result.outs[i].global_amount_index);
+        ASSERT_EQ(amountOutputs[i].second, result.outs[i].out_key);
+      }
+    }
+  }
+
+  Logging::LoggerGroup logger;
+  Currency currency;
+  AccountBase miner;
+  boost::filesystem::path directory;
+  std::vector<std::unique_ptr<core>> nodes;
+};
+
+TEST_F(RandomOutputsTest, unlockedOutputsFollowPushAndPop) {
+  core& node = openNode("node");
+  mineBlocks(node, currency.minedMoneyUnlockWindow() + 5);
+  checkUnlockedOutputs(node);
+
+  // the counts are cached now and only shifted by the blocks pushed and popped
+  for (size_t i = 0; i < 3; ++i) {
+    mineBlocks(node, 1);
+    checkUnlockedOutputs(node);
+  }
+
+  ASSERT_TRUE(node.rollback_chain_to(node.get_current_blockchain_height() - 4));
+  checkUnlockedOutputs(node);
+  mineBlocks(node, 2);
+  checkUnlockedOutputs(node);
+}
+
+// Mixins are drawn with density rising linearly towards the newest unlocked output: P(index < k) = (k / count)^2
+TEST_F(RandomOutputsTest, samplerFollowsTriangularDistribution) {
+  core& node = openNode("node");
+  mineBlocks(node, currency.minedMoneyUnlockWindow() + 60);
+
+  auto outputs = chainOutputs(node);
+  uint64_t amount = 0;
+  size_t unlocked = 0;
+  uint32_t chainHeight = node.get_current_blockchain_height();
+  for (const auto& amountOutputs : outputs) {
+    size_t count = 0;
+    while (count < amountOutputs.second.size() && amountOutputs.second[count].first + currency.minedMoneyUnlockWindow() <= chainHeight) {
+      ++count;
+    }
+
+    if (count > unlocked) {
+      amount = amountOutputs.first;
+      unlocked = count;
+    }
+  }
+
+  ASSERT_GE(unlocked, 40);
+  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request request;
+  request.amounts.push_back(amount);
+  request.outs_count = 1;
+
+  const size_t sampleCount = 4000;
+  std::vector<size_t> picks(unlocked);
+  for (size_t i = 0; i < sampleCount; ++i) {
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response response;
+    ASSERT_TRUE(node.get_random_outs_for_amounts(request, response));
+    ASSERT_EQ(1, response.outs.size());
+    ASSERT_EQ(1, response.outs[0].outs.size());
+    uint32_t index = response.outs[0].outs[0].global_amount_index;
+    ASSERT_LT(index, unlocked);
+    ASSERT_EQ(outputs[amount][index].second, response.outs[0].outs[0].out_key);
+    ++picks[index];
+  }
+
+  for (size_t quarter = 1; quarter < 4; ++quarter) {
+    size_t bound = unlocked * quarter / 4;
+    size_t below = 0;
+    for (size_t i = 0; i < bound; ++i) {
+      below += picks[i];
+    }
+
+    double expected = static_cast<double>(bound) * bound / (static_cast<double>(unlocked) * unlocked);
+    ASSERT_NEAR(expected, static_cast<double>(below) / sampleCount, 0.04) << "below " << bound << " of " << unlocked;
+  }
+
+  ASSERT_GT(picks[unlocked - 1], 0);
+}
+
+// A request for several outputs of one amount never returns the same output twice
+TEST_F(RandomOutputsTest, outputsOfOneRequestAreDistinct) {
+  core& node = openNode("node");
+  mineBlocks(node, currency.minedMoneyUnlockWindow() + 20);
+
+  auto outputs = chainOutputs(node);
+  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request request;
+  for (const auto& amount : outputs) {
+    request.amounts.push_back(amount.first);
+  }
+
+  request.outs_count = 10;
+  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response response;
+  ASSERT_TRUE(node.get_random_outs_for_amounts(request, response));
+  ASSERT_EQ(request.amounts.size(), response.outs.size());
+  for (size_t i = 0; i < response.outs.size(); ++i) {
+    ASSERT_EQ(request.amounts[i], response.outs[i].amount);
+    std::set<uint32_t> indexes;
+    for (const auto& out : response.outs[i].outs) {
+      ASSERT_TRUE(indexes.insert(out.global_amount_index).second);
+    }
+
+    ASSERT_LE(response.outs[i].outs.size(), request.outs_count);
+  }
+}
+
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "Common/RecursiveSharedMutex.h"
+
+using namespace Tools;
+
+TEST(RecursiveSharedMutex, exclusiveOwnerMayLockAgain) {
+  RecursiveSharedMutex mutex;
+  std::lock_guard<RecursiveSharedMutex> lock(mutex);
+  std::lock_guard<RecursiveSharedMutex> nestedLock(mutex);
+  std::shared_lock<RecursiveSharedMutex> nestedSharedLock(mutex);
+
+  bool locked = true;
+  std::thread([&] { locked = mutex.try_lock_shared(); }).join();
+  ASSERT_FALSE(locked);
+}
+
+TEST(RecursiveSharedMutex, readersShareTheLock) {
+  RecursiveSharedMutex mutex;
+  std::shared_lock<RecursiveSharedMutex> lock(mutex);
+  std::shared_lock<RecursiveSharedMutex> nestedLock(mutex);
+
+  bool sharedLocked = false;
+  bool locked = true;
+  std::thread([&] {
+    sharedLocked = mutex.try_lock_shared();
+    if (sharedLocked) {
+      mutex.unlock_shared();
+    }
+
+    locked = mutex.try_lock();
+  }).join();
+
+  ASSERT_TRUE(sharedLocked);
+  ASSERT_FALSE(locked);
+  ASSERT_FALSE(mutex.try_lock());
+}
+
+TEST(RecursiveSharedMutex, releasedAfterOutermostUnlock) {
+  RecursiveSharedMutex mutex;
+  mutex.lock_shared();
+  mutex.lock_shared();
+  mutex.unlock_shared();
+
+  bool locked = true;
+  std::thread([&] { locked = mutex.try_lock(); }).join();
+  ASSERT_FALSE(locked);
+
+  mutex.unlock_shared();
+  std::thread([&] {
+    locked = mutex.try_lock();
+    if (locked) {
+      mutex.unlock();
+    }
+  }).join();
+
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, sharedOwnerCantUpgrade) {
+  RecursiveSharedMutex mutex;
+  std::shared_lock<RecursiveSharedMutex> lock(mutex);
+
+  ASSERT_FALSE(mutex.try_lock());
+  try {
+    mutex.lock();
+    FAIL() << "lock() upgraded a shared lock";
+  } catch (const std::system_error& error) {
+    ASSERT_EQ(std::errc::resource_deadlock_would_occur, error.code());
+  }
+
+  // the failed upgrade leaves the shared lock and the mutex usable
+  std::shared_lock<RecursiveSharedMutex> nestedLock(mutex);
+  lock.unlock();
+  nestedLock.unlock();
+  ASSERT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
+
+TEST(RecursiveSharedMutex, readersDontStarveWriter) {
+  RecursiveSharedMutex mutex;
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        std::shared_lock<RecursiveSharedMutex> lock(mutex);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  size_t writes = 0;
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+  while (std::chrono::steady_clock::now() < end) {
+    std::lock_guard<RecursiveSharedMutex> lock(mutex);
+    ++writes;
+  }
+
+  stop = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  ASSERT_GT(writes, 10);
+}
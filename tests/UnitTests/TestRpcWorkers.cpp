@@ -0,0 +1,195 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <System/ContextGroup.h>
+#include <System/Dispatcher.h>
+#include <System/InterruptedException.h>
+
+#include "Rpc/RpcWorkers.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+
+namespace {
+
+class RpcWorkersTest : public ::testing::Test {
+public:
+  RpcWorkersTest() : workers(dispatcher, logger), contextGroup(dispatcher), released(false), completed(0) {
+  }
+
+  ~RpcWorkersTest() {
+    release();
+    contextGroup.interrupt();
+    contextGroup.wait();
+  }
+
+  // Sends a request whose handler holds its thread until release()
+  void request(const std::string& method) {
+    contextGroup.spawn([this, method] {
+      workers.execute(method, [this, method] {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t running = ++runningByMethod[method];
+        peakByMethod[method] = std::max(peakByMethod[method], running);
+        releasedChanged.wait(lock, [this] { return released; });
+        --runningByMethod[method];
+      });
+
+      ++completed;
+    });
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+    releasedChanged.notify_all();
+  }
+
+  size_t running() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto& method : runningByMethod) {
+      count += method.second;
+    }
+
+    return count;
+  }
+
+  size_t peak(const std::string& method) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return peakByMethod[method];
+  }
+
+  // Lets the dispatcher run the requests until the condition holds
+  void waitFor(const std::function<bool()>& condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition()) {
+      ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+      dispatcher.yield();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  // Gives the requests a chance to pass a limit they shouldn't pass
+  void settle() {
+    for (size_t i = 0; i < 20; ++i) {
+      dispatcher.yield();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  Logging::LoggerGroup logger;
+  System::Dispatcher dispatcher;
+  RpcWorkers workers;
+  System::ContextGroup contextGroup;
+
+  std::mutex mutex;
+  std::condition_variable releasedChanged;
+  bool released;
+  std::map<std::string, size_t> runningByMethod;
+  std::map<std::string, size_t> peakByMethod;
+  size_t completed;
+};
+
+TEST_F(RpcWorkersTest, methodConcurrencyQueuesRequests) {
+  workers.setThreads(4, 2);
+  for (size_t i = 0; i < 4; ++i) {
+    request("f_blocks_list_json");
+  }
+
+  request("getblockheaderbyheight");
+
+  waitFor([this] { return running() == 3; });
+  settle();
+  ASSERT_EQ(3, running());
+  ASSERT_EQ(2, peak("f_blocks_list_json"));
+  ASSERT_EQ(3, workers.getActiveRequestsCount());
+  ASSERT_EQ(2, workers.getQueuedRequestsCount());
+
+  release();
+  waitFor([this] { return completed == 5; });
+  ASSERT_EQ(2, peak("f_blocks_list_json"));
+  ASSERT_EQ(0, workers.getActiveRequestsCount());
+  ASSERT_EQ(0, workers.getQueuedRequestsCount());
+}
+
+TEST_F(RpcWorkersTest, threadCountQueuesOtherMethods) {
+  workers.setThreads(2, 0);
+  request("getblockheaderbyhash");
+  request("getblockheaderbyheight");
+  request("getlastblockheader");
+
+  waitFor([this] { return running() == 2; });
+  settle();
+  ASSERT_EQ(2, running());
+  ASSERT_EQ(2, workers.getActiveRequestsCount());
+  ASSERT_EQ(1, workers.getQueuedRequestsCount());
+
+  release();
+  waitFor([this] { return completed == 3; });
+  ASSERT_EQ(0, workers.getActiveRequestsCount());
+  ASSERT_EQ(0, workers.getQueuedRequestsCount());
+}
+
+TEST_F(RpcWorkersTest, handlerRunsOnAnotherThread) {
+  workers.setThreads(1, 0);
+  std::thread::id handlerThread;
+  workers.execute("getblockcount", [&] { handlerThread = std::this_thread::get_id(); });
+  ASSERT_NE(std::this_thread::get_id(), handlerThread);
+
+  workers.setThreads(0, 0);
+  workers.execute("getblockcount", [&] { handlerThread = std::this_thread::get_id(); });
+  ASSERT_EQ(std::this_thread::get_id(), handlerThread);
+}
+
+TEST_F(RpcWorkersTest, failedHandlerReleasesItsWorker) {
+  workers.setThreads(1, 1);
+  ASSERT_THROW(workers.execute("f_block_json", [] { throw std::runtime_error("block not found"); }), std::runtime_error);
+  ASSERT_EQ(0, workers.getActiveRequestsCount());
+  ASSERT_EQ(0, workers.getQueuedRequestsCount());
+
+  bool handled = false;
+  workers.execute("f_block_json", [&] { handled = true; });
+  ASSERT_TRUE(handled);
+}
+
+TEST_F(RpcWorkersTest, interruptedRequestLeavesTheQueue) {
+  workers.setThreads(1, 1);
+  request("f_transaction_json");
+  request("f_transaction_json");
+
+  waitFor([this] { return running() == 1; });
+  ASSERT_EQ(1, workers.getQueuedRequestsCount());
+
+  // the queued request gives up, the running one still finishes
+  contextGroup.interrupt();
+  waitFor([this] { return workers.getQueuedRequestsCount() == 0; });
+  ASSERT_EQ(1, workers.getActiveRequestsCount());
+
+  release();
+  waitFor([this] { return workers.getActiveRequestsCount() == 0; });
+  ASSERT_EQ(1, peak("f_transaction_json"));
+}
+
+}
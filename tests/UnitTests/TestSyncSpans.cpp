@@ -0,0 +1,244 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include <boost/uuid/random_generator.hpp>
+
+#include <System/Dispatcher.h>
+
+#include "Common/StringTools.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
+#include "P2p/LevinProtocol.h"
+#include "crypto/crypto.h"
+
+#include "ICoreStub.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+using namespace Common;
+
+namespace {
+
+const size_t SPAN_SIZE = BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+
+// Keeps the connections the handler iterates over and the block requests it sends to them
+class SyncEndpoint : public p2p_endpoint_stub {
+public:
+  virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNoteConnectionContext& context) override {
+    if (command == NOTIFY_REQUEST_GET_OBJECTS::ID) {
+      NOTIFY_REQUEST_GET_OBJECTS::request request;
+      EXPECT_TRUE(LevinProtocol::decode(req_buff, request));
+      requests.push_back(std::make_pair(context.m_connection_id, request.blocks));
+    }
+
+    return true;
+  }
+
+  virtual void for_each_connection(std::function<void(CryptoNoteConnectionContext&, PeerIdType)> f) override {
+    for (auto& connection : connections) {
+      f(connection, 0);
+    }
+  }
+
+  virtual uint64_t get_connections_count() override {
+    return connections.size();
+  }
+
+  std::list<CryptoNoteConnectionContext> connections;
+  std::vector<std::pair<boost::uuids::uuid, std::vector<Crypto::Hash>>> requests;
+};
+
+class SyncSpansTest : public ::testing::Test {
+public:
+  SyncSpansTest() :
+    currency(CurrencyBuilder(logger).currency()),
+    protocol(currency, dispatcher, core, &endpoint, logger) {
+    protocol.setSyncMaxRequests(1);
+
+    Block known = makeBlock();
+    core.addBlock(known);
+    chain.push_back(get_block_hash(known));
+    for (size_t i = 0; i < 2 * SPAN_SIZE; ++i) {
+      blocks.push_back(makeBlock());
+      chain.push_back(get_block_hash(blocks.back()));
+    }
+  }
+
+  CryptoNoteConnectionContext& connect() {
+    endpoint.connections.emplace_back();
+    CryptoNoteConnectionContext& context = endpoint.connections.back();
+    context.version = P2P_CURRENT_VERSION;
+    context.m_connection_id = uuidGenerator();
+    context.m_state = CryptoNoteConnectionContext::state_synchronizing;
+    return context;
+  }
+
+  // The peer reports the whole chain, starting from the block the core has
+  void reportChain(CryptoNoteConnectionContext& context) {
+    NOTIFY_RESPONSE_CHAIN_ENTRY::request request;
+    request.start_height = 1;
+    request.total_height = static_cast<uint32_t>(chain.size());
+    request.m_block_ids = chain;
+    receive<NOTIFY_RESPONSE_CHAIN_ENTRY>(context, request);
+  }
+
+  // Sends the blocks of the span starting at the block with the given index
+  void sendSpan(CryptoNoteConnectionContext& context, size_t first) {
+    NOTIFY_RESPONSE_GET_OBJECTS::request response;
+    response.current_blockchain_height = static_cast<uint32_t>(chain.size());
+    for (size_t i = first; i < first + SPAN_SIZE; ++i) {
+      block_complete_entry entry;
+      entry.block = asString(toBinaryArray(blocks[i]));
+      response.blocks.push_back(entry);
+    }
+
+    receive<NOTIFY_RESPONSE_GET_OBJECTS>(context, response);
+  }
+
+  // Block ids requested from the connection since the last call, one vector per request
+  std::vector<std::vector<Crypto::Hash>> takeRequests(const CryptoNoteConnectionContext& context) {
+    std::vector<std::vector<Crypto::Hash>> requested;
+    for (auto it = endpoint.requests.begin(); it != endpoint.requests.end();) {
+      if (it->first == context.m_connection_id) {
+        requested.push_back(it->second);
+        it = endpoint.requests.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    return requested;
+  }
+
+  std::vector<Crypto::Hash> span(size_t first) const {
+    return std::vector<Crypto::Hash>(chain.begin() + 1 + first, chain.begin() + 1 + first + SPAN_SIZE);
+  }
+
+  template <typename Command>
+  void receive(CryptoNoteConnectionContext& context, const typename Command::request& request) {
+    BinaryArray response;
+    bool handled = false;
+    protocol.handleCommand(true, Command::ID, LevinProtocol::encode(request), response, context, handled);
+    ASSERT_TRUE(handled);
+  }
+
+  Block makeBlock() {
+    Block block;
+    block.majorVersion = BLOCK_MAJOR_VERSION_1;
+    block.minorVersion = 0;
+    block.timestamp = 0;
+    block.previousBlockHash = Crypto::rand<Crypto::Hash>();
+    block.nonce = 0;
+    block.baseTransaction.version = 1;
+    block.baseTransaction.unlockTime = 0;
+    block.baseTransaction.inputs.push_back(BaseInput{1});
+    return block;
+  }
+
+  Logging::LoggerGroup logger;
+  Currency currency;
+  ICoreStub core;
+  System::Dispatcher dispatcher;
+  SyncEndpoint endpoint;
+  CryptoNoteProtocolHandler protocol;
+  boost::uuids::random_generator uuidGenerator;
+
+  std::vector<Block> blocks;
+  std::vector<Crypto::Hash> chain; // the block the core has, then the ids of blocks
+};
+
+TEST_F(SyncSpansTest, spansAreRequestedFromDifferentPeers) {
+  auto& first = connect();
+  auto& second = connect();
+
+  reportChain(first);
+  reportChain(second);
+  ASSERT_EQ(std::vector<std::vector<Crypto::Hash>>{span(0)}, takeRequests(first));
+  ASSERT_EQ(std::vector<std::vector<Crypto::Hash>>{span(SPAN_SIZE)}, takeRequests(second));
+
+  // a peer gets the next span only when its request is answered
+  protocol.on_idle();
+  ASSERT_TRUE(takeRequests(first).empty());
+  ASSERT_TRUE(takeRequests(second).empty());
+}
+
+TEST_F(SyncSpansTest, receivedSpansAreImportedInOrder) {
+  auto& first = connect();
+  auto& second = connect();
+  reportChain(first);
+  reportChain(second);
+
+  // the second span waits for the first one
+  sendSpan(second, SPAN_SIZE);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_synchronizing, second.m_state);
+
+  sendSpan(first, 0);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_normal, first.m_state);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_normal, second.m_state);
+}
+
+TEST_F(SyncSpansTest, blockingSpanIsRequestedAgainFromAnotherPeer) {
+  auto& slow = connect();
+  auto& fast = connect();
+  reportChain(slow);
+  reportChain(fast);
+  takeRequests(slow);
+  takeRequests(fast);
+
+  sendSpan(fast, SPAN_SIZE);
+  protocol.on_idle();
+  ASSERT_TRUE(takeRequests(fast).empty());
+
+  // the span holding back the import is taken away from its peer sooner than the others
+  std::this_thread::sleep_for(std::chrono::seconds(BLOCKS_SYNCHRONIZING_TIMEOUT / 4 + 1));
+  protocol.on_idle();
+  ASSERT_EQ(std::vector<std::vector<Crypto::Hash>>{span(0)}, takeRequests(fast));
+  ASSERT_TRUE(takeRequests(slow).empty());
+
+  sendSpan(fast, 0);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_normal, fast.m_state);
+
+  // the copy arriving late is discarded without dropping the peer
+  sendSpan(slow, 0);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_normal, slow.m_state);
+}
+
+TEST_F(SyncSpansTest, disconnectedPeerSpanIsRequestedAgain) {
+  auto& leaving = connect();
+  auto& staying = connect();
+  reportChain(leaving);
+  reportChain(staying);
+  takeRequests(leaving);
+  takeRequests(staying);
+  sendSpan(staying, SPAN_SIZE);
+
+  protocol.onConnectionClosed(leaving);
+  boost::uuids::uuid id = leaving.m_connection_id;
+  endpoint.connections.remove_if([&](const CryptoNoteConnectionContext& connection) { return connection.m_connection_id == id; });
+
+  protocol.on_idle();
+  ASSERT_EQ(std::vector<std::vector<Crypto::Hash>>{span(0)}, takeRequests(staying));
+}
+
+}
@@ -0,0 +1,204 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "CryptoNoteCore/TransactionPoolSketch.h"
+#include "crypto/crypto.h"
+#include "crypto/siphash.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+std::vector<Crypto::Hash> randomHashes(size_t count) {
+  std::vector<Crypto::Hash> hashes(count);
+  for (auto& hash : hashes) {
+    hash = Crypto::rand<Crypto::Hash>();
+  }
+
+  return hashes;
+}
+
+std::vector<uint64_t> shortIds(const TransactionPoolSketch& sketch, const std::vector<Crypto::Hash>& hashes) {
+  std::vector<uint64_t> ids;
+  for (const auto& hash : hashes) {
+    ids.push_back(sketch.shortId(hash));
+  }
+
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Serialized cell holding only the id, taken from a sketch with one cell per part
+std::string pureCell(uint64_t id, bool negative) {
+  TransactionPoolSketch own(3, 0);
+  TransactionPoolSketch other(3, 0);
+  (negative ? other : own).insert(id);
+  own.subtract(other);
+  return own.toString().substr(sizeof(uint64_t), TransactionPoolSketch::CELL_SIZE);
+}
+
+}
+
+TEST(TransactionPoolSketch, decodesDifferenceOfLargePools) {
+  auto common = randomHashes(5000);
+  auto ownOnly = randomHashes(40);
+  auto otherOnly = randomHashes(30);
+
+  uint64_t salt = Crypto::rand<uint64_t>();
+  TransactionPoolSketch own(150, salt);
+  TransactionPoolSketch other(150, salt);
+  for (const auto& hash : common) {
+    own.insert(hash);
+    other.insert(hash);
+  }
+
+  for (const auto& hash : ownOnly) {
+    own.insert(hash);
+  }
+
+  for (const auto& hash : otherOnly) {
+    other.insert(hash);
+  }
+
+  own.subtract(other);
+
+  std::vector<uint64_t> decodedOwn;
+  std::vector<uint64_t> decodedOther;
+  ASSERT_TRUE(own.decode(decodedOwn, decodedOther));
+  std::sort(decodedOwn.begin(), decodedOwn.end());
+  std::sort(decodedOther.begin(), decodedOther.end());
+  EXPECT_EQ(shortIds(own, ownOnly), decodedOwn);
+  EXPECT_EQ(shortIds(own, otherOnly), decodedOther);
+}
+
+TEST(TransactionPoolSketch, failsWhenDifferenceExceedsCells) {
+  TransactionPoolSketch own(30, 1);
+  TransactionPoolSketch other(30, 1);
+  for (const auto& hash : randomHashes(200)) {
+    own.insert(hash);
+  }
+
+  own.subtract(other);
+
+  std::vector<uint64_t> decodedOwn;
+  std::vector<uint64_t> decodedOther;
+  EXPECT_FALSE(own.decode(decodedOwn, decodedOther));
+}
+
+TEST(TransactionPoolSketch, roundTripsThroughString) {
+  TransactionPoolSketch sketch(60, Crypto::rand<uint64_t>());
+  auto hashes = randomHashes(10);
+  for (const auto& hash : hashes) {
+    sketch.insert(hash);
+  }
+
+  TransactionPoolSketch restored;
+  ASSERT_TRUE(restored.fromString(sketch.toString()));
+  EXPECT_EQ(sketch.cellCount(), restored.cellCount());
+  EXPECT_EQ(sketch.salt(), restored.salt());
+
+  std::vector<uint64_t> decodedOwn;
+  std::vector<uint64_t> decodedOther;
+  ASSERT_TRUE(restored.decode(decodedOwn, decodedOther));
+  std::sort(decodedOwn.begin(), decodedOwn.end());
+  EXPECT_EQ(shortIds(sketch, hashes), decodedOwn);
+  EXPECT_TRUE(decodedOther.empty());
+
+  const size_t cellSize = TransactionPoolSketch::CELL_SIZE;
+  EXPECT_FALSE(restored.fromString(std::string()));
+  EXPECT_FALSE(restored.fromString(std::string(8, '\0')));
+  EXPECT_FALSE(restored.fromString(std::string(cellSize * 3, '\0')));
+  EXPECT_FALSE(restored.fromString(std::string(8 + cellSize * 3 + 1, '\0')));
+  EXPECT_FALSE(restored.fromString(std::string(8 + cellSize * 4, '\0')));
+  EXPECT_TRUE(restored.fromString(std::string(8 + cellSize * 6, '\0')));
+  EXPECT_EQ(6, restored.cellCount());
+}
+
+// Vectors of the SipHash paper: key 00 01 .. 0f, messages 00 01 .. of the given length
+TEST(TransactionPoolSketch, siphashMatchesReferenceVectors) {
+  uint8_t message[15];
+  for (uint8_t i = 0; i < sizeof(message); ++i) {
+    message[i] = i;
+  }
+
+  uint64_t k0 = 0x0706050403020100ULL;
+  uint64_t k1 = 0x0f0e0d0c0b0a0908ULL;
+  EXPECT_EQ(0x726fdb47dd0e0e31ULL, Crypto::siphash24(k0, k1, message, 0));
+  EXPECT_EQ(0x93f5f5799a932462ULL, Crypto::siphash24(k0, k1, message, 8));
+  EXPECT_EQ(0xa129ca6149be45e5ULL, Crypto::siphash24(k0, k1, message, 15));
+}
+
+TEST(TransactionPoolSketch, shortIdsDependOnSalt) {
+  auto hashes = randomHashes(100);
+  TransactionPoolSketch sketch(60, 1);
+  TransactionPoolSketch sameSalt(60, 1);
+  TransactionPoolSketch otherSalt(60, 2);
+
+  EXPECT_EQ(shortIds(sketch, hashes), shortIds(sameSalt, hashes));
+  auto ids = shortIds(sketch, hashes);
+  auto otherIds = shortIds(otherSalt, hashes);
+  std::vector<uint64_t> common;
+  std::set_intersection(ids.begin(), ids.end(), otherIds.begin(), otherIds.end(), std::back_inserter(common));
+  EXPECT_TRUE(common.empty());
+}
+
+// A cell counting an id twice offers it again once it is peeled, without the check the peeling never ends
+TEST(TransactionPoolSketch, repeatedIdFailsDecode) {
+  TransactionPoolSketch sketch(30, 0);
+  sketch.insert(12345);
+  std::string data = sketch.toString();
+
+  const size_t cellSize = TransactionPoolSketch::CELL_SIZE;
+  size_t cell = 0;
+  while (data.substr(8 + cell * cellSize, cellSize) == std::string(cellSize, '\0')) {
+    ++cell;
+  }
+
+  std::string doubled(cellSize, '\0');
+  doubled[0] = 2;
+  data.replace(8 + cell * cellSize, cellSize, doubled);
+
+  TransactionPoolSketch hostile;
+  ASSERT_TRUE(hostile.fromString(data));
+  std::vector<uint64_t> decodedOwn;
+  std::vector<uint64_t> decodedOther;
+  EXPECT_FALSE(hostile.decode(decodedOwn, decodedOther));
+}
+
+// Sketches made of pure cells only decode to at most one id per cell, or fail
+TEST(TransactionPoolSketch, pureCellsDecodeBounded) {
+  std::mt19937_64 random(1);
+  for (size_t cells : { 3, 30, 300 }) {
+    for (size_t round = 0; round < 20; ++round) {
+      std::string data(8, '\0');
+      for (size_t i = 0; i < cells; ++i) {
+        data += pureCell(round % 2 == 0 ? random() : random() % 4, random() % 2 == 0);
+      }
+
+      TransactionPoolSketch hostile;
+      ASSERT_TRUE(hostile.fromString(data));
+      std::vector<uint64_t> decodedOwn;
+      std::vector<uint64_t> decodedOther;
+      hostile.decode(decodedOwn, decodedOther);
+      EXPECT_LE(decodedOwn.size() + decodedOther.size(), cells);
+    }
+  }
+}
@@ -0,0 +1,369 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include <boost/uuid/random_generator.hpp>
+
+#include <System/Dispatcher.h>
+
+#include "Common/StringTools.h"
+#include "CryptoNoteCore/CryptoNoteFormatUtils.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/Currency.h"
+#include "CryptoNoteProtocol/CryptoNoteProtocolHandler.h"
+#include "P2p/LevinProtocol.h"
+#include "crypto/crypto.h"
+
+#include "ICoreStub.h"
+
+#include <Logging/LoggerGroup.h>
+
+using namespace CryptoNote;
+using namespace Common;
+
+namespace {
+
+// Keeps the connections the handler iterates over and the notifications it sends to them
+class RecordingEndpoint : public p2p_endpoint_stub {
+public:
+  struct Notification {
+    int command;
+    BinaryArray data;
+    boost::uuids::uuid connection;
+  };
+
+  virtual bool invoke_notify_to_peer(int command, const BinaryArray& req_buff, const CryptoNoteConnectionContext& context) override {
+    notifications.push_back(Notification{command, req_buff, context.m_connection_id});
+    return true;
+  }
+
+  virtual void for_each_connection(std::function<void(CryptoNoteConnectionContext&, PeerIdType)> f) override {
+    for (auto& connection : connections) {
+      f(connection, 0);
+    }
+  }
+
+  virtual uint64_t get_connections_count() override {
+    return connections.size();
+  }
+
+  virtual void externalRelayNotifyToList(int command, const BinaryArray& data_buff, const std::list<boost::uuids::uuid> relayList) override {
+    for (const auto& connection : relayList) {
+      notifications.push_back(Notification{command, data_buff, connection});
+    }
+  }
+
+  std::list<CryptoNoteConnectionContext> connections;
+  std::vector<Notification> notifications;
+};
+
+class TransactionRelayTest : public ::testing::Test {
+public:
+  TransactionRelayTest() :
+    currency(CurrencyBuilder(logger).currency()),
+    protocol(currency, dispatcher, core, &endpoint, logger) {
+  }
+
+  CryptoNoteConnectionContext& connect(uint8_t version = P2P_CURRENT_VERSION) {
+    endpoint.connections.emplace_back();
+    CryptoNoteConnectionContext& context = endpoint.connections.back();
+    context.version = version;
+    context.m_connection_id = uuidGenerator();
+    context.m_state = CryptoNoteConnectionContext::state_normal;
+    return context;
+  }
+
+  void disconnect(CryptoNoteConnectionContext& context) {
+    protocol.onConnectionClosed(context);
+    boost::uuids::uuid id = context.m_connection_id;
+    endpoint.connections.remove_if([&](const CryptoNoteConnectionContext& connection) { return connection.m_connection_id == id; });
+  }
+
+  void announce(CryptoNoteConnectionContext& context, const std::vector<Crypto::Hash>& transactions) {
+    NOTIFY_TX_HASHES::request request;
+    request.txs = transactions;
+    BinaryArray response;
+    bool handled = false;
+    protocol.handleCommand(true, NOTIFY_TX_HASHES::ID, LevinProtocol::encode(request), response, context, handled);
+    ASSERT_TRUE(handled);
+  }
+
+  // Transactions requested from the connection since the last call
+  std::vector<Crypto::Hash> takeRequests(const CryptoNoteConnectionContext& context) {
+    std::vector<Crypto::Hash> requested;
+    for (auto it = endpoint.notifications.begin(); it != endpoint.notifications.end();) {
+      if (it->command == NOTIFY_MISSING_TXS::ID && it->connection == context.m_connection_id) {
+        NOTIFY_MISSING_TXS::request request;
+        EXPECT_TRUE(LevinProtocol::decode(it->data, request));
+        EXPECT_EQ(NULL_HASH, request.blockHash);
+        requested.insert(requested.end(), request.missing_txs.begin(), request.missing_txs.end());
+        it = endpoint.notifications.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    return requested;
+  }
+
+  template <typename Command>
+  typename Command::request lastNotification(const CryptoNoteConnectionContext& context) const {
+    typename Command::request request;
+    for (const auto& notification : endpoint.notifications) {
+      if (notification.command == Command::ID && notification.connection == context.m_connection_id) {
+        EXPECT_TRUE(LevinProtocol::decode(notification.data, request));
+      }
+    }
+
+    return request;
+  }
+
+  template <typename Command>
+  void receive(CryptoNoteConnectionContext& context, const typename Command::request& request) {
+    BinaryArray response;
+    bool handled = false;
+    protocol.handleCommand(true, Command::ID, LevinProtocol::encode(request), response, context, handled);
+    ASSERT_TRUE(handled);
+  }
+
+  Transaction makeTransaction() {
+    Transaction transaction;
+    transaction.version = 1;
+    transaction.unlockTime = Crypto::rand<uint64_t>();
+    return transaction;
+  }
+
+  Block makeBlock(const std::vector<Transaction>& transactions) {
+    Block block;
+    block.majorVersion = BLOCK_MAJOR_VERSION_1;
+    block.minorVersion = 0;
+    block.timestamp = 0;
+    block.previousBlockHash = Crypto::rand<Crypto::Hash>();
+    block.nonce = 0;
+    block.baseTransaction.version = 1;
+    block.baseTransaction.unlockTime = 0;
+    block.baseTransaction.inputs.push_back(BaseInput{1});
+    for (const auto& transaction : transactions) {
+      block.transactionHashes.push_back(getObjectHash(transaction));
+    }
+
+    return block;
+  }
+
+  size_t countNotifications(const CryptoNoteConnectionContext& context, int command) const {
+    size_t count = 0;
+    for (const auto& notification : endpoint.notifications) {
+      if (notification.command == command && notification.connection == context.m_connection_id) {
+        ++count;
+      }
+    }
+
+    return count;
+  }
+
+  Logging::LoggerGroup logger;
+  Currency currency;
+  ICoreStub core;
+  System::Dispatcher dispatcher;
+  RecordingEndpoint endpoint;
+  CryptoNoteProtocolHandler protocol;
+  boost::uuids::random_generator uuidGenerator;
+};
+
+TEST_F(TransactionRelayTest, announcedTransactionIsRequestedFromOnePeer) {
+  auto& first = connect();
+  auto& second = connect();
+  Crypto::Hash transaction = Crypto::rand<Crypto::Hash>();
+
+  announce(first, {transaction});
+  announce(second, {transaction});
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(first));
+  ASSERT_TRUE(takeRequests(second).empty());
+
+  // known transactions aren't requested at all
+  Transaction knownTransaction;
+  knownTransaction.unlockTime = 1;
+  core.addTransaction(knownTransaction);
+  announce(second, {getObjectHash(knownTransaction)});
+  ASSERT_TRUE(takeRequests(second).empty());
+}
+
+TEST_F(TransactionRelayTest, pendingLiteBlockDefersRequest) {
+  auto& peer = connect();
+  peer.m_pending_lite_block = PendingLiteBlock{NOTIFY_NEW_LITE_BLOCK::request(), {}};
+  Crypto::Hash transaction = Crypto::rand<Crypto::Hash>();
+
+  announce(peer, {transaction});
+  protocol.on_idle();
+  ASSERT_TRUE(takeRequests(peer).empty());
+
+  peer.m_pending_lite_block = boost::none;
+  protocol.on_idle();
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(peer));
+}
+
+TEST_F(TransactionRelayTest, disconnectedPeerRequestGoesToNextAnnouncer) {
+  auto& first = connect();
+  auto& second = connect();
+  auto& third = connect();
+  Crypto::Hash transaction = Crypto::rand<Crypto::Hash>();
+
+  announce(first, {transaction});
+  announce(second, {transaction});
+  announce(third, {transaction});
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(first));
+
+  disconnect(second);
+  disconnect(first);
+  protocol.on_idle();
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(third));
+
+  // without announcers left the transaction is forgotten and requested from the next one announcing it
+  disconnect(third);
+  protocol.on_idle();
+  auto& fourth = connect();
+  announce(fourth, {transaction});
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(fourth));
+}
+
+TEST_F(TransactionRelayTest, timedOutRequestGoesToNextAnnouncer) {
+  auto& first = connect();
+  auto& second = connect();
+  Crypto::Hash transaction = Crypto::rand<Crypto::Hash>();
+
+  announce(first, {transaction});
+  announce(second, {transaction});
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(first));
+
+  protocol.on_idle();
+  ASSERT_TRUE(takeRequests(second).empty());
+
+  std::this_thread::sleep_for(std::chrono::seconds(P2P_TX_REQUEST_TIMEOUT));
+  protocol.on_idle();
+  ASSERT_EQ(std::vector<Crypto::Hash>{transaction}, takeRequests(second));
+  ASSERT_TRUE(takeRequests(first).empty());
+}
+
+TEST_F(TransactionRelayTest, requestedTransactionsAreBounded) {
+  auto& first = connect();
+  auto& second = connect();
+  size_t limit = P2P_TX_REQUESTED_LIMIT;
+
+  std::vector<Crypto::Hash> transactions;
+  for (size_t i = 0; i < limit + 10; ++i) {
+    transactions.push_back(Crypto::rand<Crypto::Hash>());
+  }
+
+  announce(first, transactions);
+  ASSERT_EQ(limit, takeRequests(first).size());
+
+  announce(second, {transactions.back()});
+  ASSERT_TRUE(takeRequests(second).empty());
+}
+
+TEST_F(TransactionRelayTest, olderPeersGetTransactionBodies) {
+  auto& older = connect(P2P_LITE_BLOCKS_PROPOGATION_VERSION);
+  auto& current = connect();
+
+  NOTIFY_NEW_TRANSACTIONS::request notification;
+  notification.txs.push_back("transaction");
+  static_cast<i_cryptonote_protocol&>(protocol).relay_transactions(notification);
+  protocol.on_idle();
+
+  ASSERT_EQ(1, countNotifications(older, NOTIFY_NEW_TRANSACTIONS::ID));
+  ASSERT_EQ(0, countNotifications(older, NOTIFY_TX_HASHES::ID));
+  ASSERT_EQ(0, countNotifications(current, NOTIFY_NEW_TRANSACTIONS::ID));
+  ASSERT_EQ(1, countNotifications(current, NOTIFY_TX_HASHES::ID));
+}
+
+TEST_F(TransactionRelayTest, peersGetNewestBlockFormatTheySupport) {
+  auto& full = connect(P2P_VERSION_2);
+  auto& lite = connect(P2P_LITE_BLOCKS_PROPOGATION_VERSION);
+  auto& compact = connect(P2P_COMPACT_BLOCKS_VERSION);
+
+  NOTIFY_NEW_BLOCK::request notification;
+  notification.b.block = asString(toBinaryArray(makeBlock({ makeTransaction(), makeTransaction() })));
+  notification.current_blockchain_height = 2;
+  notification.hop = 0;
+  static_cast<i_cryptonote_protocol&>(protocol).relay_block(notification);
+  dispatcher.yield();
+
+  for (auto connection : { &full, &lite, &compact }) {
+    EXPECT_EQ(connection == &full ? 1 : 0, countNotifications(*connection, NOTIFY_NEW_BLOCK::ID));
+    EXPECT_EQ(connection == &lite ? 1 : 0, countNotifications(*connection, NOTIFY_NEW_LITE_BLOCK::ID));
+    EXPECT_EQ(connection == &compact ? 1 : 0, countNotifications(*connection, NOTIFY_NEW_COMPACT_BLOCK::ID));
+  }
+}
+
+TEST_F(TransactionRelayTest, compactBlockRequestsTransactionsMissingFromPool) {
+  auto& publisher = connect();
+  auto& receiver = connect();
+  Transaction inPool = makeTransaction();
+  Transaction missing = makeTransaction();
+  Block block = makeBlock({ missing, inPool, makeTransaction() });
+
+  NOTIFY_NEW_BLOCK::request notification;
+  notification.b.block = asString(toBinaryArray(block));
+  notification.current_blockchain_height = 2;
+  notification.hop = 0;
+  static_cast<i_cryptonote_protocol&>(protocol).relay_block(notification);
+  dispatcher.yield();
+  auto compactBlock = lastNotification<NOTIFY_NEW_COMPACT_BLOCK>(publisher);
+  ASSERT_EQ(get_block_hash(block), compactBlock.block_hash);
+  size_t shortIdSize = COMPACT_BLOCK_SHORT_ID_SIZE;
+  ASSERT_EQ(3 * shortIdSize, compactBlock.short_ids.size());
+
+  core.addPoolTransaction(inPool);
+  receive<NOTIFY_NEW_COMPACT_BLOCK>(receiver, compactBlock);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_normal, receiver.m_state);
+  auto request = lastNotification<NOTIFY_REQUEST_COMPACT_BLOCK_TXS>(receiver);
+  ASSERT_EQ(get_block_hash(block), request.block_hash);
+  ASSERT_EQ(std::vector<uint32_t>({ 0, 2 }), request.indexes);
+}
+
+TEST_F(TransactionRelayTest, compactBlockTransactionRequestsAreValidated) {
+  std::vector<Transaction> transactions = { makeTransaction(), makeTransaction() };
+  for (const auto& transaction : transactions) {
+    core.addTransaction(transaction);
+  }
+
+  Block block = makeBlock(transactions);
+  core.addBlock(block);
+
+  auto& peer = connect();
+  NOTIFY_REQUEST_COMPACT_BLOCK_TXS::request request;
+  request.block_hash = get_block_hash(block);
+  request.indexes = { 1, 0 };
+  receive<NOTIFY_REQUEST_COMPACT_BLOCK_TXS>(peer, request);
+  ASSERT_EQ(CryptoNoteConnectionContext::state_normal, peer.m_state);
+  auto response = lastNotification<NOTIFY_COMPACT_BLOCK_TXS>(peer);
+  ASSERT_EQ(2, response.txs.size());
+  ASSERT_EQ(asString(toBinaryArray(transactions[1])), response.txs[0]);
+
+  for (auto indexes : { std::vector<uint32_t>{ 0, 0 }, std::vector<uint32_t>{ 0, 1, 1 }, std::vector<uint32_t>{ 2 } }) {
+    auto& hostile = connect();
+    request.indexes = indexes;
+    receive<NOTIFY_REQUEST_COMPACT_BLOCK_TXS>(hostile, request);
+    ASSERT_EQ(CryptoNoteConnectionContext::state_shutdown, hostile.m_state);
+    ASSERT_EQ(0, countNotifications(hostile, NOTIFY_COMPACT_BLOCK_TXS::ID));
+  }
+}
+
+}
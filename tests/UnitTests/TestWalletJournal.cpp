@@ -0,0 +1,201 @@
+// Copyright (c) 2017-2022 Fuego Developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <random>
+
+#include <boost/filesystem.hpp>
+
+#include "crypto/crypto.h"
+#include "Wallet/WalletJournal.h"
+
+using namespace CryptoNote;
+
+namespace {
+
+std::string randomBytes(std::mt19937& random, size_t size) {
+  std::string bytes(size, '\0');
+  for (char& byte : bytes) {
+    byte = static_cast<char>(random());
+  }
+
+  return bytes;
+}
+
+BinaryArray toBinaryArray(const std::string& data) {
+  return BinaryArray(data.begin(), data.end());
+}
+
+class WalletJournalTest : public ::testing::Test {
+public:
+  WalletJournalTest() :
+    directory(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("WalletJournalTest_%%%%%%%%")),
+    path((directory / "wallet.journal").string()),
+    random(1) {
+    boost::filesystem::create_directories(directory);
+    Crypto::cn_context context;
+    Crypto::generate_chacha8_key(context, "password", key);
+    cacheIv = Crypto::rand<Crypto::chacha8_iv>();
+  }
+
+  ~WalletJournalTest() {
+    boost::system::error_code ignore;
+    boost::filesystem::remove_all(directory, ignore);
+  }
+
+  uint64_t append(uint64_t validSize, const BinaryArray& data) {
+    return appendWalletJournal(path, validSize, key, cacheIv, Crypto::rand<Crypto::chacha8_iv>(), data);
+  }
+
+  uint64_t fileSize() const {
+    return boost::filesystem::file_size(path);
+  }
+
+  void corruptByte(uint64_t offset) {
+    std::fstream file(path, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    file.seekg(offset);
+    char byte = static_cast<char>(file.get());
+    file.seekp(offset);
+    file.put(static_cast<char>(byte ^ 1));
+  }
+
+  boost::filesystem::path directory;
+  std::string path;
+  std::mt19937 random;
+  Crypto::chacha8_key key;
+  Crypto::chacha8_iv cacheIv;
+};
+
+TEST_F(WalletJournalTest, deltaRebuildsTarget) {
+  std::string base = randomBytes(random, 10000);
+
+  std::string appended = base + randomBytes(random, 32);
+  std::string changed = base;
+  changed[5000] ^= 1;
+  std::string moved = base.substr(3000) + randomBytes(random, 7) + base.substr(0, 3000);
+
+  for (const std::string& target : { appended, changed, moved, base.substr(17, 5000) }) {
+    std::string delta = makeBinaryDelta(base, target);
+    ASSERT_EQ(target, applyBinaryDelta(base, delta));
+    ASSERT_LT(delta.size(), 200);
+  }
+}
+
+TEST_F(WalletJournalTest, deltaWithoutCommonData) {
+  std::string target = randomBytes(random, 1000);
+  for (const std::string& base : { std::string(), std::string("short"), randomBytes(random, 1000) }) {
+    ASSERT_EQ(target, applyBinaryDelta(base, makeBinaryDelta(base, target)));
+    ASSERT_EQ(std::string(), applyBinaryDelta(base, makeBinaryDelta(base, std::string())));
+  }
+}
+
+TEST_F(WalletJournalTest, deltaCopyOutsideBaseIsRejected) {
+  std::string base = randomBytes(random, 1000);
+  std::string delta = makeBinaryDelta(base, base);
+  ASSERT_THROW(applyBinaryDelta(base.substr(0, 500), delta), std::runtime_error);
+}
+
+TEST_F(WalletJournalTest, recordsAreReplayedInOrder) {
+  uint64_t validSize = 0;
+  for (uint8_t i = 0; i < 3; ++i) {
+    validSize = append(validSize, BinaryArray(100 + i, i));
+    ASSERT_EQ(validSize, fileSize());
+  }
+
+  WalletJournalRecords journal = loadWalletJournal(path, key, cacheIv);
+  ASSERT_FALSE(journal.truncated);
+  ASSERT_EQ(validSize, journal.validSize);
+  ASSERT_EQ(3, journal.records.size());
+  for (uint8_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(BinaryArray(100 + i, i), journal.records[i]);
+  }
+}
+
+TEST_F(WalletJournalTest, recordTornByCrashIsSkippedAndOverwritten) {
+  uint64_t validSize = append(0, BinaryArray(100, 1));
+  validSize = append(validSize, BinaryArray(100, 2));
+  uint64_t tornSize = append(validSize, BinaryArray(100, 3));
+  boost::filesystem::resize_file(path, tornSize - 10);
+
+  WalletJournalRecords journal = loadWalletJournal(path, key, cacheIv);
+  ASSERT_TRUE(journal.truncated);
+  ASSERT_EQ(validSize, journal.validSize);
+  ASSERT_EQ(2, journal.records.size());
+  ASSERT_EQ(BinaryArray(100, 2), journal.records[1]);
+
+  ASSERT_EQ(validSize + walletJournalRecordSize(10), append(journal.validSize, BinaryArray(10, 4)));
+  journal = loadWalletJournal(path, key, cacheIv);
+  ASSERT_FALSE(journal.truncated);
+  ASSERT_EQ(3, journal.records.size());
+  ASSERT_EQ(BinaryArray(10, 4), journal.records[2]);
+}
+
+TEST_F(WalletJournalTest, corruptedRecordEndsReplay) {
+  uint64_t firstSize = append(0, BinaryArray(100, 1));
+  uint64_t validSize = append(firstSize, BinaryArray(100, 2));
+  append(validSize, BinaryArray(100, 3));
+  corruptByte(firstSize + walletJournalRecordSize(50));
+
+  WalletJournalRecords journal = loadWalletJournal(path, key, cacheIv);
+  ASSERT_TRUE(journal.truncated);
+  ASSERT_EQ(firstSize, journal.validSize);
+  ASSERT_EQ(1, journal.records.size());
+}
+
+TEST_F(WalletJournalTest, journalOfEarlierCacheIsIgnored) {
+  append(0, BinaryArray(100, 1));
+
+  WalletJournalRecords journal = loadWalletJournal(path, key, Crypto::rand<Crypto::chacha8_iv>());
+  ASSERT_FALSE(journal.truncated);
+  ASSERT_EQ(0, journal.validSize);
+  ASSERT_TRUE(journal.records.empty());
+
+  journal = loadWalletJournal((directory / "missing.journal").string(), key, cacheIv);
+  ASSERT_EQ(0, journal.validSize);
+  ASSERT_TRUE(journal.records.empty());
+}
+
+// The synchronizer state grows by a block hash per block and changes a few fields elsewhere,
+// each record only carries the delta from the state of the record before it
+TEST_F(WalletJournalTest, synchronizerDeltasReplayToLatestState) {
+  std::string header = randomBytes(random, 64);
+  std::string hashes = randomBytes(random, 32 * 5000);
+  std::string state = header + hashes;
+  std::string base = state;
+
+  uint64_t validSize = 0;
+  for (size_t i = 0; i < 10; ++i) {
+    header[i] ^= 1;
+    hashes += randomBytes(random, 32 * 3);
+    std::string next = header + hashes;
+    std::string delta = makeBinaryDelta(state, next);
+    ASSERT_LT(delta.size(), 400);
+
+    validSize = append(validSize, toBinaryArray(delta));
+    state = next;
+  }
+
+  WalletJournalRecords journal = loadWalletJournal(path, key, cacheIv);
+  ASSERT_EQ(10, journal.records.size());
+  std::string replayed = base;
+  for (const BinaryArray& record : journal.records) {
+    replayed = applyBinaryDelta(replayed, std::string(record.begin(), record.end()));
+  }
+
+  ASSERT_EQ(state, replayed);
+}
+
+}